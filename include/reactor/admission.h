@@ -0,0 +1,230 @@
+/**
+ * @file admission.h
+ * @brief This header contains declaration of admission, which detects
+ * overload of reactor and sheds new work, so already admitted clients keep
+ * bounded latency during traffic spikes.
+ * Overload is detected from event_loop's phase hooks: loop lag is the time
+ * from return of the wait till the end of the batch (smoothed with moving
+ * average), backlog is the number of consecutive full batches. Once either
+ * crosses its high threshold, configured policy is applied: listeners are
+ * paused, new connections are rejected and/or read budgets are lowered.
+ * It is lifted with hysteresis, i.e. after lag drops below low threshold,
+ * batches are not full anymore and minimal hold time elapsed.
+ * All methods must be called from reactor's thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include "reactor.h"
+
+/**
+ * @brief Policy flag, which pauses added listeners (EPOLLIN is removed),
+ * so new connections wait in kernel's accept queue.
+ */
+#define ADMISSION_PAUSE_LISTENERS 0x1
+/**
+ * @brief Policy flag, which makes admit method refuse new connections,
+ * so they can be closed right after accept.
+ */
+#define ADMISSION_REJECT 0x2
+/**
+ * @brief Policy flag, which makes read_budget method return lowered budget.
+ */
+#define ADMISSION_LIMIT_READS 0x4
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * admission_config_s structure.
+ */
+typedef struct admission_config_s admission_config;
+/**
+ * @brief It is a configuration of admission control.
+ */
+struct admission_config_s {
+  /**
+   * @brief Policy flags, 0 means ADMISSION_PAUSE_LISTENERS | ADMISSION_LIMIT_READS.
+   */
+  uint32_t policy;
+  /**
+   * @brief Loop lag which starts overload, 0 means 10 ms.
+   */
+  uint32_t high_lag_us;
+  /**
+   * @brief Loop lag below which overload may end, 0 means half of high_lag_us.
+   */
+  uint32_t low_lag_us;
+  /**
+   * @brief Number of consecutive full batches which starts overload,
+   * 0 means 16.
+   */
+  uint32_t full_batches;
+  /**
+   * @brief Time for which loop lag must stay below low_lag_us without full
+   * batches before overload ends, 0 means 100 ms. It is measured from the
+   * first calm check, so any spike in the meantime starts it over.
+   */
+  uint32_t hold_ms;
+  /**
+   * @brief Divisor of read budget during overload, 0 means 4.
+   */
+  uint32_t read_divisor;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * admission_stats_s structure.
+ */
+typedef struct admission_stats_s admission_stats;
+/**
+ * @brief It is a snapshot of admission control state.
+ */
+struct admission_stats_s {
+  /**
+   * @brief It is not 0 while reactor is overloaded.
+   */
+  int overloaded;
+  /**
+   * @brief Number of times overload started.
+   */
+  unsigned long overloads;
+  /**
+   * @brief Number of connections refused by admit.
+   */
+  unsigned long rejected;
+  /**
+   * @brief Smoothed loop lag.
+   */
+  uint64_t lag_ns;
+  /**
+   * @brief Number of consecutive full batches.
+   */
+  unsigned long full_batches;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * admission_s structure.
+ */
+typedef struct admission_s admission;
+/**
+ * @brief It is an optional callback called by reactor's thread when
+ * overload starts or ends.
+ *
+ * @param a It is a pointer to the admission which changed the state.
+ * @param overloaded It is not 0 if overload started.
+ * @param arg An argument given to the constructor.
+ */
+typedef void (*admission_handler)(admission *a, int overloaded, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for admission_ctx_s structure. It is just a place for
+ * private data of admission. As a user of admission class, you should
+ * never use this member.
+ */
+typedef struct admission_ctx_s admission_ctx;
+struct admission_s {
+  /**
+   * @brief It is just a place for admission's private.
+   * As a user of admission class, you should never use this member.
+   */
+  admission_ctx *ctx;
+  /**
+   * @brief This method adds listener, which is paused during overload
+   * with ADMISSION_PAUSE_LISTENERS policy. It has to be registered in the
+   * reactor and stay registered till it is removed.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   * @param eh A listener.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*add_listener)(admission *self, const event_handler *eh);
+  /**
+   * @brief This method removes listener. Paused listener is resumed.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   * @param eh A listener.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*remove_listener)(admission *self, const event_handler *eh);
+  /**
+   * @brief This method decides whether just accepted connection should
+   * be served. It refuses connections only during overload with
+   * ADMISSION_REJECT policy.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   *
+   * @return 1 if connection is admitted, 0 if it should be closed.
+   */
+  int (*admit)(admission *self);
+  /**
+   * @brief This method gives number of bytes which connection should read
+   * in one handle_event call.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   * @param budget A budget without overload.
+   *
+   * @return Budget divided by read_divisor during overload with
+   * ADMISSION_LIMIT_READS policy (at least 1), budget otherwise.
+   */
+  size_t (*read_budget)(admission *self, size_t budget);
+  /**
+   * @brief This method takes the snapshot of admission control state.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   * @param stats An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_stats)(admission *self, admission_stats *stats);
+  /**
+   * @brief This is destructor. Hooks are removed and paused listeners
+   * are resumed.
+   *
+   * @param self It is a pointer to the admission wherefrom this method
+   * is called.
+   */
+  void (*destroy)(admission *self);
+};
+
+/**
+ * @brief It's constructor for stacked admissions.
+ *
+ * @param a Admission stacked instance.
+ * @param r A reactor which is watched.
+ * @param o Proxy to operating system calls, it has to provide clock_gettime.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used.
+ * @param h An optional callback.
+ * @param arg An argument passed to the callback.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int admission_init(admission *a, reactor *r, const os *o, const admission_config *cfg,
+                   admission_handler h, void *arg);
+/**
+ * @brief It's constructor to dynamically alloc admission.
+ *
+ * @param r A reactor which is watched.
+ * @param o Proxy to operating system calls, it has to provide clock_gettime.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used.
+ * @param h An optional callback.
+ * @param arg An argument passed to the callback.
+ *
+ * @return Pointer to admission in case of success, 0 otherwise.
+ */
+admission * admission_alloc(reactor *r, const os *o, const admission_config *cfg,
+                            admission_handler h, void *arg);
+
+#endif
@@ -0,0 +1,113 @@
+/**
+ * @file balancer.h
+ * @brief This header contains declaration of balancer, which evens out
+ * the load between reactors running in different threads by migrating
+ * event_handler's from the busiest reactor to the least busy one.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef BALANCER_H
+#define BALANCER_H
+
+#include "reactor.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * balancer_policy_s structure.
+ */
+typedef struct balancer_policy_s balancer_policy;
+/**
+ * @brief It is a configuration of balancer.
+ */
+struct balancer_policy_s {
+  /**
+   * @brief Migration is triggered only if the number of events handled by
+   * the busiest reactor since previous rebalance is at least imbalance_ratio
+   * times bigger than the number of events handled by the least busy one.
+   */
+  double imbalance_ratio;
+  /**
+   * @brief Migration is not triggered if the busiest reactor handled less
+   * events since previous rebalance. It protects from migrating on noise.
+   */
+  unsigned long min_events;
+  /**
+   * @brief Maximal number of event_handler's migrated by one rebalance.
+   */
+  unsigned int max_migrations;
+  /**
+   * @brief An optional filter, which returns 0 for event_handler's which
+   * must not be migrated (e.g. listening sockets).
+   */
+  int (*can_migrate)(const event_handler *e);
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * balancer_s structure.
+ */
+typedef struct balancer_s balancer;
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for balancer_ctx_s structure. It is just a place for
+ * private data of balancer. As a user of balancer class, you should
+ * never use this member.
+ */
+typedef struct balancer_ctx_s balancer_ctx;
+struct balancer_s {
+  /**
+   * @brief It is just a place for balancer's private.
+   * As a user of balancer class, you should never use this member.
+   */
+  balancer_ctx *ctx;
+  /**
+   * @brief This method compares the load of reactors since previous call
+   * and, if policy allows, asks the busiest reactor to migrate the excess
+   * of its event_handler's to the least busy one. Migration itself is
+   * executed by the busiest reactor's event_loop thread, so this method
+   * can be called from any thread (e.g. periodically from dedicated one),
+   * but not concurrently.
+   *
+   * @param self It is a pointer to the balancer wherefrom this method
+   * is called.
+   *
+   * @return 1 if migration was requested, 0 if reactors are balanced,
+   * -1 in case of error.
+   */
+  int (*rebalance)(balancer *self);
+  /**
+   * @brief This is destructor. It does not destroy balanced reactors.
+   *
+   * @param self It is a pointer to the balancer wherefrom this method
+   * is called.
+   */
+  void (*destroy)(balancer *self);
+};
+
+/**
+ * @brief It's constructor for stacked balancers.
+ *
+ * @param b Balancer stacked instance.
+ * @param reactors An array of balanced reactors. It is copied.
+ * @param cnt Number of reactors in array.
+ * @param p Balancer policy. It is copied.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int balancer_init(balancer *b, reactor **reactors, size_t cnt, const balancer_policy *p);
+/**
+ * @brief It's constructor to dynamically alloc balancer.
+ *
+ * @param reactors An array of balanced reactors. It is copied.
+ * @param cnt Number of reactors in array.
+ * @param p Balancer policy. It is copied.
+ *
+ * @return Pointer to balancer in case of success, 0 otherwise.
+ */
+balancer * balancer_alloc(reactor **reactors, size_t cnt, const balancer_policy *p);
+
+#endif
@@ -0,0 +1,206 @@
+/**
+ * @file buf_pool.h
+ * @brief This header contains declaration of buf_pool - per reactor pool
+ * of recycled I/O buffers grouped in size classes. Buffers are carved from
+ * big chunks of memory bound to the NUMA node of the reactor's thread and
+ * optionally backed by hugepages.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef BUF_POOL_H
+#define BUF_POOL_H
+
+#include "os.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Maximal number of size classes in buf_pool.
+ */
+#define BUF_POOL_MAX_CLASSES 8
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * io_buf_s structure.
+ */
+typedef struct io_buf_s io_buf;
+/**
+ * @brief It is an I/O buffer taken from buf_pool. Pending data is stored
+ * between begin and end offsets. The idea is to acquire it only while
+ * connection has pending data and to release it once data is drained,
+ * so idle connections do not keep any buffer memory.
+ */
+struct io_buf_s {
+  /**
+   * @brief Memory of buffer.
+   */
+  char *data;
+  /**
+   * @brief Capacity of buffer.
+   */
+  size_t size;
+  /**
+   * @brief Offset of the first pending byte.
+   */
+  size_t begin;
+  /**
+   * @brief Offset right after the last pending byte.
+   */
+  size_t end;
+  /**
+   * @brief It is pool's private member, you should never use it.
+   */
+  unsigned int cls;
+  /**
+   * @brief It is pool's private member, you should never use it.
+   */
+  io_buf *next;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * buf_pool_config_s structure.
+ */
+typedef struct buf_pool_config_s buf_pool_config;
+/**
+ * @brief It is a configuration of buf_pool.
+ */
+struct buf_pool_config_s {
+  /**
+   * @brief Sizes of buffers in ascending order. Unused entries should be 0.
+   * If the first entry is 0, default classes 2, 8, 32 and 128 KiB are used.
+   */
+  size_t classes[BUF_POOL_MAX_CLASSES];
+  /**
+   * @brief Size of memory chunk which is reserved at once for each class.
+   * It is rounded up to the multiple of buffer size. 0 means 2 MiB.
+   */
+  size_t chunk_size;
+  /**
+   * @brief If not 0, chunks are allocated from explicit hugepages, falling
+   * back to transparent hugepages if none are available.
+   */
+  int use_hugepages;
+  /**
+   * @brief If not 0, chunks are bound to numa_node, and acquire fails if
+   * they can not be. Otherwise chunks prefer the node of the thread calling
+   * acquire, which should be the reactor's thread.
+   */
+  int bind_numa_node;
+  /**
+   * @brief NUMA node where chunks are bound, if bind_numa_node is set.
+   */
+  int numa_node;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * buf_pool_stats_s structure.
+ */
+typedef struct buf_pool_stats_s buf_pool_stats;
+/**
+ * @brief It is a snapshot of buf_pool memory usage.
+ */
+struct buf_pool_stats_s {
+  /**
+   * @brief Memory reserved from the system.
+   */
+  size_t reserved_bytes;
+  /**
+   * @brief Memory of currently acquired buffers.
+   */
+  size_t used_bytes;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * buf_pool_s structure.
+ */
+typedef struct buf_pool_s buf_pool;
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for buf_pool_ctx_s structure. It is just a place for
+ * private data of buf_pool. As a user of buf_pool class, you should
+ * never use this member.
+ */
+typedef struct buf_pool_ctx_s buf_pool_ctx;
+/**
+ * @brief It is a pool of io_buf's. It is not thread safe, the idea is to
+ * have one pool per reactor.
+ */
+struct buf_pool_s {
+  /**
+   * @brief It is just a place for buf_pool's private.
+   * As a user of buf_pool class, you should never use this member.
+   */
+  buf_pool_ctx *ctx;
+  /**
+   * @brief This method takes empty buffer of the smallest class which
+   * is able to store size bytes.
+   *
+   * @param self It is a pointer to the buf_pool wherefrom this method
+   * is called.
+   * @param size Requested capacity.
+   *
+   * @return A buffer or 0 if size exceeds the biggest class or memory
+   * cannot be reserved.
+   */
+  io_buf * (*acquire)(buf_pool *self, size_t size);
+  /**
+   * @brief This method gives buffer back to the pool.
+   *
+   * @param self It is a pointer to the buf_pool wherefrom this method
+   * is called.
+   * @param b A buffer acquired from this pool.
+   */
+  void (*release)(buf_pool *self, io_buf *b);
+  /**
+   * @brief This method takes the snapshot of pool's memory usage.
+   *
+   * @param self It is a pointer to the buf_pool wherefrom this method
+   * is called.
+   * @param stats An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_stats)(buf_pool *self, buf_pool_stats *stats);
+  /**
+   * @brief This is destructor. It gives all reserved memory back to the
+   * system, so no buffer can be used afterwards.
+   *
+   * @param self It is a pointer to the buf_pool wherefrom this method
+   * is called.
+   */
+  void (*destroy)(buf_pool *self);
+};
+
+/**
+ * @brief It's constructor for stacked buf_pools. No memory is reserved
+ * until the first acquire.
+ *
+ * @param p Buf_pool stacked instance.
+ * @param o Proxy to operating system calls, it has to provide mmap
+ * and munmap. Hugepages are advised with madvise and chunks are placed
+ * with getcpu and mbind, if they are provided (mbind is required for
+ * bind_numa_node).
+ * @param cfg Configuration, 0 means defaults.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int buf_pool_init(buf_pool *p, const os *o, const buf_pool_config *cfg);
+/**
+ * @brief It's constructor to dynamically alloc buf_pool.
+ *
+ * @param o Proxy to operating system calls, it has to provide mmap
+ * and munmap. Hugepages are advised with madvise and chunks are placed
+ * with getcpu and mbind, if they are provided (mbind is required for
+ * bind_numa_node).
+ * @param cfg Configuration, 0 means defaults.
+ *
+ * @return Pointer to buf_pool in case of success, 0 otherwise.
+ */
+buf_pool * buf_pool_alloc(const os *o, const buf_pool_config *cfg);
+
+#endif
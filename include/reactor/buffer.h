@@ -0,0 +1,175 @@
+/**
+ * @file buffer.h
+ * @brief This header contains declaration of reference counted immutable
+ * buffers and per connection output queues, which let the same payload be
+ * queued on many connections without copying it and flush queued slices
+ * with a single writev.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include "os.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for shared_buf_s structure. It is an immutable, reference
+ * counted buffer. References can be taken and dropped from any thread.
+ */
+typedef struct shared_buf_s shared_buf;
+
+/**
+ * @brief It allocates shared_buf and copies data into it.
+ *
+ * @param data Data to be copied.
+ * @param size Size of data.
+ *
+ * @return A buffer with one reference or 0 in case of error.
+ */
+shared_buf * shared_buf_alloc(const void *data, size_t size);
+/**
+ * @brief It creates shared_buf which takes ownership of data without copying
+ * it. Data is released by given callback once the last reference is dropped.
+ *
+ * @param data Data to be wrapped.
+ * @param size Size of data.
+ * @param release A callback which releases data, it can be 0.
+ * @param arg An argument passed to the callback.
+ *
+ * @return A buffer with one reference or 0 in case of error.
+ */
+shared_buf * shared_buf_wrap(const void *data, size_t size,
+                             void (*release)(const void *data, void *arg), void *arg);
+/**
+ * @brief It takes additional reference to the buffer.
+ *
+ * @param b A buffer.
+ *
+ * @return The same buffer.
+ */
+shared_buf * shared_buf_ref(shared_buf *b);
+/**
+ * @brief It drops the reference to the buffer and frees it with the last one.
+ *
+ * @param b A buffer.
+ */
+void shared_buf_unref(shared_buf *b);
+/**
+ * @brief It gives access to the buffer's data.
+ *
+ * @param b A buffer.
+ *
+ * @return Pointer to data.
+ */
+const void * shared_buf_data(const shared_buf *b);
+/**
+ * @brief It gives the size of buffer's data.
+ *
+ * @param b A buffer.
+ *
+ * @return Size of data.
+ */
+size_t shared_buf_size(const shared_buf *b);
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * out_queue_s structure.
+ */
+typedef struct out_queue_s out_queue;
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for out_queue_ctx_s structure. It is just a place for
+ * private data of out_queue. As a user of out_queue class, you should
+ * never use this member.
+ */
+typedef struct out_queue_ctx_s out_queue_ctx;
+/**
+ * @brief It is a queue of slices of shared_buf's waiting to be written
+ * to a single connection. It is not thread safe, so it should be used
+ * only by the thread of the reactor where connection is registered.
+ */
+struct out_queue_s {
+  /**
+   * @brief It is just a place for out_queue's private.
+   * As a user of out_queue class, you should never use this member.
+   */
+  out_queue_ctx *ctx;
+  /**
+   * @brief This method appends a slice of buffer to the queue. The queue
+   * takes its own reference to the buffer and drops it once the slice
+   * is written.
+   *
+   * @param self It is a pointer to the out_queue wherefrom this method
+   * is called.
+   * @param b A buffer.
+   * @param offset Offset of slice in buffer.
+   * @param len Length of slice.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*push)(out_queue *self, shared_buf *b, size_t offset, size_t len);
+  /**
+   * @brief This method writes as much of queued slices as the socket
+   * accepts, using one writev for up to IOV_MAX slices.
+   *
+   * @param self It is a pointer to the out_queue wherefrom this method
+   * is called.
+   * @param fd A descriptor of connection.
+   *
+   * @return Number of written bytes (0 if socket would block)
+   * or -1 in case of error.
+   */
+  ssize_t (*flush)(out_queue *self, int fd);
+  /**
+   * @brief This method gives the number of bytes waiting to be written.
+   *
+   * @param self It is a pointer to the out_queue wherefrom this method
+   * is called.
+   *
+   * @return Number of pending bytes.
+   */
+  size_t (*pending)(out_queue *self);
+  /**
+   * @brief This is destructor. It drops references of all queued slices.
+   *
+   * @param self It is a pointer to the out_queue wherefrom this method
+   * is called.
+   */
+  void (*destroy)(out_queue *self);
+};
+
+/**
+ * @brief It's constructor for stacked out_queues.
+ *
+ * @param q Out_queue stacked instance.
+ * @param o Proxy to operating system calls, it has to provide writev.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int out_queue_init(out_queue *q, const os *o);
+/**
+ * @brief It's constructor to dynamically alloc out_queue.
+ *
+ * @param o Proxy to operating system calls, it has to provide writev.
+ *
+ * @return Pointer to out_queue in case of success, 0 otherwise.
+ */
+out_queue * out_queue_alloc(const os *o);
+/**
+ * @brief It queues whole buffer on many connections. The memory cost
+ * is one slice per connection, while payload is stored once.
+ *
+ * @param qs An array of out_queue's.
+ * @param cnt Number of out_queue's in array.
+ * @param b A buffer.
+ *
+ * @return Number of out_queue's where buffer was queued.
+ */
+size_t out_queue_broadcast(out_queue **qs, size_t cnt, shared_buf *b);
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * @file channel.h
+ * @brief This header contains declaration of channel - bounded lock-free
+ * ring buffer, which is used to pass fixed size messages to the reactor
+ * running in other thread without any system call per message.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "reactor.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Kinds of channel, which differ in number of allowed producers.
+ */
+typedef enum channel_kind_e {
+  /**
+   * @brief Single producer, single consumer channel. It is the cheapest one,
+   * but only one thread at the time is allowed to call send.
+   */
+  CHANNEL_SPSC,
+  /**
+   * @brief Multiple producers, single consumer channel. Any number of
+   * threads are allowed to call send concurrently.
+   */
+  CHANNEL_MPSC
+} channel_kind;
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * channel_s structure.
+ */
+typedef struct channel_s channel;
+/**
+ * @brief It is a callback which receives a batch of messages in consumer's
+ * thread. Messages are stored one after another in the channel's ring, so
+ * msgs can be used as an array of cnt messages, which is valid only until
+ * the callback returns.
+ *
+ * @param ch It is a pointer to the channel which delivers messages.
+ * @param msgs An array of messages.
+ * @param cnt Number of messages in array.
+ * @param arg An argument given to the channel's constructor.
+ */
+typedef void (*channel_handler)(channel *ch, const void *msgs, size_t cnt, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for channel_ctx_s structure. It is just a place for
+ * private data of channel. As a user of channel class, you should
+ * never use this member.
+ */
+typedef struct channel_ctx_s channel_ctx;
+struct channel_s {
+  /**
+   * @brief It is just a place for channel's private.
+   * As a user of channel class, you should never use this member.
+   */
+  channel_ctx *ctx;
+  /**
+   * @brief It is a built-in event_handler of consumer's side. It should be
+   * registered in consumer's reactor, which then drains the channel in
+   * batches. Its fd is an eventfd, which is signalled only when the channel
+   * becomes non-empty, so many messages sent in a row cost one wake-up.
+   */
+  event_handler eh;
+  /**
+   * @brief This method copies message into the channel. It never blocks.
+   *
+   * @param self It is a pointer to the channel wherefrom this method
+   * is called.
+   * @param msg A message of size given to the constructor.
+   *
+   * @return 0 in case of success, -1 if channel is full or in case of error.
+   */
+  int (*send)(channel *self, const void *msg);
+  /**
+   * @brief This method delivers pending messages to channel_handler, but
+   * not more than capacity of the channel in one call. If messages remain
+   * after that, the eventfd is signalled again. It is called by
+   * the built-in event_handler, but it can be also used to poll the channel.
+   * Only the consumer's thread may call it.
+   *
+   * @param self It is a pointer to the channel wherefrom this method
+   * is called.
+   *
+   * @return Number of delivered messages.
+   */
+  size_t (*drain)(channel *self);
+  /**
+   * @brief This is destructor. The built-in event_handler has to be
+   * unregistered from the reactor before.
+   *
+   * @param self It is a pointer to the channel wherefrom this method
+   * is called.
+   */
+  void (*destroy)(channel *self);
+};
+
+/**
+ * @brief It's constructor for stacked channels.
+ *
+ * @param ch Channel stacked instance.
+ * @param o Proxy to operating system calls, it has to provide eventfd.
+ * @param kind Kind of channel.
+ * @param msg_size Size of single message.
+ * @param capacity Maximal number of pending messages. It is rounded up
+ * to the power of 2.
+ * @param handler A callback for received messages.
+ * @param arg An argument passed to the callback.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int channel_init(channel *ch, const os *o, channel_kind kind, size_t msg_size,
+                 size_t capacity, channel_handler handler, void *arg);
+/**
+ * @brief It's constructor to dynamically alloc channel.
+ *
+ * @param o Proxy to operating system calls, it has to provide eventfd.
+ * @param kind Kind of channel.
+ * @param msg_size Size of single message.
+ * @param capacity Maximal number of pending messages. It is rounded up
+ * to the power of 2.
+ * @param handler A callback for received messages.
+ * @param arg An argument passed to the callback.
+ *
+ * @return Pointer to channel in case of success, 0 otherwise.
+ */
+channel * channel_alloc(const os *o, channel_kind kind, size_t msg_size,
+                        size_t capacity, channel_handler handler, void *arg);
+
+/**
+ * @brief It defines type safe send function name_send for channel
+ * of messages of given type.
+ *
+ * @param name Prefix of defined function.
+ * @param type Type of message.
+ */
+#define CHANNEL_DEFINE_TYPED(name, type) \
+  static inline int name##_send(channel *ch, const type *msg) \
+  { \
+    return ch->send(ch, msg); \
+  }
+
+#endif
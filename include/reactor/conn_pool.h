@@ -0,0 +1,150 @@
+/**
+ * @file conn_pool.h
+ * @brief This header contains declaration of conn_pool - keyed pool of
+ * outbound (upstream) connections, which reuses idle healthy connections
+ * and establishes new ones with connector.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef CONN_POOL_H
+#define CONN_POOL_H
+
+#include "connector.h"
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * conn_pool_config_s structure.
+ */
+typedef struct conn_pool_config_s conn_pool_config;
+/**
+ * @brief It is a configuration of conn_pool.
+ */
+struct conn_pool_config_s {
+  /**
+   * @brief Maximal number of idle connections kept per key. Connections
+   * released above this limit are closed.
+   */
+  unsigned int max_idle;
+  /**
+   * @brief Idle connections older than this are closed instead of being
+   * reused, 0 means no limit.
+   */
+  int max_idle_ms;
+  /**
+   * @brief Timeout of new connection attempts, 0 means no limit.
+   */
+  int connect_timeout_ms;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * conn_pool_s structure.
+ */
+typedef struct conn_pool_s conn_pool;
+/**
+ * @brief It is a callback which is called by reactor's thread with
+ * acquired connection.
+ *
+ * @param p It is a pointer to the pool.
+ * @param fd A connected socket or -1 in case of error. The connection
+ * should be given back with release method.
+ * @param err 0 in case of success, errno value otherwise.
+ * @param arg An argument given to the acquire method.
+ */
+typedef void (*conn_pool_handler)(conn_pool *p, int fd, int err, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for conn_pool_ctx_s structure. It is just a place for
+ * private data of conn_pool. As a user of conn_pool class, you should
+ * never use this member.
+ */
+typedef struct conn_pool_ctx_s conn_pool_ctx;
+/**
+ * @brief It is a pool of upstream connections. It is not thread safe,
+ * the idea is to have one pool per reactor.
+ */
+struct conn_pool_s {
+  /**
+   * @brief It is just a place for conn_pool's private.
+   * As a user of conn_pool class, you should never use this member.
+   */
+  conn_pool_ctx *ctx;
+  /**
+   * @brief This method acquires connection for given key. The most
+   * recently released idle connection, which passes health check (peer
+   * did not close it and did not send anything unsolicited), is reused.
+   * Otherwise new connection to addr is established. The callback is
+   * always called later by the reactor's thread.
+   *
+   * @param self It is a pointer to the conn_pool wherefrom this method
+   * is called.
+   * @param key A key of upstream, e.g. "host:port". It is copied.
+   * @param addr Address of upstream used for new connections.
+   * @param addrlen Length of address.
+   * @param h A callback.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 in case of success, -1 otherwise (callback won't be called).
+   */
+  int (*acquire)(conn_pool *self, const char *key, const struct sockaddr *addr,
+                 socklen_t addrlen, conn_pool_handler h, void *arg);
+  /**
+   * @brief This method gives connection back to the pool. The connection
+   * must not be registered in any reactor.
+   *
+   * @param self It is a pointer to the conn_pool wherefrom this method
+   * is called.
+   * @param key A key used to acquire connection.
+   * @param fd A connection.
+   * @param reusable 0 if connection must be closed (e.g. protocol error),
+   * otherwise it is kept idle if limits allow.
+   */
+  void (*release)(conn_pool *self, const char *key, int fd, int reusable);
+  /**
+   * @brief This method gives number of idle connections for given key.
+   *
+   * @param self It is a pointer to the conn_pool wherefrom this method
+   * is called.
+   * @param key A key of upstream.
+   *
+   * @return Number of idle connections.
+   */
+  unsigned int (*idle)(conn_pool *self, const char *key);
+  /**
+   * @brief This is destructor. It closes idle connections and cancels
+   * pending acquires: their handlers are called with fd -1 and ECANCELED
+   * error. The pool must not be used from these handlers.
+   *
+   * @param self It is a pointer to the conn_pool wherefrom this method
+   * is called.
+   */
+  void (*destroy)(conn_pool *self);
+};
+
+/**
+ * @brief It's constructor for stacked conn_pools.
+ *
+ * @param p Conn_pool stacked instance.
+ * @param r A reactor which drives connections.
+ * @param o Proxy to operating system calls, it has to provide the calls
+ * required by connector and also recv and clock_gettime.
+ * @param cfg Configuration.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int conn_pool_init(conn_pool *p, reactor *r, const os *o, const conn_pool_config *cfg);
+/**
+ * @brief It's constructor to dynamically alloc conn_pool.
+ *
+ * @param r A reactor which drives connections.
+ * @param o Proxy to operating system calls, it has to provide the calls
+ * required by connector and also recv and clock_gettime.
+ * @param cfg Configuration.
+ *
+ * @return Pointer to conn_pool in case of success, 0 otherwise.
+ */
+conn_pool * conn_pool_alloc(reactor *r, const os *o, const conn_pool_config *cfg);
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file connector.h
+ * @brief This header contains declaration of connector, which drives
+ * non-blocking outbound connections by the reactor, so connection
+ * establishment never stalls the event_loop.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef CONNECTOR_H
+#define CONNECTOR_H
+
+#include "reactor.h"
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * connector_s structure.
+ */
+typedef struct connector_s connector;
+/**
+ * @brief It is a callback which is called by reactor's thread once
+ * connection attempt is finished.
+ *
+ * @param c It is a pointer to the connector which made the attempt.
+ * @param fd A connected, non-blocking socket in case of success or -1
+ * otherwise. The ownership of socket is passed to the callback, it is not
+ * registered in any reactor.
+ * @param err 0 in case of success, errno value otherwise (ETIMEDOUT
+ * if connection was not established in given time).
+ * @param arg An argument given to the connect method.
+ */
+typedef void (*connector_handler)(connector *c, int fd, int err, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for connector_ctx_s structure. It is just a place for
+ * private data of connector. As a user of connector class, you should
+ * never use this member.
+ */
+typedef struct connector_ctx_s connector_ctx;
+struct connector_s {
+  /**
+   * @brief It is just a place for connector's private.
+   * As a user of connector class, you should never use this member.
+   */
+  connector_ctx *ctx;
+  /**
+   * @brief This method starts non-blocking connect. Completion is detected
+   * by EPOLLOUT on the socket and verified with SO_ERROR. Any number of
+   * connection attempts can be in progress at the same time. The callback
+   * is never called before this method returns.
+   *
+   * @param self It is a pointer to the connector wherefrom this method
+   * is called.
+   * @param addr Address of peer.
+   * @param addrlen Length of address.
+   * @param timeout_ms Maximal time of connection attempt, 0 means no limit.
+   * @param h A callback.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 if attempt was started, -1 otherwise (callback won't be called).
+   */
+  int (*connect)(connector *self, const struct sockaddr *addr, socklen_t addrlen,
+                 int timeout_ms, connector_handler h, void *arg);
+  /**
+   * @brief This is destructor. Attempts which are still in progress are
+   * cancelled without calling their callbacks.
+   *
+   * @param self It is a pointer to the connector wherefrom this method
+   * is called.
+   */
+  void (*destroy)(connector *self);
+};
+
+/**
+ * @brief It's constructor for stacked connectors.
+ *
+ * @param c Connector stacked instance.
+ * @param r A reactor which drives connection attempts.
+ * @param o Proxy to operating system calls, it has to provide socket,
+ * connect, getsockopt, timerfd_create and timerfd_settime.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int connector_init(connector *c, reactor *r, const os *o);
+/**
+ * @brief It's constructor to dynamically alloc connector.
+ *
+ * @param r A reactor which drives connection attempts.
+ * @param o Proxy to operating system calls, it has to provide socket,
+ * connect, getsockopt, timerfd_create and timerfd_settime.
+ *
+ * @return Pointer to connector in case of success, 0 otherwise.
+ */
+connector * connector_alloc(reactor *r, const os *o);
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file coro.h
+ * @brief This header contains declaration of coro - stackless coroutine
+ * bound to a socket, which lets multi-step protocols be written as
+ * sequential code instead of a state machine scattered across callbacks.
+ * Coroutine body is a function resumed by the reactor: CORO_BEGIN/CORO_END
+ * wrap it into a switch and each await macro stores a resumption point, so
+ * it continues right at the await once the socket or the timer is ready.
+ * Awaits do not allocate, the whole state of coroutine is its frame.
+ * Since the body returns on each wait, local variables do not survive
+ * awaits - everything which has to, should be kept in the frame. At most
+ * one await macro can be placed on one line and the body can not contain
+ * its own switch around awaits.
+ * All methods must be called from reactor's thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef CORO_H
+#define CORO_H
+
+#include "reactor.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Value returned by coroutine body and methods, when coroutine
+ * waits for the socket or the timer.
+ */
+#define CORO_WAIT 1
+/**
+ * @brief Value returned by coroutine body when it is finished and by
+ * methods when operation is completed.
+ */
+#define CORO_DONE 0
+
+/**
+ * @brief It opens the body of coroutine.
+ */
+#define CORO_BEGIN(co) switch ((co)->line) { case 0:
+/**
+ * @brief It closes the body of coroutine, which is then finished.
+ */
+#define CORO_END(co) } (co)->line = -1; return CORO_DONE
+/**
+ * @brief It waits until at least one byte is read, an error occurs or peer
+ * closes the connection. Result is stored in res (0 at the end of stream)
+ * and err members.
+ */
+#define CORO_READ(co, buf, len) \
+  do { \
+    (co)->line = __LINE__; case __LINE__: \
+    if (CORO_WAIT == (co)->read((co), (buf), (len))) return CORO_WAIT; \
+  } while (0)
+/**
+ * @brief It waits until whole buffer is written or an error occurs.
+ * Result is stored in res and err members.
+ */
+#define CORO_WRITE(co, buf, len) \
+  do { \
+    (co)->line = __LINE__; case __LINE__: \
+    if (CORO_WAIT == (co)->write((co), (buf), (len))) return CORO_WAIT; \
+  } while (0)
+/**
+ * @brief It waits given number of milliseconds, socket events are not
+ * awaited meanwhile. Result is stored in res and err members.
+ */
+#define CORO_SLEEP(co, ms) \
+  do { \
+    (co)->line = __LINE__; case __LINE__: \
+    if (CORO_WAIT == (co)->sleep((co), (ms))) return CORO_WAIT; \
+  } while (0)
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * coro_s structure.
+ */
+typedef struct coro_s coro;
+/**
+ * @brief It is a body of coroutine.
+ *
+ * @param co It is a pointer to the resumed coroutine.
+ *
+ * @return CORO_WAIT if coroutine waits, CORO_DONE if it is finished.
+ */
+typedef int (*coro_fn)(coro *co);
+/**
+ * @brief It is an optional callback called by reactor's thread once
+ * coroutine is finished. Coroutine is not registered in the reactor
+ * anymore, so it can be destroyed here.
+ *
+ * @param co It is a pointer to the finished coroutine.
+ * @param arg An argument given to the constructor.
+ */
+typedef void (*coro_handler)(coro *co, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for coro_ctx_s structure. It is just a place for
+ * private data of coro. As a user of coro class, you should
+ * never use this member.
+ */
+typedef struct coro_ctx_s coro_ctx;
+struct coro_s {
+  /**
+   * @brief It is just a place for coro's private.
+   * As a user of coro class, you should never use this member.
+   */
+  coro_ctx *ctx;
+  /**
+   * @brief An event handler of the socket, which resumes coroutine.
+   * As a user of coro class, you should never use this member.
+   */
+  event_handler eh;
+  /**
+   * @brief A resumption point, which is maintained by the macros.
+   * 0 means the beginning, -1 means finished coroutine.
+   */
+  int line;
+  /**
+   * @brief Result of the last await.
+   */
+  ssize_t res;
+  /**
+   * @brief 0 if the last await succeeded, errno value otherwise.
+   */
+  int err;
+  /**
+   * @brief A frame of coroutine, i.e. state which survives awaits.
+   */
+  void *frame;
+  /**
+   * @brief This method registers the socket in the reactor and runs
+   * the body till the first wait.
+   *
+   * @param self It is a pointer to the coro wherefrom this method
+   * is called.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*start)(coro *self);
+  /**
+   * @brief This method is awaitable read used by CORO_READ.
+   *
+   * @param self It is a pointer to the coro wherefrom this method
+   * is called.
+   * @param buf A buffer.
+   * @param len Size of buffer.
+   *
+   * @return CORO_WAIT if coroutine has to wait, CORO_DONE otherwise.
+   */
+  int (*read)(coro *self, void *buf, size_t len);
+  /**
+   * @brief This method is awaitable write used by CORO_WRITE.
+   *
+   * @param self It is a pointer to the coro wherefrom this method
+   * is called.
+   * @param buf A buffer, it has to stay the same till write is completed.
+   * @param len Size of buffer.
+   *
+   * @return CORO_WAIT if coroutine has to wait, CORO_DONE otherwise.
+   */
+  int (*write)(coro *self, const void *buf, size_t len);
+  /**
+   * @brief This method is awaitable sleep used by CORO_SLEEP.
+   *
+   * @param self It is a pointer to the coro wherefrom this method
+   * is called.
+   * @param ms Number of milliseconds.
+   *
+   * @return CORO_WAIT if coroutine has to wait, CORO_DONE otherwise.
+   */
+  int (*sleep)(coro *self, unsigned int ms);
+  /**
+   * @brief This is destructor. Running coroutine is unregistered from the
+   * reactor without finishing it, the socket is not closed.
+   *
+   * @param self It is a pointer to the coro wherefrom this method
+   * is called.
+   */
+  void (*destroy)(coro *self);
+};
+
+/**
+ * @brief It's constructor for stacked coro's.
+ *
+ * @param co Coro stacked instance.
+ * @param r A reactor which resumes coroutine.
+ * @param o Proxy to operating system calls, it has to provide read, write,
+ * timerfd_create and timerfd_settime.
+ * @param fd A non-blocking socket, it is not owned by coroutine.
+ * @param fn A body of coroutine.
+ * @param frame A frame of coroutine.
+ * @param h An optional callback called once coroutine is finished.
+ * @param arg An argument passed to the callback.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int coro_init(coro *co, reactor *r, const os *o, int fd, coro_fn fn, void *frame,
+              coro_handler h, void *arg);
+/**
+ * @brief It's constructor to dynamically alloc coro.
+ *
+ * @param r A reactor which resumes coroutine.
+ * @param o Proxy to operating system calls, it has to provide read, write,
+ * timerfd_create and timerfd_settime.
+ * @param fd A non-blocking socket, it is not owned by coroutine.
+ * @param fn A body of coroutine.
+ * @param frame A frame of coroutine.
+ * @param h An optional callback called once coroutine is finished.
+ * @param arg An argument passed to the callback.
+ *
+ * @return Pointer to coro in case of success, 0 otherwise.
+ */
+coro * coro_alloc(reactor *r, const os *o, int fd, coro_fn fn, void *frame,
+                  coro_handler h, void *arg);
+
+#endif
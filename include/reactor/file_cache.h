@@ -0,0 +1,258 @@
+/**
+ * @file file_cache.h
+ * @brief This header contains declaration of file_cache - LRU cache of open
+ * files for serving static content. Small hot files are also kept mapped
+ * into memory, so they are sent with a single writev together with response
+ * headers, bigger files are sent with sendfile from cached descriptor.
+ * Files are opened and pre-faulted by file_io's helper threads, so misses
+ * never block reactor's thread. Cache is bounded by number of entries and
+ * by mapped bytes, least recently used entries which are not in use are
+ * evicted first.
+ * All methods must be called from reactor's thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include "file_io.h"
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Maximal number of headers passed to send method.
+ */
+#define FILE_CACHE_MAX_HEADERS 15
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_entry_s structure.
+ */
+typedef struct file_entry_s file_entry;
+/**
+ * @brief It is a cached file. It stays valid till it is released.
+ */
+struct file_entry_s {
+  /**
+   * @brief Path of file.
+   */
+  const char *path;
+  /**
+   * @brief Open file descriptor.
+   */
+  int fd;
+  /**
+   * @brief Size of file.
+   */
+  size_t size;
+  /**
+   * @brief Modification time of file.
+   */
+  struct timespec mtime;
+  /**
+   * @brief Mapping of whole file, 0 if file is not mapped.
+   */
+  const void *data;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_cache_config_s structure.
+ */
+typedef struct file_cache_config_s file_cache_config;
+/**
+ * @brief It is a configuration of file_cache.
+ */
+struct file_cache_config_s {
+  /**
+   * @brief Maximal number of mapped bytes, 0 means 64 MiB.
+   */
+  size_t budget_bytes;
+  /**
+   * @brief Maximal size of file which is mapped, 0 means 64 KiB.
+   */
+  size_t map_max;
+  /**
+   * @brief Maximal number of cached files, 0 means 1024.
+   */
+  size_t max_entries;
+  /**
+   * @brief Number of file_io's helper threads, 0 means 4.
+   */
+  unsigned int threads;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_cache_stats_s structure.
+ */
+typedef struct file_cache_stats_s file_cache_stats;
+/**
+ * @brief It is a snapshot of file_cache counters.
+ */
+struct file_cache_stats_s {
+  /**
+   * @brief Number of cached files.
+   */
+  size_t entries;
+  /**
+   * @brief Number of mapped bytes.
+   */
+  size_t bytes;
+  /**
+   * @brief Number of successful acquires.
+   */
+  unsigned long hits;
+  /**
+   * @brief Number of loads.
+   */
+  unsigned long misses;
+  /**
+   * @brief Number of evicted files.
+   */
+  unsigned long evictions;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_cache_s structure.
+ */
+typedef struct file_cache_s file_cache;
+/**
+ * @brief It is a callback called by reactor's thread once file is loaded.
+ * The file_cache and its file_io must not be destroyed here.
+ *
+ * @param c It is a pointer to the file_cache which loaded the file.
+ * @param e An acquired entry, which has to be released, 0 in case of error.
+ * @param err 0 in case of success, errno value otherwise.
+ * @param arg An argument given to the load method.
+ */
+typedef void (*file_cache_handler)(file_cache *c, const file_entry *e, int err, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for file_cache_ctx_s structure. It is just a place for
+ * private data of file_cache. As a user of file_cache class, you should
+ * never use this member.
+ */
+typedef struct file_cache_ctx_s file_cache_ctx;
+struct file_cache_s {
+  /**
+   * @brief It is just a place for file_cache's private.
+   * As a user of file_cache class, you should never use this member.
+   */
+  file_cache_ctx *ctx;
+  /**
+   * @brief This method takes cached file without blocking.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param path Path of file.
+   *
+   * @return Acquired entry, which has to be released, or 0 if file is not
+   * cached yet (it should be loaded then).
+   */
+  const file_entry * (*acquire)(file_cache *self, const char *path);
+  /**
+   * @brief This method loads file into the cache by file_io. Concurrent
+   * loads of the same file are merged. The callback is never called before
+   * this method returns.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param path Path of file, it is copied.
+   * @param h A callback.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 if load was started or joined, -1 otherwise (e.g. file is
+   * already cached).
+   */
+  int (*load)(file_cache *self, const char *path, file_cache_handler h, void *arg);
+  /**
+   * @brief This method releases acquired entry.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param e An entry.
+   */
+  void (*release)(file_cache *self, const file_entry *e);
+  /**
+   * @brief This method sends headers followed by the content of file.
+   * Mapped files are sent with writev, others with writev of headers and
+   * sendfile of content. It may send less than requested, so it should be
+   * called again with advanced offset once socket is writable.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param sock A socket.
+   * @param hdr Optional headers, they have to be the same in all calls.
+   * @param hdr_cnt Number of headers, at most FILE_CACHE_MAX_HEADERS.
+   * @param e An acquired entry.
+   * @param off Number of bytes (headers included) sent already.
+   *
+   * @return Number of sent bytes, -1 in case of error (errno is set).
+   */
+  ssize_t (*send)(file_cache *self, int sock, const struct iovec *hdr, int hdr_cnt,
+                  const file_entry *e, size_t off);
+  /**
+   * @brief This method drops file from the cache, so next load opens it
+   * again. Entry which is in use is freed on its last release.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param path Path of file.
+   *
+   * @return 0 in case of success, -1 if file is not cached.
+   */
+  int (*invalidate)(file_cache *self, const char *path);
+  /**
+   * @brief This method takes the snapshot of file_cache counters.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   * @param stats An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_stats)(file_cache *self, file_cache_stats *stats);
+  /**
+   * @brief This is destructor. Callbacks of pending loads are called with
+   * ECANCELED error, all files are closed and unmapped, so entries must not
+   * be used afterwards. It must not be called from a file_cache_handler
+   * or a file_io_handler of the underlying file_io.
+   *
+   * @param self It is a pointer to the file_cache wherefrom this method
+   * is called.
+   */
+  void (*destroy)(file_cache *self);
+};
+
+/**
+ * @brief It's constructor for stacked file_cache's.
+ *
+ * @param c File_cache stacked instance.
+ * @param r A reactor which delivers loaded files.
+ * @param o Proxy to operating system calls, it has to provide everything
+ * what file_io needs, writev and sendfile.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int file_cache_init(file_cache *c, reactor *r, const os *o, const file_cache_config *cfg);
+/**
+ * @brief It's constructor to dynamically alloc file_cache.
+ *
+ * @param r A reactor which delivers loaded files.
+ * @param o Proxy to operating system calls, it has to provide everything
+ * what file_io needs, writev and sendfile.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used.
+ *
+ * @return Pointer to file_cache in case of success, 0 otherwise.
+ */
+file_cache * file_cache_alloc(reactor *r, const os *o, const file_cache_config *cfg);
+
+#endif
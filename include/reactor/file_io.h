@@ -0,0 +1,160 @@
+/**
+ * @file file_io.h
+ * @brief This header contains declaration of file_io, which performs
+ * blocking file operations (open, stat, read) by a pool of helper threads,
+ * so page cache misses never stall the event_loop. Completions are passed
+ * back through the channel, whose event_handler is registered in the
+ * reactor, and callbacks are called by reactor's thread.
+ * Requests and callbacks must be issued from reactor's thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include "reactor.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_io_result_s structure.
+ */
+typedef struct file_io_result_s file_io_result;
+/**
+ * @brief It is an outcome of file operation.
+ */
+struct file_io_result_s {
+  /**
+   * @brief A file descriptor, which is opened by open request (its ownership
+   * is passed to the callback) or given to read request.
+   */
+  int fd;
+  /**
+   * @brief Number of read bytes for read request, 0 for open request,
+   * -1 in case of error.
+   */
+  ssize_t res;
+  /**
+   * @brief 0 in case of success, errno value otherwise.
+   */
+  int err;
+  /**
+   * @brief Size of opened file.
+   */
+  size_t size;
+  /**
+   * @brief Modification time of opened file.
+   */
+  struct timespec mtime;
+  /**
+   * @brief Read-only, pre-faulted mapping of whole opened file if it was
+   * requested and file fits the limit, 0 otherwise. Its ownership is passed
+   * to the callback.
+   */
+  void *data;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * file_io_s structure.
+ */
+typedef struct file_io_s file_io;
+/**
+ * @brief It is a callback which is called by reactor's thread once
+ * request is completed. The file_io must not be destroyed here, also
+ * not indirectly by destroying a file_cache built on it.
+ *
+ * @param fio It is a pointer to the file_io which completed the request.
+ * @param res An outcome of the request.
+ * @param arg An argument given to the request.
+ */
+typedef void (*file_io_handler)(file_io *fio, const file_io_result *res, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for file_io_ctx_s structure. It is just a place for
+ * private data of file_io. As a user of file_io class, you should
+ * never use this member.
+ */
+typedef struct file_io_ctx_s file_io_ctx;
+struct file_io_s {
+  /**
+   * @brief It is just a place for file_io's private.
+   * As a user of file_io class, you should never use this member.
+   */
+  file_io_ctx *ctx;
+  /**
+   * @brief This method requests opening of file for reading.
+   * The callback is never called before this method returns.
+   *
+   * @param self It is a pointer to the file_io wherefrom this method
+   * is called.
+   * @param path Path of file, it is copied.
+   * @param map_max Maximal size of file, which is also mapped into memory,
+   * 0 means never.
+   * @param h A callback.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 if request was queued, -1 otherwise (e.g. too many requests
+   * are in progress).
+   */
+  int (*open)(file_io *self, const char *path, size_t map_max, file_io_handler h, void *arg);
+  /**
+   * @brief This method requests reading of file at given offset.
+   * The callback is never called before this method returns.
+   *
+   * @param self It is a pointer to the file_io wherefrom this method
+   * is called.
+   * @param fd A file descriptor, it has to stay open till the callback.
+   * @param buf A buffer, it has to stay valid till the callback.
+   * @param len Size of buffer.
+   * @param off Offset in file.
+   * @param h A callback.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 if request was queued, -1 otherwise.
+   */
+  int (*read)(file_io *self, int fd, void *buf, size_t len, off_t off, file_io_handler h, void *arg);
+  /**
+   * @brief This is destructor. Helper threads are joined, then callbacks
+   * of requests which are not delivered yet are called with -1 result and
+   * ECANCELED error (opened files are closed and unmapped), so their
+   * buffers may be released there. No new request is accepted meanwhile.
+   * It must not be called from a file_io_handler, because completions are
+   * being delivered there.
+   *
+   * @param self It is a pointer to the file_io wherefrom this method
+   * is called.
+   */
+  void (*destroy)(file_io *self);
+};
+
+/**
+ * @brief It's constructor for stacked file_io's.
+ *
+ * @param fio File_io stacked instance.
+ * @param r A reactor which delivers completions.
+ * @param o Proxy to operating system calls, it has to provide open, fstat,
+ * pread, mmap, munmap, close and eventfd.
+ * @param threads Number of helper threads, 0 means 4.
+ * @param capacity Maximal number of requests in progress, 0 means 1024.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int file_io_init(file_io *fio, reactor *r, const os *o, unsigned int threads, size_t capacity);
+/**
+ * @brief It's constructor to dynamically alloc file_io.
+ *
+ * @param r A reactor which delivers completions.
+ * @param o Proxy to operating system calls, it has to provide open, fstat,
+ * pread, mmap, munmap, close and eventfd.
+ * @param threads Number of helper threads, 0 means 4.
+ * @param capacity Maximal number of requests in progress, 0 means 1024.
+ *
+ * @return Pointer to file_io in case of success, 0 otherwise.
+ */
+file_io * file_io_alloc(reactor *r, const os *o, unsigned int threads, size_t capacity);
+
+#endif
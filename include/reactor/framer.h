@@ -0,0 +1,237 @@
+/**
+ * @file framer.h
+ * @brief This header contains declaration of framer - built-in event_handler,
+ * which reads data from descriptor, splits it into messages with pluggable
+ * decoder and hands them to the application in batches as zero-copy views
+ * of the read buffer.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef FRAMER_H
+#define FRAMER_H
+
+#include "reactor.h"
+#include "buf_pool.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Maximal number of frames delivered in one batch.
+ */
+#define FRAMER_MAX_BATCH 64
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * frame_s structure.
+ */
+typedef struct frame_s frame;
+/**
+ * @brief It is a view of single message inside of the read buffer.
+ * Framing bytes (delimiter, length prefix) are not part of the view.
+ */
+struct frame_s {
+  /**
+   * @brief The first byte of message.
+   */
+  const char *data;
+  /**
+   * @brief Length of message.
+   */
+  size_t len;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * decoder_s structure.
+ */
+typedef struct decoder_s decoder;
+/**
+ * @brief It is a decoder stage, which finds the first message in data.
+ * Built-in decoders are set up by decoder_*_init functions, but any
+ * decode method can be plugged in.
+ */
+struct decoder_s {
+  /**
+   * @brief This method finds the first message in data.
+   *
+   * @param self It is a pointer to the decoder wherefrom this method
+   * is called.
+   * @param data Pending data.
+   * @param len Length of pending data.
+   * @param f An output view of found message.
+   *
+   * @return Number of consumed bytes (including framing) if message was
+   * found, 0 if more data is needed, -1 in case of protocol error.
+   */
+  ssize_t (*decode)(const decoder *self, const char *data, size_t len, frame *f);
+  /**
+   * @brief Delimiter of line decoder.
+   */
+  char delimiter;
+  /**
+   * @brief Size of big-endian length prefix (1, 2 or 4) of
+   * length-prefixed decoder.
+   */
+  unsigned int prefix_size;
+  /**
+   * @brief Size of message of fixed-size decoder or maximal size of message
+   * of other decoders.
+   */
+  size_t size;
+  /**
+   * @brief Number of leading bytes of pending data, which were already
+   * passed to decode without a complete message. Framer keeps it in its own
+   * copy of decoder and resets it when a message is consumed, so line decoder
+   * resumes search of delimiter instead of rescanning partial message.
+   */
+  size_t scanned;
+  /**
+   * @brief It is a place for private data of custom decoders.
+   */
+  void *ctx;
+};
+
+/**
+ * @brief It sets up decoder of delimited messages (e.g. text lines).
+ * Delimiter is searched with SSE2/AVX2 when available.
+ *
+ * @param d A decoder.
+ * @param delimiter A delimiter of messages, e.g. '\n'.
+ * @param max_size Maximal size of message, longer ones are protocol errors.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int decoder_line_init(decoder *d, char delimiter, size_t max_size);
+/**
+ * @brief It sets up decoder of messages preceded by big-endian length.
+ *
+ * @param d A decoder.
+ * @param prefix_size Size of length prefix: 1, 2 or 4.
+ * @param max_size Maximal size of message, longer ones are protocol errors.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int decoder_length_prefixed_init(decoder *d, unsigned int prefix_size, size_t max_size);
+/**
+ * @brief It sets up decoder of fixed-size messages.
+ *
+ * @param d A decoder.
+ * @param size Size of message.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int decoder_fixed_init(decoder *d, size_t size);
+/**
+ * @brief It finds the first occurrence of byte in data using the widest
+ * available SIMD instructions.
+ *
+ * @param data Data to be searched.
+ * @param len Length of data.
+ * @param c Searched byte.
+ *
+ * @return Pointer to the found byte or 0.
+ */
+const char * framer_find_byte(const char *data, size_t len, char c);
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * framer_s structure.
+ */
+typedef struct framer_s framer;
+/**
+ * @brief It is a callback with a batch of decoded messages. Views are valid
+ * only until callback returns. The framer must not be destroyed here.
+ *
+ * @param f It is a pointer to the framer which decoded messages.
+ * @param frames An array of messages.
+ * @param cnt Number of messages in array.
+ * @param arg An argument given to the framer's constructor.
+ */
+typedef void (*framer_handler)(framer *f, const frame *frames, size_t cnt, void *arg);
+/**
+ * @brief It is a callback called once the peer closed connection, read
+ * failed or decoder reported protocol error. The framer is not used
+ * afterwards, so it can be unregistered and destroyed here.
+ *
+ * @param f It is a pointer to the framer.
+ * @param err 0 if peer closed connection, errno value otherwise
+ * (EPROTO for protocol errors).
+ * @param arg An argument given to the framer's constructor.
+ */
+typedef void (*framer_close_handler)(framer *f, int err, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for framer_ctx_s structure. It is just a place for
+ * private data of framer. As a user of framer class, you should
+ * never use this member.
+ */
+typedef struct framer_ctx_s framer_ctx;
+struct framer_s {
+  /**
+   * @brief It is just a place for framer's private.
+   * As a user of framer class, you should never use this member.
+   */
+  framer_ctx *ctx;
+  /**
+   * @brief It is a built-in event_handler, which should be registered
+   * in the reactor. Its fd is the descriptor given to the constructor.
+   */
+  event_handler eh;
+  /**
+   * @brief This method gives the number of buffered bytes of incomplete
+   * message.
+   *
+   * @param self It is a pointer to the framer wherefrom this method
+   * is called.
+   *
+   * @return Number of buffered bytes.
+   */
+  size_t (*pending)(framer *self);
+  /**
+   * @brief This is destructor. It gives the read buffer back to the pool,
+   * but it does not close the descriptor.
+   *
+   * @param self It is a pointer to the framer wherefrom this method
+   * is called.
+   */
+  void (*destroy)(framer *self);
+};
+
+/**
+ * @brief It's constructor for stacked framers.
+ *
+ * @param f Framer stacked instance.
+ * @param o Proxy to operating system calls.
+ * @param pool A pool of read buffers. Buffer is held only while there is
+ * an incomplete message, so idle connections do not keep it.
+ * @param buf_size Size of read buffer, it limits the size of message.
+ * @param fd A descriptor to read from.
+ * @param d A decoder, it is copied.
+ * @param on_frames A callback for decoded messages.
+ * @param on_close A callback for closed connection.
+ * @param arg An argument passed to callbacks.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int framer_init(framer *f, const os *o, buf_pool *pool, size_t buf_size, int fd, const decoder *d,
+                framer_handler on_frames, framer_close_handler on_close, void *arg);
+/**
+ * @brief It's constructor to dynamically alloc framer.
+ *
+ * @param o Proxy to operating system calls.
+ * @param pool A pool of read buffers.
+ * @param buf_size Size of read buffer, it limits the size of message.
+ * @param fd A descriptor to read from.
+ * @param d A decoder, it is copied.
+ * @param on_frames A callback for decoded messages.
+ * @param on_close A callback for closed connection.
+ * @param arg An argument passed to callbacks.
+ *
+ * @return Pointer to framer in case of success, 0 otherwise.
+ */
+framer * framer_alloc(const os *o, buf_pool *pool, size_t buf_size, int fd, const decoder *d,
+                      framer_handler on_frames, framer_close_handler on_close, void *arg);
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * @file hot_restart.h
+ * @brief This header contains declaration of hot_restart, which hands
+ * listening (and optionally established) sockets over from running process
+ * to its successor, so deploy of new binary neither refuses connections
+ * nor resets accept queue.
+ * Old process serves its sockets on Unix domain socket (SOCK_SEQPACKET)
+ * bound to well known path. New process takes them (every socket is sent
+ * with SCM_RIGHTS along with its name), registers them in its reactors and
+ * reports it is ready. Then old process is notified to stop accepting,
+ * drain its connections and exit. Until then, both processes accept from
+ * the same queue.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef HOT_RESTART_H
+#define HOT_RESTART_H
+
+#include "reactor.h"
+
+/**
+ * @brief Maximal length of socket name including terminating zero.
+ */
+#define HOT_RESTART_NAME_SIZE 32
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * hot_restart_s structure.
+ */
+typedef struct hot_restart_s hot_restart;
+/**
+ * @brief It is a callback which is called by reactor's thread in old
+ * process, once successor took the sockets and is ready. The callback
+ * should stop accepting (unregister and close the listeners), drain
+ * connections and stop reactor.
+ *
+ * @param hr It is a pointer to the hot_restart which served the sockets.
+ * @param arg An argument given to the serve method.
+ */
+typedef void (*hot_restart_handler)(hot_restart *hr, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for hot_restart_ctx_s structure. It is just a place for
+ * private data of hot_restart. As a user of hot_restart class, you should
+ * never use this member.
+ */
+typedef struct hot_restart_ctx_s hot_restart_ctx;
+struct hot_restart_s {
+  /**
+   * @brief It is just a place for hot_restart's private.
+   * As a user of hot_restart class, you should never use this member.
+   */
+  hot_restart_ctx *ctx;
+  /**
+   * @brief This method adds socket which is handed over to successor.
+   * The socket stays owned by caller. Established connection should be
+   * added only when it is idle, as data already read by this process are
+   * not passed.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   * @param name Unique name of socket, which successor uses to find it.
+   * @param fd A socket.
+   *
+   * @return 0 in case of success, -1 otherwise (e.g. name is too long or
+   * already used).
+   */
+  int (*add_fd)(hot_restart *self, const char *name, int fd);
+  /**
+   * @brief This method starts serving of added sockets. Stale path is
+   * removed, so successor always replaces socket of its predecessor.
+   * One successor is served at a time.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   * @param r A reactor which drives serving.
+   * @param h A callback called once successor is ready.
+   * @param arg An argument passed to the callback.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*serve)(hot_restart *self, reactor *r, hot_restart_handler h, void *arg);
+  /**
+   * @brief This method connects to predecessor and receives its sockets.
+   * It blocks, so it should be called before event_loop is started.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   * @param timeout_ms Maximal time of waiting for each message of
+   * predecessor, 0 means no limit.
+   *
+   * @return Number of received sockets in case of success, -1 otherwise
+   * (e.g. there is no predecessor, then process should start cold).
+   */
+  int (*take)(hot_restart *self, int timeout_ms);
+  /**
+   * @brief This method finds socket received by take.
+   * The ownership of socket is passed to caller.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   * @param name Name of socket.
+   *
+   * @return A socket in case of success, -1 otherwise.
+   */
+  int (*get_fd)(hot_restart *self, const char *name);
+  /**
+   * @brief This method tells predecessor that received sockets are
+   * registered, so it can drain and exit. Sockets which were received, but
+   * not got by get_fd, are closed.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*ready)(hot_restart *self);
+  /**
+   * @brief This is destructor. Path is removed unless sockets were handed
+   * over, as then it belongs to successor.
+   *
+   * @param self It is a pointer to the hot_restart wherefrom this method
+   * is called.
+   */
+  void (*destroy)(hot_restart *self);
+};
+
+/**
+ * @brief It's constructor for stacked hot_restarts.
+ *
+ * @param hr Hot_restart stacked instance.
+ * @param o Proxy to operating system calls, it has to provide socket,
+ * bind, listen, accept, connect, setsockopt, recv, recvmsg, sendmsg, write,
+ * close and unlink.
+ * @param path Path of Unix domain socket.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int hot_restart_init(hot_restart *hr, const os *o, const char *path);
+/**
+ * @brief It's constructor to dynamically alloc hot_restart.
+ *
+ * @param o Proxy to operating system calls, it has to provide socket,
+ * bind, listen, accept, connect, setsockopt, recv, recvmsg, sendmsg, write,
+ * close and unlink.
+ * @param path Path of Unix domain socket.
+ *
+ * @return Pointer to hot_restart in case of success, 0 otherwise.
+ */
+hot_restart * hot_restart_alloc(const os *o, const char *path);
+
+#endif
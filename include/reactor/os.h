@@ -10,8 +10,12 @@
 #ifndef OS_H
 #define OS_H
 
+#include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <time.h>
 
 /**
  * @brief This is structure which is a proxy to system calls.
@@ -28,8 +32,29 @@ typedef struct os_s {
   int (*bind)(int, const struct sockaddr *, socklen_t );
   int (*listen)(int, int);
   int (*accept)(int, struct sockaddr *, socklen_t *);
+  int (*connect)(int, const struct sockaddr *, socklen_t);
+  int (*getsockopt)(int, int, int, void *, socklen_t *);
+  int (*setsockopt)(int, int, int, const void *, socklen_t);
+  ssize_t (*recv)(int, void *, size_t, int);
+  ssize_t (*recvmsg)(int, struct msghdr *, int);
+  ssize_t (*sendmsg)(int, const struct msghdr *, int);
   ssize_t (*read)(int, void *, size_t);
   ssize_t (*write)(int, const void *, size_t);
+  ssize_t (*writev)(int, const struct iovec *, int);
+  ssize_t (*sendfile)(int, int, off_t *, size_t);
+  int (*open)(const char *, int, ...);
+  int (*fstat)(int, struct stat *);
+  int (*unlink)(const char *);
+  ssize_t (*pread)(int, void *, size_t, off_t);
+  int (*eventfd)(unsigned int, int);
+  void * (*mmap)(void *, size_t, int, int, int, off_t);
+  int (*munmap)(void *, size_t);
+  int (*madvise)(void *, size_t, int);
+  long (*mbind)(void *, unsigned long, int, const unsigned long *, unsigned long, unsigned int);
+  int (*getcpu)(unsigned int *, unsigned int *);
+  int (*timerfd_create)(int, int);
+  int (*timerfd_settime)(int, int, const struct itimerspec *, struct itimerspec *);
+  int (*clock_gettime)(clockid_t, struct timespec *);
 } os;
 
 /**
@@ -0,0 +1,190 @@
+/**
+ * @file os_sim.h
+ * @brief This header contains declaration of simulated os proxy, in which
+ * file descriptors, epoll readiness and data transfer are in-memory
+ * structures and time is virtual. It enables deterministic scalability
+ * benchmarks and stress tests of reactor with millions of connections,
+ * without sockets, ulimit changes nor kernel involvement.
+ * Time advances only in epoll_wait: every call moves virtual clock by one
+ * tick and delivers messages generated with configured arrival distribution
+ * to accepted connections. As os proxy calls have no context, there is one
+ * simulation per process and it has to be driven by single thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef OS_SIM_H
+#define OS_SIM_H
+
+#include "os.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief It is a distribution of message targets among connections.
+ */
+typedef enum os_sim_target_e {
+  /**
+   * @brief Each connection is equally likely to receive a message.
+   */
+  OS_SIM_UNIFORM,
+  /**
+   * @brief Connections accepted first receive most of messages, target
+   * index is n * u^skew for uniformly distributed u.
+   */
+  OS_SIM_SKEWED
+} os_sim_target;
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * os_sim_config_s structure.
+ */
+typedef struct os_sim_config_s os_sim_config;
+/**
+ * @brief It is a configuration of simulation.
+ */
+struct os_sim_config_s {
+  /**
+   * @brief Maximal number of file descriptors, 0 means 4M.
+   */
+  size_t max_fds;
+  /**
+   * @brief Virtual time elapsed by one epoll_wait call, 0 means 100 us.
+   */
+  uint64_t tick_ns;
+  /**
+   * @brief Once virtual time reaches it, epoll_wait fails with ESHUTDOWN,
+   * which ends reactor's event_loop. 0 means unlimited.
+   */
+  uint64_t duration_ns;
+  /**
+   * @brief Number of messages arriving per second of virtual time to all
+   * accepted connections, 0 disables generated traffic.
+   */
+  double arrival_rate;
+  /**
+   * @brief If it is not 0, inter-arrival times are exponentially distributed
+   * (Poisson arrivals), otherwise they are constant.
+   */
+  int poisson;
+  /**
+   * @brief Distribution of message targets.
+   */
+  os_sim_target target;
+  /**
+   * @brief Skew of OS_SIM_SKEWED distribution, values below 1 mean 1.
+   */
+  double skew;
+  /**
+   * @brief Size of generated message, which is filled by 'x' and ends with
+   * new line. 0 means 64 bytes.
+   */
+  size_t msg_size;
+  /**
+   * @brief Seed of pseudo random generator, 0 means default one.
+   */
+  uint64_t seed;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * os_sim_stats_s structure.
+ */
+typedef struct os_sim_stats_s os_sim_stats;
+/**
+ * @brief It is a snapshot of simulation counters.
+ */
+struct os_sim_stats_s {
+  /**
+   * @brief Current virtual time.
+   */
+  uint64_t now_ns;
+  /**
+   * @brief Number of currently open file descriptors.
+   */
+  uint64_t open_fds;
+  /**
+   * @brief Number of accepted connections.
+   */
+  uint64_t accepted;
+  /**
+   * @brief Number of messages delivered to connections.
+   */
+  uint64_t arrivals;
+  /**
+   * @brief Number of bytes read by read, recv and recvmsg.
+   */
+  uint64_t rx_bytes;
+  /**
+   * @brief Number of bytes written by write and writev to connections.
+   */
+  uint64_t tx_bytes;
+  /**
+   * @brief Number of epoll_wait calls.
+   */
+  uint64_t epoll_waits;
+  /**
+   * @brief Number of events returned by epoll_wait calls.
+   */
+  uint64_t events;
+};
+
+/**
+ * @brief A constructor of simulated os proxy.
+ *
+ * @param o A pointer to os object, which becomes simulated proxy.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used and no traffic is generated.
+ *
+ * @return 0 in case of success, -1 otherwise (e.g. simulation is already
+ * running).
+ */
+int os_sim_init(os *o, const os_sim_config *cfg);
+/**
+ * @brief It stops simulation and releases all its memory.
+ * Simulated proxies must not be used anymore.
+ *
+ * @return 0 in case of success, -1 if simulation is not running.
+ */
+int os_sim_finish(void);
+/**
+ * @brief It queues incoming connections on listening socket, which are then
+ * returned by accept.
+ *
+ * @param listen_fd A socket on which listen was called.
+ * @param cnt Number of connections.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int os_sim_connect(int listen_fd, size_t cnt);
+/**
+ * @brief It delivers data to connection, as if peer sent it.
+ *
+ * @param fd A socket.
+ * @param data Data.
+ * @param len Length of data.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int os_sim_deliver(int fd, const void *data, size_t len);
+/**
+ * @brief It closes the peer side of connection, so read returns 0 once
+ * delivered data are consumed.
+ *
+ * @param fd A socket.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int os_sim_hangup(int fd);
+/**
+ * @brief It takes snapshot of simulation counters.
+ *
+ * @param stats An output snapshot.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int os_sim_get_stats(os_sim_stats *stats);
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * @file os_trace.h
+ * @brief This header contains declaration of recording and replaying
+ * os proxies. Recording proxy forwards calls to another os proxy and
+ * logs results of epoll_wait, accept, read, recv, write and writev as well
+ * as descriptors created by epoll_create1, socket, eventfd and
+ * timerfd_create with their timing into compact binary trace. Replaying
+ * proxy feeds such trace back to reactor and event_handler's without any
+ * kernel involvement, so once captured load pattern can be reproduced on
+ * any machine to profile reactor overhead.
+ * As os proxy calls have no context, there is one recorder and one
+ * replayer per process. Trace is stored in host byte order.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef OS_TRACE_H
+#define OS_TRACE_H
+
+#include "os.h"
+
+#include <stddef.h>
+
+/**
+ * @brief A constructor of recording os proxy. All calls are forwarded to
+ * real proxy, the traced ones are recorded. Recording is thread safe, but
+ * faithful replay is possible only for trace of single event_loop thread.
+ *
+ * @param o A pointer to os object, which becomes recording proxy.
+ * @param real A proxy which really executes calls. It is copied.
+ * @param trace_fd A file descriptor where trace is written. Recorder does
+ * not close it.
+ * @param with_payload If it is not 0, data received by read and recv is
+ * recorded too, otherwise replay fills buffers with zeros.
+ *
+ * @return 0 in case of success, -1 otherwise (e.g. recorder is already
+ * running).
+ */
+int os_record_init(os *o, const os *real, int trace_fd, int with_payload);
+/**
+ * @brief It stops recording and flushes buffered trace into trace_fd.
+ * Recording proxies must not be used anymore.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int os_record_finish(void);
+/**
+ * @brief A constructor of replaying os proxy. Whole trace is read into
+ * memory first.
+ * epoll_wait returns recorded events and -1 once trace is exhausted, which
+ * ends reactor's event_loop. accept, read, recv, write and writev return
+ * recorded results if the next recorded call matches them by type and fd,
+ * otherwise they fail with EAGAIN and the call is counted as diverged.
+ * epoll_create1, socket, eventfd and timerfd_create return recorded
+ * descriptors, so recorded events are dispatched to the same handlers; if
+ * they diverge, fake descriptors are returned instead.
+ * clock_gettime returns trace time of the last replayed call for any
+ * clock. Other calls just succeed.
+ *
+ * @param o A pointer to os object, which becomes replaying proxy.
+ * @param trace_fd A file descriptor wherefrom trace is read. Replayer does
+ * not close it.
+ *
+ * @return 0 in case of success, -1 otherwise (e.g. trace is corrupted).
+ */
+int os_replay_init(os *o, int trace_fd);
+/**
+ * @brief It stops replaying and releases the trace.
+ * Replaying proxies must not be used anymore.
+ *
+ * @return Number of diverged calls, -1 if replayer is not running.
+ */
+long os_replay_finish(void);
+
+#endif
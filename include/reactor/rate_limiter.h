@@ -0,0 +1,222 @@
+/**
+ * @file rate_limiter.h
+ * @brief This header contains declaration of rate_limiter, which shapes
+ * traffic of event_handler's with token buckets of bytes and messages per
+ * second. Handler, whose bucket is exhausted, has its read interest dropped
+ * in the reactor instead of reading and discarding data, so kernel buffers
+ * and TCP flow control push back on the peer. Buckets are refilled lazily
+ * from reactor's cached clock and throttled handlers of one rate_limiter
+ * are resumed by a single shared timerfd.
+ * All methods must be called from reactor's thread.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef RATE_LIMITER_H
+#define RATE_LIMITER_H
+
+#include "reactor.h"
+
+#include <stddef.h>
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * rate_limit_config_s structure.
+ */
+typedef struct rate_limit_config_s rate_limit_config;
+/**
+ * @brief It is a configuration of bucket. At least one rate has to be set.
+ */
+struct rate_limit_config_s {
+  /**
+   * @brief Bytes per second, 0 means unlimited.
+   */
+  uint64_t bytes_per_sec;
+  /**
+   * @brief Maximal number of bytes available at once, 0 means bytes_per_sec.
+   */
+  uint64_t bytes_burst;
+  /**
+   * @brief Messages per second, 0 means unlimited.
+   */
+  uint64_t msgs_per_sec;
+  /**
+   * @brief Maximal number of messages available at once, 0 means msgs_per_sec.
+   */
+  uint64_t msgs_burst;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * rate_bucket_s structure.
+ */
+typedef struct rate_bucket_s rate_bucket;
+/**
+ * @brief It is a token bucket of one event_handler. It is owned by the user,
+ * e.g. embedded into connection, so attaching does not allocate.
+ * All members are rate_limiter's private, you should never use them.
+ */
+struct rate_bucket_s {
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  const event_handler *eh;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  rate_limit_config cfg;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  int64_t bytes;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  int64_t msgs;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  uint64_t last_ns;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  uint64_t resume_ns;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  rate_bucket *prev;
+  /**
+   * @brief It is rate_limiter's private member, you should never use it.
+   */
+  rate_bucket *next;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * rate_limiter_stats_s structure.
+ */
+typedef struct rate_limiter_stats_s rate_limiter_stats;
+/**
+ * @brief It is a snapshot of rate_limiter counters.
+ */
+struct rate_limiter_stats_s {
+  /**
+   * @brief Number of handlers, which are throttled right now.
+   */
+  size_t throttled;
+  /**
+   * @brief Number of times any handler was throttled.
+   */
+  unsigned long throttles;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * rate_limiter_s structure.
+ */
+typedef struct rate_limiter_s rate_limiter;
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for rate_limiter_ctx_s structure. It is just a place for
+ * private data of rate_limiter. As a user of rate_limiter class, you should
+ * never use this member.
+ */
+typedef struct rate_limiter_ctx_s rate_limiter_ctx;
+struct rate_limiter_s {
+  /**
+   * @brief It is just a place for rate_limiter's private.
+   * As a user of rate_limiter class, you should never use this member.
+   */
+  rate_limiter_ctx *ctx;
+  /**
+   * @brief This method attaches full bucket to registered event_handler.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   * @param b A bucket, it has to stay valid till it is detached.
+   * @param eh An event handler registered in rate_limiter's reactor.
+   * @param cfg A configuration, it is copied. Rates and bursts must not
+   * exceed INT64_MAX / 10^9 (about 9.2 GB or messages per second).
+   *
+   * @return 0 in case of success, -1 otherwise (e.g. a rate is too big).
+   */
+  int (*attach)(rate_limiter *self, rate_bucket *b, const event_handler *eh, const rate_limit_config *cfg);
+  /**
+   * @brief This method detaches bucket. If handler is throttled, its read
+   * interest (EPOLLIN) is restored.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   * @param b An attached bucket.
+   */
+  void (*detach)(rate_limiter *self, rate_bucket *b);
+  /**
+   * @brief This method gives number of bytes, which handler may read now.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   * @param b An attached bucket.
+   * @param want Number of bytes handler would like to read.
+   *
+   * @return Number of bytes up to want, 0 if handler is throttled.
+   */
+  size_t (*budget)(rate_limiter *self, rate_bucket *b, size_t want);
+  /**
+   * @brief This method takes tokens for data which was read. Once any
+   * bucket runs dry, read interest (EPOLLIN) of handler is cleared till it
+   * is refilled by at least 10 ms worth of tokens (or whole burst, if it is
+   * smaller), then EPOLLIN is restored. Other events of the mask given by
+   * reactor's get_interest are kept.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   * @param b An attached bucket.
+   * @param bytes Number of read bytes.
+   * @param msgs Number of read messages.
+   *
+   * @return 1 if handler may continue reading, 0 if it is throttled.
+   */
+  int (*charge)(rate_limiter *self, rate_bucket *b, size_t bytes, size_t msgs);
+  /**
+   * @brief This method takes the snapshot of rate_limiter counters.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   * @param stats An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_stats)(rate_limiter *self, rate_limiter_stats *stats);
+  /**
+   * @brief This is destructor. Throttled handlers are resumed.
+   *
+   * @param self It is a pointer to the rate_limiter wherefrom this method
+   * is called.
+   */
+  void (*destroy)(rate_limiter *self);
+};
+
+/**
+ * @brief It's constructor for stacked rate_limiter's.
+ *
+ * @param rl Rate_limiter stacked instance.
+ * @param r A reactor, whose handlers are shaped.
+ * @param o Proxy to operating system calls, it has to provide read, close,
+ * timerfd_create and timerfd_settime.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int rate_limiter_init(rate_limiter *rl, reactor *r, const os *o);
+/**
+ * @brief It's constructor to dynamically alloc rate_limiter.
+ *
+ * @param r A reactor, whose handlers are shaped.
+ * @param o Proxy to operating system calls, it has to provide read, close,
+ * timerfd_create and timerfd_settime.
+ *
+ * @return Pointer to rate_limiter in case of success, 0 otherwise.
+ */
+rate_limiter * rate_limiter_alloc(reactor *r, const os *o);
+
+#endif
@@ -13,6 +13,9 @@
 
 #include "os.h"
 
+#include <stdint.h>
+#include <pthread.h>
+
 /**
  * @brief Just a helper typedef for shorter name usage for
  * event_handler_s structure.
@@ -60,6 +63,136 @@ struct event_handler_s {
  * reactor_s structure.
  */
 typedef struct reactor_s reactor;
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * reactor_load_s structure.
+ */
+typedef struct reactor_load_s reactor_load;
+/**
+ * @brief It is a snapshot of reactor's load metrics. All counters
+ * are cumulative since reactor construction, so the caller should
+ * compute deltas between two snapshots to get the current load.
+ */
+struct reactor_load_s {
+  /**
+   * @brief Number of events dispatched to event_handler's.
+   */
+  unsigned long events;
+  /**
+   * @brief Number of waits which returned as many events as fit the batch,
+   * so more events were probably pending. Growing value means reactor falls
+   * behind.
+   */
+  unsigned long full_batches;
+  /**
+   * @brief Number of currently registered event_handler's.
+   */
+  unsigned long handlers;
+};
+/**
+ * @brief It is a task which can be posted to the reactor to be executed
+ * by its event_loop thread.
+ *
+ * @param r It is a pointer to the reactor which executes the task.
+ * @param arg It is an argument given while posting the task.
+ */
+typedef void (*reactor_task)(reactor *r, void *arg);
+/**
+ * @brief Phases of single event_loop iteration, where hooks can be
+ * registered.
+ */
+typedef enum reactor_phase_e {
+  /**
+   * @brief Hooks of this phase are called right before waiting for events.
+   */
+  REACTOR_PHASE_PREPARE,
+  /**
+   * @brief Hooks of this phase are called right after all events of the batch
+   * are dispatched and deferred flushes are done.
+   */
+  REACTOR_PHASE_CHECK
+} reactor_phase;
+/**
+ * @brief It is a hook called by event_loop in given phase of each iteration.
+ *
+ * @param r It is a pointer to the reactor which calls the hook.
+ * @param arg It is an argument given while adding the hook.
+ */
+typedef void (*reactor_hook)(reactor *r, void *arg);
+/**
+ * @brief Flag of per event_handler accounting, which enables measuring of
+ * wall time spent in handle_event with monotonic clock.
+ */
+#define REACTOR_ACCOUNT_WALL 0x1
+/**
+ * @brief Flag of per event_handler accounting, which enables measuring of
+ * CPU time spent in handle_event with thread CPU-time clock. Each sample is
+ * a system call, so it is much more expensive than REACTOR_ACCOUNT_WALL.
+ */
+#define REACTOR_ACCOUNT_CPU 0x2
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * reactor_eh_stats_s structure.
+ */
+typedef struct reactor_eh_stats_s reactor_eh_stats;
+/**
+ * @brief It is a snapshot of cumulative statistics of registered
+ * event_handler. Counters are reset when event_handler is registered
+ * (also when it is migrated to another reactor).
+ */
+struct reactor_eh_stats_s {
+  /**
+   * @brief Number of handle_event calls.
+   */
+  uint64_t calls;
+  /**
+   * @brief Wall time spent in handle_event, if REACTOR_ACCOUNT_WALL is enabled.
+   */
+  uint64_t wall_ns;
+  /**
+   * @brief The longest single handle_event call, if REACTOR_ACCOUNT_WALL is enabled.
+   */
+  uint64_t max_wall_ns;
+  /**
+   * @brief CPU time spent in handle_event, if REACTOR_ACCOUNT_CPU is enabled.
+   */
+  uint64_t cpu_ns;
+};
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * reactor_activity_s structure.
+ */
+typedef struct reactor_activity_s reactor_activity;
+/**
+ * @brief It is a snapshot of what reactor's event_loop is doing right now.
+ * It can be taken from any thread, e.g. by watchdog.
+ */
+struct reactor_activity_s {
+  /**
+   * @brief 1 if event_loop is running, 0 otherwise.
+   */
+  int running;
+  /**
+   * @brief Thread which runs event_loop. Valid only if running is 1.
+   */
+  pthread_t thread;
+  /**
+   * @brief Time elapsed since the current batch of events started to be
+   * processed, 0 if event_loop is waiting for events. It is measured only
+   * if os proxy provides clock_gettime.
+   */
+  uint64_t busy_ns;
+  /**
+   * @brief event_handler which is being dispatched, 0 if event_loop is
+   * outside of handle_event (e.g. in hook or task). It must not be
+   * dereferenced, because it can be destroyed meanwhile.
+   */
+  const event_handler *eh;
+  /**
+   * @brief File descriptor of eh, -1 if eh is 0.
+   */
+  int fd;
+};
 /**
  * @brief Just a forward declaration and helper typedef for shorter
  * name usage for reactor_ctx_s structure. It is just a place for
@@ -67,6 +200,11 @@ typedef struct reactor_s reactor;
  * never use this member.
  */
 typedef struct reactor_ctx_s reactor_ctx;
+/**
+ * @brief Just a forward declaration of tracer, which is declared
+ * in tracer.h.
+ */
+typedef struct tracer_s tracer;
 struct reactor_s {
   /**
    * @brief It is just a place for reactor's private.
@@ -97,6 +235,108 @@ struct reactor_s {
    * the destructor of event_handler.
    */
   int (*unregister_eh)(reactor *self, const event_handler *e);
+  /**
+   * @brief This method registers many event_handler's at once, e.g. pools
+   * of pre-opened descriptors at startup. Handler tables are grown once
+   * for the whole batch, so it is much cheaper than registering one by one.
+   * Registration is all or nothing: if any event_handler is invalid or
+   * duplicated (also within the batch), none of them stays registered.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param ehs Event handlers. Please note: reactor does not take
+   * the ownership for these pointers.
+   * @param cnt Number of event handlers.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*register_many)(reactor *self, event_handler * const *ehs, size_t cnt);
+  /**
+   * @brief This method unregisters many event_handler's at once. All
+   * registered ones are unregistered even if some of them are not.
+   * Handlers are unindexed and their pending flushes are cancelled in a
+   * single pass, only removal from epoll costs one call per handler.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param ehs Event handlers. Please note: reactor does not call
+   * their destructors.
+   * @param cnt Number of event handlers.
+   *
+   * @return 0 if all event handlers were unregistered, -1 otherwise.
+   */
+  int (*unregister_many)(reactor *self, const event_handler * const *ehs, size_t cnt);
+  /**
+   * @brief This method changes the epoll event mask, which registered
+   * event_handler is interested in. By default event_handler is registered
+   * only for EPOLLIN, so e.g. EPOLLOUT can be used to wait until non-blocking
+   * connect or write completes.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param e A registered event handler.
+   * @param events A new epoll event mask.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*modify_eh)(reactor *self, const event_handler *e, uint32_t events);
+  /**
+   * @brief This method gives the epoll event mask, which registered
+   * event_handler is interested in, i.e. the last one set by modify_eh.
+   * It lets e.g. read interest be toggled without clobbering write interest.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param e A registered event handler.
+   * @param events An output event mask.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_interest)(reactor *self, const event_handler *e, uint32_t *events);
+  /**
+   * @brief This method adds hook to given phase of event_loop iteration.
+   * Hooks of the same phase are called in order of adding.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param phase A phase of iteration.
+   * @param hook A hook.
+   * @param arg An argument passed to the hook.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*add_hook)(reactor *self, reactor_phase phase, reactor_hook hook, void *arg);
+  /**
+   * @brief This method removes hook added with the same arguments.
+   * It is safe to be called from hook itself.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param phase A phase of iteration.
+   * @param hook A hook.
+   * @param arg An argument given while adding the hook.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*remove_hook)(reactor *self, reactor_phase phase, reactor_hook hook, void *arg);
+  /**
+   * @brief This method defers flushing of registered event_handler's output
+   * till all events of the current batch are dispatched. On the first call
+   * in the batch socket is corked (TCP_CORK, if os proxy provides setsockopt),
+   * so all small writes done meanwhile are coalesced into full packets. After
+   * the batch flush is called once and socket is uncorked. Further calls in
+   * the same batch are no-ops.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param e A registered event handler.
+   * @param flush An optional method which writes pending output of e.
+   * It is allowed to unregister and free e. If e is unregistered before
+   * the flush runs, the flush is cancelled and the socket is uncorked.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*defer_flush)(reactor *self, event_handler *e, void (*flush)(event_handler *e));
   /**
    * @brief This is heart of the reactor - main event loop. It is a blocking
    * method, wich has embedded loop with waiting for events at registered
@@ -114,11 +354,160 @@ struct reactor_s {
    * is called.
    */
   void (*stop)(reactor *self);
+  /**
+   * @brief This is the only method which is safe to be called from any
+   * thread. It enqueues the task which will be executed by the thread running
+   * event_loop, right after the current batch of events is dispatched.
+   * If os proxy provides eventfd the sleeping event_loop is woken up,
+   * otherwise the task waits for the next epoll_wait timeout.
+   * Tasks which are still pending when reactor is destroyed are dropped.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param task A task to execute.
+   * @param arg An argument passed to the task.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*post)(reactor *self, reactor_task task, void *arg);
+  /**
+   * @brief This method is the same as post, but if the task is dropped by
+   * destroy, cleanup is called instead, so e.g. arg can be released. It is
+   * called by the thread destroying the reactor, which must not be used by
+   * cleanup anymore.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param task A task to execute.
+   * @param cleanup An optional task called instead of dropped one.
+   * @param arg An argument passed to the task or cleanup.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*post_with_cleanup)(reactor *self, reactor_task task, reactor_task cleanup, void *arg);
+  /**
+   * @brief This method moves registered event_handler to another reactor,
+   * which e.g. runs in other thread. The event_handler is unregistered
+   * from self immediately and registered in target by target's event_loop
+   * thread (using post method). If target refuses the registration or it
+   * is destroyed before the registration, the event_handler is registered
+   * back in self in the same way. If that is not possible either,
+   * handle_event of the event_handler is called with EPOLLHUP | EPOLLERR,
+   * as it is not registered anywhere then, so it can release itself.
+   * Event mask set by modify_eh, accounting stats and activity are carried
+   * over with the event_handler.
+   * It has to be called from the thread running self's event_loop
+   * (e.g. from handle_event) or when self's event_loop is not running.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param e A registered event handler.
+   * @param target A reactor which takes over the event_handler.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*migrate_eh)(reactor *self, event_handler *e, reactor *target);
+  /**
+   * @brief This method migrates the most active event_handler's to target
+   * reactor. Activity is the number of events dispatched to event_handler
+   * since previous call of this method. Event handlers are taken from the
+   * busiest one as long as the sum of their activity fits the given share
+   * of activity of all event_handler's. It has the same threading
+   * requirements as migrate_eh.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param target A reactor which takes over the event_handler's.
+   * @param share Maximal part of activity to be moved to target, from 0
+   * to 1. Being relative, it does not depend on how long ago this method
+   * was called last time.
+   * @param max_cnt Maximal number of event_handler's to be moved.
+   * @param can_migrate An optional filter, which returns 0 for event_handler's
+   * which must stay in self (e.g. listening sockets).
+   *
+   * @return Number of migrated event_handler's or -1 in case of error.
+   */
+  int (*shed_load)(reactor *self, reactor *target, double share, unsigned int max_cnt,
+                   int (*can_migrate)(const event_handler *e));
+  /**
+   * @brief This method takes the snapshot of reactor's load. It is safe
+   * to be called from any thread.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param load An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_load)(reactor *self, reactor_load *load);
+  /**
+   * @brief This method enables or disables per event_handler accounting.
+   * It should be called before event_loop is started or from its thread.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param flags Bitwise or of REACTOR_ACCOUNT_* flags, 0 disables accounting.
+   *
+   * @return 0 in case of success, -1 otherwise (e.g. os proxy does not
+   * provide clock_gettime).
+   */
+  int (*set_accounting)(reactor *self, uint32_t flags);
+  /**
+   * @brief This method gets statistics of registered event_handler.
+   * It should be called from event_loop thread.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param e A registered event handler.
+   * @param stats An output statistics.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_eh_stats)(reactor *self, const event_handler *e, reactor_eh_stats *stats);
+  /**
+   * @brief This method takes snapshot of event_loop's current activity.
+   * It is thread safe.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param activity An output snapshot.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_activity)(reactor *self, reactor_activity *activity);
+  /**
+   * @brief This method attaches tracer, which enables receive timestamps on
+   * all registered and later registered sockets and samples kernel to
+   * dispatch delay before each readable socket is dispatched. It should be
+   * called before event_loop is started or from its thread.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   * @param t A tracer, 0 detaches the current one. Timestamps already
+   * enabled on sockets are left as they are.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*set_tracer)(reactor *self, tracer *t);
+  /**
+   * @brief This method gives monotonic time cached at the start of the
+   * current batch of events, so handlers, hooks and tasks of one batch
+   * share it without calling clock_gettime. Outside of a batch the clock
+   * is read. It should be called from event_loop thread.
+   *
+   * @param self It is a pointer to the reactor wherefrom this method
+   * is called.
+   *
+   * @return Time in nanoseconds, 0 if os proxy does not provide
+   * clock_gettime.
+   */
+  uint64_t (*now_ns)(reactor *self);
   /**
    * @brief This is destructor. You should call this method once reactor
    * won't be used anymore to avoid memory leaks. Note: if thre will be some
    * reigstered event_handler's, destructor will unregister all of them, but
-   * still it will not call theris destructors.
+   * still it will not call theris destructors. They are dropped together
+   * with the epoll instance, so no per descriptor epoll_ctl is issued.
    *
    * @param self It is a pointer to the reactor wherefrom this method
    * is called.
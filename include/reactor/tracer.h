@@ -0,0 +1,175 @@
+/**
+ * @file tracer.h
+ * @brief This header contains declaration of tracer, which measures
+ * delay between the moment kernel received data on socket (taken from
+ * SO_TIMESTAMPNS receive timestamp) and the moment reactor dispatches
+ * the readiness event to event_handler. Delays are collected into
+ * histogram and into trace ring, which can be dumped to a file.
+ * One tracer should be attached to one reactor.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef TRACER_H
+#define TRACER_H
+
+#include "os.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of histogram buckets. Bucket i counts delays in range
+ * [2^i, 2^(i+1)) ns, the first bucket counts also 0 and the last one
+ * counts everything above.
+ */
+#define TRACER_BUCKETS 40
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * trace_record_s structure.
+ */
+typedef struct trace_record_s trace_record;
+/**
+ * @brief It is a single traced dispatch.
+ */
+struct trace_record_s {
+  /**
+   * @brief Traced file descriptor.
+   */
+  int fd;
+  /**
+   * @brief Kernel receive time of the oldest unread data (CLOCK_REALTIME).
+   */
+  uint64_t kernel_ns;
+  /**
+   * @brief Dispatch time (CLOCK_REALTIME).
+   */
+  uint64_t dispatch_ns;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * tracer_histogram_s structure.
+ */
+typedef struct tracer_histogram_s tracer_histogram;
+/**
+ * @brief It is a snapshot of cumulative delays histogram.
+ */
+struct tracer_histogram_s {
+  /**
+   * @brief Number of samples.
+   */
+  uint64_t samples;
+  /**
+   * @brief Sum of all delays.
+   */
+  uint64_t sum_ns;
+  /**
+   * @brief The longest delay.
+   */
+  uint64_t max_ns;
+  /**
+   * @brief Number of samples in each bucket.
+   */
+  uint64_t buckets[TRACER_BUCKETS];
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * tracer_s structure.
+ */
+typedef struct tracer_s tracer;
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for tracer_ctx_s structure. It is just a place for
+ * private data of tracer. As a user of tracer class, you should
+ * never use this member.
+ */
+typedef struct tracer_ctx_s tracer_ctx;
+struct tracer_s {
+  /**
+   * @brief It is just a place for tracer's private.
+   * As a user of tracer class, you should never use this member.
+   */
+  tracer_ctx *ctx;
+  /**
+   * @brief This method enables receive timestamps on socket. It is called
+   * by reactor for each registered event_handler.
+   *
+   * @param self It is a pointer to the tracer wherefrom this method
+   * is called.
+   * @param fd A socket.
+   *
+   * @return 0 in case of success, -1 otherwise (e.g. fd is not a socket).
+   */
+  int (*enable)(tracer *self, int fd);
+  /**
+   * @brief This method peeks receive timestamp of the oldest unread data
+   * on socket and records its delay till now. It is called by reactor right
+   * before readable socket is dispatched, so it must be called from thread
+   * of reactor's event_loop only.
+   *
+   * @param self It is a pointer to the tracer wherefrom this method
+   * is called.
+   * @param fd A readable socket with enabled timestamps.
+   *
+   * @return 0 if sample was recorded, -1 otherwise.
+   */
+  int (*sample)(tracer *self, int fd);
+  /**
+   * @brief This method takes snapshot of delays histogram. It is thread safe.
+   *
+   * @param self It is a pointer to the tracer wherefrom this method
+   * is called.
+   * @param h An output histogram.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*get_histogram)(tracer *self, tracer_histogram *h);
+  /**
+   * @brief This method writes recent records from trace ring into file
+   * descriptor, one "fd kernel_ns dispatch_ns delay_ns" text line per record,
+   * the oldest first. It is thread safe and it never blocks the tracing
+   * reactor: records overwritten while being read are skipped.
+   *
+   * @param self It is a pointer to the tracer wherefrom this method
+   * is called.
+   * @param fd A file descriptor.
+   *
+   * @return Number of written records, -1 in case of error.
+   */
+  ssize_t (*dump)(tracer *self, int fd);
+  /**
+   * @brief This is destructor. Tracer has to be detached from reactor before.
+   *
+   * @param self It is a pointer to the tracer wherefrom this method
+   * is called.
+   */
+  void (*destroy)(tracer *self);
+};
+
+/**
+ * @brief It's constructor for stacked tracers.
+ *
+ * @param t Tracer stacked instance.
+ * @param o Proxy to operating system calls, it has to provide setsockopt,
+ * recvmsg, clock_gettime and write.
+ * @param ring_size Number of records kept in trace ring, it is rounded up
+ * to power of two. 0 disables the ring, only histogram is collected.
+ *
+ * @return 0 in case of success, -1 otherwise.
+ */
+int tracer_init(tracer *t, const os *o, size_t ring_size);
+/**
+ * @brief It's constructor to dynamically alloc tracer.
+ *
+ * @param o Proxy to operating system calls.
+ * @param ring_size Number of records kept in trace ring.
+ *
+ * @return Pointer to tracer in case of success, 0 otherwise.
+ */
+tracer * tracer_alloc(const os *o, size_t ring_size);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file watchdog.h
+ * @brief This header contains declaration of watchdog, which runs own
+ * thread and detects reactors whose event_loop spends in one batch of
+ * events more than given budget, e.g. because of event_handler blocking
+ * in handle_event. Offending event_handler is reported and backtrace of
+ * stalled thread is dumped.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include "reactor.h"
+
+#include <stdint.h>
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * watchdog_config_s structure.
+ */
+typedef struct watchdog_config_s watchdog_config;
+/**
+ * @brief It is a configuration of watchdog.
+ */
+struct watchdog_config_s {
+  /**
+   * @brief Maximal time of processing one batch of events in milliseconds.
+   * 0 means default 50 ms.
+   */
+  uint32_t budget_ms;
+  /**
+   * @brief Period of checking watched reactors in milliseconds.
+   * 0 means default 10 ms.
+   */
+  uint32_t period_ms;
+  /**
+   * @brief Signal sent to stalled event_loop thread, which handler dumps
+   * backtrace of the thread into dump_fd. 0 disables dumping. The signal
+   * handler is installed by constructor and restored by destructor.
+   * The handler is process-wide, so only one watchdog per process may dump
+   * backtraces, constructor of another one fails until it is destroyed.
+   */
+  int signo;
+  /**
+   * @brief File descriptor where reports and backtraces are written.
+   * 0 means stderr.
+   */
+  int dump_fd;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * watchdog_report_s structure.
+ */
+typedef struct watchdog_report_s watchdog_report;
+/**
+ * @brief It is a report of detected stall.
+ */
+struct watchdog_report_s {
+  /**
+   * @brief Stalled reactor.
+   */
+  reactor *r;
+  /**
+   * @brief event_handler which was being dispatched, 0 if stall happened
+   * outside of handle_event (e.g. in hook or task). It must not be
+   * dereferenced, because it can be destroyed meanwhile.
+   */
+  const event_handler *eh;
+  /**
+   * @brief File descriptor of eh, -1 if eh is 0.
+   */
+  int fd;
+  /**
+   * @brief Time spent in the current batch of events when stall was detected.
+   */
+  uint64_t stalled_ns;
+};
+
+/**
+ * @brief Just a helper typedef for shorter name usage for
+ * watchdog_s structure.
+ */
+typedef struct watchdog_s watchdog;
+/**
+ * @brief It is a callback called from watchdog thread once per detected stall.
+ * It must not call watch or unwatch methods.
+ *
+ * @param w It is a pointer to the watchdog which detected the stall.
+ * @param report A report of the stall.
+ * @param arg It is an argument given to constructor.
+ */
+typedef void (*watchdog_handler)(watchdog *w, const watchdog_report *report, void *arg);
+/**
+ * @brief Just a forward declaration and helper typedef for shorter
+ * name usage for watchdog_ctx_s structure. It is just a place for
+ * private data of watchdog. As a user of watchdog class, you should
+ * never use this member.
+ */
+typedef struct watchdog_ctx_s watchdog_ctx;
+struct watchdog_s {
+  /**
+   * @brief It is just a place for watchdog's private.
+   * As a user of watchdog class, you should never use this member.
+   */
+  watchdog_ctx *ctx;
+  /**
+   * @brief This method starts watching of reactor. It is thread safe.
+   *
+   * @param self It is a pointer to the watchdog wherefrom this method
+   * is called.
+   * @param r A reactor. It has to be unwatched before it is destroyed.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*watch)(watchdog *self, reactor *r);
+  /**
+   * @brief This method stops watching of reactor. It is thread safe.
+   *
+   * @param self It is a pointer to the watchdog wherefrom this method
+   * is called.
+   * @param r A watched reactor.
+   *
+   * @return 0 in case of success, -1 otherwise.
+   */
+  int (*unwatch)(watchdog *self, reactor *r);
+  /**
+   * @brief This is destructor. It stops watchdog thread, but it does not
+   * destroy watched reactors.
+   *
+   * @param self It is a pointer to the watchdog wherefrom this method
+   * is called.
+   */
+  void (*destroy)(watchdog *self);
+};
+
+/**
+ * @brief It's constructor for stacked watchdogs. It starts watchdog thread.
+ *
+ * @param w Watchdog stacked instance.
+ * @param cfg An optional configuration, it is copied. If it is 0, defaults
+ * are used and backtraces are dumped with SIGRTMIN.
+ * @param h An optional stall handler. If it is 0, stall is reported by
+ * writing a line into dump_fd.
+ * @param arg An argument passed to the handler.
+ *
+ * @return 0 in case of success, -1 otherwise (also if other watchdog already
+ * dumps backtraces).
+ */
+int watchdog_init(watchdog *w, const watchdog_config *cfg, watchdog_handler h, void *arg);
+/**
+ * @brief It's constructor to dynamically alloc watchdog.
+ *
+ * @param cfg An optional configuration, it is copied.
+ * @param h An optional stall handler.
+ * @param arg An argument passed to the handler.
+ *
+ * @return Pointer to watchdog in case of success, 0 otherwise.
+ */
+watchdog * watchdog_alloc(const watchdog_config *cfg, watchdog_handler h, void *arg);
+
+#endif
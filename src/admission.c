@@ -0,0 +1,272 @@
+#include "reactor/admission.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct admission_ctx_s {
+  admission *owner;
+  reactor *r;
+  const os *o;
+  admission_config cfg;
+  admission_handler h;
+  void *arg;
+  const event_handler **listeners;
+  size_t listeners_cnt;
+  size_t listeners_cap;
+  admission_stats stats;
+  unsigned long last_full_batches;
+  uint64_t calm_since_ns;
+};
+
+static void admission_terminate(admission *self);
+static void admission_free(admission *self);
+static int admission_add_listener(admission *self, const event_handler *eh);
+static int admission_remove_listener(admission *self, const event_handler *eh);
+static int admission_admit(admission *self);
+static size_t admission_read_budget(admission *self, size_t budget);
+static int admission_get_stats(admission *self, admission_stats *stats);
+static void admission_check(reactor *r, void *arg);
+static void admission_set(admission_ctx *ctx, int overloaded);
+static void admission_pause(admission_ctx *ctx, const event_handler *eh, int paused);
+static uint64_t admission_now_ns(admission_ctx *ctx);
+
+int admission_init(admission *a, reactor *r, const os *o, const admission_config *cfg,
+                   admission_handler h, void *arg)
+{
+  if ( (!a) || (!r) || (!o) || (!o->clock_gettime) )
+    return -1;
+
+  admission_ctx *ctx = (admission_ctx *) malloc(sizeof(admission_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(admission_ctx));
+  ctx->r = r;
+  ctx->o = o;
+  ctx->h = h;
+  ctx->arg = arg;
+  if (cfg)
+    ctx->cfg = *cfg;
+  if (!ctx->cfg.policy)
+    ctx->cfg.policy = ADMISSION_PAUSE_LISTENERS | ADMISSION_LIMIT_READS;
+  if (!ctx->cfg.high_lag_us)
+    ctx->cfg.high_lag_us = 10000;
+  if ( (!ctx->cfg.low_lag_us) || (ctx->cfg.low_lag_us > ctx->cfg.high_lag_us) )
+    ctx->cfg.low_lag_us = ctx->cfg.high_lag_us / 2;
+  if (!ctx->cfg.full_batches)
+    ctx->cfg.full_batches = 16;
+  if (!ctx->cfg.hold_ms)
+    ctx->cfg.hold_ms = 100;
+  if (!ctx->cfg.read_divisor)
+    ctx->cfg.read_divisor = 4;
+
+  reactor_load load;
+  if ( (0 != r->get_load(r, &load)) || (0 != r->add_hook(r, REACTOR_PHASE_CHECK, admission_check, ctx)) ) {
+    free(ctx);
+    return -1;
+  }
+  ctx->last_full_batches = load.full_batches;
+
+  memset(a, 0, sizeof(admission));
+  ctx->owner = a;
+  a->ctx = ctx;
+  a->add_listener = admission_add_listener;
+  a->remove_listener = admission_remove_listener;
+  a->admit = admission_admit;
+  a->read_budget = admission_read_budget;
+  a->get_stats = admission_get_stats;
+  a->destroy = admission_terminate;
+
+  return 0;
+}
+
+admission * admission_alloc(reactor *r, const os *o, const admission_config *cfg,
+                            admission_handler h, void *arg)
+{
+  admission *res = (admission *) malloc(sizeof(admission));
+  if (res) {
+    if (0 != admission_init(res, r, o, cfg, h, arg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = admission_free;
+  }
+
+  return res;
+}
+
+static void admission_terminate(admission *self)
+{
+  if (self && self->ctx) {
+    admission_ctx *ctx = self->ctx;
+    ctx->r->remove_hook(ctx->r, REACTOR_PHASE_CHECK, admission_check, ctx);
+    if (ctx->stats.overloaded) {
+      for (size_t i = 0; i < ctx->listeners_cnt; ++i)
+        admission_pause(ctx, ctx->listeners[i], 0);
+    }
+    free(ctx->listeners);
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void admission_free(admission *self)
+{
+  if (self) {
+    admission_terminate(self);
+    free(self);
+  }
+}
+
+static int admission_add_listener(admission *self, const event_handler *eh)
+{
+  if ( (!self) || (!self->ctx) || (!eh) ) {
+    return -1;
+  }
+
+  admission_ctx *ctx = self->ctx;
+  for (size_t i = 0; i < ctx->listeners_cnt; ++i) {
+    if (eh == ctx->listeners[i]) {
+      return -1;
+    }
+  }
+
+  if (ctx->listeners_cnt == ctx->listeners_cap) {
+    const size_t cap = (ctx->listeners_cap) ? 2 * ctx->listeners_cap : 4;
+    const event_handler **listeners = (const event_handler **) realloc(ctx->listeners, cap * sizeof(event_handler *));
+    if (!listeners) {
+      return -1;
+    }
+    ctx->listeners = listeners;
+    ctx->listeners_cap = cap;
+  }
+
+  ctx->listeners[ctx->listeners_cnt++] = eh;
+  if (ctx->stats.overloaded)
+    admission_pause(ctx, eh, 1);
+
+  return 0;
+}
+
+static int admission_remove_listener(admission *self, const event_handler *eh)
+{
+  if ( (!self) || (!self->ctx) || (!eh) ) {
+    return -1;
+  }
+
+  admission_ctx *ctx = self->ctx;
+  for (size_t i = 0; i < ctx->listeners_cnt; ++i) {
+    if (eh == ctx->listeners[i]) {
+      if (ctx->stats.overloaded)
+        admission_pause(ctx, eh, 0);
+      ctx->listeners[i] = ctx->listeners[--ctx->listeners_cnt];
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static int admission_admit(admission *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return 1;
+  }
+
+  admission_ctx *ctx = self->ctx;
+  if ( (ctx->stats.overloaded) && (ctx->cfg.policy & ADMISSION_REJECT) ) {
+    ++ctx->stats.rejected;
+    return 0;
+  }
+
+  return 1;
+}
+
+static size_t admission_read_budget(admission *self, size_t budget)
+{
+  if ( (!self) || (!self->ctx) || (!self->ctx->stats.overloaded) ||
+       (!(self->ctx->cfg.policy & ADMISSION_LIMIT_READS)) ) {
+    return budget;
+  }
+
+  const size_t res = budget / self->ctx->cfg.read_divisor;
+
+  return (res) ? res : 1;
+}
+
+static int admission_get_stats(admission *self, admission_stats *stats)
+{
+  if ( (!self) || (!self->ctx) || (!stats) ) {
+    return -1;
+  }
+
+  *stats = self->ctx->stats;
+
+  return 0;
+}
+
+static void admission_check(reactor *r, void *arg)
+{
+  admission_ctx *ctx = (admission_ctx *) arg;
+  reactor_activity activity;
+  reactor_load load;
+  if ( (0 != r->get_activity(r, &activity)) || (0 != r->get_load(r, &load)) ) {
+    return;
+  }
+
+  /* exponential moving average with weight 1/8, so single slow batch is not an overload */
+  ctx->stats.lag_ns = ctx->stats.lag_ns - ctx->stats.lag_ns / 8 + activity.busy_ns / 8;
+  if (load.full_batches != ctx->last_full_batches)
+    ++ctx->stats.full_batches;
+  else
+    ctx->stats.full_batches = 0;
+  ctx->last_full_batches = load.full_batches;
+
+  const uint64_t high_ns = (uint64_t) ctx->cfg.high_lag_us * 1000ULL;
+  const uint64_t low_ns = (uint64_t) ctx->cfg.low_lag_us * 1000ULL;
+  if (!ctx->stats.overloaded) {
+    if ( (ctx->stats.lag_ns >= high_ns) || (ctx->stats.full_batches >= ctx->cfg.full_batches) )
+      admission_set(ctx, 1);
+  }
+  else if ( (ctx->stats.lag_ns <= low_ns) && (!ctx->stats.full_batches) ) {
+    /* overload ends once the loop stays calm for hold_ms, any spike starts it over */
+    const uint64_t now_ns = admission_now_ns(ctx);
+    if (!ctx->calm_since_ns)
+      ctx->calm_since_ns = now_ns;
+    else if (now_ns - ctx->calm_since_ns >= (uint64_t) ctx->cfg.hold_ms * 1000000ULL)
+      admission_set(ctx, 0);
+  }
+  else {
+    ctx->calm_since_ns = 0;
+  }
+}
+
+static void admission_set(admission_ctx *ctx, int overloaded)
+{
+  ctx->stats.overloaded = overloaded;
+  ctx->calm_since_ns = 0;
+  if (overloaded)
+    ++ctx->stats.overloads;
+
+  for (size_t i = 0; i < ctx->listeners_cnt; ++i)
+    admission_pause(ctx, ctx->listeners[i], overloaded);
+
+  if (ctx->h)
+    ctx->h(ctx->owner, overloaded, ctx->arg);
+}
+
+static void admission_pause(admission_ctx *ctx, const event_handler *eh, int paused)
+{
+  uint32_t events = 0;
+  if ( (ctx->cfg.policy & ADMISSION_PAUSE_LISTENERS) && (0 == ctx->r->get_interest(ctx->r, eh, &events)) )
+    ctx->r->modify_eh(ctx->r, eh, (paused) ? (events & ~EPOLLIN) : (events | EPOLLIN));
+}
+
+static uint64_t admission_now_ns(admission_ctx *ctx)
+{
+  struct timespec ts;
+  if (0 != ctx->o->clock_gettime(CLOCK_MONOTONIC, &ts)) {
+    return 0;
+  }
+
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,163 @@
+#include "reactor/balancer.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct shed_request_s {
+  reactor *target;
+  double share;
+  unsigned int max_cnt;
+  int (*can_migrate)(const event_handler *e);
+} shed_request;
+
+struct balancer_ctx_s {
+  reactor **reactors;
+  unsigned long *last_events;
+  size_t cnt;
+  balancer_policy policy;
+};
+
+static void balancer_terminate(balancer *self);
+static void balancer_free(balancer *self);
+static int balancer_rebalance(balancer *self);
+static void balancer_shed(reactor *r, void *arg);
+static void balancer_drop_shed(reactor *r, void *arg);
+
+int balancer_init(balancer *b, reactor **reactors, size_t cnt, const balancer_policy *p)
+{
+  if ( (!b) || (!reactors) || (2 > cnt) || (!p) )
+    return -1;
+
+  memset(b, 0, sizeof(balancer));
+  balancer_ctx *ctx = (balancer_ctx *) malloc(sizeof(balancer_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(balancer_ctx));
+
+  ctx->reactors = (reactor **) malloc(cnt * sizeof(reactor *));
+  ctx->last_events = (unsigned long *) malloc(cnt * sizeof(unsigned long));
+  if ( (!ctx->reactors) || (!ctx->last_events) ) {
+    free(ctx->reactors);
+    free(ctx->last_events);
+    free(ctx);
+    return -1;
+  }
+
+  ctx->cnt = cnt;
+  ctx->policy = *p;
+  for (size_t i = 0; i < cnt; ++i) {
+    reactor_load load;
+    memset(&load, 0, sizeof(load));
+    ctx->reactors[i] = reactors[i];
+    if ( (!reactors[i]) || (0 != reactors[i]->get_load(reactors[i], &load)) ) {
+      free(ctx->reactors);
+      free(ctx->last_events);
+      free(ctx);
+      return -1;
+    }
+    ctx->last_events[i] = load.events;
+  }
+
+  b->ctx = ctx;
+  b->rebalance = balancer_rebalance;
+  b->destroy = balancer_terminate;
+
+  return 0;
+}
+
+balancer * balancer_alloc(reactor **reactors, size_t cnt, const balancer_policy *p)
+{
+  balancer *res = (balancer *) malloc(sizeof(balancer));
+  if (res) {
+    if (0 != balancer_init(res, reactors, cnt, p)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = balancer_free;
+  }
+
+  return res;
+}
+
+static void balancer_terminate(balancer *self)
+{
+  if (self && self->ctx) {
+    free(self->ctx->reactors);
+    free(self->ctx->last_events);
+    free(self->ctx);
+    self->ctx = 0;
+  }
+}
+
+static void balancer_free(balancer *self)
+{
+  if (self) {
+    balancer_terminate(self);
+    free(self);
+  }
+}
+
+static int balancer_rebalance(balancer *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  balancer_ctx *ctx = self->ctx;
+  size_t hot = 0;
+  size_t cold = 0;
+  unsigned long hot_events = 0;
+  unsigned long cold_events = (unsigned long) -1;
+  for (size_t i = 0; i < ctx->cnt; ++i) {
+    reactor_load load;
+    if (0 != ctx->reactors[i]->get_load(ctx->reactors[i], &load)) {
+      return -1;
+    }
+
+    const unsigned long delta = load.events - ctx->last_events[i];
+    ctx->last_events[i] = load.events;
+    if (delta >= hot_events) {
+      hot = i;
+      hot_events = delta;
+    }
+    if (delta < cold_events) {
+      cold = i;
+      cold_events = delta;
+    }
+  }
+
+  if ( (hot == cold) || (!hot_events) || (hot_events < ctx->policy.min_events) ||
+       ((double) hot_events < ctx->policy.imbalance_ratio * (double) cold_events) ) {
+    return 0;
+  }
+
+  shed_request *req = (shed_request *) malloc(sizeof(shed_request));
+  if (!req) {
+    return -1;
+  }
+  req->target = ctx->reactors[cold];
+  /* half of the difference is moved, as a share of hot reactor's events */
+  req->share = (double) (hot_events - cold_events) / 2.0 / (double) hot_events;
+  req->max_cnt = ctx->policy.max_migrations;
+  req->can_migrate = ctx->policy.can_migrate;
+
+  reactor *r = ctx->reactors[hot];
+  if (0 != r->post_with_cleanup(r, balancer_shed, balancer_drop_shed, req)) {
+    free(req);
+    return -1;
+  }
+
+  return 1;
+}
+
+static void balancer_shed(reactor *r, void *arg)
+{
+  shed_request *req = (shed_request *) arg;
+  r->shed_load(r, req->target, req->share, req->max_cnt, req->can_migrate);
+  free(req);
+}
+
+static void balancer_drop_shed(reactor *r, void *arg)
+{
+  free(arg);
+}
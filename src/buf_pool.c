@@ -0,0 +1,285 @@
+#include "reactor/buf_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#endif
+#ifndef MPOL_BIND
+#define MPOL_BIND 2
+#endif
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+typedef struct chunk_s {
+  void *mem;
+  size_t len;
+  io_buf *hdrs;
+  struct chunk_s *next;
+} chunk;
+
+typedef struct size_class_s {
+  size_t buf_size;
+  io_buf *free_list;
+  chunk *chunks;
+} size_class;
+
+struct buf_pool_ctx_s {
+  const os *o;
+  size_class classes[BUF_POOL_MAX_CLASSES];
+  unsigned int classes_cnt;
+  size_t chunk_size;
+  int use_hugepages;
+  int numa_node;
+  size_t reserved_bytes;
+  size_t used_bytes;
+};
+
+static void buf_pool_terminate(buf_pool *self);
+static void buf_pool_free(buf_pool *self);
+static io_buf * buf_pool_acquire(buf_pool *self, size_t size);
+static void buf_pool_release(buf_pool *self, io_buf *b);
+static int buf_pool_get_stats(buf_pool *self, buf_pool_stats *stats);
+static int buf_pool_reserve(buf_pool_ctx *ctx, unsigned int cls);
+static void * buf_pool_map(buf_pool_ctx *ctx, size_t *len);
+static int buf_pool_bind(buf_pool_ctx *ctx, void *mem, size_t len);
+
+int buf_pool_init(buf_pool *p, const os *o, const buf_pool_config *cfg)
+{
+  static const size_t default_classes[] = { 2048, 8192, 32768, 131072 };
+
+  if ( (!p) || (!o) || (!o->mmap) || (!o->munmap) ||
+       ( (cfg) && (cfg->bind_numa_node) && ( (cfg->numa_node < 0) || (!o->mbind) ) ) )
+    return -1;
+
+  memset(p, 0, sizeof(buf_pool));
+  buf_pool_ctx *ctx = (buf_pool_ctx *) malloc(sizeof(buf_pool_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(buf_pool_ctx));
+
+  ctx->o = o;
+  ctx->chunk_size = HUGEPAGE_SIZE;
+  ctx->numa_node = -1;
+  if ( (cfg) && (cfg->classes[0]) ) {
+    for (unsigned int i = 0; (i < BUF_POOL_MAX_CLASSES) && (cfg->classes[i]); ++i) {
+      if ( (i) && (cfg->classes[i] <= cfg->classes[i - 1]) ) {
+        free(ctx);
+        return -1;
+      }
+      ctx->classes[ctx->classes_cnt++].buf_size = cfg->classes[i];
+    }
+  }
+  else {
+    for (unsigned int i = 0; i < sizeof(default_classes) / sizeof(default_classes[0]); ++i)
+      ctx->classes[ctx->classes_cnt++].buf_size = default_classes[i];
+  }
+  if (cfg) {
+    if (cfg->chunk_size)
+      ctx->chunk_size = cfg->chunk_size;
+    ctx->use_hugepages = cfg->use_hugepages;
+    if (cfg->bind_numa_node)
+      ctx->numa_node = cfg->numa_node;
+  }
+
+  p->ctx = ctx;
+  p->acquire = buf_pool_acquire;
+  p->release = buf_pool_release;
+  p->get_stats = buf_pool_get_stats;
+  p->destroy = buf_pool_terminate;
+
+  return 0;
+}
+
+buf_pool * buf_pool_alloc(const os *o, const buf_pool_config *cfg)
+{
+  buf_pool *res = (buf_pool *) malloc(sizeof(buf_pool));
+  if (res) {
+    if (0 != buf_pool_init(res, o, cfg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = buf_pool_free;
+  }
+
+  return res;
+}
+
+static void buf_pool_terminate(buf_pool *self)
+{
+  if (self && self->ctx) {
+    buf_pool_ctx *ctx = self->ctx;
+    for (unsigned int i = 0; i < ctx->classes_cnt; ++i) {
+      chunk *c = ctx->classes[i].chunks;
+      while (c) {
+        chunk *next = c->next;
+        ctx->o->munmap(c->mem, c->len);
+        free(c->hdrs);
+        free(c);
+        c = next;
+      }
+    }
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void buf_pool_free(buf_pool *self)
+{
+  if (self) {
+    buf_pool_terminate(self);
+    free(self);
+  }
+}
+
+static io_buf * buf_pool_acquire(buf_pool *self, size_t size)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return 0;
+  }
+
+  buf_pool_ctx *ctx = self->ctx;
+  unsigned int cls = 0;
+  while ( (cls < ctx->classes_cnt) && (ctx->classes[cls].buf_size < size) )
+    ++cls;
+  if (cls == ctx->classes_cnt) {
+    return 0;
+  }
+
+  size_class *sc = &ctx->classes[cls];
+  if ( (!sc->free_list) && (0 != buf_pool_reserve(ctx, cls)) ) {
+    return 0;
+  }
+
+  io_buf *res = sc->free_list;
+  sc->free_list = res->next;
+  res->next = 0;
+  res->begin = 0;
+  res->end = 0;
+  ctx->used_bytes += res->size;
+
+  return res;
+}
+
+static void buf_pool_release(buf_pool *self, io_buf *b)
+{
+  if ( (!self) || (!self->ctx) || (!b) || (b->cls >= self->ctx->classes_cnt) ) {
+    return;
+  }
+
+  size_class *sc = &self->ctx->classes[b->cls];
+  self->ctx->used_bytes -= b->size;
+  b->next = sc->free_list;
+  sc->free_list = b;
+}
+
+static int buf_pool_get_stats(buf_pool *self, buf_pool_stats *stats)
+{
+  if ( (!self) || (!self->ctx) || (!stats) ) {
+    return -1;
+  }
+
+  stats->reserved_bytes = self->ctx->reserved_bytes;
+  stats->used_bytes = self->ctx->used_bytes;
+
+  return 0;
+}
+
+static int buf_pool_reserve(buf_pool_ctx *ctx, unsigned int cls)
+{
+  size_class *sc = &ctx->classes[cls];
+  size_t len = (ctx->chunk_size > sc->buf_size) ? ctx->chunk_size : sc->buf_size;
+  len = (len + sc->buf_size - 1) / sc->buf_size * sc->buf_size;
+
+  chunk *c = (chunk *) malloc(sizeof(chunk));
+  if (!c) {
+    return -1;
+  }
+
+  const size_t cnt = len / sc->buf_size;
+  c->hdrs = (io_buf *) malloc(cnt * sizeof(io_buf));
+  c->mem = (c->hdrs) ? buf_pool_map(ctx, &len) : 0;
+  if (!c->mem) {
+    free(c->hdrs);
+    free(c);
+    return -1;
+  }
+  c->len = len;
+  c->next = sc->chunks;
+  sc->chunks = c;
+  ctx->reserved_bytes += len;
+
+  for (size_t i = 0; i < cnt; ++i) {
+    io_buf *b = &c->hdrs[i];
+    b->data = (char *) c->mem + i * sc->buf_size;
+    b->size = sc->buf_size;
+    b->begin = 0;
+    b->end = 0;
+    b->cls = cls;
+    b->next = sc->free_list;
+    sc->free_list = b;
+  }
+
+  return 0;
+}
+
+static void * buf_pool_map(buf_pool_ctx *ctx, size_t *len)
+{
+  void *res = MAP_FAILED;
+  if (ctx->use_hugepages) {
+    const size_t huge_len = (*len + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+    res = ctx->o->mmap(0, huge_len, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (MAP_FAILED != res)
+      *len = huge_len;
+  }
+
+  if (MAP_FAILED == res) {
+    res = ctx->o->mmap(0, *len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == res) {
+      return 0;
+    }
+    /* transparent hugepages are only a hint, chunk is usable without them */
+    if ( (ctx->use_hugepages) && (ctx->o->madvise) )
+      ctx->o->madvise(res, *len, MADV_HUGEPAGE);
+  }
+
+  if (0 != buf_pool_bind(ctx, res, *len)) {
+    ctx->o->munmap(res, *len);
+    return 0;
+  }
+
+  return res;
+}
+
+static int buf_pool_bind(buf_pool_ctx *ctx, void *mem, size_t len)
+{
+  const int required = (0 <= ctx->numa_node);
+  int node = ctx->numa_node;
+  if (!required) {
+    /* local placement is only a preference, pages stay where the first touch puts them */
+    unsigned int cpu = 0;
+    unsigned int cpu_node = 0;
+    if ( (!ctx->o->mbind) || (!ctx->o->getcpu) || (0 != ctx->o->getcpu(&cpu, &cpu_node)) ) {
+      return 0;
+    }
+    node = (int) cpu_node;
+  }
+
+  const unsigned long bits = 8 * sizeof(unsigned long);
+  unsigned long mask[4];
+  if ((unsigned long) node >= bits * (sizeof(mask) / sizeof(mask[0]))) {
+    return (required) ? -1 : 0;
+  }
+  memset(mask, 0, sizeof(mask));
+  mask[node / bits] = 1UL << (node % bits);
+
+  const int mode = (required) ? MPOL_BIND : MPOL_PREFERRED;
+  if (0 != ctx->o->mbind(mem, len, mode, mask, bits * (sizeof(mask) / sizeof(mask[0])), 0)) {
+    return (required) ? -1 : 0;
+  }
+
+  return 0;
+}
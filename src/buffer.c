@@ -0,0 +1,273 @@
+#include "reactor/buffer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+struct shared_buf_s {
+  atomic_size_t refs;
+  const char *data;
+  size_t size;
+  void (*release)(const void *data, void *arg);
+  void *arg;
+  char inline_data[];
+};
+
+typedef struct slice_s {
+  shared_buf *b;
+  size_t offset;
+  size_t len;
+} slice;
+
+struct out_queue_ctx_s {
+  const os *o;
+  slice *slices;
+  size_t head;
+  size_t cnt;
+  size_t cap;
+  size_t pending;
+};
+
+static void out_queue_terminate(out_queue *self);
+static void out_queue_free(out_queue *self);
+static int out_queue_push(out_queue *self, shared_buf *b, size_t offset, size_t len);
+static ssize_t out_queue_flush(out_queue *self, int fd);
+static size_t out_queue_pending(out_queue *self);
+static int out_queue_grow(out_queue_ctx *ctx);
+static void out_queue_consume(out_queue_ctx *ctx, size_t written);
+
+shared_buf * shared_buf_alloc(const void *data, size_t size)
+{
+  if ( (!data) && (size) )
+    return 0;
+
+  shared_buf *res = (shared_buf *) malloc(sizeof(shared_buf) + size);
+  if (res) {
+    atomic_init(&res->refs, 1);
+    memcpy(res->inline_data, data, size);
+    res->data = res->inline_data;
+    res->size = size;
+    res->release = 0;
+    res->arg = 0;
+  }
+
+  return res;
+}
+
+shared_buf * shared_buf_wrap(const void *data, size_t size,
+                             void (*release)(const void *data, void *arg), void *arg)
+{
+  if ( (!data) && (size) )
+    return 0;
+
+  shared_buf *res = (shared_buf *) malloc(sizeof(shared_buf));
+  if (res) {
+    atomic_init(&res->refs, 1);
+    res->data = (const char *) data;
+    res->size = size;
+    res->release = release;
+    res->arg = arg;
+  }
+
+  return res;
+}
+
+shared_buf * shared_buf_ref(shared_buf *b)
+{
+  if (b)
+    atomic_fetch_add_explicit(&b->refs, 1, memory_order_relaxed);
+
+  return b;
+}
+
+void shared_buf_unref(shared_buf *b)
+{
+  if ( (b) && (1 == atomic_fetch_sub_explicit(&b->refs, 1, memory_order_acq_rel)) ) {
+    if (b->release)
+      b->release(b->data, b->arg);
+    free(b);
+  }
+}
+
+const void * shared_buf_data(const shared_buf *b)
+{
+  return (b) ? b->data : 0;
+}
+
+size_t shared_buf_size(const shared_buf *b)
+{
+  return (b) ? b->size : 0;
+}
+
+int out_queue_init(out_queue *q, const os *o)
+{
+  if ( (!q) || (!o) || (!o->writev) )
+    return -1;
+
+  memset(q, 0, sizeof(out_queue));
+  out_queue_ctx *ctx = (out_queue_ctx *) malloc(sizeof(out_queue_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(out_queue_ctx));
+  ctx->o = o;
+
+  q->ctx = ctx;
+  q->push = out_queue_push;
+  q->flush = out_queue_flush;
+  q->pending = out_queue_pending;
+  q->destroy = out_queue_terminate;
+
+  return 0;
+}
+
+out_queue * out_queue_alloc(const os *o)
+{
+  out_queue *res = (out_queue *) malloc(sizeof(out_queue));
+  if (res) {
+    if (0 != out_queue_init(res, o)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = out_queue_free;
+  }
+
+  return res;
+}
+
+size_t out_queue_broadcast(out_queue **qs, size_t cnt, shared_buf *b)
+{
+  size_t res = 0;
+  if ( (qs) && (b) ) {
+    for (size_t i = 0; i < cnt; ++i) {
+      if ( (qs[i]) && (0 == qs[i]->push(qs[i], b, 0, b->size)) )
+        ++res;
+    }
+  }
+
+  return res;
+}
+
+static void out_queue_terminate(out_queue *self)
+{
+  if (self && self->ctx) {
+    out_queue_ctx *ctx = self->ctx;
+    for (size_t i = 0; i < ctx->cnt; ++i)
+      shared_buf_unref(ctx->slices[(ctx->head + i) % ctx->cap].b);
+    free(ctx->slices);
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void out_queue_free(out_queue *self)
+{
+  if (self) {
+    out_queue_terminate(self);
+    free(self);
+  }
+}
+
+static int out_queue_push(out_queue *self, shared_buf *b, size_t offset, size_t len)
+{
+  if ( (!self) || (!self->ctx) || (!b) || (offset > b->size) || (len > b->size - offset) ) {
+    return -1;
+  }
+
+  if (0 == len) {
+    return 0;
+  }
+
+  out_queue_ctx *ctx = self->ctx;
+  if ( (ctx->cnt == ctx->cap) && (0 != out_queue_grow(ctx)) ) {
+    return -1;
+  }
+
+  slice *s = &ctx->slices[(ctx->head + ctx->cnt) % ctx->cap];
+  s->b = shared_buf_ref(b);
+  s->offset = offset;
+  s->len = len;
+  ++ctx->cnt;
+  ctx->pending += len;
+
+  return 0;
+}
+
+static ssize_t out_queue_flush(out_queue *self, int fd)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  out_queue_ctx *ctx = self->ctx;
+  struct iovec iov[IOV_MAX];
+  ssize_t res = 0;
+  while (ctx->cnt) {
+    int iov_cnt = 0;
+    for (size_t i = 0; (i < ctx->cnt) && (iov_cnt < IOV_MAX); ++i, ++iov_cnt) {
+      const slice *s = &ctx->slices[(ctx->head + i) % ctx->cap];
+      iov[iov_cnt].iov_base = (void *) (s->b->data + s->offset);
+      iov[iov_cnt].iov_len = s->len;
+    }
+
+    const ssize_t written = ctx->o->writev(fd, iov, iov_cnt);
+    if (written < 0) {
+      if ( (EAGAIN == errno) || (EWOULDBLOCK == errno) || (EINTR == errno) )
+        break;
+      return -1;
+    }
+
+    out_queue_consume(ctx, (size_t) written);
+    res += written;
+    if (0 == written)
+      break;
+  }
+
+  return res;
+}
+
+static size_t out_queue_pending(out_queue *self)
+{
+  return ( (self) && (self->ctx) ) ? self->ctx->pending : 0;
+}
+
+static int out_queue_grow(out_queue_ctx *ctx)
+{
+  const size_t cap = (ctx->cap) ? 2 * ctx->cap : 8;
+  slice *slices = (slice *) malloc(cap * sizeof(slice));
+  if (!slices) {
+    return -1;
+  }
+
+  for (size_t i = 0; i < ctx->cnt; ++i)
+    slices[i] = ctx->slices[(ctx->head + i) % ctx->cap];
+  free(ctx->slices);
+  ctx->slices = slices;
+  ctx->head = 0;
+  ctx->cap = cap;
+
+  return 0;
+}
+
+static void out_queue_consume(out_queue_ctx *ctx, size_t written)
+{
+  ctx->pending -= written;
+  while ( (written) && (ctx->cnt) ) {
+    slice *s = &ctx->slices[ctx->head];
+    if (written < s->len) {
+      s->offset += written;
+      s->len -= written;
+      break;
+    }
+
+    written -= s->len;
+    shared_buf_unref(s->b);
+    ctx->head = (ctx->head + 1) % ctx->cap;
+    --ctx->cnt;
+  }
+}
@@ -0,0 +1,247 @@
+#include "reactor/channel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+
+#define CACHE_LINE 64
+
+struct channel_ctx_s {
+  _Alignas(CACHE_LINE) atomic_size_t tail;
+  size_t cached_head;
+  _Alignas(CACHE_LINE) atomic_size_t head;
+  atomic_int signaled;
+  _Alignas(CACHE_LINE) const os *o;
+  channel_kind kind;
+  size_t msg_size;
+  size_t mask;
+  atomic_size_t *seqs;
+  char *msgs;
+  channel_handler handler;
+  void *arg;
+};
+
+static void channel_terminate(channel *self);
+static void channel_free(channel *self);
+static int channel_send(channel *self, const void *msg);
+static size_t channel_drain(channel *self);
+static void channel_handle_event(event_handler *self, uint32_t events);
+static int channel_publish_spsc(channel_ctx *ctx, const void *msg);
+static int channel_publish_mpsc(channel_ctx *ctx, const void *msg);
+static size_t channel_ready_spsc(channel_ctx *ctx, size_t head, size_t max_cnt);
+static size_t channel_ready_mpsc(channel_ctx *ctx, size_t head, size_t max_cnt);
+
+int channel_init(channel *ch, const os *o, channel_kind kind, size_t msg_size,
+                 size_t capacity, channel_handler handler, void *arg)
+{
+  if ( (!ch) || (!o) || (!o->eventfd) || (0 == msg_size) || (0 == capacity) || (!handler) )
+    return -1;
+
+  size_t cap = 1;
+  while (cap < capacity)
+    cap <<= 1;
+
+  memset(ch, 0, sizeof(channel));
+  channel_ctx *ctx = (channel_ctx *) aligned_alloc(CACHE_LINE, sizeof(channel_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(channel_ctx));
+
+  ctx->msgs = (char *) malloc(cap * msg_size);
+  if (CHANNEL_MPSC == kind)
+    ctx->seqs = (atomic_size_t *) malloc(cap * sizeof(atomic_size_t));
+  const int fd = o->eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if ( (!ctx->msgs) || ( (CHANNEL_MPSC == kind) && (!ctx->seqs) ) || (fd < 0) ) {
+    if (0 <= fd)
+      o->close(fd);
+    free(ctx->msgs);
+    free(ctx->seqs);
+    free(ctx);
+    return -1;
+  }
+
+  atomic_init(&ctx->tail, 0);
+  atomic_init(&ctx->head, 0);
+  atomic_init(&ctx->signaled, 0);
+  for (size_t i = 0; (ctx->seqs) && (i < cap); ++i)
+    atomic_init(&ctx->seqs[i], i);
+  ctx->o = o;
+  ctx->kind = kind;
+  ctx->msg_size = msg_size;
+  ctx->mask = cap - 1;
+  ctx->handler = handler;
+  ctx->arg = arg;
+
+  ch->ctx = ctx;
+  ch->eh.fd = fd;
+  ch->eh.ctx = ch;
+  ch->eh.handle_event = channel_handle_event;
+  ch->send = channel_send;
+  ch->drain = channel_drain;
+  ch->destroy = channel_terminate;
+
+  return 0;
+}
+
+channel * channel_alloc(const os *o, channel_kind kind, size_t msg_size,
+                        size_t capacity, channel_handler handler, void *arg)
+{
+  channel *res = (channel *) malloc(sizeof(channel));
+  if (res) {
+    if (0 != channel_init(res, o, kind, msg_size, capacity, handler, arg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = channel_free;
+  }
+
+  return res;
+}
+
+static void channel_terminate(channel *self)
+{
+  if (self && self->ctx) {
+    self->ctx->o->close(self->eh.fd);
+    free(self->ctx->msgs);
+    free(self->ctx->seqs);
+    free(self->ctx);
+    self->ctx = 0;
+    self->eh.fd = -1;
+  }
+}
+
+static void channel_free(channel *self)
+{
+  if (self) {
+    channel_terminate(self);
+    free(self);
+  }
+}
+
+static int channel_send(channel *self, const void *msg)
+{
+  if ( (!self) || (!self->ctx) || (!msg) ) {
+    return -1;
+  }
+
+  channel_ctx *ctx = self->ctx;
+  const int res = (CHANNEL_SPSC == ctx->kind) ? channel_publish_spsc(ctx, msg)
+                                              : channel_publish_mpsc(ctx, msg);
+
+  if ( (0 == res) && (0 == atomic_exchange_explicit(&ctx->signaled, 1, memory_order_seq_cst)) ) {
+    const uint64_t one = 1;
+    ctx->o->write(self->eh.fd, &one, sizeof(one));
+  }
+
+  return res;
+}
+
+static size_t channel_drain(channel *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return 0;
+  }
+
+  channel_ctx *ctx = self->ctx;
+  const size_t cap = ctx->mask + 1;
+  size_t res = 0;
+  size_t head = atomic_load_explicit(&ctx->head, memory_order_relaxed);
+  while (res < cap) {
+    const size_t idx = head & ctx->mask;
+    const size_t contiguous = (cap - idx < cap - res) ? cap - idx : cap - res;
+    const size_t cnt = (CHANNEL_SPSC == ctx->kind) ? channel_ready_spsc(ctx, head, contiguous)
+                                                   : channel_ready_mpsc(ctx, head, contiguous);
+    if (0 == cnt)
+      break;
+
+    ctx->handler(self, ctx->msgs + idx * ctx->msg_size, cnt, ctx->arg);
+
+    if (CHANNEL_MPSC == ctx->kind) {
+      for (size_t i = 0; i < cnt; ++i)
+        atomic_store_explicit(&ctx->seqs[idx + i], head + i + cap, memory_order_release);
+    }
+    head += cnt;
+    atomic_store_explicit(&ctx->head, head, memory_order_release);
+    res += cnt;
+  }
+
+  /* the rest is left for the next wake-up, so other handlers of the reactor are not starved */
+  if ( (res == cap) && (0 != ((CHANNEL_SPSC == ctx->kind) ? channel_ready_spsc(ctx, head, 1)
+                                                          : channel_ready_mpsc(ctx, head, 1))) ) {
+    const uint64_t one = 1;
+    atomic_store_explicit(&ctx->signaled, 1, memory_order_seq_cst);
+    ctx->o->write(self->eh.fd, &one, sizeof(one));
+  }
+
+  return res;
+}
+
+static void channel_handle_event(event_handler *self, uint32_t events)
+{
+  channel *ch = (channel *) self->ctx;
+  uint64_t cnt = 0;
+
+  ch->ctx->o->read(self->fd, &cnt, sizeof(cnt));
+  atomic_store_explicit(&ch->ctx->signaled, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  channel_drain(ch);
+}
+
+static int channel_publish_spsc(channel_ctx *ctx, const void *msg)
+{
+  const size_t tail = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+  if (tail - ctx->cached_head > ctx->mask) {
+    ctx->cached_head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+    if (tail - ctx->cached_head > ctx->mask)
+      return -1;
+  }
+
+  memcpy(ctx->msgs + (tail & ctx->mask) * ctx->msg_size, msg, ctx->msg_size);
+  atomic_store_explicit(&ctx->tail, tail + 1, memory_order_release);
+
+  return 0;
+}
+
+static int channel_publish_mpsc(channel_ctx *ctx, const void *msg)
+{
+  size_t pos = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+  for (;;) {
+    const size_t seq = atomic_load_explicit(&ctx->seqs[pos & ctx->mask], memory_order_acquire);
+    const intptr_t dif = (intptr_t) seq - (intptr_t) pos;
+    if (0 == dif) {
+      if (atomic_compare_exchange_weak_explicit(&ctx->tail, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+        break;
+    }
+    else if (dif < 0) {
+      return -1;
+    }
+    else {
+      pos = atomic_load_explicit(&ctx->tail, memory_order_relaxed);
+    }
+  }
+
+  memcpy(ctx->msgs + (pos & ctx->mask) * ctx->msg_size, msg, ctx->msg_size);
+  atomic_store_explicit(&ctx->seqs[pos & ctx->mask], pos + 1, memory_order_release);
+
+  return 0;
+}
+
+static size_t channel_ready_spsc(channel_ctx *ctx, size_t head, size_t max_cnt)
+{
+  const size_t available = atomic_load_explicit(&ctx->tail, memory_order_acquire) - head;
+
+  return (available < max_cnt) ? available : max_cnt;
+}
+
+static size_t channel_ready_mpsc(channel_ctx *ctx, size_t head, size_t max_cnt)
+{
+  size_t res = 0;
+  while ( (res < max_cnt) &&
+          (head + res + 1 == atomic_load_explicit(&ctx->seqs[(head + res) & ctx->mask], memory_order_acquire)) )
+    ++res;
+
+  return res;
+}
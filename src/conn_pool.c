@@ -0,0 +1,348 @@
+#include "reactor/conn_pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+typedef struct idle_conn_s {
+  int fd;
+  long long since_ms;
+} idle_conn;
+
+typedef struct upstream_s {
+  char *key;
+  idle_conn *idle;
+  unsigned int idle_cnt;
+  struct upstream_s *next;
+} upstream;
+
+typedef struct request_s {
+  conn_pool *pool;
+  conn_pool_handler h;
+  void *arg;
+  int fd;
+  struct request_s *prev;
+  struct request_s *next;
+} request;
+
+struct conn_pool_ctx_s {
+  reactor *r;
+  const os *o;
+  conn_pool_config cfg;
+  connector conn;
+  event_handler ready_eh;
+  upstream *upstreams;
+  request *ready;
+  request *ready_tail;
+  request *connecting;
+};
+
+static void conn_pool_terminate(conn_pool *self);
+static void conn_pool_free(conn_pool *self);
+static int conn_pool_acquire(conn_pool *self, const char *key, const struct sockaddr *addr,
+                             socklen_t addrlen, conn_pool_handler h, void *arg);
+static void conn_pool_release(conn_pool *self, const char *key, int fd, int reusable);
+static unsigned int conn_pool_idle(conn_pool *self, const char *key);
+static void conn_pool_handle_ready(event_handler *self, uint32_t events);
+static void conn_pool_connected(connector *c, int fd, int err, void *arg);
+static upstream * conn_pool_find(conn_pool_ctx *ctx, const char *key, int create);
+static int conn_pool_take_idle(conn_pool_ctx *ctx, upstream *u);
+static void conn_pool_expire(conn_pool_ctx *ctx, upstream *u);
+static long long conn_pool_now_ms(conn_pool_ctx *ctx);
+static void conn_pool_unlink(request **list, request *req);
+static void conn_pool_cancel(conn_pool *p, request *list);
+
+int conn_pool_init(conn_pool *p, reactor *r, const os *o, const conn_pool_config *cfg)
+{
+  if ( (!p) || (!r) || (!o) || (!cfg) || (!o->recv) || (!o->clock_gettime) || (!o->eventfd) )
+    return -1;
+
+  memset(p, 0, sizeof(conn_pool));
+  conn_pool_ctx *ctx = (conn_pool_ctx *) malloc(sizeof(conn_pool_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(conn_pool_ctx));
+  ctx->r = r;
+  ctx->o = o;
+  ctx->cfg = *cfg;
+
+  if (0 != connector_init(&ctx->conn, r, o)) {
+    free(ctx);
+    return -1;
+  }
+
+  ctx->ready_eh.fd = o->eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  ctx->ready_eh.ctx = p;
+  ctx->ready_eh.handle_event = conn_pool_handle_ready;
+  if ( (ctx->ready_eh.fd < 0) || (0 != r->register_eh(r, &ctx->ready_eh)) ) {
+    if (0 <= ctx->ready_eh.fd)
+      o->close(ctx->ready_eh.fd);
+    ctx->conn.destroy(&ctx->conn);
+    free(ctx);
+    return -1;
+  }
+
+  p->ctx = ctx;
+  p->acquire = conn_pool_acquire;
+  p->release = conn_pool_release;
+  p->idle = conn_pool_idle;
+  p->destroy = conn_pool_terminate;
+
+  return 0;
+}
+
+conn_pool * conn_pool_alloc(reactor *r, const os *o, const conn_pool_config *cfg)
+{
+  conn_pool *res = (conn_pool *) malloc(sizeof(conn_pool));
+  if (res) {
+    if (0 != conn_pool_init(res, r, o, cfg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = conn_pool_free;
+  }
+
+  return res;
+}
+
+static void conn_pool_terminate(conn_pool *self)
+{
+  if (self && self->ctx) {
+    conn_pool_ctx *ctx = self->ctx;
+    ctx->r->unregister_eh(ctx->r, &ctx->ready_eh);
+    ctx->o->close(ctx->ready_eh.fd);
+    ctx->conn.destroy(&ctx->conn);
+
+    request *ready = ctx->ready;
+    request *connecting = ctx->connecting;
+    ctx->ready = 0;
+    ctx->ready_tail = 0;
+    ctx->connecting = 0;
+    for (request *req = ready; 0 != req; req = req->next)
+      ctx->o->close(req->fd);
+    conn_pool_cancel(self, ready);
+    conn_pool_cancel(self, connecting);
+    while (ctx->upstreams) {
+      upstream *u = ctx->upstreams;
+      ctx->upstreams = u->next;
+      for (unsigned int i = 0; i < u->idle_cnt; ++i)
+        ctx->o->close(u->idle[i].fd);
+      free(u->idle);
+      free(u->key);
+      free(u);
+    }
+
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void conn_pool_free(conn_pool *self)
+{
+  if (self) {
+    conn_pool_terminate(self);
+    free(self);
+  }
+}
+
+static int conn_pool_acquire(conn_pool *self, const char *key, const struct sockaddr *addr,
+                             socklen_t addrlen, conn_pool_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!key) || (!addr) || (!h) ) {
+    return -1;
+  }
+
+  conn_pool_ctx *ctx = self->ctx;
+  request *req = (request *) malloc(sizeof(request));
+  if (!req) {
+    return -1;
+  }
+  memset(req, 0, sizeof(request));
+  req->pool = self;
+  req->h = h;
+  req->arg = arg;
+  /* upstream is created by release, once there is a connection to keep */
+  upstream *u = conn_pool_find(ctx, key, 0);
+  req->fd = (u) ? conn_pool_take_idle(ctx, u) : -1;
+
+  if (0 <= req->fd) {
+    const uint64_t one = 1;
+    if (!ctx->ready) {
+      ctx->o->write(ctx->ready_eh.fd, &one, sizeof(one));
+      ctx->ready = req;
+    }
+    else {
+      ctx->ready_tail->next = req;
+      req->prev = ctx->ready_tail;
+    }
+    ctx->ready_tail = req;
+    return 0;
+  }
+
+  if (0 != ctx->conn.connect(&ctx->conn, addr, addrlen, ctx->cfg.connect_timeout_ms,
+                             conn_pool_connected, req)) {
+    free(req);
+    return -1;
+  }
+
+  req->next = ctx->connecting;
+  if (ctx->connecting)
+    ctx->connecting->prev = req;
+  ctx->connecting = req;
+
+  return 0;
+}
+
+static void conn_pool_release(conn_pool *self, const char *key, int fd, int reusable)
+{
+  if ( (!self) || (!self->ctx) || (fd < 0) ) {
+    return;
+  }
+
+  conn_pool_ctx *ctx = self->ctx;
+  upstream *u = (reusable && key) ? conn_pool_find(ctx, key, 1) : 0;
+  if (u)
+    conn_pool_expire(ctx, u);
+
+  if ( (!u) || (u->idle_cnt >= ctx->cfg.max_idle) ) {
+    ctx->o->close(fd);
+    return;
+  }
+
+  u->idle[u->idle_cnt].fd = fd;
+  u->idle[u->idle_cnt].since_ms = conn_pool_now_ms(ctx);
+  ++u->idle_cnt;
+}
+
+static unsigned int conn_pool_idle(conn_pool *self, const char *key)
+{
+  if ( (!self) || (!self->ctx) || (!key) ) {
+    return 0;
+  }
+
+  upstream *u = conn_pool_find(self->ctx, key, 0);
+
+  return (u) ? u->idle_cnt : 0;
+}
+
+static void conn_pool_handle_ready(event_handler *self, uint32_t events)
+{
+  conn_pool *p = (conn_pool *) self->ctx;
+  conn_pool_ctx *ctx = p->ctx;
+  uint64_t cnt = 0;
+  ctx->o->read(self->fd, &cnt, sizeof(cnt));
+
+  request *ready = ctx->ready;
+  ctx->ready = 0;
+  ctx->ready_tail = 0;
+  while (ready) {
+    request *req = ready;
+    ready = req->next;
+    req->h(p, req->fd, 0, req->arg);
+    free(req);
+  }
+}
+
+static void conn_pool_connected(connector *c, int fd, int err, void *arg)
+{
+  request *req = (request *) arg;
+  conn_pool *p = req->pool;
+
+  conn_pool_unlink(&p->ctx->connecting, req);
+  req->h(p, fd, err, req->arg);
+  free(req);
+}
+
+static upstream * conn_pool_find(conn_pool_ctx *ctx, const char *key, int create)
+{
+  for (upstream *u = ctx->upstreams; 0 != u; u = u->next) {
+    if (0 == strcmp(key, u->key))
+      return u;
+  }
+
+  if (!create) {
+    return 0;
+  }
+
+  upstream *u = (upstream *) malloc(sizeof(upstream));
+  if (!u) {
+    return 0;
+  }
+  memset(u, 0, sizeof(upstream));
+  u->key = strdup(key);
+  u->idle = (idle_conn *) malloc((ctx->cfg.max_idle + 1) * sizeof(idle_conn));
+  if ( (!u->key) || (!u->idle) ) {
+    free(u->key);
+    free(u->idle);
+    free(u);
+    return 0;
+  }
+  u->next = ctx->upstreams;
+  ctx->upstreams = u;
+
+  return u;
+}
+
+static int conn_pool_take_idle(conn_pool_ctx *ctx, upstream *u)
+{
+  conn_pool_expire(ctx, u);
+
+  while (u->idle_cnt) {
+    const int fd = u->idle[--u->idle_cnt].fd;
+    char c = 0;
+    const ssize_t res = ctx->o->recv(fd, &c, sizeof(c), MSG_PEEK | MSG_DONTWAIT);
+    if ( (res < 0) && ( (EAGAIN == errno) || (EWOULDBLOCK == errno) ) )
+      return fd;
+    ctx->o->close(fd);
+  }
+
+  return -1;
+}
+
+static void conn_pool_expire(conn_pool_ctx *ctx, upstream *u)
+{
+  if ( (0 >= ctx->cfg.max_idle_ms) || (0 == u->idle_cnt) ) {
+    return;
+  }
+
+  const long long deadline = conn_pool_now_ms(ctx) - ctx->cfg.max_idle_ms;
+  unsigned int expired = 0;
+  while ( (expired < u->idle_cnt) && (u->idle[expired].since_ms < deadline) )
+    ctx->o->close(u->idle[expired++].fd);
+
+  if (expired) {
+    u->idle_cnt -= expired;
+    memmove(u->idle, u->idle + expired, u->idle_cnt * sizeof(idle_conn));
+  }
+}
+
+static long long conn_pool_now_ms(conn_pool_ctx *ctx)
+{
+  struct timespec ts;
+  memset(&ts, 0, sizeof(ts));
+  ctx->o->clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (long long) ts.tv_sec * 1000LL + ts.tv_nsec / 1000000L;
+}
+
+static void conn_pool_unlink(request **list, request *req)
+{
+  if (req->prev)
+    req->prev->next = req->next;
+  else
+    *list = req->next;
+  if (req->next)
+    req->next->prev = req->prev;
+}
+
+static void conn_pool_cancel(conn_pool *p, request *list)
+{
+  while (list) {
+    request *req = list;
+    list = req->next;
+    req->h(p, -1, ECANCELED, req->arg);
+    free(req);
+  }
+}
@@ -0,0 +1,216 @@
+#include "reactor/connector.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+
+typedef struct connect_op_s {
+  connector *owner;
+  event_handler sock_eh;
+  event_handler timer_eh;
+  connector_handler h;
+  void *arg;
+  struct connect_op_s *prev;
+  struct connect_op_s *next;
+} connect_op;
+
+struct connector_ctx_s {
+  reactor *r;
+  const os *o;
+  connect_op *ops;
+};
+
+static void connector_terminate(connector *self);
+static void connector_free(connector *self);
+static int connector_connect(connector *self, const struct sockaddr *addr, socklen_t addrlen,
+                             int timeout_ms, connector_handler h, void *arg);
+static void connector_handle_connected(event_handler *self, uint32_t events);
+static void connector_handle_timeout(event_handler *self, uint32_t events);
+static int connector_arm_timer(connector_ctx *ctx, connect_op *op, int timeout_ms);
+static void connector_release(connector_ctx *ctx, connect_op *op, int close_sock);
+static void connector_finish(connect_op *op, int err);
+
+int connector_init(connector *c, reactor *r, const os *o)
+{
+  if ( (!c) || (!r) || (!o) || (!o->socket) || (!o->connect) || (!o->getsockopt) ||
+       (!o->timerfd_create) || (!o->timerfd_settime) )
+    return -1;
+
+  memset(c, 0, sizeof(connector));
+  connector_ctx *ctx = (connector_ctx *) malloc(sizeof(connector_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(connector_ctx));
+  ctx->r = r;
+  ctx->o = o;
+
+  c->ctx = ctx;
+  c->connect = connector_connect;
+  c->destroy = connector_terminate;
+
+  return 0;
+}
+
+connector * connector_alloc(reactor *r, const os *o)
+{
+  connector *res = (connector *) malloc(sizeof(connector));
+  if (res) {
+    if (0 != connector_init(res, r, o)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = connector_free;
+  }
+
+  return res;
+}
+
+static void connector_terminate(connector *self)
+{
+  if (self && self->ctx) {
+    while (self->ctx->ops) {
+      connect_op *op = self->ctx->ops;
+      self->ctx->ops = op->next;
+      connector_release(self->ctx, op, 1);
+      free(op);
+    }
+    free(self->ctx);
+    self->ctx = 0;
+  }
+}
+
+static void connector_free(connector *self)
+{
+  if (self) {
+    connector_terminate(self);
+    free(self);
+  }
+}
+
+static int connector_connect(connector *self, const struct sockaddr *addr, socklen_t addrlen,
+                             int timeout_ms, connector_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!addr) || (!h) || (timeout_ms < 0) ) {
+    return -1;
+  }
+
+  connector_ctx *ctx = self->ctx;
+  const int fd = ctx->o->socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  if ( (0 != ctx->o->connect(fd, addr, addrlen)) && (EINPROGRESS != errno) ) {
+    ctx->o->close(fd);
+    return -1;
+  }
+
+  connect_op *op = (connect_op *) malloc(sizeof(connect_op));
+  if (!op) {
+    ctx->o->close(fd);
+    return -1;
+  }
+  memset(op, 0, sizeof(connect_op));
+  op->owner = self;
+  op->h = h;
+  op->arg = arg;
+  op->sock_eh.fd = fd;
+  op->sock_eh.ctx = op;
+  op->sock_eh.handle_event = connector_handle_connected;
+  op->timer_eh.fd = -1;
+  op->timer_eh.ctx = op;
+  op->timer_eh.handle_event = connector_handle_timeout;
+
+  if (0 != ctx->r->register_eh(ctx->r, &op->sock_eh)) {
+    ctx->o->close(fd);
+    free(op);
+    return -1;
+  }
+
+  if ( (0 != ctx->r->modify_eh(ctx->r, &op->sock_eh, EPOLLOUT)) ||
+       ( (timeout_ms) && (0 != connector_arm_timer(ctx, op, timeout_ms)) ) ) {
+    connector_release(ctx, op, 1);
+    free(op);
+    return -1;
+  }
+
+  op->next = ctx->ops;
+  if (ctx->ops)
+    ctx->ops->prev = op;
+  ctx->ops = op;
+
+  return 0;
+}
+
+static void connector_handle_connected(event_handler *self, uint32_t events)
+{
+  connect_op *op = (connect_op *) self->ctx;
+  const os *o = op->owner->ctx->o;
+
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (0 != o->getsockopt(self->fd, SOL_SOCKET, SO_ERROR, &err, &len))
+    err = errno;
+  if ( (0 == err) && (events & (EPOLLERR | EPOLLHUP)) )
+    err = ECONNREFUSED;
+
+  connector_finish(op, err);
+}
+
+static void connector_handle_timeout(event_handler *self, uint32_t events)
+{
+  connector_finish((connect_op *) self->ctx, ETIMEDOUT);
+}
+
+static int connector_arm_timer(connector_ctx *ctx, connect_op *op, int timeout_ms)
+{
+  const int tfd = ctx->o->timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (tfd < 0) {
+    return -1;
+  }
+
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = timeout_ms / 1000;
+  its.it_value.tv_nsec = (long) (timeout_ms % 1000) * 1000000L;
+
+  op->timer_eh.fd = tfd;
+  if ( (0 != ctx->o->timerfd_settime(tfd, 0, &its, 0)) ||
+       (0 != ctx->r->register_eh(ctx->r, &op->timer_eh)) ) {
+    ctx->o->close(tfd);
+    op->timer_eh.fd = -1;
+    return -1;
+  }
+
+  return 0;
+}
+
+static void connector_release(connector_ctx *ctx, connect_op *op, int close_sock)
+{
+  ctx->r->unregister_eh(ctx->r, &op->sock_eh);
+  if (0 <= op->timer_eh.fd) {
+    ctx->r->unregister_eh(ctx->r, &op->timer_eh);
+    ctx->o->close(op->timer_eh.fd);
+    op->timer_eh.fd = -1;
+  }
+  if (close_sock)
+    ctx->o->close(op->sock_eh.fd);
+}
+
+static void connector_finish(connect_op *op, int err)
+{
+  connector *c = op->owner;
+  connector_ctx *ctx = c->ctx;
+
+  if (op->prev)
+    op->prev->next = op->next;
+  else
+    ctx->ops = op->next;
+  if (op->next)
+    op->next->prev = op->prev;
+
+  connector_release(ctx, op, err);
+  op->h(c, (err) ? -1 : op->sock_eh.fd, err, op->arg);
+  free(op);
+}
@@ -0,0 +1,249 @@
+#include "reactor/coro.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+
+struct coro_ctx_s {
+  reactor *r;
+  const os *o;
+  coro_fn fn;
+  coro_handler h;
+  void *arg;
+  event_handler timer_eh;
+  uint32_t interest;
+  int running;
+  int sleeping;
+  size_t written;
+};
+
+static void coro_terminate(coro *self);
+static void coro_free(coro *self);
+static int coro_start(coro *self);
+static int coro_read(coro *self, void *buf, size_t len);
+static int coro_write(coro *self, const void *buf, size_t len);
+static int coro_sleep(coro *self, unsigned int ms);
+static void coro_handle_event(event_handler *self, uint32_t events);
+static void coro_resume(coro *self);
+static void coro_release(coro *self);
+static void coro_wait_for(coro *self, uint32_t events);
+static int coro_is_blocked(int err);
+
+int coro_init(coro *co, reactor *r, const os *o, int fd, coro_fn fn, void *frame,
+              coro_handler h, void *arg)
+{
+  if ( (!co) || (!r) || (!o) || (fd < 0) || (!fn) || (!o->read) || (!o->write) ||
+       (!o->timerfd_create) || (!o->timerfd_settime) )
+    return -1;
+
+  coro_ctx *ctx = (coro_ctx *) malloc(sizeof(coro_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(coro_ctx));
+  ctx->r = r;
+  ctx->o = o;
+  ctx->fn = fn;
+  ctx->h = h;
+  ctx->arg = arg;
+  ctx->timer_eh.fd = -1;
+  ctx->timer_eh.ctx = co;
+  ctx->timer_eh.handle_event = coro_handle_event;
+
+  memset(co, 0, sizeof(coro));
+  co->ctx = ctx;
+  co->eh.fd = fd;
+  co->eh.ctx = co;
+  co->eh.handle_event = coro_handle_event;
+  co->frame = frame;
+  co->start = coro_start;
+  co->read = coro_read;
+  co->write = coro_write;
+  co->sleep = coro_sleep;
+  co->destroy = coro_terminate;
+
+  return 0;
+}
+
+coro * coro_alloc(reactor *r, const os *o, int fd, coro_fn fn, void *frame,
+                  coro_handler h, void *arg)
+{
+  coro *res = (coro *) malloc(sizeof(coro));
+  if (res) {
+    if (0 != coro_init(res, r, o, fd, fn, frame, h, arg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = coro_free;
+  }
+
+  return res;
+}
+
+static void coro_terminate(coro *self)
+{
+  if (self && self->ctx) {
+    coro_release(self);
+    free(self->ctx);
+    self->ctx = 0;
+  }
+}
+
+static void coro_free(coro *self)
+{
+  if (self) {
+    coro_terminate(self);
+    free(self);
+  }
+}
+
+static int coro_start(coro *self)
+{
+  if ( (!self) || (!self->ctx) || (self->ctx->running) || (-1 == self->line) ) {
+    return -1;
+  }
+
+  coro_ctx *ctx = self->ctx;
+  if (0 != ctx->r->register_eh(ctx->r, &self->eh)) {
+    return -1;
+  }
+  ctx->interest = EPOLLIN;
+  ctx->running = 1;
+  coro_resume(self);
+
+  return 0;
+}
+
+static int coro_read(coro *self, void *buf, size_t len)
+{
+  const ssize_t n = self->ctx->o->read(self->eh.fd, buf, len);
+  if ( (n < 0) && (coro_is_blocked(errno)) ) {
+    coro_wait_for(self, EPOLLIN);
+    return CORO_WAIT;
+  }
+
+  self->res = n;
+  self->err = (n < 0) ? errno : 0;
+
+  return CORO_DONE;
+}
+
+static int coro_write(coro *self, const void *buf, size_t len)
+{
+  coro_ctx *ctx = self->ctx;
+  while (ctx->written < len) {
+    const ssize_t n = ctx->o->write(self->eh.fd, (const char *) buf + ctx->written, len - ctx->written);
+    if (n < 0) {
+      if (coro_is_blocked(errno)) {
+        coro_wait_for(self, EPOLLOUT);
+        return CORO_WAIT;
+      }
+      self->res = -1;
+      self->err = errno;
+      ctx->written = 0;
+      return CORO_DONE;
+    }
+    ctx->written += n;
+  }
+
+  self->res = (ssize_t) ctx->written;
+  self->err = 0;
+  ctx->written = 0;
+
+  return CORO_DONE;
+}
+
+static int coro_sleep(coro *self, unsigned int ms)
+{
+  coro_ctx *ctx = self->ctx;
+  if (!ctx->sleeping) {
+    if (ctx->timer_eh.fd < 0) {
+      ctx->timer_eh.fd = ctx->o->timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+      if ( (ctx->timer_eh.fd < 0) || (0 != ctx->r->register_eh(ctx->r, &ctx->timer_eh)) ) {
+        self->res = -1;
+        self->err = errno;
+        if (0 <= ctx->timer_eh.fd)
+          ctx->o->close(ctx->timer_eh.fd);
+        ctx->timer_eh.fd = -1;
+        return CORO_DONE;
+      }
+    }
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = ms / 1000;
+    /* zero value would disarm the timer, so the shortest sleep is used instead */
+    its.it_value.tv_nsec = (ms) ? (long) (ms % 1000) * 1000000L : 1;
+    if (0 != ctx->o->timerfd_settime(ctx->timer_eh.fd, 0, &its, 0)) {
+      self->res = -1;
+      self->err = errno;
+      return CORO_DONE;
+    }
+    ctx->sleeping = 1;
+    /* hang up is reported regardless of the mask, so it is reported once at most */
+    coro_wait_for(self, EPOLLONESHOT);
+    return CORO_WAIT;
+  }
+
+  uint64_t expirations = 0;
+  if (sizeof(expirations) != ctx->o->read(ctx->timer_eh.fd, &expirations, sizeof(expirations))) {
+    return CORO_WAIT;
+  }
+
+  ctx->sleeping = 0;
+  self->res = 0;
+  self->err = 0;
+
+  return CORO_DONE;
+}
+
+static void coro_handle_event(event_handler *self, uint32_t events)
+{
+  coro *co = (coro *) self->ctx;
+  if (co->ctx->running)
+    coro_resume(co);
+}
+
+static void coro_resume(coro *self)
+{
+  if (CORO_WAIT == self->ctx->fn(self)) {
+    return;
+  }
+
+  coro_ctx *ctx = self->ctx;
+  coro_release(self);
+  self->line = -1;
+  /* it is the last access, because the callback may destroy coroutine */
+  if (ctx->h)
+    ctx->h(self, ctx->arg);
+}
+
+static void coro_release(coro *self)
+{
+  coro_ctx *ctx = self->ctx;
+  if (ctx->running) {
+    ctx->r->unregister_eh(ctx->r, &self->eh);
+    ctx->running = 0;
+  }
+  if (0 <= ctx->timer_eh.fd) {
+    ctx->r->unregister_eh(ctx->r, &ctx->timer_eh);
+    ctx->o->close(ctx->timer_eh.fd);
+    ctx->timer_eh.fd = -1;
+  }
+  ctx->sleeping = 0;
+  ctx->written = 0;
+}
+
+static void coro_wait_for(coro *self, uint32_t events)
+{
+  coro_ctx *ctx = self->ctx;
+  if (events != ctx->interest) {
+    ctx->r->modify_eh(ctx->r, &self->eh, events);
+    ctx->interest = events;
+  }
+}
+
+static int coro_is_blocked(int err)
+{
+  return (EAGAIN == err) || (EWOULDBLOCK == err);
+}
@@ -0,0 +1,455 @@
+#include "reactor/file_cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+
+typedef struct file_waiter_s file_waiter;
+struct file_waiter_s {
+  file_cache_handler h;
+  void *arg;
+  file_waiter *next;
+};
+
+typedef struct file_node_s file_node;
+struct file_node_s {
+  file_entry e;
+  file_cache_ctx *ctx;
+  char *path;
+  unsigned int refs;
+  int loading;
+  int cached;
+  file_waiter *waiters;
+  file_node *next_by_path;
+  file_node *prev;
+  file_node *next;
+};
+
+typedef struct file_list_s {
+  file_node *first;
+  file_node *last;
+} file_list;
+
+struct file_cache_ctx_s {
+  file_cache *owner;
+  const os *o;
+  file_cache_config cfg;
+  file_io fio;
+  file_node **by_path;
+  size_t by_path_bits;
+  /* cached entries which are not in use, most recently used first */
+  file_list idle;
+  /* invalidated entries which are still in use or loading */
+  file_list orphans;
+  file_cache_stats stats;
+};
+
+static void file_cache_terminate(file_cache *self);
+static void file_cache_free(file_cache *self);
+static const file_entry * file_cache_acquire(file_cache *self, const char *path);
+static int file_cache_load(file_cache *self, const char *path, file_cache_handler h, void *arg);
+static void file_cache_release(file_cache *self, const file_entry *e);
+static ssize_t file_cache_send(file_cache *self, int sock, const struct iovec *hdr, int hdr_cnt,
+                               const file_entry *e, size_t off);
+static int file_cache_invalidate(file_cache *self, const char *path);
+static int file_cache_get_stats(file_cache *self, file_cache_stats *stats);
+static void file_cache_loaded(file_io *fio, const file_io_result *res, void *arg);
+static void file_cache_evict(file_cache_ctx *ctx);
+static void file_cache_uncache(file_cache_ctx *ctx, file_node *node);
+static void file_cache_free_node(file_cache_ctx *ctx, file_node *node);
+static file_node * file_cache_find(file_cache_ctx *ctx, const char *path);
+static size_t file_cache_hash(const char *path, size_t bits);
+static void file_list_push(file_list *list, file_node *node);
+static void file_list_unlink(file_list *list, file_node *node);
+
+int file_cache_init(file_cache *c, reactor *r, const os *o, const file_cache_config *cfg)
+{
+  if ( (!c) || (!r) || (!o) || (!o->writev) || (!o->write) || (!o->sendfile) )
+    return -1;
+
+  file_cache_ctx *ctx = (file_cache_ctx *) malloc(sizeof(file_cache_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(file_cache_ctx));
+  ctx->o = o;
+  if (cfg)
+    ctx->cfg = *cfg;
+  if (!ctx->cfg.budget_bytes)
+    ctx->cfg.budget_bytes = 64 * 1024 * 1024;
+  if (!ctx->cfg.map_max)
+    ctx->cfg.map_max = 64 * 1024;
+  if (!ctx->cfg.max_entries)
+    ctx->cfg.max_entries = 1024;
+
+  ctx->by_path_bits = 1;
+  while (((size_t) 1 << ctx->by_path_bits) < ctx->cfg.max_entries)
+    ++ctx->by_path_bits;
+  ctx->by_path = (file_node **) calloc((size_t) 1 << ctx->by_path_bits, sizeof(file_node *));
+  if ( (!ctx->by_path) || (0 != file_io_init(&ctx->fio, r, o, ctx->cfg.threads, ctx->cfg.max_entries)) ) {
+    free(ctx->by_path);
+    free(ctx);
+    return -1;
+  }
+
+  memset(c, 0, sizeof(file_cache));
+  ctx->owner = c;
+  c->ctx = ctx;
+  c->acquire = file_cache_acquire;
+  c->load = file_cache_load;
+  c->release = file_cache_release;
+  c->send = file_cache_send;
+  c->invalidate = file_cache_invalidate;
+  c->get_stats = file_cache_get_stats;
+  c->destroy = file_cache_terminate;
+
+  return 0;
+}
+
+file_cache * file_cache_alloc(reactor *r, const os *o, const file_cache_config *cfg)
+{
+  file_cache *res = (file_cache *) malloc(sizeof(file_cache));
+  if (res) {
+    if (0 != file_cache_init(res, r, o, cfg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = file_cache_free;
+  }
+
+  return res;
+}
+
+static void file_cache_terminate(file_cache *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return;
+  }
+
+  file_cache_ctx *ctx = self->ctx;
+  /* pending loads are cancelled here, so their nodes are freed and no callback refers to nodes below */
+  ctx->fio.destroy(&ctx->fio);
+  for (size_t i = 0; i < ((size_t) 1 << ctx->by_path_bits); ++i) {
+    while (ctx->by_path[i]) {
+      file_node *node = ctx->by_path[i];
+      ctx->by_path[i] = node->next_by_path;
+      file_cache_free_node(ctx, node);
+    }
+  }
+  while (ctx->orphans.first) {
+    file_node *node = ctx->orphans.first;
+    file_list_unlink(&ctx->orphans, node);
+    file_cache_free_node(ctx, node);
+  }
+  free(ctx->by_path);
+  free(ctx);
+  self->ctx = 0;
+}
+
+static void file_cache_free(file_cache *self)
+{
+  if (self) {
+    file_cache_terminate(self);
+    free(self);
+  }
+}
+
+static const file_entry * file_cache_acquire(file_cache *self, const char *path)
+{
+  if ( (!self) || (!self->ctx) || (!path) ) {
+    return 0;
+  }
+
+  file_cache_ctx *ctx = self->ctx;
+  file_node *node = file_cache_find(ctx, path);
+  if ( (!node) || (node->loading) ) {
+    return 0;
+  }
+
+  if (0 == node->refs++)
+    file_list_unlink(&ctx->idle, node);
+  ++ctx->stats.hits;
+
+  return &node->e;
+}
+
+static int file_cache_load(file_cache *self, const char *path, file_cache_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!path) || (!h) ) {
+    return -1;
+  }
+
+  file_cache_ctx *ctx = self->ctx;
+  file_node *node = file_cache_find(ctx, path);
+  if ( (node) && (!node->loading) ) {
+    return -1;
+  }
+
+  file_waiter *waiter = (file_waiter *) malloc(sizeof(file_waiter));
+  if (!waiter) {
+    return -1;
+  }
+  waiter->h = h;
+  waiter->arg = arg;
+
+  if (node) {
+    waiter->next = node->waiters;
+    node->waiters = waiter;
+    return 0;
+  }
+
+  node = (file_node *) malloc(sizeof(file_node));
+  if (node) {
+    memset(node, 0, sizeof(file_node));
+    node->path = strdup(path);
+  }
+  if ( (!node) || (!node->path) ||
+       (0 != ctx->fio.open(&ctx->fio, path, ctx->cfg.map_max, file_cache_loaded, node)) ) {
+    if (node)
+      free(node->path);
+    free(node);
+    free(waiter);
+    return -1;
+  }
+
+  waiter->next = 0;
+  node->ctx = ctx;
+  node->e.path = node->path;
+  node->e.fd = -1;
+  node->loading = 1;
+  node->cached = 1;
+  node->waiters = waiter;
+  const size_t bucket = file_cache_hash(path, ctx->by_path_bits);
+  node->next_by_path = ctx->by_path[bucket];
+  ctx->by_path[bucket] = node;
+  ++ctx->stats.misses;
+
+  return 0;
+}
+
+static void file_cache_release(file_cache *self, const file_entry *e)
+{
+  if ( (!self) || (!self->ctx) || (!e) ) {
+    return;
+  }
+
+  file_cache_ctx *ctx = self->ctx;
+  file_node *node = (file_node *) e;
+  if ( (0 == node->refs) || (0 != --node->refs) ) {
+    return;
+  }
+
+  if (node->cached) {
+    file_list_push(&ctx->idle, node);
+    file_cache_evict(ctx);
+  }
+  else {
+    file_list_unlink(&ctx->orphans, node);
+    file_cache_free_node(ctx, node);
+  }
+}
+
+static ssize_t file_cache_send(file_cache *self, int sock, const struct iovec *hdr, int hdr_cnt,
+                               const file_entry *e, size_t off)
+{
+  if ( (!self) || (!self->ctx) || (!e) || (hdr_cnt < 0) || (FILE_CACHE_MAX_HEADERS < hdr_cnt) ||
+       ( (0 < hdr_cnt) && (!hdr) ) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  const os *o = self->ctx->o;
+  struct iovec iov[FILE_CACHE_MAX_HEADERS + 1];
+  int iov_cnt = 0;
+  size_t skip = off;
+  for (int i = 0; i < hdr_cnt; ++i) {
+    if (skip >= hdr[i].iov_len) {
+      skip -= hdr[i].iov_len;
+      continue;
+    }
+    iov[iov_cnt].iov_base = (char *) hdr[i].iov_base + skip;
+    iov[iov_cnt++].iov_len = hdr[i].iov_len - skip;
+    skip = 0;
+  }
+
+  if ( (!iov_cnt) && (skip >= e->size) ) {
+    return 0;
+  }
+
+  if ( (e->data) && (skip < e->size) ) {
+    iov[iov_cnt].iov_base = (char *) e->data + skip;
+    iov[iov_cnt++].iov_len = e->size - skip;
+    return (1 == iov_cnt) ? o->write(sock, iov[0].iov_base, iov[0].iov_len)
+                          : o->writev(sock, iov, iov_cnt);
+  }
+
+  /* headers go first, content follows in the next call once they are out */
+  if (iov_cnt) {
+    return o->writev(sock, iov, iov_cnt);
+  }
+
+  off_t file_off = (off_t) skip;
+
+  return o->sendfile(sock, e->fd, &file_off, e->size - skip);
+}
+
+static int file_cache_invalidate(file_cache *self, const char *path)
+{
+  if ( (!self) || (!self->ctx) || (!path) ) {
+    return -1;
+  }
+
+  file_cache_ctx *ctx = self->ctx;
+  file_node *node = file_cache_find(ctx, path);
+  if (!node) {
+    return -1;
+  }
+
+  file_cache_uncache(ctx, node);
+  if ( (node->loading) || (node->refs) ) {
+    file_list_push(&ctx->orphans, node);
+  }
+  else {
+    file_list_unlink(&ctx->idle, node);
+    file_cache_free_node(ctx, node);
+  }
+
+  return 0;
+}
+
+static int file_cache_get_stats(file_cache *self, file_cache_stats *stats)
+{
+  if ( (!self) || (!self->ctx) || (!stats) ) {
+    return -1;
+  }
+
+  *stats = self->ctx->stats;
+
+  return 0;
+}
+
+static void file_cache_loaded(file_io *fio, const file_io_result *res, void *arg)
+{
+  file_node *node = (file_node *) arg;
+  file_cache_ctx *ctx = node->ctx;
+  file_waiter *waiter = node->waiters;
+  node->waiters = 0;
+
+  if (res->res < 0) {
+    if (node->cached)
+      file_cache_uncache(ctx, node);
+    else
+      file_list_unlink(&ctx->orphans, node);
+    file_cache_free_node(ctx, node);
+  }
+  else {
+    node->loading = 0;
+    node->e.fd = res->fd;
+    node->e.size = res->size;
+    node->e.mtime = res->mtime;
+    node->e.data = res->data;
+    for (file_waiter *curr = waiter; curr; curr = curr->next)
+      ++node->refs;
+    if (node->cached) {
+      ++ctx->stats.entries;
+      if (node->e.data)
+        ctx->stats.bytes += node->e.size;
+    }
+  }
+
+  /* node may be freed by the last release in callbacks, so it is not touched below */
+  while (waiter) {
+    file_waiter *next = waiter->next;
+    waiter->h(ctx->owner, (res->res < 0) ? 0 : &node->e, res->err, waiter->arg);
+    free(waiter);
+    waiter = next;
+  }
+
+  file_cache_evict(ctx);
+}
+
+static void file_cache_evict(file_cache_ctx *ctx)
+{
+  while ( (ctx->idle.last) &&
+          ( (ctx->stats.bytes > ctx->cfg.budget_bytes) || (ctx->stats.entries > ctx->cfg.max_entries) ) ) {
+    file_node *node = ctx->idle.last;
+    file_list_unlink(&ctx->idle, node);
+    file_cache_uncache(ctx, node);
+    file_cache_free_node(ctx, node);
+    ++ctx->stats.evictions;
+  }
+}
+
+static void file_cache_uncache(file_cache_ctx *ctx, file_node *node)
+{
+  file_node **curr = &ctx->by_path[file_cache_hash(node->path, ctx->by_path_bits)];
+  while (*curr != node)
+    curr = &(*curr)->next_by_path;
+  *curr = node->next_by_path;
+  node->cached = 0;
+
+  if (!node->loading) {
+    --ctx->stats.entries;
+    if (node->e.data)
+      ctx->stats.bytes -= node->e.size;
+  }
+}
+
+static void file_cache_free_node(file_cache_ctx *ctx, file_node *node)
+{
+  while (node->waiters) {
+    file_waiter *next = node->waiters->next;
+    free(node->waiters);
+    node->waiters = next;
+  }
+  if (node->e.data)
+    ctx->o->munmap((void *) node->e.data, node->e.size);
+  if (0 <= node->e.fd)
+    ctx->o->close(node->e.fd);
+  free(node->path);
+  free(node);
+}
+
+static file_node * file_cache_find(file_cache_ctx *ctx, const char *path)
+{
+  file_node *curr = ctx->by_path[file_cache_hash(path, ctx->by_path_bits)];
+  while ( (curr) && (0 != strcmp(path, curr->path)) )
+    curr = curr->next_by_path;
+
+  return curr;
+}
+
+static size_t file_cache_hash(const char *path, size_t bits)
+{
+  /* FNV-1a, folded to the number of buckets by the multiplicative step */
+  uint64_t h = 0xCBF29CE484222325ULL;
+  for (const unsigned char *p = (const unsigned char *) path; *p; ++p)
+    h = (h ^ *p) * 0x100000001B3ULL;
+
+  return (size_t) ((h * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static void file_list_push(file_list *list, file_node *node)
+{
+  node->prev = 0;
+  node->next = list->first;
+  if (list->first)
+    list->first->prev = node;
+  else
+    list->last = node;
+  list->first = node;
+}
+
+static void file_list_unlink(file_list *list, file_node *node)
+{
+  if (node->prev)
+    node->prev->next = node->next;
+  else
+    list->first = node->next;
+  if (node->next)
+    node->next->prev = node->prev;
+  else
+    list->last = node->prev;
+  node->prev = 0;
+  node->next = 0;
+}
@@ -0,0 +1,344 @@
+#include "reactor/file_io.h"
+#include "reactor/channel.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+typedef enum file_io_op_e {
+  FILE_IO_OPEN,
+  FILE_IO_READ
+} file_io_op;
+
+typedef struct file_io_req_s {
+  file_io_op op;
+  char *path;
+  size_t map_max;
+  int fd;
+  void *buf;
+  size_t len;
+  off_t off;
+  file_io_handler h;
+  void *arg;
+} file_io_req;
+
+typedef struct file_io_done_s {
+  file_io_handler h;
+  void *arg;
+  file_io_op op;
+  file_io_result res;
+} file_io_done;
+
+struct file_io_ctx_s {
+  file_io *owner;
+  reactor *r;
+  const os *o;
+  channel done;
+  pthread_t *threads;
+  unsigned int threads_cnt;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int run;
+  int cancelled;
+  file_io_req *queue;
+  size_t capacity;
+  size_t head;
+  size_t queued;
+  size_t in_flight;
+};
+
+static void file_io_terminate(file_io *self);
+static void file_io_free(file_io *self);
+static int file_io_open(file_io *self, const char *path, size_t map_max, file_io_handler h, void *arg);
+static int file_io_read(file_io *self, int fd, void *buf, size_t len, off_t off, file_io_handler h, void *arg);
+static int file_io_submit(file_io_ctx *ctx, const file_io_req *req);
+static void * file_io_run(void *arg);
+static void file_io_execute(file_io_ctx *ctx, file_io_req *req, file_io_done *done);
+static void file_io_complete(channel *ch, const void *msgs, size_t cnt, void *arg);
+static void file_io_cancel(file_io_ctx *ctx, const file_io_done *done);
+static void file_io_cancel_queued(file_io_ctx *ctx, const file_io_req *req);
+
+int file_io_init(file_io *fio, reactor *r, const os *o, unsigned int threads, size_t capacity)
+{
+  if ( (!fio) || (!r) || (!o) || (!o->open) || (!o->fstat) || (!o->pread) ||
+       (!o->mmap) || (!o->munmap) || (!o->close) )
+    return -1;
+
+  file_io_ctx *ctx = (file_io_ctx *) malloc(sizeof(file_io_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(file_io_ctx));
+  ctx->r = r;
+  ctx->o = o;
+  ctx->threads_cnt = (threads) ? threads : 4;
+  ctx->capacity = (capacity) ? capacity : 1024;
+  ctx->run = 1;
+  ctx->threads = (pthread_t *) malloc(ctx->threads_cnt * sizeof(pthread_t));
+  ctx->queue = (file_io_req *) malloc(ctx->capacity * sizeof(file_io_req));
+  if ( (!ctx->threads) || (!ctx->queue) ) {
+    free(ctx->threads);
+    free(ctx->queue);
+    free(ctx);
+    return -1;
+  }
+
+  /* requests in progress never exceed capacity, so workers never find the channel full */
+  if (0 != channel_init(&ctx->done, o, CHANNEL_MPSC, sizeof(file_io_done), ctx->capacity, file_io_complete, ctx)) {
+    free(ctx->threads);
+    free(ctx->queue);
+    free(ctx);
+    return -1;
+  }
+  if (0 != r->register_eh(r, &ctx->done.eh)) {
+    ctx->done.destroy(&ctx->done);
+    free(ctx->threads);
+    free(ctx->queue);
+    free(ctx);
+    return -1;
+  }
+
+  pthread_mutex_init(&ctx->lock, 0);
+  pthread_cond_init(&ctx->cond, 0);
+  memset(fio, 0, sizeof(file_io));
+  ctx->owner = fio;
+  fio->ctx = ctx;
+  fio->open = file_io_open;
+  fio->read = file_io_read;
+  fio->destroy = file_io_terminate;
+
+  for (unsigned int i = 0; i < ctx->threads_cnt; ++i) {
+    if (0 != pthread_create(&ctx->threads[i], 0, file_io_run, ctx)) {
+      ctx->threads_cnt = i;
+      file_io_terminate(fio);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+file_io * file_io_alloc(reactor *r, const os *o, unsigned int threads, size_t capacity)
+{
+  file_io *res = (file_io *) malloc(sizeof(file_io));
+  if (res) {
+    if (0 != file_io_init(res, r, o, threads, capacity)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = file_io_free;
+  }
+
+  return res;
+}
+
+static void file_io_terminate(file_io *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return;
+  }
+
+  file_io_ctx *ctx = self->ctx;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->run = 0;
+  pthread_cond_broadcast(&ctx->cond);
+  pthread_mutex_unlock(&ctx->lock);
+  for (unsigned int i = 0; i < ctx->threads_cnt; ++i)
+    pthread_join(ctx->threads[i], 0);
+
+  /* completed requests precede the queued ones, so callbacks follow submission order */
+  ctx->cancelled = 1;
+  ctx->done.drain(&ctx->done);
+  for (size_t i = 0; i < ctx->queued; ++i)
+    file_io_cancel_queued(ctx, &ctx->queue[(ctx->head + i) % ctx->capacity]);
+  ctx->queued = 0;
+
+  ctx->r->unregister_eh(ctx->r, &ctx->done.eh);
+  ctx->done.destroy(&ctx->done);
+  pthread_cond_destroy(&ctx->cond);
+  pthread_mutex_destroy(&ctx->lock);
+  free(ctx->threads);
+  free(ctx->queue);
+  free(ctx);
+  self->ctx = 0;
+}
+
+static void file_io_free(file_io *self)
+{
+  if (self) {
+    file_io_terminate(self);
+    free(self);
+  }
+}
+
+static int file_io_open(file_io *self, const char *path, size_t map_max, file_io_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!path) || (!h) ) {
+    return -1;
+  }
+
+  file_io_req req;
+  memset(&req, 0, sizeof(req));
+  req.op = FILE_IO_OPEN;
+  req.path = strdup(path);
+  req.map_max = map_max;
+  req.fd = -1;
+  req.h = h;
+  req.arg = arg;
+  if ( (!req.path) || (0 != file_io_submit(self->ctx, &req)) ) {
+    free(req.path);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int file_io_read(file_io *self, int fd, void *buf, size_t len, off_t off, file_io_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (fd < 0) || (!buf) || (!h) ) {
+    return -1;
+  }
+
+  file_io_req req;
+  memset(&req, 0, sizeof(req));
+  req.op = FILE_IO_READ;
+  req.fd = fd;
+  req.buf = buf;
+  req.len = len;
+  req.off = off;
+  req.h = h;
+  req.arg = arg;
+
+  return file_io_submit(self->ctx, &req);
+}
+
+static int file_io_submit(file_io_ctx *ctx, const file_io_req *req)
+{
+  /* in_flight is touched only by reactor's thread, queue is shared with workers */
+  if ( (ctx->cancelled) || (ctx->in_flight == ctx->capacity) ) {
+    return -1;
+  }
+
+  ++ctx->in_flight;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->queue[(ctx->head + ctx->queued++) % ctx->capacity] = *req;
+  pthread_cond_signal(&ctx->cond);
+  pthread_mutex_unlock(&ctx->lock);
+
+  return 0;
+}
+
+static void * file_io_run(void *arg)
+{
+  file_io_ctx *ctx = (file_io_ctx *) arg;
+  file_io_req req;
+  file_io_done done;
+
+  pthread_mutex_lock(&ctx->lock);
+  while (ctx->run) {
+    if (!ctx->queued) {
+      pthread_cond_wait(&ctx->cond, &ctx->lock);
+      continue;
+    }
+
+    req = ctx->queue[ctx->head];
+    ctx->head = (ctx->head + 1) % ctx->capacity;
+    --ctx->queued;
+    pthread_mutex_unlock(&ctx->lock);
+
+    file_io_execute(ctx, &req, &done);
+    free(req.path);
+    ctx->done.send(&ctx->done, &done);
+
+    pthread_mutex_lock(&ctx->lock);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  return 0;
+}
+
+static void file_io_execute(file_io_ctx *ctx, file_io_req *req, file_io_done *done)
+{
+  memset(done, 0, sizeof(file_io_done));
+  done->h = req->h;
+  done->arg = req->arg;
+  done->op = req->op;
+  done->res.fd = req->fd;
+
+  if (FILE_IO_READ == req->op) {
+    done->res.res = ctx->o->pread(req->fd, req->buf, req->len, req->off);
+    if (done->res.res < 0)
+      done->res.err = errno;
+    return;
+  }
+
+  struct stat st;
+  done->res.fd = ctx->o->open(req->path, O_RDONLY | O_CLOEXEC);
+  if (done->res.fd < 0) {
+    done->res.res = -1;
+    done->res.err = errno;
+    return;
+  }
+  const int stated = (0 == ctx->o->fstat(done->res.fd, &st));
+  if ( (!stated) || (!S_ISREG(st.st_mode)) ) {
+    done->res.err = (stated) ? EISDIR : errno;
+    done->res.res = -1;
+    ctx->o->close(done->res.fd);
+    done->res.fd = -1;
+    return;
+  }
+
+  done->res.size = (size_t) st.st_size;
+  done->res.mtime = st.st_mtim;
+  if ( (0 < done->res.size) && (done->res.size <= req->map_max) ) {
+    /* pages are faulted in here, so reactor's thread never waits for the disk */
+    void *data = ctx->o->mmap(0, done->res.size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, done->res.fd, 0);
+    if (MAP_FAILED != data)
+      done->res.data = data;
+  }
+}
+
+static void file_io_complete(channel *ch, const void *msgs, size_t cnt, void *arg)
+{
+  file_io_ctx *ctx = (file_io_ctx *) arg;
+  const file_io_done *done = (const file_io_done *) msgs;
+
+  for (size_t i = 0; i < cnt; ++i) {
+    --ctx->in_flight;
+    if (ctx->cancelled)
+      file_io_cancel(ctx, &done[i]);
+    else
+      done[i].h(ctx->owner, &done[i].res, done[i].arg);
+  }
+}
+
+static void file_io_cancel(file_io_ctx *ctx, const file_io_done *done)
+{
+  if ( (FILE_IO_OPEN == done->op) && (0 <= done->res.fd) ) {
+    if (done->res.data)
+      ctx->o->munmap(done->res.data, done->res.size);
+    ctx->o->close(done->res.fd);
+  }
+
+  file_io_result res;
+  memset(&res, 0, sizeof(res));
+  res.fd = (FILE_IO_READ == done->op) ? done->res.fd : -1;
+  res.res = -1;
+  res.err = ECANCELED;
+  done->h(ctx->owner, &res, done->arg);
+}
+
+static void file_io_cancel_queued(file_io_ctx *ctx, const file_io_req *req)
+{
+  file_io_done done;
+  memset(&done, 0, sizeof(done));
+  done.h = req->h;
+  done.arg = req->arg;
+  done.op = req->op;
+  done.res.fd = req->fd;
+  free(req->path);
+  --ctx->in_flight;
+  file_io_cancel(ctx, &done);
+}
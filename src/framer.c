@@ -0,0 +1,337 @@
+#include "reactor/framer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define FRAMER_X86_SIMD
+#include <immintrin.h>
+#endif
+
+struct framer_ctx_s {
+  const os *o;
+  buf_pool *pool;
+  size_t buf_size;
+  io_buf *buf;
+  decoder d;
+  framer_handler on_frames;
+  framer_close_handler on_close;
+  void *arg;
+};
+
+static void framer_terminate(framer *self);
+static void framer_free(framer *self);
+static size_t framer_pending(framer *self);
+static void framer_handle_event(event_handler *self, uint32_t events);
+static int framer_decode(framer *f);
+static void framer_release_buf(framer_ctx *ctx);
+static ssize_t framer_decode_line(const decoder *self, const char *data, size_t len, frame *f);
+static ssize_t framer_decode_length_prefixed(const decoder *self, const char *data, size_t len, frame *f);
+static ssize_t framer_decode_fixed(const decoder *self, const char *data, size_t len, frame *f);
+static const char * framer_find_byte_scalar(const char *data, size_t len, char c);
+#ifdef FRAMER_X86_SIMD
+static const char * framer_find_byte_sse2(const char *data, size_t len, char c);
+static const char * framer_find_byte_avx2(const char *data, size_t len, char c);
+#endif
+
+int decoder_line_init(decoder *d, char delimiter, size_t max_size)
+{
+  if ( (!d) || (0 == max_size) )
+    return -1;
+
+  memset(d, 0, sizeof(decoder));
+  d->decode = framer_decode_line;
+  d->delimiter = delimiter;
+  d->size = max_size;
+
+  return 0;
+}
+
+int decoder_length_prefixed_init(decoder *d, unsigned int prefix_size, size_t max_size)
+{
+  if ( (!d) || ( (1 != prefix_size) && (2 != prefix_size) && (4 != prefix_size) ) )
+    return -1;
+
+  memset(d, 0, sizeof(decoder));
+  d->decode = framer_decode_length_prefixed;
+  d->prefix_size = prefix_size;
+  d->size = max_size;
+
+  return 0;
+}
+
+int decoder_fixed_init(decoder *d, size_t size)
+{
+  if ( (!d) || (0 == size) )
+    return -1;
+
+  memset(d, 0, sizeof(decoder));
+  d->decode = framer_decode_fixed;
+  d->size = size;
+
+  return 0;
+}
+
+const char * framer_find_byte(const char *data, size_t len, char c)
+{
+#ifdef FRAMER_X86_SIMD
+  static const char * (*impl)(const char *, size_t, char) = 0;
+  if (!impl) {
+    __builtin_cpu_init();
+    impl = (__builtin_cpu_supports("avx2")) ? framer_find_byte_avx2 : framer_find_byte_sse2;
+  }
+
+  return impl(data, len, c);
+#else
+  return framer_find_byte_scalar(data, len, c);
+#endif
+}
+
+int framer_init(framer *f, const os *o, buf_pool *pool, size_t buf_size, int fd, const decoder *d,
+                framer_handler on_frames, framer_close_handler on_close, void *arg)
+{
+  if ( (!f) || (!o) || (!pool) || (0 == buf_size) || (fd < 0) || (!d) || (!d->decode) ||
+       (!on_frames) || (!on_close) )
+    return -1;
+
+  memset(f, 0, sizeof(framer));
+  framer_ctx *ctx = (framer_ctx *) malloc(sizeof(framer_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(framer_ctx));
+  ctx->o = o;
+  ctx->pool = pool;
+  ctx->buf_size = buf_size;
+  ctx->d = *d;
+  ctx->d.scanned = 0;
+  ctx->on_frames = on_frames;
+  ctx->on_close = on_close;
+  ctx->arg = arg;
+
+  f->ctx = ctx;
+  f->eh.fd = fd;
+  f->eh.ctx = f;
+  f->eh.handle_event = framer_handle_event;
+  f->pending = framer_pending;
+  f->destroy = framer_terminate;
+
+  return 0;
+}
+
+framer * framer_alloc(const os *o, buf_pool *pool, size_t buf_size, int fd, const decoder *d,
+                      framer_handler on_frames, framer_close_handler on_close, void *arg)
+{
+  framer *res = (framer *) malloc(sizeof(framer));
+  if (res) {
+    if (0 != framer_init(res, o, pool, buf_size, fd, d, on_frames, on_close, arg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = framer_free;
+  }
+
+  return res;
+}
+
+static void framer_terminate(framer *self)
+{
+  if (self && self->ctx) {
+    framer_release_buf(self->ctx);
+    free(self->ctx);
+    self->ctx = 0;
+  }
+}
+
+static void framer_free(framer *self)
+{
+  if (self) {
+    framer_terminate(self);
+    free(self);
+  }
+}
+
+static size_t framer_pending(framer *self)
+{
+  if ( (!self) || (!self->ctx) || (!self->ctx->buf) ) {
+    return 0;
+  }
+
+  return self->ctx->buf->end - self->ctx->buf->begin;
+}
+
+static void framer_handle_event(event_handler *self, uint32_t events)
+{
+  framer *f = (framer *) self->ctx;
+  framer_ctx *ctx = f->ctx;
+
+  if (!ctx->buf) {
+    ctx->buf = ctx->pool->acquire(ctx->pool, ctx->buf_size);
+    if (!ctx->buf) {
+      ctx->on_close(f, ENOMEM, ctx->arg);
+      return;
+    }
+  }
+
+  io_buf *b = ctx->buf;
+  const ssize_t cnt = ctx->o->read(self->fd, b->data + b->end, b->size - b->end);
+  if (cnt <= 0) {
+    const int err = (0 == cnt) ? 0 : errno;
+    if ( (cnt < 0) && ( (EAGAIN == err) || (EWOULDBLOCK == err) || (EINTR == err) ) ) {
+      if (b->begin == b->end)
+        framer_release_buf(ctx);
+      return;
+    }
+    framer_release_buf(ctx);
+    ctx->on_close(f, err, ctx->arg);
+    return;
+  }
+  b->end += cnt;
+
+  if (0 != framer_decode(f)) {
+    framer_release_buf(ctx);
+    ctx->on_close(f, EPROTO, ctx->arg);
+  }
+}
+
+static int framer_decode(framer *f)
+{
+  framer_ctx *ctx = f->ctx;
+  io_buf *b = ctx->buf;
+  frame frames[FRAMER_MAX_BATCH];
+  size_t cnt = 0;
+  int res = 0;
+
+  while (b->begin < b->end) {
+    const ssize_t consumed = ctx->d.decode(&ctx->d, b->data + b->begin, b->end - b->begin, &frames[cnt]);
+    if (consumed <= 0) {
+      res = (consumed < 0) ? -1 : 0;
+      ctx->d.scanned = b->end - b->begin;
+      break;
+    }
+
+    b->begin += consumed;
+    ctx->d.scanned = 0;
+    if (FRAMER_MAX_BATCH == ++cnt) {
+      ctx->on_frames(f, frames, cnt, ctx->arg);
+      cnt = 0;
+    }
+  }
+
+  if (cnt)
+    ctx->on_frames(f, frames, cnt, ctx->arg);
+
+  if (b->begin == b->end) {
+    framer_release_buf(ctx);
+  }
+  else if (b->begin) {
+    memmove(b->data, b->data + b->begin, b->end - b->begin);
+    b->end -= b->begin;
+    b->begin = 0;
+  }
+  else if (b->end == b->size) {
+    res = -1;
+  }
+
+  return res;
+}
+
+static void framer_release_buf(framer_ctx *ctx)
+{
+  if (ctx->buf) {
+    ctx->pool->release(ctx->pool, ctx->buf);
+    ctx->buf = 0;
+  }
+  ctx->d.scanned = 0;
+}
+
+static ssize_t framer_decode_line(const decoder *self, const char *data, size_t len, frame *f)
+{
+  const size_t scan_len = (len > self->size) ? self->size + 1 : len;
+  const size_t from = (self->scanned < scan_len) ? self->scanned : scan_len;
+  const char *delim = framer_find_byte(data + from, scan_len - from, self->delimiter);
+  if (!delim) {
+    return (len > self->size) ? -1 : 0;
+  }
+
+  f->data = data;
+  f->len = delim - data;
+
+  return f->len + 1;
+}
+
+static ssize_t framer_decode_length_prefixed(const decoder *self, const char *data, size_t len, frame *f)
+{
+  if (len < self->prefix_size) {
+    return 0;
+  }
+
+  size_t size = 0;
+  for (unsigned int i = 0; i < self->prefix_size; ++i)
+    size = (size << 8) | (unsigned char) data[i];
+
+  if (size > self->size) {
+    return -1;
+  }
+  if (len < self->prefix_size + size) {
+    return 0;
+  }
+
+  f->data = data + self->prefix_size;
+  f->len = size;
+
+  return self->prefix_size + size;
+}
+
+static ssize_t framer_decode_fixed(const decoder *self, const char *data, size_t len, frame *f)
+{
+  if (len < self->size) {
+    return 0;
+  }
+
+  f->data = data;
+  f->len = self->size;
+
+  return self->size;
+}
+
+static const char * framer_find_byte_scalar(const char *data, size_t len, char c)
+{
+  for (size_t i = 0; i < len; ++i) {
+    if (c == data[i])
+      return data + i;
+  }
+
+  return 0;
+}
+
+#ifdef FRAMER_X86_SIMD
+static const char * framer_find_byte_sse2(const char *data, size_t len, char c)
+{
+  const __m128i needle = _mm_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    const __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+    const unsigned int mask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask)
+      return data + i + __builtin_ctz(mask);
+  }
+
+  return framer_find_byte_scalar(data + i, len - i, c);
+}
+
+__attribute__((target("avx2")))
+static const char * framer_find_byte_avx2(const char *data, size_t len, char c)
+{
+  const __m256i needle = _mm256_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    const __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+    const unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+    if (mask)
+      return data + i + __builtin_ctz(mask);
+  }
+
+  return framer_find_byte_sse2(data + i, len - i, c);
+}
+#endif
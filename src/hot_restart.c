@@ -0,0 +1,442 @@
+#include "reactor/hot_restart.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#define HOT_RESTART_BATCH 64
+#define HOT_RESTART_READY 'R'
+
+typedef struct hot_restart_fd_s {
+  char name[HOT_RESTART_NAME_SIZE];
+  int fd;
+  int received;
+} hot_restart_fd;
+
+struct hot_restart_ctx_s {
+  hot_restart *owner;
+  const os *o;
+  struct sockaddr_un addr;
+  reactor *r;
+  hot_restart_handler h;
+  void *arg;
+  event_handler listen_eh;
+  event_handler peer_eh;
+  hot_restart_fd *fds;
+  size_t fds_cnt;
+  size_t fds_cap;
+  int handed_over;
+};
+
+static void hot_restart_terminate(hot_restart *self);
+static void hot_restart_free(hot_restart *self);
+static int hot_restart_add_fd(hot_restart *self, const char *name, int fd);
+static int hot_restart_serve(hot_restart *self, reactor *r, hot_restart_handler h, void *arg);
+static int hot_restart_take(hot_restart *self, int timeout_ms);
+static int hot_restart_get_fd(hot_restart *self, const char *name);
+static int hot_restart_ready(hot_restart *self);
+static void hot_restart_handle_successor(event_handler *self, uint32_t events);
+static void hot_restart_handle_ready(event_handler *self, uint32_t events);
+static int hot_restart_send_fds(hot_restart_ctx *ctx, int fd);
+static int hot_restart_send_batch(hot_restart_ctx *ctx, int fd, const hot_restart_fd **batch, size_t cnt);
+static int hot_restart_recv_batch(hot_restart_ctx *ctx, int fd);
+static int hot_restart_push(hot_restart_ctx *ctx, const char *name, int fd, int received);
+static hot_restart_fd * hot_restart_find(hot_restart_ctx *ctx, const char *name, int received);
+static void hot_restart_close_received(hot_restart_ctx *ctx);
+static void hot_restart_close_peer(hot_restart_ctx *ctx);
+
+int hot_restart_init(hot_restart *hr, const os *o, const char *path)
+{
+  if ( (!hr) || (!o) || (!path) || (!o->socket) || (!o->bind) || (!o->listen) || (!o->accept) ||
+       (!o->connect) || (!o->setsockopt) || (!o->recv) || (!o->recvmsg) || (!o->sendmsg) ||
+       (!o->write) || (!o->close) || (!o->unlink) )
+    return -1;
+
+  hot_restart_ctx *ctx = (hot_restart_ctx *) malloc(sizeof(hot_restart_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(hot_restart_ctx));
+  if (strlen(path) >= sizeof(ctx->addr.sun_path)) {
+    free(ctx);
+    return -1;
+  }
+
+  memset(hr, 0, sizeof(hot_restart));
+  ctx->owner = hr;
+  ctx->o = o;
+  ctx->addr.sun_family = AF_UNIX;
+  strcpy(ctx->addr.sun_path, path);
+  ctx->listen_eh.fd = -1;
+  ctx->listen_eh.ctx = ctx;
+  ctx->listen_eh.handle_event = hot_restart_handle_successor;
+  ctx->peer_eh.fd = -1;
+  ctx->peer_eh.ctx = ctx;
+  ctx->peer_eh.handle_event = hot_restart_handle_ready;
+
+  hr->ctx = ctx;
+  hr->add_fd = hot_restart_add_fd;
+  hr->serve = hot_restart_serve;
+  hr->take = hot_restart_take;
+  hr->get_fd = hot_restart_get_fd;
+  hr->ready = hot_restart_ready;
+  hr->destroy = hot_restart_terminate;
+
+  return 0;
+}
+
+hot_restart * hot_restart_alloc(const os *o, const char *path)
+{
+  hot_restart *res = (hot_restart *) malloc(sizeof(hot_restart));
+  if (res) {
+    if (0 != hot_restart_init(res, o, path)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = hot_restart_free;
+  }
+
+  return res;
+}
+
+static void hot_restart_terminate(hot_restart *self)
+{
+  if (self && self->ctx) {
+    hot_restart_ctx *ctx = self->ctx;
+    hot_restart_close_peer(ctx);
+    hot_restart_close_received(ctx);
+    if (0 <= ctx->listen_eh.fd) {
+      ctx->r->unregister_eh(ctx->r, &ctx->listen_eh);
+      ctx->o->close(ctx->listen_eh.fd);
+      if (!ctx->handed_over)
+        ctx->o->unlink(ctx->addr.sun_path);
+    }
+    free(ctx->fds);
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void hot_restart_free(hot_restart *self)
+{
+  if (self) {
+    hot_restart_terminate(self);
+    free(self);
+  }
+}
+
+static int hot_restart_add_fd(hot_restart *self, const char *name, int fd)
+{
+  if ( (!self) || (!self->ctx) || (!name) || (!*name) || (0 > fd) ||
+       (strlen(name) >= HOT_RESTART_NAME_SIZE) || (hot_restart_find(self->ctx, name, 0)) ) {
+    return -1;
+  }
+
+  return hot_restart_push(self->ctx, name, fd, 0);
+}
+
+static int hot_restart_serve(hot_restart *self, reactor *r, hot_restart_handler h, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!r) || (!h) || (0 <= self->ctx->listen_eh.fd) ) {
+    return -1;
+  }
+
+  hot_restart_ctx *ctx = self->ctx;
+  const int fd = ctx->o->socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (0 > fd) {
+    return -1;
+  }
+
+  ctx->o->unlink(ctx->addr.sun_path);
+  if ( (0 != ctx->o->bind(fd, (const struct sockaddr *) &ctx->addr, sizeof(ctx->addr))) ||
+       (0 != ctx->o->listen(fd, 1)) ) {
+    ctx->o->close(fd);
+    return -1;
+  }
+
+  ctx->listen_eh.fd = fd;
+  if (0 != r->register_eh(r, &ctx->listen_eh)) {
+    ctx->listen_eh.fd = -1;
+    ctx->o->close(fd);
+    ctx->o->unlink(ctx->addr.sun_path);
+    return -1;
+  }
+  ctx->r = r;
+  ctx->h = h;
+  ctx->arg = arg;
+
+  return 0;
+}
+
+static int hot_restart_take(hot_restart *self, int timeout_ms)
+{
+  if ( (!self) || (!self->ctx) || (0 > timeout_ms) || (0 <= self->ctx->peer_eh.fd) ) {
+    return -1;
+  }
+
+  hot_restart_ctx *ctx = self->ctx;
+  const int fd = ctx->o->socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (0 > fd) {
+    return -1;
+  }
+
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  if ( (0 != ctx->o->setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))) ||
+       (0 != ctx->o->connect(fd, (const struct sockaddr *) &ctx->addr, sizeof(ctx->addr))) ) {
+    ctx->o->close(fd);
+    return -1;
+  }
+
+  const size_t already = ctx->fds_cnt;
+  int res = 1;
+  while (0 < res)
+    res = hot_restart_recv_batch(ctx, fd);
+  if (0 > res) {
+    ctx->o->close(fd);
+    hot_restart_close_received(ctx);
+    return -1;
+  }
+  ctx->peer_eh.fd = fd;
+
+  return ctx->fds_cnt - already;
+}
+
+static int hot_restart_get_fd(hot_restart *self, const char *name)
+{
+  if ( (!self) || (!self->ctx) || (!name) ) {
+    return -1;
+  }
+
+  hot_restart_fd *e = hot_restart_find(self->ctx, name, 1);
+  if (!e) {
+    return -1;
+  }
+
+  const int fd = e->fd;
+  e->fd = -1;
+
+  return fd;
+}
+
+static int hot_restart_ready(hot_restart *self)
+{
+  if ( (!self) || (!self->ctx) || (0 > self->ctx->peer_eh.fd) ) {
+    return -1;
+  }
+
+  hot_restart_ctx *ctx = self->ctx;
+  const char byte = HOT_RESTART_READY;
+  const int res = (1 == ctx->o->write(ctx->peer_eh.fd, &byte, 1)) ? 0 : -1;
+  ctx->o->close(ctx->peer_eh.fd);
+  ctx->peer_eh.fd = -1;
+  hot_restart_close_received(ctx);
+
+  return res;
+}
+
+static void hot_restart_handle_successor(event_handler *self, uint32_t events)
+{
+  hot_restart_ctx *ctx = (hot_restart_ctx *) self->ctx;
+  const int fd = ctx->o->accept(self->fd, 0, 0);
+  if (0 > fd) {
+    return;
+  }
+
+  if ( (0 <= ctx->peer_eh.fd) || (0 != hot_restart_send_fds(ctx, fd)) ) {
+    ctx->o->close(fd);
+    return;
+  }
+
+  ctx->peer_eh.fd = fd;
+  if (0 != ctx->r->register_eh(ctx->r, &ctx->peer_eh)) {
+    ctx->peer_eh.fd = -1;
+    ctx->o->close(fd);
+  }
+}
+
+static void hot_restart_handle_ready(event_handler *self, uint32_t events)
+{
+  hot_restart_ctx *ctx = (hot_restart_ctx *) self->ctx;
+  char byte = 0;
+  const ssize_t len = ctx->o->recv(self->fd, &byte, 1, MSG_DONTWAIT);
+  if ( (0 > len) && ( (EAGAIN == errno) || (EINTR == errno) ) ) {
+    return;
+  }
+
+  /* successor which hung up without being ready just leaves sockets here */
+  hot_restart_close_peer(ctx);
+  if ( (1 == len) && (HOT_RESTART_READY == byte) ) {
+    ctx->handed_over = 1;
+    ctx->h(ctx->owner, ctx->arg);
+  }
+}
+
+static int hot_restart_send_fds(hot_restart_ctx *ctx, int fd)
+{
+  const hot_restart_fd *batch[HOT_RESTART_BATCH];
+  size_t cnt = 0;
+
+  for (size_t i = 0; i < ctx->fds_cnt; ++i) {
+    if (ctx->fds[i].received)
+      continue;
+    batch[cnt++] = &ctx->fds[i];
+    if (HOT_RESTART_BATCH == cnt) {
+      if (0 != hot_restart_send_batch(ctx, fd, batch, cnt)) {
+        return -1;
+      }
+      cnt = 0;
+    }
+  }
+  if ( (cnt) && (0 != hot_restart_send_batch(ctx, fd, batch, cnt)) ) {
+    return -1;
+  }
+
+  /* batch with one empty name and no socket terminates the list */
+  return hot_restart_send_batch(ctx, fd, batch, 0);
+}
+
+static int hot_restart_send_batch(hot_restart_ctx *ctx, int fd, const hot_restart_fd **batch, size_t cnt)
+{
+  char names[HOT_RESTART_BATCH * HOT_RESTART_NAME_SIZE];
+  union {
+    char buf[CMSG_SPACE(HOT_RESTART_BATCH * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov;
+  struct msghdr msg;
+
+  memset(names, 0, sizeof(names));
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = names;
+  iov.iov_len = (cnt) ? cnt * HOT_RESTART_NAME_SIZE : HOT_RESTART_NAME_SIZE;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (cnt) {
+    int fds[HOT_RESTART_BATCH];
+    for (size_t i = 0; i < cnt; ++i) {
+      memcpy(names + i * HOT_RESTART_NAME_SIZE, batch[i]->name, HOT_RESTART_NAME_SIZE);
+      fds[i] = batch[i]->fd;
+    }
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(cnt * sizeof(int));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(cnt * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, cnt * sizeof(int));
+  }
+
+  return ((ssize_t) iov.iov_len == ctx->o->sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL)) ? 0 : -1;
+}
+
+static int hot_restart_recv_batch(hot_restart_ctx *ctx, int fd)
+{
+  char names[HOT_RESTART_BATCH * HOT_RESTART_NAME_SIZE];
+  union {
+    char buf[CMSG_SPACE(HOT_RESTART_BATCH * sizeof(int))];
+    struct cmsghdr align;
+  } control;
+  struct iovec iov;
+  struct msghdr msg;
+  int fds[HOT_RESTART_BATCH];
+  size_t fds_cnt = 0;
+
+  memset(&msg, 0, sizeof(msg));
+  iov.iov_base = names;
+  iov.iov_len = sizeof(names);
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  const ssize_t len = ctx->o->recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+  for (struct cmsghdr *cmsg = (0 < len) ? CMSG_FIRSTHDR(&msg) : 0; cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if ( (SOL_SOCKET == cmsg->cmsg_level) && (SCM_RIGHTS == cmsg->cmsg_type) ) {
+      const size_t cnt = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      memcpy(fds + fds_cnt, CMSG_DATA(cmsg), cnt * sizeof(int));
+      fds_cnt += cnt;
+    }
+  }
+
+  int res = (0 < len) && (0 == len % HOT_RESTART_NAME_SIZE) && (!(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) ? 0 : -1;
+  const size_t names_cnt = (0 == res) ? len / HOT_RESTART_NAME_SIZE : 0;
+  if ( (0 == res) && (0 == fds_cnt) && (1 == names_cnt) && (!names[0]) ) {
+    return 0;
+  }
+  if (names_cnt != fds_cnt)
+    res = -1;
+
+  for (size_t i = 0; i < fds_cnt; ++i) {
+    char *name = names + i * HOT_RESTART_NAME_SIZE;
+    name[HOT_RESTART_NAME_SIZE - 1] = 0;
+    if ( (0 != res) || (!*name) || (hot_restart_find(ctx, name, 1)) ||
+         (0 != hot_restart_push(ctx, name, fds[i], 1)) ) {
+      res = -1;
+      ctx->o->close(fds[i]);
+    }
+  }
+
+  return (0 == res) ? 1 : -1;
+}
+
+static int hot_restart_push(hot_restart_ctx *ctx, const char *name, int fd, int received)
+{
+  if (ctx->fds_cnt == ctx->fds_cap) {
+    const size_t cap = (ctx->fds_cap) ? 2 * ctx->fds_cap : 8;
+    hot_restart_fd *fds = (hot_restart_fd *) realloc(ctx->fds, cap * sizeof(hot_restart_fd));
+    if (!fds) {
+      return -1;
+    }
+    ctx->fds = fds;
+    ctx->fds_cap = cap;
+  }
+
+  hot_restart_fd *e = &ctx->fds[ctx->fds_cnt++];
+  memset(e->name, 0, sizeof(e->name));
+  strncpy(e->name, name, sizeof(e->name) - 1);
+  e->fd = fd;
+  e->received = received;
+
+  return 0;
+}
+
+static hot_restart_fd * hot_restart_find(hot_restart_ctx *ctx, const char *name, int received)
+{
+  for (size_t i = 0; i < ctx->fds_cnt; ++i) {
+    if ( (received == ctx->fds[i].received) && (0 <= ctx->fds[i].fd) &&
+         (0 == strncmp(ctx->fds[i].name, name, HOT_RESTART_NAME_SIZE)) )
+      return &ctx->fds[i];
+  }
+
+  return 0;
+}
+
+static void hot_restart_close_received(hot_restart_ctx *ctx)
+{
+  size_t cnt = 0;
+  for (size_t i = 0; i < ctx->fds_cnt; ++i) {
+    if (!ctx->fds[i].received) {
+      ctx->fds[cnt++] = ctx->fds[i];
+    }
+    else if (0 <= ctx->fds[i].fd) {
+      ctx->o->close(ctx->fds[i].fd);
+    }
+  }
+  ctx->fds_cnt = cnt;
+}
+
+static void hot_restart_close_peer(hot_restart_ctx *ctx)
+{
+  if (0 > ctx->peer_eh.fd) {
+    return;
+  }
+
+  if (ctx->r)
+    ctx->r->unregister_eh(ctx->r, &ctx->peer_eh);
+  ctx->o->close(ctx->peer_eh.fd);
+  ctx->peer_eh.fd = -1;
+}
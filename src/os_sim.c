@@ -0,0 +1,926 @@
+#include "reactor/os_sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+
+#define OS_SIM_FIRST_FD 3
+
+typedef enum sim_fd_type_e {
+  SIM_FREE = 0,
+  SIM_EPOLL,
+  SIM_SOCKET,
+  SIM_LISTENER,
+  SIM_EVENTFD,
+  SIM_TIMERFD
+} sim_fd_type;
+
+typedef struct sim_ring_s {
+  int *fds;
+  size_t cap;
+  size_t head;
+  size_t cnt;
+} sim_ring;
+
+typedef struct sim_fd_s {
+  uint8_t type;
+  uint8_t hup;
+  uint32_t interest;
+  int epoll;
+  int queued_in;
+  size_t ring_pos;
+  int target_idx;
+  uint64_t data;
+  uint64_t counter;
+  char *rx;
+  size_t rx_off;
+  size_t rx_len;
+  size_t rx_cap;
+  sim_ring *ring;
+  uint64_t expire_ns;
+  uint64_t interval_ns;
+} sim_fd;
+
+typedef struct sim_s {
+  int running;
+  os_sim_config cfg;
+  os_sim_stats stats;
+  sim_fd *fds;
+  size_t fds_cap;
+  int *free_fds;
+  size_t free_cnt;
+  size_t next_fd;
+  int *targets;
+  size_t targets_cnt;
+  size_t targets_cap;
+  int *timers;
+  size_t timers_cnt;
+  size_t timers_cap;
+  uint64_t next_arrival_ns;
+  uint64_t rnd;
+  char *msg;
+} sim;
+
+static sim SIM;
+
+static int os_sim_epoll_create1(int flags);
+static int os_sim_epoll_ctl(int epfd, int op, int fd, struct epoll_event *ev);
+static int os_sim_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout);
+static int os_sim_close(int fd);
+static int os_sim_socket(int domain, int type, int protocol);
+static int os_sim_bind(int fd, const struct sockaddr *addr, socklen_t addr_len);
+static int os_sim_listen(int fd, int backlog);
+static int os_sim_accept(int fd, struct sockaddr *addr, socklen_t *addr_len);
+static int os_sim_connect_fd(int fd, const struct sockaddr *addr, socklen_t addr_len);
+static int os_sim_getsockopt(int fd, int level, int name, void *val, socklen_t *len);
+static int os_sim_setsockopt(int fd, int level, int name, const void *val, socklen_t len);
+static ssize_t os_sim_recv(int fd, void *buf, size_t len, int flags);
+static ssize_t os_sim_recvmsg(int fd, struct msghdr *msg, int flags);
+static ssize_t os_sim_read(int fd, void *buf, size_t len);
+static ssize_t os_sim_write(int fd, const void *buf, size_t len);
+static ssize_t os_sim_writev(int fd, const struct iovec *iov, int iov_cnt);
+static int os_sim_eventfd(unsigned int initval, int flags);
+static int os_sim_unlink(const char *path);
+static int os_sim_timerfd_create(int clockid, int flags);
+static int os_sim_timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                                  struct itimerspec *old_value);
+static int os_sim_clock_gettime(clockid_t clock, struct timespec *ts);
+
+static sim_fd * sim_get(int fd, sim_fd_type type);
+static int sim_open(sim_fd_type type);
+static int sim_add_target(int fd);
+static void sim_remove_target(sim_fd *f);
+static uint32_t sim_ready_events(const sim_fd *f);
+static void sim_notify(int fd);
+static int sim_ring_push(sim_ring *ring, int fd);
+static int sim_rx_append(sim_fd *f, const void *data, size_t len);
+static ssize_t sim_input(int fd, void *buf, size_t len, int peek);
+static void sim_advance(uint64_t now_ns);
+static uint64_t sim_next_event_ns(void);
+static uint64_t sim_interarrival_ns(void);
+static double sim_random(void);
+static uint64_t sim_ts_to_ns(const struct timespec *ts);
+static void sim_ns_to_ts(uint64_t ns, struct timespec *ts);
+
+int os_sim_init(os *o, const os_sim_config *cfg)
+{
+  if ( (!o) || (SIM.running) )
+    return -1;
+
+  memset(&SIM, 0, sizeof(SIM));
+  if (cfg)
+    SIM.cfg = *cfg;
+  if (!SIM.cfg.max_fds)
+    SIM.cfg.max_fds = 4 * 1024 * 1024;
+  if (!SIM.cfg.tick_ns)
+    SIM.cfg.tick_ns = 100000;
+  if (!SIM.cfg.msg_size)
+    SIM.cfg.msg_size = 64;
+  if (SIM.cfg.skew < 1.0)
+    SIM.cfg.skew = 1.0;
+  SIM.rnd = (SIM.cfg.seed) ? SIM.cfg.seed : 0x2545F4914F6CDD1DULL;
+
+  SIM.msg = (char *) malloc(SIM.cfg.msg_size);
+  if (!SIM.msg) {
+    return -1;
+  }
+  memset(SIM.msg, 'x', SIM.cfg.msg_size - 1);
+  SIM.msg[SIM.cfg.msg_size - 1] = '\n';
+  SIM.next_fd = OS_SIM_FIRST_FD;
+  SIM.next_arrival_ns = (0 < SIM.cfg.arrival_rate) ? sim_interarrival_ns() : UINT64_MAX;
+  SIM.running = 1;
+
+  memset(o, 0, sizeof(os));
+  o->epoll_create1 = os_sim_epoll_create1;
+  o->epoll_ctl = os_sim_epoll_ctl;
+  o->epoll_wait = os_sim_epoll_wait;
+  o->close = os_sim_close;
+  o->socket = os_sim_socket;
+  o->bind = os_sim_bind;
+  o->listen = os_sim_listen;
+  o->accept = os_sim_accept;
+  o->connect = os_sim_connect_fd;
+  o->getsockopt = os_sim_getsockopt;
+  o->setsockopt = os_sim_setsockopt;
+  o->recv = os_sim_recv;
+  o->recvmsg = os_sim_recvmsg;
+  o->read = os_sim_read;
+  o->write = os_sim_write;
+  o->writev = os_sim_writev;
+  o->eventfd = os_sim_eventfd;
+  o->unlink = os_sim_unlink;
+  o->mmap = mmap;
+  o->munmap = munmap;
+  o->madvise = madvise;
+  o->timerfd_create = os_sim_timerfd_create;
+  o->timerfd_settime = os_sim_timerfd_settime;
+  o->clock_gettime = os_sim_clock_gettime;
+
+  return 0;
+}
+
+int os_sim_finish(void)
+{
+  if (!SIM.running) {
+    return -1;
+  }
+
+  for (size_t fd = 0; fd < SIM.fds_cap; ++fd) {
+    free(SIM.fds[fd].rx);
+    if (SIM.fds[fd].ring) {
+      free(SIM.fds[fd].ring->fds);
+      free(SIM.fds[fd].ring);
+    }
+  }
+  free(SIM.fds);
+  free(SIM.free_fds);
+  free(SIM.targets);
+  free(SIM.timers);
+  free(SIM.msg);
+  memset(&SIM, 0, sizeof(SIM));
+
+  return 0;
+}
+
+int os_sim_connect(int listen_fd, size_t cnt)
+{
+  sim_fd *f = sim_get(listen_fd, SIM_LISTENER);
+  if (!f) {
+    return -1;
+  }
+
+  f->counter += cnt;
+  sim_notify(listen_fd);
+
+  return 0;
+}
+
+int os_sim_deliver(int fd, const void *data, size_t len)
+{
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if ( (!f) || (f->hup) || (0 != sim_rx_append(f, data, len)) ) {
+    return -1;
+  }
+
+  sim_notify(fd);
+
+  return 0;
+}
+
+int os_sim_hangup(int fd)
+{
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if (!f) {
+    return -1;
+  }
+
+  f->hup = 1;
+  sim_remove_target(f);
+  sim_notify(fd);
+
+  return 0;
+}
+
+int os_sim_get_stats(os_sim_stats *stats)
+{
+  if ( (!SIM.running) || (!stats) ) {
+    return -1;
+  }
+
+  *stats = SIM.stats;
+
+  return 0;
+}
+
+static int os_sim_epoll_create1(int flags)
+{
+  const int fd = sim_open(SIM_EPOLL);
+  if (0 > fd) {
+    return -1;
+  }
+
+  sim_ring *ring = (sim_ring *) calloc(1, sizeof(sim_ring));
+  if (!ring) {
+    os_sim_close(fd);
+    errno = ENOMEM;
+    return -1;
+  }
+  SIM.fds[fd].ring = ring;
+
+  return fd;
+}
+
+static int os_sim_epoll_ctl(int epfd, int op, int fd, struct epoll_event *ev)
+{
+  sim_fd *f = sim_get(fd, SIM_FREE);
+  if ( (!sim_get(epfd, SIM_EPOLL)) || (!f) || (SIM_EPOLL == f->type) ) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (EPOLL_CTL_ADD == op) {
+    if (0 <= f->epoll) {
+      errno = EEXIST;
+      return -1;
+    }
+  }
+  else if (epfd != f->epoll) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  if (EPOLL_CTL_DEL == op) {
+    f->epoll = -1;
+    f->interest = 0;
+    return 0;
+  }
+
+  if (!ev) {
+    errno = EFAULT;
+    return -1;
+  }
+  f->epoll = epfd;
+  f->interest = ev->events;
+  f->data = ev->data.u64;
+  sim_notify(fd);
+
+  return 0;
+}
+
+static int os_sim_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout)
+{
+  sim_fd *ep = sim_get(epfd, SIM_EPOLL);
+  if ( (!ep) || (0 >= max_evs) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  ++SIM.stats.epoll_waits;
+  const uint64_t deadline_ns = (0 > timeout) ? UINT64_MAX : SIM.stats.now_ns + (uint64_t) timeout * 1000000ULL;
+  uint64_t now_ns = SIM.stats.now_ns + SIM.cfg.tick_ns;
+  for (;;) {
+    if ( (SIM.cfg.duration_ns) && (now_ns > SIM.cfg.duration_ns) )
+      now_ns = SIM.cfg.duration_ns;
+    sim_advance(now_ns);
+
+    int cnt = 0;
+    sim_ring *ring = SIM.fds[epfd].ring;
+    for (size_t pending = ring->cnt; (pending) && (cnt < max_evs); --pending) {
+      const int fd = ring->fds[ring->head];
+      ring->head = (ring->head + 1) % ring->cap;
+      --ring->cnt;
+      if (0 > fd)
+        continue;
+      sim_fd *f = &SIM.fds[fd];
+      if (epfd != f->queued_in)
+        continue;
+      f->queued_in = -1;
+      if (epfd != f->epoll)
+        continue;
+      const uint32_t ready = sim_ready_events(f) & (f->interest | EPOLLERR | EPOLLHUP);
+      if (!ready)
+        continue;
+      evs[cnt].events = ready;
+      evs[cnt].data.u64 = f->data;
+      ++cnt;
+      if (!(f->interest & EPOLLET)) {
+        /* level triggered fd is checked again by the next epoll_wait */
+        if (0 == sim_ring_push(ring, fd))
+          f->queued_in = epfd;
+      }
+    }
+    if (cnt) {
+      SIM.stats.events += cnt;
+      return cnt;
+    }
+
+    if ( (SIM.cfg.duration_ns) && (SIM.stats.now_ns >= SIM.cfg.duration_ns) ) {
+      errno = ESHUTDOWN;
+      return -1;
+    }
+    if (SIM.stats.now_ns >= deadline_ns) {
+      return 0;
+    }
+
+    const uint64_t next_ns = sim_next_event_ns();
+    if ( (UINT64_MAX == next_ns) && (UINT64_MAX == deadline_ns) && (!SIM.cfg.duration_ns) ) {
+      /* nothing will ever happen, so blocking forever is reported as timeout */
+      return 0;
+    }
+    now_ns = (next_ns < deadline_ns) ? next_ns : deadline_ns;
+    if (now_ns <= SIM.stats.now_ns)
+      now_ns = SIM.stats.now_ns + 1;
+  }
+}
+
+static int os_sim_close(int fd)
+{
+  sim_fd *f = sim_get(fd, SIM_FREE);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (SIM_EPOLL == f->type) {
+    /* fds still queued in the ready ring must not point to it anymore */
+    const sim_ring *ring = f->ring;
+    for (size_t i = 0; (ring) && (i < ring->cnt); ++i) {
+      const int queued = ring->fds[(ring->head + i) % ring->cap];
+      if ( (0 <= queued) && (fd == SIM.fds[queued].queued_in) )
+        SIM.fds[queued].queued_in = -1;
+    }
+    for (size_t i = 0; i < SIM.fds_cap; ++i) {
+      if (fd == SIM.fds[i].epoll)
+        SIM.fds[i].epoll = -1;
+    }
+  }
+  if (SIM_TIMERFD == f->type) {
+    for (size_t i = 0; i < SIM.timers_cnt; ++i) {
+      if (fd == SIM.timers[i]) {
+        SIM.timers[i] = SIM.timers[--SIM.timers_cnt];
+        break;
+      }
+    }
+  }
+  if ( (0 <= f->queued_in) && (SIM.fds[f->queued_in].ring) ) {
+    /* the entry in ready ring is left as a hole, so fd may be reused */
+    SIM.fds[f->queued_in].ring->fds[f->ring_pos] = -1;
+  }
+  sim_remove_target(f);
+  free(f->rx);
+  if (f->ring) {
+    free(f->ring->fds);
+    free(f->ring);
+  }
+  memset(f, 0, sizeof(sim_fd));
+  SIM.free_fds[SIM.free_cnt++] = fd;
+  --SIM.stats.open_fds;
+
+  return 0;
+}
+
+static int os_sim_socket(int domain, int type, int protocol)
+{
+  return sim_open(SIM_SOCKET);
+}
+
+static int os_sim_bind(int fd, const struct sockaddr *addr, socklen_t addr_len)
+{
+  if (!sim_get(fd, SIM_SOCKET)) {
+    errno = EBADF;
+    return -1;
+  }
+
+  return 0;
+}
+
+static int os_sim_listen(int fd, int backlog)
+{
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+
+  f->type = SIM_LISTENER;
+
+  return 0;
+}
+
+static int os_sim_accept(int fd, struct sockaddr *addr, socklen_t *addr_len)
+{
+  sim_fd *f = sim_get(fd, SIM_LISTENER);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+  if (!f->counter) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  const int cli_fd = sim_open(SIM_SOCKET);
+  if (0 > cli_fd) {
+    return -1;
+  }
+  if (0 != sim_add_target(cli_fd)) {
+    os_sim_close(cli_fd);
+    errno = ENOMEM;
+    return -1;
+  }
+  --SIM.fds[fd].counter;
+  ++SIM.stats.accepted;
+  if (addr_len)
+    *addr_len = 0;
+
+  return cli_fd;
+}
+
+static int os_sim_connect_fd(int fd, const struct sockaddr *addr, socklen_t addr_len)
+{
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if ( (0 > f->target_idx) && (0 != sim_add_target(fd)) ) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  return 0;
+}
+
+static int os_sim_getsockopt(int fd, int level, int name, void *val, socklen_t *len)
+{
+  if (!sim_get(fd, SIM_FREE)) {
+    errno = EBADF;
+    return -1;
+  }
+  if ( (val) && (len) )
+    memset(val, 0, *len);
+
+  return 0;
+}
+
+static int os_sim_setsockopt(int fd, int level, int name, const void *val, socklen_t len)
+{
+  if (!sim_get(fd, SIM_FREE)) {
+    errno = EBADF;
+    return -1;
+  }
+
+  return 0;
+}
+
+static ssize_t os_sim_recv(int fd, void *buf, size_t len, int flags)
+{
+  return sim_input(fd, buf, len, flags & MSG_PEEK);
+}
+
+static ssize_t os_sim_recvmsg(int fd, struct msghdr *msg, int flags)
+{
+  if ( (!msg) || (!msg->msg_iovlen) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  msg->msg_controllen = 0;
+  msg->msg_flags = 0;
+
+  return sim_input(fd, msg->msg_iov[0].iov_base, msg->msg_iov[0].iov_len, flags & MSG_PEEK);
+}
+
+static ssize_t os_sim_read(int fd, void *buf, size_t len)
+{
+  sim_fd *f = sim_get(fd, SIM_FREE);
+  if ( (f) && ( (SIM_EVENTFD == f->type) || (SIM_TIMERFD == f->type) ) ) {
+    if (sizeof(uint64_t) > len) {
+      errno = EINVAL;
+      return -1;
+    }
+    if (!f->counter) {
+      errno = EAGAIN;
+      return -1;
+    }
+    memcpy(buf, &f->counter, sizeof(uint64_t));
+    f->counter = 0;
+    return sizeof(uint64_t);
+  }
+
+  return sim_input(fd, buf, len, 0);
+}
+
+static ssize_t os_sim_write(int fd, const void *buf, size_t len)
+{
+  sim_fd *f = sim_get(fd, SIM_FREE);
+  if ( (f) && (SIM_EVENTFD == f->type) ) {
+    uint64_t value = 0;
+    if (sizeof(uint64_t) > len) {
+      errno = EINVAL;
+      return -1;
+    }
+    memcpy(&value, buf, sizeof(value));
+    f->counter += value;
+    sim_notify(fd);
+    return sizeof(uint64_t);
+  }
+  if ( (!f) || (SIM_SOCKET != f->type) ) {
+    errno = EBADF;
+    return -1;
+  }
+  if (f->hup) {
+    errno = EPIPE;
+    return -1;
+  }
+
+  SIM.stats.tx_bytes += len;
+
+  return len;
+}
+
+static ssize_t os_sim_writev(int fd, const struct iovec *iov, int iov_cnt)
+{
+  size_t len = 0;
+  for (int i = 0; i < iov_cnt; ++i)
+    len += iov[i].iov_len;
+
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+  if (f->hup) {
+    errno = EPIPE;
+    return -1;
+  }
+
+  SIM.stats.tx_bytes += len;
+
+  return len;
+}
+
+static int os_sim_eventfd(unsigned int initval, int flags)
+{
+  const int fd = sim_open(SIM_EVENTFD);
+  if (0 <= fd)
+    SIM.fds[fd].counter = initval;
+
+  return fd;
+}
+
+static int os_sim_unlink(const char *path)
+{
+  /* simulated sockets are not bound into file system, so there is nothing to remove */
+  return 0;
+}
+
+static int os_sim_timerfd_create(int clockid, int flags)
+{
+  if (SIM.timers_cnt == SIM.timers_cap) {
+    const size_t cap = (SIM.timers_cap) ? 2 * SIM.timers_cap : 16;
+    int *timers = (int *) realloc(SIM.timers, cap * sizeof(int));
+    if (!timers) {
+      errno = ENOMEM;
+      return -1;
+    }
+    SIM.timers = timers;
+    SIM.timers_cap = cap;
+  }
+
+  const int fd = sim_open(SIM_TIMERFD);
+  if (0 <= fd)
+    SIM.timers[SIM.timers_cnt++] = fd;
+
+  return fd;
+}
+
+static int os_sim_timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                                  struct itimerspec *old_value)
+{
+  sim_fd *f = sim_get(fd, SIM_TIMERFD);
+  if ( (!f) || (!new_value) ) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  if (old_value) {
+    sim_ns_to_ts( (f->expire_ns) ? f->expire_ns - SIM.stats.now_ns : 0, &old_value->it_value);
+    sim_ns_to_ts(f->interval_ns, &old_value->it_interval);
+  }
+
+  const uint64_t value_ns = sim_ts_to_ns(&new_value->it_value);
+  f->interval_ns = sim_ts_to_ns(&new_value->it_interval);
+  if (!value_ns)
+    f->expire_ns = 0;
+  else if (flags & TFD_TIMER_ABSTIME)
+    f->expire_ns = (value_ns > SIM.stats.now_ns) ? value_ns : SIM.stats.now_ns + 1;
+  else
+    f->expire_ns = SIM.stats.now_ns + value_ns;
+  f->counter = 0;
+
+  return 0;
+}
+
+static int os_sim_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  sim_ns_to_ts(SIM.stats.now_ns, ts);
+
+  return 0;
+}
+
+static sim_fd * sim_get(int fd, sim_fd_type type)
+{
+  if ( (!SIM.running) || (0 > fd) || ((size_t) fd >= SIM.fds_cap) || (SIM_FREE == SIM.fds[fd].type) ) {
+    return 0;
+  }
+
+  if ( (SIM_FREE != type) && (type != SIM.fds[fd].type) ) {
+    return 0;
+  }
+
+  return &SIM.fds[fd];
+}
+
+static int sim_open(sim_fd_type type)
+{
+  int fd = -1;
+  if (SIM.free_cnt) {
+    fd = SIM.free_fds[--SIM.free_cnt];
+  }
+  else {
+    if (SIM.next_fd >= SIM.cfg.max_fds) {
+      errno = EMFILE;
+      return -1;
+    }
+    if (SIM.next_fd >= SIM.fds_cap) {
+      size_t cap = (SIM.fds_cap) ? 2 * SIM.fds_cap : 1024;
+      if (cap > SIM.cfg.max_fds)
+        cap = SIM.cfg.max_fds;
+      sim_fd *fds = (sim_fd *) realloc(SIM.fds, cap * sizeof(sim_fd));
+      int *free_fds = (fds) ? (int *) realloc(SIM.free_fds, cap * sizeof(int)) : 0;
+      if (fds)
+        SIM.fds = fds;
+      if (!free_fds) {
+        errno = ENOMEM;
+        return -1;
+      }
+      memset(SIM.fds + SIM.fds_cap, 0, (cap - SIM.fds_cap) * sizeof(sim_fd));
+      SIM.free_fds = free_fds;
+      SIM.fds_cap = cap;
+    }
+    fd = (int) SIM.next_fd++;
+  }
+
+  sim_fd *f = &SIM.fds[fd];
+  memset(f, 0, sizeof(sim_fd));
+  f->type = type;
+  f->epoll = -1;
+  f->queued_in = -1;
+  f->target_idx = -1;
+  ++SIM.stats.open_fds;
+
+  return fd;
+}
+
+static int sim_add_target(int fd)
+{
+  if (SIM.targets_cnt == SIM.targets_cap) {
+    const size_t cap = (SIM.targets_cap) ? 2 * SIM.targets_cap : 1024;
+    int *targets = (int *) realloc(SIM.targets, cap * sizeof(int));
+    if (!targets) {
+      return -1;
+    }
+    SIM.targets = targets;
+    SIM.targets_cap = cap;
+  }
+
+  SIM.fds[fd].target_idx = (int) SIM.targets_cnt;
+  SIM.targets[SIM.targets_cnt++] = fd;
+
+  return 0;
+}
+
+static void sim_remove_target(sim_fd *f)
+{
+  if (0 > f->target_idx) {
+    return;
+  }
+
+  const int last = SIM.targets[--SIM.targets_cnt];
+  SIM.targets[f->target_idx] = last;
+  SIM.fds[last].target_idx = f->target_idx;
+  f->target_idx = -1;
+}
+
+static uint32_t sim_ready_events(const sim_fd *f)
+{
+  switch (f->type) {
+    case SIM_SOCKET:
+      return EPOLLOUT | ( (f->rx_len) ? EPOLLIN : 0 ) | ( (f->hup) ? EPOLLIN | EPOLLRDHUP : 0 );
+    case SIM_LISTENER:
+    case SIM_TIMERFD:
+      return (f->counter) ? EPOLLIN : 0;
+    case SIM_EVENTFD:
+      return EPOLLOUT | ( (f->counter) ? EPOLLIN : 0 );
+    default:
+      return 0;
+  }
+}
+
+static void sim_notify(int fd)
+{
+  sim_fd *f = &SIM.fds[fd];
+  if ( (0 > f->epoll) || (f->epoll == f->queued_in) ) {
+    return;
+  }
+  if (!(sim_ready_events(f) & (f->interest | EPOLLERR | EPOLLHUP))) {
+    return;
+  }
+
+  if (0 == sim_ring_push(SIM.fds[f->epoll].ring, fd))
+    f->queued_in = f->epoll;
+}
+
+static int sim_ring_push(sim_ring *ring, int fd)
+{
+  if (ring->cnt == ring->cap) {
+    const size_t cap = (ring->cap) ? 2 * ring->cap : 1024;
+    int *fds = (int *) malloc(cap * sizeof(int));
+    if (!fds) {
+      return -1;
+    }
+    for (size_t i = 0; i < ring->cnt; ++i) {
+      fds[i] = ring->fds[(ring->head + i) % ring->cap];
+      if (0 <= fds[i])
+        SIM.fds[fds[i]].ring_pos = i;
+    }
+    free(ring->fds);
+    ring->fds = fds;
+    ring->cap = cap;
+    ring->head = 0;
+  }
+
+  const size_t pos = (ring->head + ring->cnt) % ring->cap;
+  ring->fds[pos] = fd;
+  SIM.fds[fd].ring_pos = pos;
+  ++ring->cnt;
+
+  return 0;
+}
+
+static int sim_rx_append(sim_fd *f, const void *data, size_t len)
+{
+  if ( (f->rx_off) && (f->rx_off + f->rx_len + len > f->rx_cap) ) {
+    memmove(f->rx, f->rx + f->rx_off, f->rx_len);
+    f->rx_off = 0;
+  }
+  if (f->rx_len + len > f->rx_cap) {
+    size_t cap = (f->rx_cap) ? f->rx_cap : 256;
+    while (cap < f->rx_len + len)
+      cap *= 2;
+    char *rx = (char *) realloc(f->rx, cap);
+    if (!rx) {
+      return -1;
+    }
+    f->rx = rx;
+    f->rx_cap = cap;
+  }
+
+  memcpy(f->rx + f->rx_off + f->rx_len, data, len);
+  f->rx_len += len;
+
+  return 0;
+}
+
+static ssize_t sim_input(int fd, void *buf, size_t len, int peek)
+{
+  sim_fd *f = sim_get(fd, SIM_SOCKET);
+  if (!f) {
+    errno = EBADF;
+    return -1;
+  }
+
+  if (!f->rx_len) {
+    if (f->hup) {
+      return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+  }
+
+  const size_t res = (len < f->rx_len) ? len : f->rx_len;
+  memcpy(buf, f->rx + f->rx_off, res);
+  if (!peek) {
+    f->rx_off += res;
+    f->rx_len -= res;
+    if (!f->rx_len)
+      f->rx_off = 0;
+    SIM.stats.rx_bytes += res;
+  }
+
+  return res;
+}
+
+static void sim_advance(uint64_t now_ns)
+{
+  while ( (SIM.next_arrival_ns <= now_ns) ) {
+    if (SIM.targets_cnt) {
+      const double u = sim_random();
+      size_t idx = (OS_SIM_SKEWED == SIM.cfg.target) ? (size_t) (SIM.targets_cnt * pow(u, SIM.cfg.skew))
+                                                     : (size_t) (SIM.targets_cnt * u);
+      if (idx >= SIM.targets_cnt)
+        idx = SIM.targets_cnt - 1;
+      const int fd = SIM.targets[idx];
+      if (0 == sim_rx_append(&SIM.fds[fd], SIM.msg, SIM.cfg.msg_size)) {
+        ++SIM.stats.arrivals;
+        sim_notify(fd);
+      }
+    }
+    SIM.next_arrival_ns += sim_interarrival_ns();
+  }
+
+  for (size_t i = 0; i < SIM.timers_cnt; ++i) {
+    sim_fd *f = &SIM.fds[SIM.timers[i]];
+    if ( (!f->expire_ns) || (f->expire_ns > now_ns) )
+      continue;
+    if (f->interval_ns) {
+      const uint64_t expirations = (now_ns - f->expire_ns) / f->interval_ns + 1;
+      f->counter += expirations;
+      f->expire_ns += expirations * f->interval_ns;
+    }
+    else {
+      ++f->counter;
+      f->expire_ns = 0;
+    }
+    sim_notify(SIM.timers[i]);
+  }
+
+  SIM.stats.now_ns = now_ns;
+}
+
+static uint64_t sim_next_event_ns(void)
+{
+  uint64_t res = SIM.next_arrival_ns;
+
+  for (size_t i = 0; i < SIM.timers_cnt; ++i) {
+    const sim_fd *f = &SIM.fds[SIM.timers[i]];
+    if ( (f->expire_ns) && (f->expire_ns < res) )
+      res = f->expire_ns;
+  }
+
+  return res;
+}
+
+static uint64_t sim_interarrival_ns(void)
+{
+  const double mean_ns = 1e9 / SIM.cfg.arrival_rate;
+  const double res = (SIM.cfg.poisson) ? -log(sim_random()) * mean_ns : mean_ns;
+
+  return (res < 1.0) ? 1 : (uint64_t) res;
+}
+
+static double sim_random(void)
+{
+  /* xorshift64*, returns value in (0, 1] */
+  SIM.rnd ^= SIM.rnd >> 12;
+  SIM.rnd ^= SIM.rnd << 25;
+  SIM.rnd ^= SIM.rnd >> 27;
+  const uint64_t r = SIM.rnd * 0x2545F4914F6CDD1DULL;
+
+  return ((r >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t sim_ts_to_ns(const struct timespec *ts)
+{
+  return (uint64_t) ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void sim_ns_to_ts(uint64_t ns, struct timespec *ts)
+{
+  ts->tv_sec = ns / 1000000000ULL;
+  ts->tv_nsec = ns % 1000000000ULL;
+}
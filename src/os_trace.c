@@ -0,0 +1,682 @@
+#include "reactor/os_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#define OS_TRACE_MAGIC "RCTRACE1"
+#define OS_TRACE_BUF_SIZE (64 * 1024)
+#define OS_TRACE_EVENT_SIZE (sizeof(uint32_t) + sizeof(uint64_t))
+#define OS_TRACE_FIRST_FAKE_FD (1 << 20)
+
+typedef enum os_trace_op_e {
+  OS_TRACE_EPOLL_WAIT = 1,
+  OS_TRACE_ACCEPT,
+  OS_TRACE_READ,
+  OS_TRACE_RECV,
+  OS_TRACE_WRITE,
+  OS_TRACE_WRITEV,
+  OS_TRACE_EPOLL_CREATE1,
+  OS_TRACE_SOCKET,
+  OS_TRACE_EVENTFD,
+  OS_TRACE_TIMERFD_CREATE
+} os_trace_op;
+
+typedef struct os_trace_entry_s {
+  uint8_t op;
+  uint8_t reserved[3];
+  int32_t fd;
+  int32_t err;
+  uint32_t payload_len;
+  int64_t result;
+  uint64_t time_ns;
+} os_trace_entry;
+
+typedef struct os_recorder_s {
+  int running;
+  os real;
+  int trace_fd;
+  int with_payload;
+  int failed;
+  pthread_mutex_t lock;
+  char *buf;
+  size_t len;
+} os_recorder;
+
+typedef struct os_replayer_s {
+  int running;
+  char *trace;
+  size_t len;
+  size_t pos;
+  uint64_t now_ns;
+  long diverged;
+  int next_fake_fd;
+} os_replayer;
+
+static os_recorder RECORDER = { 0, .lock = PTHREAD_MUTEX_INITIALIZER };
+static os_replayer REPLAYER;
+
+static int os_record_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout);
+static int os_record_accept(int fd, struct sockaddr *addr, socklen_t *addr_len);
+static ssize_t os_record_read(int fd, void *buf, size_t len);
+static ssize_t os_record_recv(int fd, void *buf, size_t len, int flags);
+static ssize_t os_record_write(int fd, const void *buf, size_t len);
+static ssize_t os_record_writev(int fd, const struct iovec *iov, int iov_cnt);
+static int os_record_epoll_create1(int flags);
+static int os_record_socket(int domain, int type, int protocol);
+static int os_record_eventfd(unsigned int initval, int flags);
+static int os_record_timerfd_create(int clockid, int flags);
+static int os_record_created(os_trace_op op, int res);
+static void os_record_append(os_trace_op op, int fd, int64_t result, int err, const void *payload,
+                             size_t payload_len);
+static void os_record_payload(char *dst, const void *payload, size_t len, int events);
+static int os_record_flush(void);
+static int os_record_write_all(const char *data, size_t len);
+
+static int os_replay_epoll_create1(int flags);
+static int os_replay_epoll_ctl(int epfd, int op, int fd, struct epoll_event *ev);
+static int os_replay_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout);
+static int os_replay_close(int fd);
+static int os_replay_socket(int domain, int type, int protocol);
+static int os_replay_bind(int fd, const struct sockaddr *addr, socklen_t addr_len);
+static int os_replay_listen(int fd, int backlog);
+static int os_replay_accept(int fd, struct sockaddr *addr, socklen_t *addr_len);
+static int os_replay_connect(int fd, const struct sockaddr *addr, socklen_t addr_len);
+static int os_replay_getsockopt(int fd, int level, int name, void *val, socklen_t *len);
+static int os_replay_setsockopt(int fd, int level, int name, const void *val, socklen_t len);
+static ssize_t os_replay_recv(int fd, void *buf, size_t len, int flags);
+static ssize_t os_replay_recvmsg(int fd, struct msghdr *msg, int flags);
+static ssize_t os_replay_read(int fd, void *buf, size_t len);
+static ssize_t os_replay_write(int fd, const void *buf, size_t len);
+static ssize_t os_replay_writev(int fd, const struct iovec *iov, int iov_cnt);
+static int os_replay_eventfd(unsigned int initval, int flags);
+static int os_replay_unlink(const char *path);
+static int os_replay_timerfd_create(int clockid, int flags);
+static int os_replay_timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                                     struct itimerspec *old_value);
+static int os_replay_clock_gettime(clockid_t clock, struct timespec *ts);
+static ssize_t os_replay_input(os_trace_op op, int fd, void *buf, size_t len);
+static ssize_t os_replay_output(os_trace_op op, int fd);
+static int os_replay_created(os_trace_op op);
+static const os_trace_entry * os_replay_peek(const char **payload);
+static const os_trace_entry * os_replay_consume(os_trace_op op, int fd, const char **payload);
+
+int os_record_init(os *o, const os *real, int trace_fd, int with_payload)
+{
+  if ( (!o) || (!real) || (!real->write) || (0 > trace_fd) )
+    return -1;
+
+  pthread_mutex_lock(&RECORDER.lock);
+  if (RECORDER.running) {
+    pthread_mutex_unlock(&RECORDER.lock);
+    return -1;
+  }
+
+  RECORDER.buf = (char *) malloc(OS_TRACE_BUF_SIZE);
+  if (!RECORDER.buf) {
+    pthread_mutex_unlock(&RECORDER.lock);
+    return -1;
+  }
+  RECORDER.real = *real;
+  RECORDER.trace_fd = trace_fd;
+  RECORDER.with_payload = with_payload;
+  RECORDER.failed = 0;
+  RECORDER.len = sizeof(OS_TRACE_MAGIC) - 1;
+  memcpy(RECORDER.buf, OS_TRACE_MAGIC, RECORDER.len);
+  RECORDER.running = 1;
+  pthread_mutex_unlock(&RECORDER.lock);
+
+  *o = *real;
+  if (real->epoll_wait)
+    o->epoll_wait = os_record_epoll_wait;
+  if (real->accept)
+    o->accept = os_record_accept;
+  if (real->read)
+    o->read = os_record_read;
+  if (real->recv)
+    o->recv = os_record_recv;
+  o->write = os_record_write;
+  if (real->writev)
+    o->writev = os_record_writev;
+  if (real->epoll_create1)
+    o->epoll_create1 = os_record_epoll_create1;
+  if (real->socket)
+    o->socket = os_record_socket;
+  if (real->eventfd)
+    o->eventfd = os_record_eventfd;
+  if (real->timerfd_create)
+    o->timerfd_create = os_record_timerfd_create;
+
+  return 0;
+}
+
+int os_record_finish(void)
+{
+  pthread_mutex_lock(&RECORDER.lock);
+  if (!RECORDER.running) {
+    pthread_mutex_unlock(&RECORDER.lock);
+    return -1;
+  }
+
+  const int res = ( (0 == os_record_flush()) && (!RECORDER.failed) ) ? 0 : -1;
+  free(RECORDER.buf);
+  RECORDER.buf = 0;
+  RECORDER.running = 0;
+  pthread_mutex_unlock(&RECORDER.lock);
+
+  return res;
+}
+
+int os_replay_init(os *o, int trace_fd)
+{
+  if ( (!o) || (0 > trace_fd) || (REPLAYER.running) )
+    return -1;
+
+  size_t cap = OS_TRACE_BUF_SIZE;
+  size_t len = 0;
+  char *trace = (char *) malloc(cap);
+  for (;;) {
+    if (!trace) {
+      return -1;
+    }
+    const ssize_t res = read(trace_fd, trace + len, cap - len);
+    if (0 > res) {
+      free(trace);
+      return -1;
+    }
+    if (0 == res)
+      break;
+    len += res;
+    if (len == cap) {
+      char *bigger = (char *) realloc(trace, 2 * cap);
+      if (!bigger)
+        free(trace);
+      trace = bigger;
+      cap *= 2;
+    }
+  }
+
+  const size_t magic_len = sizeof(OS_TRACE_MAGIC) - 1;
+  size_t pos = magic_len;
+  while ( (len >= magic_len) && (pos + sizeof(os_trace_entry) <= len) ) {
+    os_trace_entry e;
+    memcpy(&e, trace + pos, sizeof(e));
+    pos += sizeof(e) + e.payload_len;
+  }
+  if ( (len < magic_len) || (0 != memcmp(trace, OS_TRACE_MAGIC, magic_len)) || (pos != len) ) {
+    free(trace);
+    return -1;
+  }
+
+  memset(&REPLAYER, 0, sizeof(REPLAYER));
+  REPLAYER.trace = trace;
+  REPLAYER.len = len;
+  REPLAYER.pos = magic_len;
+  REPLAYER.next_fake_fd = OS_TRACE_FIRST_FAKE_FD;
+  REPLAYER.running = 1;
+
+  memset(o, 0, sizeof(os));
+  o->epoll_create1 = os_replay_epoll_create1;
+  o->epoll_ctl = os_replay_epoll_ctl;
+  o->epoll_wait = os_replay_epoll_wait;
+  o->close = os_replay_close;
+  o->socket = os_replay_socket;
+  o->bind = os_replay_bind;
+  o->listen = os_replay_listen;
+  o->accept = os_replay_accept;
+  o->connect = os_replay_connect;
+  o->getsockopt = os_replay_getsockopt;
+  o->setsockopt = os_replay_setsockopt;
+  o->recv = os_replay_recv;
+  o->recvmsg = os_replay_recvmsg;
+  o->read = os_replay_read;
+  o->write = os_replay_write;
+  o->writev = os_replay_writev;
+  o->eventfd = os_replay_eventfd;
+  o->unlink = os_replay_unlink;
+  o->mmap = mmap;
+  o->munmap = munmap;
+  o->madvise = madvise;
+  o->timerfd_create = os_replay_timerfd_create;
+  o->timerfd_settime = os_replay_timerfd_settime;
+  o->clock_gettime = os_replay_clock_gettime;
+
+  return 0;
+}
+
+long os_replay_finish(void)
+{
+  if (!REPLAYER.running) {
+    return -1;
+  }
+
+  const long diverged = REPLAYER.diverged;
+  free(REPLAYER.trace);
+  memset(&REPLAYER, 0, sizeof(REPLAYER));
+
+  return diverged;
+}
+
+static int os_record_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout)
+{
+  const int res = RECORDER.real.epoll_wait(epfd, evs, max_evs, timeout);
+  const int err = errno;
+  os_record_append(OS_TRACE_EPOLL_WAIT, epfd, res, err, evs, (0 < res) ? res * OS_TRACE_EVENT_SIZE : 0);
+  errno = err;
+
+  return res;
+}
+
+static int os_record_accept(int fd, struct sockaddr *addr, socklen_t *addr_len)
+{
+  const int res = RECORDER.real.accept(fd, addr, addr_len);
+  const int err = errno;
+  os_record_append(OS_TRACE_ACCEPT, fd, res, err, 0, 0);
+  errno = err;
+
+  return res;
+}
+
+static ssize_t os_record_read(int fd, void *buf, size_t len)
+{
+  const ssize_t res = RECORDER.real.read(fd, buf, len);
+  const int err = errno;
+  os_record_append(OS_TRACE_READ, fd, res, err, buf, ( (RECORDER.with_payload) && (0 < res) ) ? res : 0);
+  errno = err;
+
+  return res;
+}
+
+static ssize_t os_record_recv(int fd, void *buf, size_t len, int flags)
+{
+  const ssize_t res = RECORDER.real.recv(fd, buf, len, flags);
+  const int err = errno;
+  os_record_append(OS_TRACE_RECV, fd, res, err, buf, ( (RECORDER.with_payload) && (0 < res) ) ? res : 0);
+  errno = err;
+
+  return res;
+}
+
+static ssize_t os_record_write(int fd, const void *buf, size_t len)
+{
+  const ssize_t res = RECORDER.real.write(fd, buf, len);
+  const int err = errno;
+  os_record_append(OS_TRACE_WRITE, fd, res, err, 0, 0);
+  errno = err;
+
+  return res;
+}
+
+static ssize_t os_record_writev(int fd, const struct iovec *iov, int iov_cnt)
+{
+  const ssize_t res = RECORDER.real.writev(fd, iov, iov_cnt);
+  const int err = errno;
+  os_record_append(OS_TRACE_WRITEV, fd, res, err, 0, 0);
+  errno = err;
+
+  return res;
+}
+
+static int os_record_epoll_create1(int flags)
+{
+  return os_record_created(OS_TRACE_EPOLL_CREATE1, RECORDER.real.epoll_create1(flags));
+}
+
+static int os_record_socket(int domain, int type, int protocol)
+{
+  return os_record_created(OS_TRACE_SOCKET, RECORDER.real.socket(domain, type, protocol));
+}
+
+static int os_record_eventfd(unsigned int initval, int flags)
+{
+  return os_record_created(OS_TRACE_EVENTFD, RECORDER.real.eventfd(initval, flags));
+}
+
+static int os_record_timerfd_create(int clockid, int flags)
+{
+  return os_record_created(OS_TRACE_TIMERFD_CREATE, RECORDER.real.timerfd_create(clockid, flags));
+}
+
+static int os_record_created(os_trace_op op, int res)
+{
+  const int err = errno;
+  os_record_append(op, -1, res, err, 0, 0);
+  errno = err;
+
+  return res;
+}
+
+static void os_record_append(os_trace_op op, int fd, int64_t result, int err, const void *payload,
+                             size_t payload_len)
+{
+  os_trace_entry e;
+  struct timespec ts;
+  memset(&e, 0, sizeof(e));
+  e.op = op;
+  e.fd = fd;
+  e.err = (0 > result) ? err : 0;
+  e.payload_len = payload_len;
+  e.result = result;
+  if ( (RECORDER.real.clock_gettime) && (0 == RECORDER.real.clock_gettime(CLOCK_MONOTONIC, &ts)) )
+    e.time_ns = (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+
+  const int events = (OS_TRACE_EPOLL_WAIT == op);
+  pthread_mutex_lock(&RECORDER.lock);
+  if (RECORDER.running) {
+    if (RECORDER.len + sizeof(e) + payload_len > OS_TRACE_BUF_SIZE)
+      os_record_flush();
+    if (RECORDER.len + sizeof(e) + payload_len <= OS_TRACE_BUF_SIZE) {
+      memcpy(RECORDER.buf + RECORDER.len, &e, sizeof(e));
+      os_record_payload(RECORDER.buf + RECORDER.len + sizeof(e), payload, payload_len, events);
+      RECORDER.len += sizeof(e) + payload_len;
+    }
+    else {
+      /* payload bigger than buffer is serialized into temporary one */
+      char *tmp = (char *) malloc(sizeof(e) + payload_len);
+      if (tmp) {
+        memcpy(tmp, &e, sizeof(e));
+        os_record_payload(tmp + sizeof(e), payload, payload_len, events);
+        if (0 != os_record_write_all(tmp, sizeof(e) + payload_len))
+          RECORDER.failed = 1;
+        free(tmp);
+      }
+      else {
+        RECORDER.failed = 1;
+      }
+    }
+  }
+  pthread_mutex_unlock(&RECORDER.lock);
+}
+
+static void os_record_payload(char *dst, const void *payload, size_t len, int events)
+{
+  if (!events) {
+    memcpy(dst, payload, len);
+    return;
+  }
+
+  const struct epoll_event *evs = (const struct epoll_event *) payload;
+  for (size_t i = 0; i < len / OS_TRACE_EVENT_SIZE; ++i) {
+    const uint32_t ev = evs[i].events;
+    const uint64_t data = evs[i].data.u64;
+    memcpy(dst, &ev, sizeof(ev));
+    memcpy(dst + sizeof(ev), &data, sizeof(data));
+    dst += OS_TRACE_EVENT_SIZE;
+  }
+}
+
+static int os_record_flush(void)
+{
+  if (0 != os_record_write_all(RECORDER.buf, RECORDER.len)) {
+    RECORDER.failed = 1;
+    RECORDER.len = 0;
+    return -1;
+  }
+  RECORDER.len = 0;
+
+  return 0;
+}
+
+static int os_record_write_all(const char *data, size_t len)
+{
+  while (len) {
+    const ssize_t res = RECORDER.real.write(RECORDER.trace_fd, data, len);
+    if (0 > res) {
+      if (EINTR == errno)
+        continue;
+      return -1;
+    }
+    data += res;
+    len -= res;
+  }
+
+  return 0;
+}
+
+static int os_replay_epoll_create1(int flags)
+{
+  return os_replay_created(OS_TRACE_EPOLL_CREATE1);
+}
+
+static int os_replay_epoll_ctl(int epfd, int op, int fd, struct epoll_event *ev)
+{
+  return 0;
+}
+
+static int os_replay_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout)
+{
+  const os_trace_entry *e = 0;
+  const char *payload = 0;
+
+  /* calls which were not replayed by the code under test are skipped */
+  while ( (0 != (e = os_replay_peek(&payload))) && (OS_TRACE_EPOLL_WAIT != e->op) ) {
+    os_replay_consume(e->op, e->fd, 0);
+    ++REPLAYER.diverged;
+  }
+  if (!e) {
+    errno = ESHUTDOWN;
+    return -1;
+  }
+  os_replay_consume(OS_TRACE_EPOLL_WAIT, e->fd, &payload);
+
+  if (0 > e->result) {
+    errno = e->err;
+    return -1;
+  }
+
+  int cnt = (int) e->result;
+  if (cnt > max_evs) {
+    cnt = max_evs;
+    ++REPLAYER.diverged;
+  }
+  for (int i = 0; i < cnt; ++i) {
+    uint32_t ev;
+    uint64_t data;
+    memcpy(&ev, payload + i * OS_TRACE_EVENT_SIZE, sizeof(ev));
+    memcpy(&data, payload + i * OS_TRACE_EVENT_SIZE + sizeof(ev), sizeof(data));
+    evs[i].events = ev;
+    evs[i].data.u64 = data;
+  }
+
+  return cnt;
+}
+
+static int os_replay_close(int fd)
+{
+  return 0;
+}
+
+static int os_replay_socket(int domain, int type, int protocol)
+{
+  return os_replay_created(OS_TRACE_SOCKET);
+}
+
+static int os_replay_bind(int fd, const struct sockaddr *addr, socklen_t addr_len)
+{
+  return 0;
+}
+
+static int os_replay_listen(int fd, int backlog)
+{
+  return 0;
+}
+
+static int os_replay_accept(int fd, struct sockaddr *addr, socklen_t *addr_len)
+{
+  const os_trace_entry *e = os_replay_consume(OS_TRACE_ACCEPT, fd, 0);
+  if (!e) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (addr_len)
+    *addr_len = 0;
+  errno = e->err;
+
+  return (int) e->result;
+}
+
+static int os_replay_connect(int fd, const struct sockaddr *addr, socklen_t addr_len)
+{
+  return 0;
+}
+
+static int os_replay_getsockopt(int fd, int level, int name, void *val, socklen_t *len)
+{
+  if ( (val) && (len) )
+    memset(val, 0, *len);
+
+  return 0;
+}
+
+static int os_replay_setsockopt(int fd, int level, int name, const void *val, socklen_t len)
+{
+  return 0;
+}
+
+static ssize_t os_replay_recv(int fd, void *buf, size_t len, int flags)
+{
+  return os_replay_input(OS_TRACE_RECV, fd, buf, len);
+}
+
+static ssize_t os_replay_recvmsg(int fd, struct msghdr *msg, int flags)
+{
+  errno = EAGAIN;
+
+  return -1;
+}
+
+static ssize_t os_replay_read(int fd, void *buf, size_t len)
+{
+  return os_replay_input(OS_TRACE_READ, fd, buf, len);
+}
+
+static ssize_t os_replay_write(int fd, const void *buf, size_t len)
+{
+  return os_replay_output(OS_TRACE_WRITE, fd);
+}
+
+static ssize_t os_replay_writev(int fd, const struct iovec *iov, int iov_cnt)
+{
+  return os_replay_output(OS_TRACE_WRITEV, fd);
+}
+
+static int os_replay_eventfd(unsigned int initval, int flags)
+{
+  return os_replay_created(OS_TRACE_EVENTFD);
+}
+
+static int os_replay_unlink(const char *path)
+{
+  /* file system is not part of trace, replay must not remove real files */
+  return 0;
+}
+
+static int os_replay_timerfd_create(int clockid, int flags)
+{
+  return os_replay_created(OS_TRACE_TIMERFD_CREATE);
+}
+
+static int os_replay_timerfd_settime(int fd, int flags, const struct itimerspec *new_value,
+                                     struct itimerspec *old_value)
+{
+  if (old_value)
+    memset(old_value, 0, sizeof(struct itimerspec));
+
+  return 0;
+}
+
+static int os_replay_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  ts->tv_sec = REPLAYER.now_ns / 1000000000ULL;
+  ts->tv_nsec = REPLAYER.now_ns % 1000000000ULL;
+
+  return 0;
+}
+
+static ssize_t os_replay_input(os_trace_op op, int fd, void *buf, size_t len)
+{
+  const char *payload = 0;
+  const os_trace_entry *e = os_replay_consume(op, fd, &payload);
+  if (!e) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  if (0 > e->result) {
+    errno = e->err;
+    return -1;
+  }
+
+  size_t res = (size_t) e->result;
+  if (res > len) {
+    res = len;
+    ++REPLAYER.diverged;
+  }
+  if (e->payload_len)
+    memcpy(buf, payload, (res < e->payload_len) ? res : e->payload_len);
+  else
+    memset(buf, 0, res);
+
+  return res;
+}
+
+static ssize_t os_replay_output(os_trace_op op, int fd)
+{
+  const os_trace_entry *e = os_replay_consume(op, fd, 0);
+  if (!e) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  errno = e->err;
+
+  return (0 > e->result) ? -1 : e->result;
+}
+
+static int os_replay_created(os_trace_op op)
+{
+  /* recorded descriptor is returned, so recorded events reach the same handlers */
+  const os_trace_entry *e = os_replay_consume(op, -1, 0);
+  if (!e) {
+    return REPLAYER.next_fake_fd++;
+  }
+
+  errno = e->err;
+
+  return (int) e->result;
+}
+
+static const os_trace_entry * os_replay_peek(const char **payload)
+{
+  static os_trace_entry e;
+
+  if (REPLAYER.pos + sizeof(os_trace_entry) > REPLAYER.len) {
+    return 0;
+  }
+
+  memcpy(&e, REPLAYER.trace + REPLAYER.pos, sizeof(e));
+  if (payload)
+    *payload = REPLAYER.trace + REPLAYER.pos + sizeof(e);
+
+  return &e;
+}
+
+static const os_trace_entry * os_replay_consume(os_trace_op op, int fd, const char **payload)
+{
+  const os_trace_entry *e = os_replay_peek(payload);
+
+  if ( (!e) || (op != e->op) || ( (OS_TRACE_EPOLL_WAIT != op) && (fd != e->fd) ) ) {
+    if (OS_TRACE_EPOLL_WAIT != op)
+      ++REPLAYER.diverged;
+    return 0;
+  }
+
+  REPLAYER.pos += sizeof(os_trace_entry) + e->payload_len;
+  REPLAYER.now_ns = e->time_ns;
+
+  return e;
+}
@@ -1,5 +1,15 @@
 #include "reactor/os.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+
+static long os_linux_mbind(void *addr, unsigned long len, int mode, const unsigned long *nodemask,
+                           unsigned long maxnode, unsigned int flags);
+static int os_linux_getcpu(unsigned int *cpu, unsigned int *node);
 
 void os_linux_init(os *o)
 {
@@ -12,8 +22,40 @@ void os_linux_init(os *o)
     o->bind = bind;
     o->listen = listen;
     o->accept = accept;
+    o->connect = connect;
+    o->getsockopt = getsockopt;
+    o->setsockopt = setsockopt;
+    o->recv = recv;
+    o->recvmsg = recvmsg;
+    o->sendmsg = sendmsg;
     o->read = read;
     o->write = write;
+    o->writev = writev;
+    o->sendfile = sendfile;
+    o->open = open;
+    o->fstat = fstat;
+    o->unlink = unlink;
+    o->pread = pread;
+    o->eventfd = eventfd;
+    o->mmap = mmap;
+    o->munmap = munmap;
+    o->madvise = madvise;
+    o->mbind = os_linux_mbind;
+    o->getcpu = os_linux_getcpu;
+    o->timerfd_create = timerfd_create;
+    o->timerfd_settime = timerfd_settime;
+    o->clock_gettime = clock_gettime;
   }
 }
 
+/* glibc wraps neither of them (mbind lives in libnuma), so the raw system calls are used */
+static long os_linux_mbind(void *addr, unsigned long len, int mode, const unsigned long *nodemask,
+                           unsigned long maxnode, unsigned int flags)
+{
+  return syscall(SYS_mbind, addr, len, mode, nodemask, maxnode, flags);
+}
+
+static int os_linux_getcpu(unsigned int *cpu, unsigned int *node)
+{
+  return (int) syscall(SYS_getcpu, cpu, node, 0);
+}
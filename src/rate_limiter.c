@@ -0,0 +1,329 @@
+#include "reactor/rate_limiter.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+
+/* tokens are kept in token-nanoseconds, so refill of any elapsed time is exact */
+#define NS_PER_SEC 1000000000ULL
+/* bigger rate or burst would overflow tokens, i.e. it is about 9.2 GB/s */
+#define RATE_MAX ((uint64_t) INT64_MAX / NS_PER_SEC)
+/* throttled handler waits for this part of second worth of tokens, i.e. it is resumed at most 100 times per second */
+#define RESUME_DIVISOR 100
+
+struct rate_limiter_ctx_s {
+  reactor *r;
+  const os *o;
+  event_handler timer_eh;
+  uint64_t armed_ns;
+  rate_bucket *throttled;
+  rate_limiter_stats stats;
+};
+
+static void rate_limiter_terminate(rate_limiter *self);
+static void rate_limiter_free(rate_limiter *self);
+static int rate_limiter_attach(rate_limiter *self, rate_bucket *b, const event_handler *eh, const rate_limit_config *cfg);
+static void rate_limiter_detach(rate_limiter *self, rate_bucket *b);
+static size_t rate_limiter_budget(rate_limiter *self, rate_bucket *b, size_t want);
+static int rate_limiter_charge(rate_limiter *self, rate_bucket *b, size_t bytes, size_t msgs);
+static int rate_limiter_get_stats(rate_limiter *self, rate_limiter_stats *stats);
+static void rate_limiter_handle_timer(event_handler *self, uint32_t events);
+static void rate_limiter_throttle(rate_limiter_ctx *ctx, rate_bucket *b, uint64_t now_ns);
+static void rate_limiter_resume(rate_limiter_ctx *ctx, rate_bucket *b);
+static void rate_limiter_arm(rate_limiter_ctx *ctx, uint64_t at_ns);
+static void rate_refill(rate_bucket *b, uint64_t now_ns);
+static void rate_refill_tokens(int64_t *tokens, uint64_t rate, uint64_t burst, uint64_t elapsed_ns);
+static void rate_take_tokens(int64_t *tokens, size_t cnt);
+static uint64_t rate_wait_ns(int64_t tokens, uint64_t rate, uint64_t burst);
+
+int rate_limiter_init(rate_limiter *rl, reactor *r, const os *o)
+{
+  if ( (!rl) || (!r) || (!o) || (!o->read) || (!o->close) || (!o->timerfd_create) ||
+       (!o->timerfd_settime) )
+    return -1;
+
+  rate_limiter_ctx *ctx = (rate_limiter_ctx *) malloc(sizeof(rate_limiter_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(rate_limiter_ctx));
+  ctx->r = r;
+  ctx->o = o;
+  ctx->timer_eh.ctx = ctx;
+  ctx->timer_eh.handle_event = rate_limiter_handle_timer;
+  ctx->timer_eh.fd = o->timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if ( (ctx->timer_eh.fd < 0) || (0 != r->register_eh(r, &ctx->timer_eh)) ) {
+    if (0 <= ctx->timer_eh.fd)
+      o->close(ctx->timer_eh.fd);
+    free(ctx);
+    return -1;
+  }
+
+  memset(rl, 0, sizeof(rate_limiter));
+  rl->ctx = ctx;
+  rl->attach = rate_limiter_attach;
+  rl->detach = rate_limiter_detach;
+  rl->budget = rate_limiter_budget;
+  rl->charge = rate_limiter_charge;
+  rl->get_stats = rate_limiter_get_stats;
+  rl->destroy = rate_limiter_terminate;
+
+  return 0;
+}
+
+rate_limiter * rate_limiter_alloc(reactor *r, const os *o)
+{
+  rate_limiter *res = (rate_limiter *) malloc(sizeof(rate_limiter));
+  if (res) {
+    if (0 != rate_limiter_init(res, r, o)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = rate_limiter_free;
+  }
+
+  return res;
+}
+
+static void rate_limiter_terminate(rate_limiter *self)
+{
+  if (self && self->ctx) {
+    rate_limiter_ctx *ctx = self->ctx;
+    while (ctx->throttled)
+      rate_limiter_resume(ctx, ctx->throttled);
+    ctx->r->unregister_eh(ctx->r, &ctx->timer_eh);
+    ctx->o->close(ctx->timer_eh.fd);
+    free(ctx);
+    self->ctx = 0;
+  }
+}
+
+static void rate_limiter_free(rate_limiter *self)
+{
+  if (self) {
+    rate_limiter_terminate(self);
+    free(self);
+  }
+}
+
+static int rate_limiter_attach(rate_limiter *self, rate_bucket *b, const event_handler *eh, const rate_limit_config *cfg)
+{
+  if ( (!self) || (!self->ctx) || (!b) || (!eh) || (!cfg) || ( (!cfg->bytes_per_sec) && (!cfg->msgs_per_sec) ) ) {
+    return -1;
+  }
+
+  memset(b, 0, sizeof(rate_bucket));
+  b->eh = eh;
+  b->cfg = *cfg;
+  if (!b->cfg.bytes_burst)
+    b->cfg.bytes_burst = b->cfg.bytes_per_sec;
+  if (!b->cfg.msgs_burst)
+    b->cfg.msgs_burst = b->cfg.msgs_per_sec;
+  if ( (b->cfg.bytes_per_sec > RATE_MAX) || (b->cfg.bytes_burst > RATE_MAX) ||
+       (b->cfg.msgs_per_sec > RATE_MAX) || (b->cfg.msgs_burst > RATE_MAX) ) {
+    b->eh = 0;
+    return -1;
+  }
+  b->bytes = (int64_t) (b->cfg.bytes_burst * NS_PER_SEC);
+  b->msgs = (int64_t) (b->cfg.msgs_burst * NS_PER_SEC);
+  b->last_ns = self->ctx->r->now_ns(self->ctx->r);
+
+  return 0;
+}
+
+static void rate_limiter_detach(rate_limiter *self, rate_bucket *b)
+{
+  if ( (!self) || (!self->ctx) || (!b) ) {
+    return;
+  }
+
+  if (b->resume_ns)
+    rate_limiter_resume(self->ctx, b);
+  b->eh = 0;
+}
+
+static size_t rate_limiter_budget(rate_limiter *self, rate_bucket *b, size_t want)
+{
+  if ( (!self) || (!self->ctx) || (!b) || (!b->eh) ) {
+    return want;
+  }
+
+  if (b->resume_ns) {
+    return 0;
+  }
+
+  rate_refill(b, self->ctx->r->now_ns(self->ctx->r));
+  if ( (b->cfg.bytes_per_sec) && ((uint64_t) b->bytes / NS_PER_SEC < want) ) {
+    /* bucket of not throttled handler is never empty, so at least one byte is allowed */
+    const size_t allowed = (size_t) ((uint64_t) b->bytes / NS_PER_SEC);
+    return (allowed) ? allowed : 1;
+  }
+
+  return want;
+}
+
+static int rate_limiter_charge(rate_limiter *self, rate_bucket *b, size_t bytes, size_t msgs)
+{
+  if ( (!self) || (!self->ctx) || (!b) || (!b->eh) ) {
+    return 1;
+  }
+
+  const uint64_t now_ns = self->ctx->r->now_ns(self->ctx->r);
+  rate_refill(b, now_ns);
+  if (b->cfg.bytes_per_sec)
+    rate_take_tokens(&b->bytes, bytes);
+  if (b->cfg.msgs_per_sec)
+    rate_take_tokens(&b->msgs, msgs);
+
+  if ( ( (b->cfg.bytes_per_sec) && (b->bytes <= 0) ) || ( (b->cfg.msgs_per_sec) && (b->msgs <= 0) ) ) {
+    if (!b->resume_ns)
+      rate_limiter_throttle(self->ctx, b, now_ns);
+    return 0;
+  }
+
+  return (b->resume_ns) ? 0 : 1;
+}
+
+static int rate_limiter_get_stats(rate_limiter *self, rate_limiter_stats *stats)
+{
+  if ( (!self) || (!self->ctx) || (!stats) ) {
+    return -1;
+  }
+
+  *stats = self->ctx->stats;
+
+  return 0;
+}
+
+static void rate_limiter_handle_timer(event_handler *self, uint32_t events)
+{
+  rate_limiter_ctx *ctx = (rate_limiter_ctx *) self->ctx;
+  uint64_t expirations = 0;
+  ctx->o->read(self->fd, &expirations, sizeof(expirations));
+  ctx->armed_ns = 0;
+
+  const uint64_t now_ns = ctx->r->now_ns(ctx->r);
+  uint64_t next_ns = 0;
+  rate_bucket *b = ctx->throttled;
+  while (b) {
+    rate_bucket *next = b->next;
+    if (b->resume_ns <= now_ns) {
+      rate_refill(b, now_ns);
+      rate_limiter_resume(ctx, b);
+    }
+    else if ( (!next_ns) || (b->resume_ns < next_ns) ) {
+      next_ns = b->resume_ns;
+    }
+    b = next;
+  }
+
+  if (next_ns)
+    rate_limiter_arm(ctx, next_ns);
+}
+
+static void rate_limiter_throttle(rate_limiter_ctx *ctx, rate_bucket *b, uint64_t now_ns)
+{
+  uint64_t wait_ns = rate_wait_ns(b->bytes, b->cfg.bytes_per_sec, b->cfg.bytes_burst);
+  const uint64_t msgs_wait_ns = rate_wait_ns(b->msgs, b->cfg.msgs_per_sec, b->cfg.msgs_burst);
+  if (wait_ns < msgs_wait_ns)
+    wait_ns = msgs_wait_ns;
+
+  uint32_t events = 0;
+  if (0 == ctx->r->get_interest(ctx->r, b->eh, &events))
+    ctx->r->modify_eh(ctx->r, b->eh, events & ~EPOLLIN);
+  b->resume_ns = now_ns + ((wait_ns) ? wait_ns : 1);
+  b->prev = 0;
+  b->next = ctx->throttled;
+  if (ctx->throttled)
+    ctx->throttled->prev = b;
+  ctx->throttled = b;
+  ++ctx->stats.throttled;
+  ++ctx->stats.throttles;
+
+  if ( (!ctx->armed_ns) || (b->resume_ns < ctx->armed_ns) )
+    rate_limiter_arm(ctx, b->resume_ns);
+}
+
+static void rate_limiter_resume(rate_limiter_ctx *ctx, rate_bucket *b)
+{
+  if (b->prev)
+    b->prev->next = b->next;
+  else
+    ctx->throttled = b->next;
+  if (b->next)
+    b->next->prev = b->prev;
+  b->prev = 0;
+  b->next = 0;
+  b->resume_ns = 0;
+  --ctx->stats.throttled;
+
+  /* handler could be unregistered meanwhile, then there is nothing to restore */
+  uint32_t events = 0;
+  if (0 == ctx->r->get_interest(ctx->r, b->eh, &events))
+    ctx->r->modify_eh(ctx->r, b->eh, events | EPOLLIN);
+}
+
+static void rate_limiter_arm(rate_limiter_ctx *ctx, uint64_t at_ns)
+{
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = at_ns / NS_PER_SEC;
+  its.it_value.tv_nsec = at_ns % NS_PER_SEC;
+  if (0 == ctx->o->timerfd_settime(ctx->timer_eh.fd, TFD_TIMER_ABSTIME, &its, 0))
+    ctx->armed_ns = at_ns;
+}
+
+static void rate_refill(rate_bucket *b, uint64_t now_ns)
+{
+  if (now_ns <= b->last_ns) {
+    return;
+  }
+
+  const uint64_t elapsed_ns = now_ns - b->last_ns;
+  rate_refill_tokens(&b->bytes, b->cfg.bytes_per_sec, b->cfg.bytes_burst, elapsed_ns);
+  rate_refill_tokens(&b->msgs, b->cfg.msgs_per_sec, b->cfg.msgs_burst, elapsed_ns);
+  b->last_ns = now_ns;
+}
+
+static void rate_refill_tokens(int64_t *tokens, uint64_t rate, uint64_t burst, uint64_t elapsed_ns)
+{
+  if (!rate) {
+    return;
+  }
+
+  const int64_t full = (int64_t) (burst * NS_PER_SEC);
+  const uint64_t missing = (uint64_t) full - (uint64_t) *tokens;
+  if (elapsed_ns > missing / rate)
+    *tokens = full;
+  else
+    *tokens += (int64_t) (elapsed_ns * rate);
+}
+
+static uint64_t rate_wait_ns(int64_t tokens, uint64_t rate, uint64_t burst)
+{
+  if (!rate) {
+    return 0;
+  }
+
+  uint64_t resume = rate * NS_PER_SEC / RESUME_DIVISOR;
+  if (resume > burst * NS_PER_SEC)
+    resume = burst * NS_PER_SEC;
+  if (resume < NS_PER_SEC)
+    resume = NS_PER_SEC;
+  if (tokens >= (int64_t) resume) {
+    return 0;
+  }
+
+  return (resume - (uint64_t) tokens + rate - 1) / rate;
+}
+
+static void rate_take_tokens(int64_t *tokens, size_t cnt)
+{
+  /* debt is capped by the same limit as burst, so refill arithmetic never overflows */
+  const int64_t floor = -(int64_t) (RATE_MAX * NS_PER_SEC);
+  const uint64_t cost = ((uint64_t) cnt < RATE_MAX) ? (uint64_t) cnt * NS_PER_SEC : RATE_MAX * NS_PER_SEC;
+  if ((uint64_t) *tokens - (uint64_t) floor < cost)
+    *tokens = floor;
+  else
+    *tokens -= (int64_t) cost;
+}
@@ -1,27 +1,131 @@
 #include "reactor/reactor.h"
+#include "reactor/tracer.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 
 typedef struct event_handler_node_s {
   event_handler *eh;
-  struct event_handler_node_s *next;
+  int fd;
+  uint32_t events;
+  unsigned long window_events;
+  reactor_eh_stats stats;
+  struct event_handler_node_s *next_by_eh;
 } event_handler_node;
 
+typedef struct task_node_s {
+  reactor_task task;
+  reactor_task cleanup;
+  void *arg;
+  struct task_node_s *next;
+} task_node;
+
+typedef struct hook_node_s {
+  reactor_hook hook;
+  void *arg;
+  int removed;
+  struct hook_node_s *next;
+} hook_node;
+
+typedef struct flush_entry_s {
+  event_handler *eh;
+  void (*flush)(event_handler *e);
+  int fd;
+  int corked;
+} flush_entry;
+
+typedef struct migration_s {
+  event_handler *eh;
+  reactor *origin;
+  uint32_t events;
+  unsigned long window_events;
+  reactor_eh_stats stats;
+} migration;
+
 struct reactor_ctx_s {
   int epoll_fd;
+  int wake_fd;
   const os *o;
-  event_handler_node *root;
+  event_handler_node **fds;
+  size_t fds_cap;
+  event_handler_node **by_eh;
+  size_t by_eh_bits;
   int run;
+  pthread_mutex_t tasks_lock;
+  task_node *tasks_head;
+  task_node *tasks_tail;
+  atomic_int tasks_pending;
+  atomic_ulong events;
+  atomic_ulong full_batches;
+  atomic_ulong handlers;
+  hook_node *hooks[REACTOR_PHASE_CHECK + 1];
+  int running_hooks;
+  flush_entry *flushes;
+  size_t flushes_cnt;
+  size_t flushes_cap;
+  uint32_t accounting;
+  pthread_t thread;
+  atomic_int running;
+  atomic_uint_fast64_t busy_since_ns;
+  uint64_t batch_ns;
+  _Atomic(const event_handler *) current_eh;
+  atomic_int current_fd;
+  tracer *tracer;
 };
 
 static void reactor_terminate(reactor *self);
 static void reactor_free(reactor *self);
 static int reactor_register_eh(reactor *self, event_handler *e);
 static int reactor_unregister_eh(reactor *self, const event_handler *e);
+static int reactor_register_many(reactor *self, event_handler * const *ehs, size_t cnt);
+static int reactor_unregister_many(reactor *self, const event_handler * const *ehs, size_t cnt);
+static int reactor_modify_eh(reactor *self, const event_handler *e, uint32_t events);
+static int reactor_get_interest(reactor *self, const event_handler *e, uint32_t *events);
 static void reactor_event_loop(reactor *self);
 static void reactor_stop(reactor *self);
-static int reactor_validateDuplicate(event_handler_node *root, const event_handler *eh);
-static event_handler_node * reactor_find_eh(event_handler_node *root, const int fd);
+static int reactor_post(reactor *self, reactor_task task, void *arg);
+static int reactor_post_with_cleanup(reactor *self, reactor_task task, reactor_task cleanup, void *arg);
+static int reactor_migrate_eh(reactor *self, event_handler *e, reactor *target);
+static int reactor_shed_load(reactor *self, reactor *target, double share, unsigned int max_cnt,
+                             int (*can_migrate)(const event_handler *e));
+static int reactor_get_load(reactor *self, reactor_load *load);
+static int reactor_add_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg);
+static int reactor_remove_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg);
+static int reactor_defer_flush(reactor *self, event_handler *e, void (*flush)(event_handler *e));
+static void reactor_run_hooks(reactor *self, reactor_phase phase);
+static void reactor_purge_hooks(reactor *self, reactor_phase phase, int all);
+static void reactor_run_flushes(reactor *self);
+static void reactor_drop_flush(reactor *self, const event_handler *e);
+static void reactor_drop_orphan_flushes(reactor *self);
+static int reactor_cork(reactor *self, int fd, int on);
+static int reactor_is_registered(reactor *self, const event_handler *e);
+static int reactor_set_accounting(reactor *self, uint32_t flags);
+static int reactor_get_eh_stats(reactor *self, const event_handler *e, reactor_eh_stats *stats);
+static int reactor_get_activity(reactor *self, reactor_activity *activity);
+static int reactor_set_tracer(reactor *self, tracer *t);
+static uint64_t reactor_cached_now_ns(reactor *self);
+static void reactor_dispatch(reactor *self, event_handler_node *ehn, uint32_t events);
+static uint64_t reactor_now_ns(reactor *self, clockid_t clock);
+static void reactor_run_tasks(reactor *self);
+static void reactor_drop_tasks(reactor *self);
+static void reactor_adopt_eh(reactor *self, void *arg);
+static void reactor_drop_eh(reactor *self, void *arg);
+static void reactor_return_eh(reactor *self, migration *m);
+static int reactor_compare_activity(const void *a, const void *b);
+static int reactor_validateDuplicate(reactor_ctx *ctx, const event_handler *eh);
+static int reactor_reserve_eh(reactor_ctx *ctx, const int max_fd, size_t cnt);
+static int reactor_add_eh(reactor_ctx *ctx, event_handler *eh, uint32_t events);
+static int reactor_restore_eh(reactor *self, const migration *m);
+static void reactor_index_eh(reactor_ctx *ctx, event_handler_node *ehn);
+static void reactor_unindex_eh(reactor_ctx *ctx, event_handler_node *ehn);
+static size_t reactor_hash_eh(const event_handler *eh, size_t bits);
+static event_handler_node * reactor_find_node(reactor_ctx *ctx, const event_handler *eh);
+static event_handler_node * reactor_find_eh(reactor_ctx *ctx, const int fd);
 
 int reactor_init(reactor *r, const os *o)
 {
@@ -39,14 +143,53 @@ int reactor_init(reactor *r, const os *o)
 
   ctx->o = o;
   ctx->epoll_fd = epoll_fd;
+  ctx->wake_fd = -1;
+  pthread_mutex_init(&ctx->tasks_lock, 0);
+  atomic_init(&ctx->tasks_pending, 0);
+  atomic_init(&ctx->events, 0);
+  atomic_init(&ctx->full_batches, 0);
+  atomic_init(&ctx->handlers, 0);
+  atomic_init(&ctx->running, 0);
+  atomic_init(&ctx->busy_since_ns, 0);
+  atomic_init(&ctx->current_eh, 0);
+  atomic_init(&ctx->current_fd, -1);
 
   r->ctx = ctx;
   r->register_eh = reactor_register_eh;
   r->unregister_eh = reactor_unregister_eh;
+  r->register_many = reactor_register_many;
+  r->unregister_many = reactor_unregister_many;
+  r->modify_eh = reactor_modify_eh;
+  r->get_interest = reactor_get_interest;
   r->event_loop = reactor_event_loop;
   r->stop = reactor_stop;
+  r->post = reactor_post;
+  r->post_with_cleanup = reactor_post_with_cleanup;
+  r->migrate_eh = reactor_migrate_eh;
+  r->shed_load = reactor_shed_load;
+  r->get_load = reactor_get_load;
+  r->add_hook = reactor_add_hook;
+  r->remove_hook = reactor_remove_hook;
+  r->defer_flush = reactor_defer_flush;
+  r->set_accounting = reactor_set_accounting;
+  r->get_eh_stats = reactor_get_eh_stats;
+  r->get_activity = reactor_get_activity;
+  r->set_tracer = reactor_set_tracer;
+  r->now_ns = reactor_cached_now_ns;
   r->destroy = reactor_terminate;
 
+  if (o->eventfd) {
+    struct epoll_event ee;
+    memset(&ee, 0, sizeof(ee));
+    ctx->wake_fd = o->eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ee.data.fd = ctx->wake_fd;
+    ee.events = 0 | EPOLLIN;
+    if ( (ctx->wake_fd < 0) || (0 != o->epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ctx->wake_fd, &ee)) ) {
+      reactor_terminate(r);
+      return -1;
+    }
+  }
+
   return 0;
 }
 
@@ -66,10 +209,19 @@ reactor * reactor_alloc(const os *o)
 static void reactor_terminate(reactor *self)
 {
   if (self && self->ctx && self->ctx->o) {
-    while (self->ctx->root) {
-      reactor_unregister_eh(self, self->ctx->root->eh);
-    }
+    /* closing of epoll drops all registrations at once, so nodes are just freed */
     self->ctx->o->close(self->ctx->epoll_fd);
+    for (size_t fd = 0; fd < self->ctx->fds_cap; ++fd)
+      free(self->ctx->fds[fd]);
+    free(self->ctx->fds);
+    free(self->ctx->by_eh);
+    reactor_drop_tasks(self);
+    reactor_purge_hooks(self, REACTOR_PHASE_PREPARE, 1);
+    reactor_purge_hooks(self, REACTOR_PHASE_CHECK, 1);
+    free(self->ctx->flushes);
+    if (0 <= self->ctx->wake_fd)
+      self->ctx->o->close(self->ctx->wake_fd);
+    pthread_mutex_destroy(&self->ctx->tasks_lock);
     free(self->ctx);
     self->ctx = 0;
   }
@@ -90,29 +242,15 @@ static int reactor_register_eh(reactor *self, event_handler *eh)
     return -1;
   }
 
-  if (0 != reactor_validateDuplicate(self->ctx->root, eh)) {
+  if (0 != reactor_validateDuplicate(self->ctx, eh)) {
       return -1;
   }
 
-  const int epoll_fd = self->ctx->epoll_fd;
-  const int fd = eh->fd;
-
-  struct epoll_event ee;
-  memset(&ee, 0, sizeof(ee));
-  ee.data.fd = fd;
-  ee.events = 0 | EPOLLIN;
-
-  int res = self->ctx->o->epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ee);
-
-  if (0 == res) {
-    event_handler_node *new_root = (event_handler_node*) malloc(sizeof (event_handler_node));
-    memset(new_root, 0, sizeof(event_handler_node));
-    new_root->eh = eh;
-    new_root->next = self->ctx->root;
-    self->ctx->root = new_root;
+  if (0 != reactor_reserve_eh(self->ctx, eh->fd, 1)) {
+    return -1;
   }
 
-  return res;
+  return reactor_add_eh(self->ctx, eh, EPOLLIN);
 }
 
 static int reactor_unregister_eh(reactor *self, const event_handler *eh)
@@ -122,28 +260,130 @@ static int reactor_unregister_eh(reactor *self, const event_handler *eh)
   }
 
   const int epoll_fd = self->ctx->epoll_fd;
-  const int fd = eh->fd;
-
-  event_handler_node *prev = 0;
-  event_handler_node *curr = self->ctx->root;
-  for (; 0 != curr; prev = curr, curr = curr->next)
-    if ( eh == curr->eh )
-      break;
+  event_handler_node *curr = reactor_find_node(self->ctx, eh);
 
   int res = -1;
   if (curr) {
-    if (curr == self->ctx->root)
-      self->ctx->root = curr->next;
-    else
-      prev->next = curr->next;
-
+    const int fd = curr->fd;
+    reactor_drop_flush(self, eh);
+    reactor_unindex_eh(self->ctx, curr);
     free(curr);
+    atomic_fetch_sub_explicit(&self->ctx->handlers, 1, memory_order_relaxed);
     res = self->ctx->o->epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, 0);
   }
 
   return res;
 }
 
+static int reactor_register_many(reactor *self, event_handler * const *ehs, size_t cnt)
+{
+  if ( (!self) || (!self->ctx) || ( (cnt) && (!ehs) ) ) {
+    return -1;
+  }
+  if (0 == cnt) {
+    return 0;
+  }
+
+  int max_fd = -1;
+  for (size_t i = 0; i < cnt; ++i) {
+    if ( (!ehs[i]) || (0 != reactor_validateDuplicate(self->ctx, ehs[i])) ) {
+      return -1;
+    }
+    if (max_fd < ehs[i]->fd)
+      max_fd = ehs[i]->fd;
+  }
+
+  if (0 != reactor_reserve_eh(self->ctx, max_fd, cnt)) {
+    return -1;
+  }
+
+  size_t added = 0;
+  /* duplicates within the batch are found here, because earlier ones are indexed already */
+  while ( (added < cnt) && (0 == reactor_validateDuplicate(self->ctx, ehs[added])) &&
+          (0 == reactor_add_eh(self->ctx, ehs[added], EPOLLIN)) )
+    ++added;
+
+  if (added == cnt) {
+    return 0;
+  }
+
+  while (added)
+    reactor_unregister_eh(self, ehs[--added]);
+
+  return -1;
+}
+
+static int reactor_unregister_many(reactor *self, const event_handler * const *ehs, size_t cnt)
+{
+  if ( (!self) || (!self->ctx) || ( (cnt) && (!ehs) ) ) {
+    return -1;
+  }
+
+  reactor_ctx *ctx = self->ctx;
+  int res = 0;
+  unsigned long removed = 0;
+  for (size_t i = 0; i < cnt; ++i) {
+    event_handler_node *curr = (ehs[i]) ? reactor_find_node(ctx, ehs[i]) : 0;
+    if (!curr) {
+      res = -1;
+      continue;
+    }
+    const int fd = curr->fd;
+    reactor_unindex_eh(ctx, curr);
+    free(curr);
+    ++removed;
+    if (0 != ctx->o->epoll_ctl(ctx->epoll_fd, EPOLL_CTL_DEL, fd, 0))
+      res = -1;
+  }
+
+  if (removed) {
+    atomic_fetch_sub_explicit(&ctx->handlers, removed, memory_order_relaxed);
+    reactor_drop_orphan_flushes(self);
+  }
+
+  return res;
+}
+
+static int reactor_modify_eh(reactor *self, const event_handler *eh, uint32_t events)
+{
+  if ( (!self) || (!self->ctx) || (!eh) ) {
+    return -1;
+  }
+
+  event_handler_node *ehn = reactor_find_eh(self->ctx, eh->fd);
+  if ( (!ehn) || (eh != ehn->eh) ) {
+    return -1;
+  }
+
+  struct epoll_event ee;
+  memset(&ee, 0, sizeof(ee));
+  ee.data.fd = eh->fd;
+  ee.events = events;
+
+  if (0 != self->ctx->o->epoll_ctl(self->ctx->epoll_fd, EPOLL_CTL_MOD, eh->fd, &ee)) {
+    return -1;
+  }
+  ehn->events = events;
+
+  return 0;
+}
+
+static int reactor_get_interest(reactor *self, const event_handler *eh, uint32_t *events)
+{
+  if ( (!self) || (!self->ctx) || (!eh) || (!events) ) {
+    return -1;
+  }
+
+  event_handler_node *ehn = reactor_find_eh(self->ctx, eh->fd);
+  if ( (!ehn) || (eh != ehn->eh) ) {
+    return -1;
+  }
+
+  *events = ehn->events;
+
+  return 0;
+}
+
 static void reactor_event_loop(reactor *self)
 {
   if ( (!self) || (!self->ctx) || (!self->ctx->o) ) {
@@ -151,24 +391,47 @@ static void reactor_event_loop(reactor *self)
   }
 
   const int epoll_fd = self->ctx->epoll_fd;
+  const int wake_fd = self->ctx->wake_fd;
   const int wait_timeout_ms = 250;
   const int max_events = 10;
   struct epoll_event evs[max_events];
   self->ctx->run = 1;
+  self->ctx->thread = pthread_self();
+  atomic_store_explicit(&self->ctx->running, 1, memory_order_release);
   while (self->ctx->run) {
+    reactor_run_hooks(self, REACTOR_PHASE_PREPARE);
     const int events_cnt = self->ctx->o->epoll_wait(epoll_fd, evs, max_events, wait_timeout_ms);
     if (events_cnt < 0) {
-      return;
+      break;
     }
     else {
+      self->ctx->batch_ns = reactor_now_ns(self, CLOCK_MONOTONIC);
+      atomic_store_explicit(&self->ctx->busy_since_ns, self->ctx->batch_ns, memory_order_relaxed);
+      unsigned long dispatched = 0;
       for (int i = 0; i < events_cnt; ++i) {
         const int fd = evs[i].data.fd;
-        event_handler_node* ehn = reactor_find_eh(self->ctx->root, fd);
-        if (ehn)
-          ehn->eh->handle_event(ehn->eh, evs[i].events);
+        if (fd == wake_fd) {
+          uint64_t cnt = 0;
+          self->ctx->o->read(wake_fd, &cnt, sizeof(cnt));
+          continue;
+        }
+        event_handler_node* ehn = reactor_find_eh(self->ctx, fd);
+        if (ehn) {
+          ++dispatched;
+          reactor_dispatch(self, ehn, evs[i].events);
+        }
       }
+      atomic_fetch_add_explicit(&self->ctx->events, dispatched, memory_order_relaxed);
+      if (max_events == events_cnt)
+        atomic_fetch_add_explicit(&self->ctx->full_batches, 1, memory_order_relaxed);
+      reactor_run_flushes(self);
+      reactor_run_hooks(self, REACTOR_PHASE_CHECK);
+      reactor_run_tasks(self);
+      atomic_store_explicit(&self->ctx->busy_since_ns, 0, memory_order_relaxed);
+      self->ctx->batch_ns = 0;
     }
   }
+  atomic_store_explicit(&self->ctx->running, 0, memory_order_release);
 }
 
 static void reactor_stop(reactor *self)
@@ -180,30 +443,659 @@ static void reactor_stop(reactor *self)
   self->ctx->run = 0;
 }
 
-static int reactor_validateDuplicate(event_handler_node *root, const event_handler *eh)
+static int reactor_post(reactor *self, reactor_task task, void *arg)
 {
-  int res = 0;
-  for (event_handler_node *curr = root; 0 != curr; curr = curr->next) {
-    if ( ( (eh) && (curr->eh) && (eh->fd == curr->eh->fd) ) || (eh == curr->eh) ) {
-      res = -1;
-      break;
+  return reactor_post_with_cleanup(self, task, 0, arg);
+}
+
+static int reactor_post_with_cleanup(reactor *self, reactor_task task, reactor_task cleanup, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!task) ) {
+    return -1;
+  }
+
+  task_node *tn = (task_node *) malloc(sizeof(task_node));
+  if (!tn) {
+    return -1;
+  }
+  memset(tn, 0, sizeof(task_node));
+  tn->task = task;
+  tn->cleanup = cleanup;
+  tn->arg = arg;
+
+  pthread_mutex_lock(&self->ctx->tasks_lock);
+  const int was_empty = (0 == self->ctx->tasks_head);
+  if (was_empty)
+    self->ctx->tasks_head = tn;
+  else
+    self->ctx->tasks_tail->next = tn;
+  self->ctx->tasks_tail = tn;
+  atomic_store_explicit(&self->ctx->tasks_pending, 1, memory_order_release);
+  pthread_mutex_unlock(&self->ctx->tasks_lock);
+
+  if ( (was_empty) && (0 <= self->ctx->wake_fd) ) {
+    const uint64_t one = 1;
+    self->ctx->o->write(self->ctx->wake_fd, &one, sizeof(one));
+  }
+
+  return 0;
+}
+
+static int reactor_migrate_eh(reactor *self, event_handler *e, reactor *target)
+{
+  if ( (!self) || (!self->ctx) || (!e) || (!target) || (!target->ctx) || (self == target) ) {
+    return -1;
+  }
+
+  event_handler_node *ehn = reactor_find_node(self->ctx, e);
+  if (!ehn) {
+    return -1;
+  }
+
+  migration *m = (migration *) malloc(sizeof(migration));
+  if (!m) {
+    return -1;
+  }
+  m->eh = e;
+  m->origin = self;
+  m->events = ehn->events;
+  m->window_events = ehn->window_events;
+  m->stats = ehn->stats;
+
+  if (0 != reactor_unregister_eh(self, e)) {
+    free(m);
+    return -1;
+  }
+
+  if (0 != target->post_with_cleanup(target, reactor_adopt_eh, reactor_drop_eh, m)) {
+    reactor_restore_eh(self, m);
+    free(m);
+    return -1;
+  }
+
+  return 0;
+}
+
+static int reactor_shed_load(reactor *self, reactor *target, double share, unsigned int max_cnt,
+                             int (*can_migrate)(const event_handler *e))
+{
+  if ( (!self) || (!self->ctx) || (!target) || (!target->ctx) || (self == target) ||
+       (!(share >= 0.0)) || (share > 1.0) ) {
+    return -1;
+  }
+
+  const unsigned long handlers = atomic_load_explicit(&self->ctx->handlers, memory_order_relaxed);
+  if ( (0 == handlers) || (0 == max_cnt) ) {
+    return 0;
+  }
+
+  event_handler_node **candidates = (event_handler_node **) malloc(handlers * sizeof(event_handler_node *));
+  if (!candidates) {
+    return -1;
+  }
+
+  size_t candidates_cnt = 0;
+  unsigned long window_events = 0;
+  for (size_t fd = 0; fd < self->ctx->fds_cap; ++fd) {
+    event_handler_node *curr = self->ctx->fds[fd];
+    if (!curr)
+      continue;
+    window_events += curr->window_events;
+    if ( (curr->window_events) && ( (!can_migrate) || (can_migrate(curr->eh)) ) )
+      candidates[candidates_cnt++] = curr;
+  }
+  qsort(candidates, candidates_cnt, sizeof(event_handler_node *), reactor_compare_activity);
+
+  /* budget is a share of the same window, however many rebalance intervals it spans */
+  const unsigned long events_budget = (unsigned long) (share * (double) window_events);
+
+  size_t selected_cnt = 0;
+  unsigned long moved_events = 0;
+  for (size_t i = 0; (i < candidates_cnt) && (selected_cnt < max_cnt); ++i) {
+    if (moved_events + candidates[i]->window_events <= events_budget) {
+      moved_events += candidates[i]->window_events;
+      candidates[selected_cnt++] = candidates[i];
     }
   }
 
+  for (size_t fd = 0; fd < self->ctx->fds_cap; ++fd) {
+    if (self->ctx->fds[fd])
+      self->ctx->fds[fd]->window_events = 0;
+  }
+
+  int res = 0;
+  for (size_t i = 0; i < selected_cnt; ++i) {
+    if (0 == reactor_migrate_eh(self, candidates[i]->eh, target))
+      ++res;
+  }
+
+  free(candidates);
   return res;
 }
 
-static event_handler_node * reactor_find_eh(event_handler_node *root, const int fd)
+static int reactor_get_load(reactor *self, reactor_load *load)
 {
-  event_handler_node *res = 0;
+  if ( (!self) || (!self->ctx) || (!load) ) {
+    return -1;
+  }
 
-  for (event_handler_node *curr = root; 0 != curr; curr = curr->next) {
-    if ( (curr->eh) && (fd == curr->eh->fd) ) {
-      res = curr;
-      break;
+  load->events = atomic_load_explicit(&self->ctx->events, memory_order_relaxed);
+  load->full_batches = atomic_load_explicit(&self->ctx->full_batches, memory_order_relaxed);
+  load->handlers = atomic_load_explicit(&self->ctx->handlers, memory_order_relaxed);
+
+  return 0;
+}
+
+static int reactor_add_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!hook) || (phase > REACTOR_PHASE_CHECK) ) {
+    return -1;
+  }
+
+  hook_node *hn = (hook_node *) malloc(sizeof(hook_node));
+  if (!hn) {
+    return -1;
+  }
+  memset(hn, 0, sizeof(hook_node));
+  hn->hook = hook;
+  hn->arg = arg;
+
+  hook_node **tail = &self->ctx->hooks[phase];
+  while (*tail)
+    tail = &(*tail)->next;
+  *tail = hn;
+
+  return 0;
+}
+
+static int reactor_remove_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg)
+{
+  if ( (!self) || (!self->ctx) || (!hook) || (phase > REACTOR_PHASE_CHECK) ) {
+    return -1;
+  }
+
+  for (hook_node *curr = self->ctx->hooks[phase]; 0 != curr; curr = curr->next) {
+    if ( (!curr->removed) && (hook == curr->hook) && (arg == curr->arg) ) {
+      curr->removed = 1;
+      if (!self->ctx->running_hooks)
+        reactor_purge_hooks(self, phase, 0);
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+static int reactor_defer_flush(reactor *self, event_handler *e, void (*flush)(event_handler *e))
+{
+  if ( (!self) || (!self->ctx) || (!e) || (!reactor_is_registered(self, e)) ) {
+    return -1;
+  }
+
+  reactor_ctx *ctx = self->ctx;
+  for (size_t i = 0; i < ctx->flushes_cnt; ++i) {
+    if (e == ctx->flushes[i].eh)
+      return 0;
+  }
+
+  if (ctx->flushes_cnt == ctx->flushes_cap) {
+    const size_t cap = (ctx->flushes_cap) ? 2 * ctx->flushes_cap : 16;
+    flush_entry *flushes = (flush_entry *) realloc(ctx->flushes, cap * sizeof(flush_entry));
+    if (!flushes) {
+      return -1;
+    }
+    ctx->flushes = flushes;
+    ctx->flushes_cap = cap;
+  }
+
+  flush_entry *fe = &ctx->flushes[ctx->flushes_cnt++];
+  fe->eh = e;
+  fe->flush = flush;
+  fe->fd = e->fd;
+  fe->corked = (0 == reactor_cork(self, e->fd, 1));
+
+  return 0;
+}
+
+static void reactor_run_hooks(reactor *self, reactor_phase phase)
+{
+  if (!self->ctx->hooks[phase]) {
+    return;
+  }
+
+  self->ctx->running_hooks = 1;
+  for (hook_node *curr = self->ctx->hooks[phase]; 0 != curr; curr = curr->next) {
+    if (!curr->removed)
+      curr->hook(self, curr->arg);
+  }
+  self->ctx->running_hooks = 0;
+
+  reactor_purge_hooks(self, phase, 0);
+}
+
+static void reactor_purge_hooks(reactor *self, reactor_phase phase, int all)
+{
+  hook_node **curr = &self->ctx->hooks[phase];
+  while (*curr) {
+    hook_node *hn = *curr;
+    if ( (all) || (hn->removed) ) {
+      *curr = hn->next;
+      free(hn);
+    }
+    else {
+      curr = &hn->next;
+    }
+  }
+}
+
+static void reactor_run_flushes(reactor *self)
+{
+  reactor_ctx *ctx = self->ctx;
+  for (size_t i = 0; i < ctx->flushes_cnt; ++i) {
+    const flush_entry fe = ctx->flushes[i];
+    if (!fe.eh)
+      continue;
+    if (fe.flush)
+      fe.flush(fe.eh);
+    /* flush could unregister and free the handler, so it is compared, but never dereferenced */
+    event_handler_node *ehn = reactor_find_eh(ctx, fe.fd);
+    if ( (fe.corked) && (ehn) && (fe.eh == ehn->eh) )
+      reactor_cork(self, fe.fd, 0);
+  }
+  ctx->flushes_cnt = 0;
+}
+
+static void reactor_drop_flush(reactor *self, const event_handler *e)
+{
+  reactor_ctx *ctx = self->ctx;
+  for (size_t i = 0; i < ctx->flushes_cnt; ++i) {
+    flush_entry *fe = &ctx->flushes[i];
+    if (e == fe->eh) {
+      /* entry is only marked, since flushes may be running right now */
+      fe->eh = 0;
+      if (fe->corked)
+        reactor_cork(self, fe->fd, 0);
+      return;
+    }
+  }
+}
+
+static void reactor_drop_orphan_flushes(reactor *self)
+{
+  reactor_ctx *ctx = self->ctx;
+  /* pending flush always belongs to registered handler, so the ones of unindexed handlers are dropped in one pass */
+  for (size_t i = 0; i < ctx->flushes_cnt; ++i) {
+    flush_entry *fe = &ctx->flushes[i];
+    if ( (fe->eh) && (!reactor_find_node(ctx, fe->eh)) ) {
+      fe->eh = 0;
+      if (fe->corked)
+        reactor_cork(self, fe->fd, 0);
+    }
+  }
+}
+
+static int reactor_cork(reactor *self, int fd, int on)
+{
+  if (!self->ctx->o->setsockopt) {
+    return -1;
+  }
+
+  return self->ctx->o->setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+}
+
+static int reactor_is_registered(reactor *self, const event_handler *e)
+{
+  event_handler_node *ehn = reactor_find_eh(self->ctx, e->fd);
+
+  return ( (ehn) && (e == ehn->eh) );
+}
+
+static int reactor_set_accounting(reactor *self, uint32_t flags)
+{
+  if ( (!self) || (!self->ctx) || (flags & ~(REACTOR_ACCOUNT_WALL | REACTOR_ACCOUNT_CPU)) ) {
+    return -1;
+  }
+
+  if ( (flags) && (!self->ctx->o->clock_gettime) ) {
+    return -1;
+  }
+
+  self->ctx->accounting = flags;
+
+  return 0;
+}
+
+static int reactor_get_eh_stats(reactor *self, const event_handler *e, reactor_eh_stats *stats)
+{
+  if ( (!self) || (!self->ctx) || (!e) || (!stats) ) {
+    return -1;
+  }
+
+  event_handler_node *ehn = reactor_find_eh(self->ctx, e->fd);
+  if ( (!ehn) || (e != ehn->eh) ) {
+    return -1;
+  }
+
+  *stats = ehn->stats;
+
+  return 0;
+}
+
+static int reactor_get_activity(reactor *self, reactor_activity *activity)
+{
+  if ( (!self) || (!self->ctx) || (!activity) ) {
+    return -1;
+  }
+
+  reactor_ctx *ctx = self->ctx;
+  memset(activity, 0, sizeof(reactor_activity));
+  activity->running = atomic_load_explicit(&ctx->running, memory_order_acquire);
+  if (activity->running)
+    activity->thread = ctx->thread;
+  activity->eh = atomic_load_explicit(&ctx->current_eh, memory_order_relaxed);
+  activity->fd = atomic_load_explicit(&ctx->current_fd, memory_order_relaxed);
+  const uint64_t since = atomic_load_explicit(&ctx->busy_since_ns, memory_order_relaxed);
+  if (since) {
+    const uint64_t now = reactor_now_ns(self, CLOCK_MONOTONIC);
+    activity->busy_ns = (now > since) ? now - since : 0;
+  }
+
+  return 0;
+}
+
+static int reactor_set_tracer(reactor *self, tracer *t)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  self->ctx->tracer = t;
+  if (t) {
+    for (size_t fd = 0; fd < self->ctx->fds_cap; ++fd) {
+      if (self->ctx->fds[fd])
+        t->enable(t, (int) fd);
+    }
+  }
+
+  return 0;
+}
+
+static uint64_t reactor_cached_now_ns(reactor *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return 0;
+  }
+
+  return (self->ctx->batch_ns) ? self->ctx->batch_ns : reactor_now_ns(self, CLOCK_MONOTONIC);
+}
+
+static void reactor_dispatch(reactor *self, event_handler_node *ehn, uint32_t events)
+{
+  reactor_ctx *ctx = self->ctx;
+  event_handler *eh = ehn->eh;
+  const int fd = eh->fd;
+
+  ++ehn->window_events;
+  ++ehn->stats.calls;
+  atomic_store_explicit(&ctx->current_eh, eh, memory_order_relaxed);
+  atomic_store_explicit(&ctx->current_fd, fd, memory_order_relaxed);
+
+  if ( (ctx->tracer) && (events & EPOLLIN) )
+    ctx->tracer->sample(ctx->tracer, fd);
+
+  const uint32_t accounting = ctx->accounting;
+  if (!accounting) {
+    eh->handle_event(eh, events);
+  }
+  else {
+    const uint64_t wall_start = (accounting & REACTOR_ACCOUNT_WALL) ? reactor_now_ns(self, CLOCK_MONOTONIC) : 0;
+    const uint64_t cpu_start = (accounting & REACTOR_ACCOUNT_CPU) ? reactor_now_ns(self, CLOCK_THREAD_CPUTIME_ID) : 0;
+    eh->handle_event(eh, events);
+    const uint64_t wall_end = (accounting & REACTOR_ACCOUNT_WALL) ? reactor_now_ns(self, CLOCK_MONOTONIC) : 0;
+    const uint64_t cpu_end = (accounting & REACTOR_ACCOUNT_CPU) ? reactor_now_ns(self, CLOCK_THREAD_CPUTIME_ID) : 0;
+
+    /* handler could unregister itself, so its node is looked up again */
+    ehn = reactor_find_eh(ctx, fd);
+    if ( (ehn) && (eh == ehn->eh) ) {
+      const uint64_t wall = wall_end - wall_start;
+      ehn->stats.wall_ns += wall;
+      if (wall > ehn->stats.max_wall_ns)
+        ehn->stats.max_wall_ns = wall;
+      ehn->stats.cpu_ns += cpu_end - cpu_start;
+    }
+  }
+
+  atomic_store_explicit(&ctx->current_eh, 0, memory_order_relaxed);
+  atomic_store_explicit(&ctx->current_fd, -1, memory_order_relaxed);
+}
+
+static uint64_t reactor_now_ns(reactor *self, clockid_t clock)
+{
+  struct timespec ts;
+  if ( (!self->ctx->o->clock_gettime) || (0 != self->ctx->o->clock_gettime(clock, &ts)) ) {
+    return 0;
+  }
+
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void reactor_run_tasks(reactor *self)
+{
+  if (!atomic_exchange_explicit(&self->ctx->tasks_pending, 0, memory_order_acquire)) {
+    return;
+  }
+
+  pthread_mutex_lock(&self->ctx->tasks_lock);
+  task_node *tn = self->ctx->tasks_head;
+  self->ctx->tasks_head = 0;
+  self->ctx->tasks_tail = 0;
+  pthread_mutex_unlock(&self->ctx->tasks_lock);
+
+  while (tn) {
+    task_node *next = tn->next;
+    tn->task(self, tn->arg);
+    free(tn);
+    tn = next;
+  }
+}
+
+static void reactor_drop_tasks(reactor *self)
+{
+  pthread_mutex_lock(&self->ctx->tasks_lock);
+  task_node *tn = self->ctx->tasks_head;
+  self->ctx->tasks_head = 0;
+  self->ctx->tasks_tail = 0;
+  pthread_mutex_unlock(&self->ctx->tasks_lock);
+
+  while (tn) {
+    task_node *next = tn->next;
+    if (tn->cleanup)
+      tn->cleanup(self, tn->arg);
+    free(tn);
+    tn = next;
+  }
+}
+
+static void reactor_adopt_eh(reactor *self, void *arg)
+{
+  migration *m = (migration *) arg;
+  if (0 == reactor_restore_eh(self, m)) {
+    free(m);
+    return;
+  }
+
+  reactor_return_eh(self, m);
+}
+
+static void reactor_drop_eh(reactor *self, void *arg)
+{
+  reactor_return_eh(self, (migration *) arg);
+}
+
+static void reactor_return_eh(reactor *self, migration *m)
+{
+  if ( (m->origin) && (self != m->origin) ) {
+    reactor *origin = m->origin;
+    m->origin = 0;
+    if (0 == origin->post_with_cleanup(origin, reactor_adopt_eh, reactor_drop_eh, m))
+      return;
+  }
+
+  /* handler is not registered anywhere now, so it is told the same way as about closed peer */
+  m->eh->handle_event(m->eh, EPOLLHUP | EPOLLERR);
+  free(m);
+}
+
+static int reactor_compare_activity(const void *a, const void *b)
+{
+  const event_handler_node *l = *(event_handler_node * const *) a;
+  const event_handler_node *r = *(event_handler_node * const *) b;
+
+  if (l->window_events == r->window_events)
+    return 0;
+
+  return (l->window_events > r->window_events) ? -1 : 1;
+}
+
+static int reactor_validateDuplicate(reactor_ctx *ctx, const event_handler *eh)
+{
+  if ( (0 > eh->fd) || (reactor_find_eh(ctx, eh->fd)) || (reactor_find_node(ctx, eh)) ) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static int reactor_reserve_eh(reactor_ctx *ctx, const int max_fd, size_t cnt)
+{
+  if ( (size_t) max_fd >= ctx->fds_cap ) {
+    size_t cap = (ctx->fds_cap) ? ctx->fds_cap : 64;
+    while (cap <= (size_t) max_fd)
+      cap *= 2;
+    event_handler_node **fds = (event_handler_node **) realloc(ctx->fds, cap * sizeof(event_handler_node *));
+    if (!fds) {
+      return -1;
     }
+    memset(fds + ctx->fds_cap, 0, (cap - ctx->fds_cap) * sizeof(event_handler_node *));
+    ctx->fds = fds;
+    ctx->fds_cap = cap;
+  }
+
+  const size_t handlers = atomic_load_explicit(&ctx->handlers, memory_order_relaxed);
+  size_t bits = (ctx->by_eh) ? ctx->by_eh_bits : 6;
+  while (handlers + cnt > ((size_t) 1 << bits))
+    ++bits;
+  if ( (!ctx->by_eh) || (bits != ctx->by_eh_bits) ) {
+    event_handler_node **by_eh = (event_handler_node **) calloc((size_t) 1 << bits, sizeof(event_handler_node *));
+    if (!by_eh) {
+      return -1;
+    }
+    const size_t old_cnt = (ctx->by_eh) ? (size_t) 1 << ctx->by_eh_bits : 0;
+    for (size_t i = 0; i < old_cnt; ++i) {
+      event_handler_node *curr = ctx->by_eh[i];
+      while (curr) {
+        event_handler_node *next = curr->next_by_eh;
+        const size_t bucket = reactor_hash_eh(curr->eh, bits);
+        curr->next_by_eh = by_eh[bucket];
+        by_eh[bucket] = curr;
+        curr = next;
+      }
+    }
+    free(ctx->by_eh);
+    ctx->by_eh = by_eh;
+    ctx->by_eh_bits = bits;
+  }
+
+  return 0;
+}
+
+static int reactor_add_eh(reactor_ctx *ctx, event_handler *eh, uint32_t events)
+{
+  event_handler_node *ehn = (event_handler_node*) malloc(sizeof (event_handler_node));
+  if (!ehn) {
+    return -1;
+  }
+  memset(ehn, 0, sizeof(event_handler_node));
+  ehn->eh = eh;
+  ehn->fd = eh->fd;
+  ehn->events = events;
+
+  struct epoll_event ee;
+  memset(&ee, 0, sizeof(ee));
+  ee.data.fd = eh->fd;
+  ee.events = events;
+
+  int res = ctx->o->epoll_ctl(ctx->epoll_fd, EPOLL_CTL_ADD, eh->fd, &ee);
+
+  if (0 == res) {
+    reactor_index_eh(ctx, ehn);
+    atomic_fetch_add_explicit(&ctx->handlers, 1, memory_order_relaxed);
+    if (ctx->tracer)
+      ctx->tracer->enable(ctx->tracer, eh->fd);
+  }
+  else {
+    free(ehn);
   }
 
   return res;
 }
 
+static int reactor_restore_eh(reactor *self, const migration *m)
+{
+  if ( (!self->ctx) || (0 != reactor_validateDuplicate(self->ctx, m->eh)) ||
+       (0 != reactor_reserve_eh(self->ctx, m->eh->fd, 1)) ||
+       (0 != reactor_add_eh(self->ctx, m->eh, m->events)) ) {
+    return -1;
+  }
+
+  event_handler_node *ehn = reactor_find_eh(self->ctx, m->eh->fd);
+  ehn->window_events = m->window_events;
+  ehn->stats = m->stats;
+
+  return 0;
+}
+
+static void reactor_index_eh(reactor_ctx *ctx, event_handler_node *ehn)
+{
+  const size_t bucket = reactor_hash_eh(ehn->eh, ctx->by_eh_bits);
+  ehn->next_by_eh = ctx->by_eh[bucket];
+  ctx->by_eh[bucket] = ehn;
+  ctx->fds[ehn->fd] = ehn;
+}
+
+static void reactor_unindex_eh(reactor_ctx *ctx, event_handler_node *ehn)
+{
+  event_handler_node **curr = &ctx->by_eh[reactor_hash_eh(ehn->eh, ctx->by_eh_bits)];
+  while (*curr != ehn)
+    curr = &(*curr)->next_by_eh;
+  *curr = ehn->next_by_eh;
+  ctx->fds[ehn->fd] = 0;
+}
+
+static size_t reactor_hash_eh(const event_handler *eh, size_t bits)
+{
+  return (size_t) (((uint64_t) (uintptr_t) eh * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+static event_handler_node * reactor_find_node(reactor_ctx *ctx, const event_handler *eh)
+{
+  if (!ctx->by_eh) {
+    return 0;
+  }
+
+  event_handler_node *curr = ctx->by_eh[reactor_hash_eh(eh, ctx->by_eh_bits)];
+  while ( (curr) && (eh != curr->eh) )
+    curr = curr->next_by_eh;
+
+  return curr;
+}
+
+static event_handler_node * reactor_find_eh(reactor_ctx *ctx, const int fd)
+{
+  if ( (0 > fd) || ((size_t) fd >= ctx->fds_cap) ) {
+    return 0;
+  }
+
+  return ctx->fds[fd];
+}
+
@@ -0,0 +1,285 @@
+#include "reactor/tracer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+typedef struct trace_slot_s {
+  atomic_uint_fast64_t seq;
+  atomic_int fd;
+  atomic_uint_fast64_t kernel_ns;
+  atomic_uint_fast64_t dispatch_ns;
+} trace_slot;
+
+struct tracer_ctx_s {
+  const os *o;
+  trace_slot *ring;
+  size_t mask;
+  atomic_uint_fast64_t head;
+  atomic_uint_fast64_t samples;
+  atomic_uint_fast64_t sum_ns;
+  atomic_uint_fast64_t max_ns;
+  atomic_uint_fast64_t buckets[TRACER_BUCKETS];
+};
+
+static void tracer_terminate(tracer *self);
+static void tracer_free(tracer *self);
+static int tracer_enable(tracer *self, int fd);
+static int tracer_sample(tracer *self, int fd);
+static int tracer_get_histogram(tracer *self, tracer_histogram *h);
+static ssize_t tracer_dump(tracer *self, int fd);
+static void tracer_record(tracer *self, int fd, uint64_t kernel_ns, uint64_t dispatch_ns);
+static void tracer_add(atomic_uint_fast64_t *counter, uint64_t value);
+static int tracer_write_all(tracer *self, int fd, const char *data, size_t len);
+
+int tracer_init(tracer *t, const os *o, size_t ring_size)
+{
+  if ( (!t) || (!o) || (!o->setsockopt) || (!o->recvmsg) || (!o->clock_gettime) || (!o->write) )
+    return -1;
+
+  memset(t, 0, sizeof(tracer));
+  tracer_ctx *ctx = (tracer_ctx *) malloc(sizeof(tracer_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(tracer_ctx));
+
+  if (ring_size) {
+    size_t size = 1;
+    while (size < ring_size)
+      size <<= 1;
+    ctx->ring = (trace_slot *) malloc(size * sizeof(trace_slot));
+    if (!ctx->ring) {
+      free(ctx);
+      return -1;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      atomic_init(&ctx->ring[i].seq, 0);
+      atomic_init(&ctx->ring[i].fd, -1);
+      atomic_init(&ctx->ring[i].kernel_ns, 0);
+      atomic_init(&ctx->ring[i].dispatch_ns, 0);
+    }
+    ctx->mask = size - 1;
+  }
+
+  ctx->o = o;
+  atomic_init(&ctx->head, 0);
+  atomic_init(&ctx->samples, 0);
+  atomic_init(&ctx->sum_ns, 0);
+  atomic_init(&ctx->max_ns, 0);
+  for (size_t i = 0; i < TRACER_BUCKETS; ++i)
+    atomic_init(&ctx->buckets[i], 0);
+
+  t->ctx = ctx;
+  t->enable = tracer_enable;
+  t->sample = tracer_sample;
+  t->get_histogram = tracer_get_histogram;
+  t->dump = tracer_dump;
+  t->destroy = tracer_terminate;
+
+  return 0;
+}
+
+tracer * tracer_alloc(const os *o, size_t ring_size)
+{
+  tracer *res = (tracer *) malloc(sizeof(tracer));
+  if (res) {
+    if (0 != tracer_init(res, o, ring_size)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = tracer_free;
+  }
+
+  return res;
+}
+
+static void tracer_terminate(tracer *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return;
+  }
+
+  free(self->ctx->ring);
+  free(self->ctx);
+  self->ctx = 0;
+}
+
+static void tracer_free(tracer *self)
+{
+  tracer_terminate(self);
+  free(self);
+}
+
+static int tracer_enable(tracer *self, int fd)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  const int one = 1;
+
+  return self->ctx->o->setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+}
+
+static int tracer_sample(tracer *self, int fd)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  char byte;
+  struct iovec iov;
+  iov.iov_base = &byte;
+  iov.iov_len = sizeof(byte);
+  union {
+    char buf[CMSG_SPACE(sizeof(struct timespec))];
+    struct cmsghdr align;
+  } control;
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = sizeof(control.buf);
+
+  if (0 >= self->ctx->o->recvmsg(fd, &msg, MSG_PEEK | MSG_DONTWAIT)) {
+    return -1;
+  }
+
+  struct timespec kernel_ts;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  for (; 0 != cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if ( (SOL_SOCKET == cmsg->cmsg_level) && (SCM_TIMESTAMPNS == cmsg->cmsg_type) )
+      break;
+  }
+  if (!cmsg) {
+    return -1;
+  }
+  memcpy(&kernel_ts, CMSG_DATA(cmsg), sizeof(kernel_ts));
+
+  struct timespec now_ts;
+  if (0 != self->ctx->o->clock_gettime(CLOCK_REALTIME, &now_ts)) {
+    return -1;
+  }
+
+  tracer_record(self, fd, (uint64_t) kernel_ts.tv_sec * 1000000000ULL + kernel_ts.tv_nsec,
+                (uint64_t) now_ts.tv_sec * 1000000000ULL + now_ts.tv_nsec);
+
+  return 0;
+}
+
+static int tracer_get_histogram(tracer *self, tracer_histogram *h)
+{
+  if ( (!self) || (!self->ctx) || (!h) ) {
+    return -1;
+  }
+
+  tracer_ctx *ctx = self->ctx;
+  h->samples = atomic_load_explicit(&ctx->samples, memory_order_relaxed);
+  h->sum_ns = atomic_load_explicit(&ctx->sum_ns, memory_order_relaxed);
+  h->max_ns = atomic_load_explicit(&ctx->max_ns, memory_order_relaxed);
+  for (size_t i = 0; i < TRACER_BUCKETS; ++i)
+    h->buckets[i] = atomic_load_explicit(&ctx->buckets[i], memory_order_relaxed);
+
+  return 0;
+}
+
+static ssize_t tracer_dump(tracer *self, int fd)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return -1;
+  }
+
+  tracer_ctx *ctx = self->ctx;
+  if (!ctx->ring) {
+    return 0;
+  }
+
+  char buf[4096];
+  size_t len = 0;
+  ssize_t cnt = 0;
+  const uint64_t head = atomic_load_explicit(&ctx->head, memory_order_acquire);
+  const uint64_t size = ctx->mask + 1;
+  for (uint64_t n = (head > size) ? head - size : 0; n < head; ++n) {
+    trace_slot *slot = &ctx->ring[n & ctx->mask];
+    const uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (2 * n + 2 != seq)
+      continue;
+    const int rec_fd = atomic_load_explicit(&slot->fd, memory_order_relaxed);
+    const uint64_t kernel_ns = atomic_load_explicit(&slot->kernel_ns, memory_order_relaxed);
+    const uint64_t dispatch_ns = atomic_load_explicit(&slot->dispatch_ns, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (seq != atomic_load_explicit(&slot->seq, memory_order_relaxed))
+      continue;
+
+    if (sizeof(buf) - len < 128) {
+      if (0 != tracer_write_all(self, fd, buf, len))
+        return -1;
+      len = 0;
+    }
+    len += snprintf(buf + len, sizeof(buf) - len, "%d %llu %llu %llu\n", rec_fd,
+                    (unsigned long long) kernel_ns, (unsigned long long) dispatch_ns,
+                    (unsigned long long) ( (dispatch_ns > kernel_ns) ? dispatch_ns - kernel_ns : 0 ));
+    ++cnt;
+  }
+
+  if ( (len) && (0 != tracer_write_all(self, fd, buf, len)) ) {
+    return -1;
+  }
+
+  return cnt;
+}
+
+static void tracer_record(tracer *self, int fd, uint64_t kernel_ns, uint64_t dispatch_ns)
+{
+  tracer_ctx *ctx = self->ctx;
+  const uint64_t delay = (dispatch_ns > kernel_ns) ? dispatch_ns - kernel_ns : 0;
+
+  size_t bucket = 0;
+  if (delay)
+    bucket = 63 - __builtin_clzll(delay);
+  if (bucket >= TRACER_BUCKETS)
+    bucket = TRACER_BUCKETS - 1;
+
+  /* there is only one writer, so plain load and store are enough */
+  tracer_add(&ctx->samples, 1);
+  tracer_add(&ctx->sum_ns, delay);
+  tracer_add(&ctx->buckets[bucket], 1);
+  if (delay > atomic_load_explicit(&ctx->max_ns, memory_order_relaxed))
+    atomic_store_explicit(&ctx->max_ns, delay, memory_order_relaxed);
+
+  if (!ctx->ring) {
+    return;
+  }
+
+  const uint64_t n = atomic_load_explicit(&ctx->head, memory_order_relaxed);
+  trace_slot *slot = &ctx->ring[n & ctx->mask];
+  atomic_store_explicit(&slot->seq, 2 * n + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&slot->fd, fd, memory_order_relaxed);
+  atomic_store_explicit(&slot->kernel_ns, kernel_ns, memory_order_relaxed);
+  atomic_store_explicit(&slot->dispatch_ns, dispatch_ns, memory_order_relaxed);
+  atomic_store_explicit(&slot->seq, 2 * n + 2, memory_order_release);
+  atomic_store_explicit(&ctx->head, n + 1, memory_order_release);
+}
+
+static void tracer_add(atomic_uint_fast64_t *counter, uint64_t value)
+{
+  atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value,
+                        memory_order_relaxed);
+}
+
+static int tracer_write_all(tracer *self, int fd, const char *data, size_t len)
+{
+  while (len) {
+    const ssize_t res = self->ctx->o->write(fd, data, len);
+    if (0 >= res) {
+      return -1;
+    }
+    data += res;
+    len -= res;
+  }
+
+  return 0;
+}
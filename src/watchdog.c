@@ -0,0 +1,298 @@
+#define _GNU_SOURCE
+
+#include "reactor/watchdog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <execinfo.h>
+
+typedef struct watched_s {
+  reactor *r;
+  uint64_t last_busy_ns;
+  int reported;
+} watched;
+
+struct watchdog_ctx_s {
+  watchdog_config cfg;
+  watchdog_handler h;
+  void *arg;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  int run;
+  watched *reactors;
+  size_t cnt;
+  size_t cap;
+  struct sigaction old_action;
+};
+
+static atomic_int watchdog_dump_fd = 2;
+static atomic_int watchdog_dump_signo = 0;
+
+static void watchdog_terminate(watchdog *self);
+static void watchdog_free(watchdog *self);
+static int watchdog_watch(watchdog *self, reactor *r);
+static int watchdog_unwatch(watchdog *self, reactor *r);
+static void * watchdog_run(void *arg);
+static void watchdog_check(watchdog *self);
+static void watchdog_report_stall(watchdog *self, const watchdog_report *report);
+static void watchdog_dump_backtrace(int sig);
+
+int watchdog_init(watchdog *w, const watchdog_config *cfg, watchdog_handler h, void *arg)
+{
+  if (!w)
+    return -1;
+
+  memset(w, 0, sizeof(watchdog));
+  watchdog_ctx *ctx = (watchdog_ctx *) malloc(sizeof(watchdog_ctx));
+  if (!ctx) {
+    return -1;
+  }
+  memset(ctx, 0, sizeof(watchdog_ctx));
+
+  if (cfg)
+    ctx->cfg = *cfg;
+  else
+    ctx->cfg.signo = SIGRTMIN;
+  if (!ctx->cfg.budget_ms)
+    ctx->cfg.budget_ms = 50;
+  if (!ctx->cfg.period_ms)
+    ctx->cfg.period_ms = 10;
+  if (0 >= ctx->cfg.dump_fd)
+    ctx->cfg.dump_fd = 2;
+  ctx->h = h;
+  ctx->arg = arg;
+  ctx->run = 1;
+
+  if (0 < ctx->cfg.signo) {
+    /* handler and its dump_fd are process-wide, so they are owned by one watchdog */
+    int unused = 0;
+    if (!atomic_compare_exchange_strong(&watchdog_dump_signo, &unused, ctx->cfg.signo)) {
+      free(ctx);
+      return -1;
+    }
+
+    /* the first backtrace call may load libgcc, which is not signal safe */
+    void *frame = 0;
+    backtrace(&frame, 1);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = watchdog_dump_backtrace;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    atomic_store(&watchdog_dump_fd, ctx->cfg.dump_fd);
+    if (0 != sigaction(ctx->cfg.signo, &sa, &ctx->old_action)) {
+      atomic_store(&watchdog_dump_signo, 0);
+      free(ctx);
+      return -1;
+    }
+  }
+
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&ctx->cond, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&ctx->lock, 0);
+
+  w->ctx = ctx;
+  w->watch = watchdog_watch;
+  w->unwatch = watchdog_unwatch;
+  w->destroy = watchdog_terminate;
+
+  if (0 != pthread_create(&ctx->thread, 0, watchdog_run, w)) {
+    if (0 < ctx->cfg.signo) {
+      sigaction(ctx->cfg.signo, &ctx->old_action, 0);
+      atomic_store(&watchdog_dump_signo, 0);
+    }
+    pthread_cond_destroy(&ctx->cond);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+    memset(w, 0, sizeof(watchdog));
+    return -1;
+  }
+
+  return 0;
+}
+
+watchdog * watchdog_alloc(const watchdog_config *cfg, watchdog_handler h, void *arg)
+{
+  watchdog *res = (watchdog *) malloc(sizeof(watchdog));
+  if (res) {
+    if (0 != watchdog_init(res, cfg, h, arg)) {
+      free(res);
+      return 0;
+    }
+    res->destroy = watchdog_free;
+  }
+
+  return res;
+}
+
+static void watchdog_terminate(watchdog *self)
+{
+  if ( (!self) || (!self->ctx) ) {
+    return;
+  }
+
+  watchdog_ctx *ctx = self->ctx;
+  pthread_mutex_lock(&ctx->lock);
+  ctx->run = 0;
+  pthread_cond_signal(&ctx->cond);
+  pthread_mutex_unlock(&ctx->lock);
+  pthread_join(ctx->thread, 0);
+
+  if (0 < ctx->cfg.signo) {
+    sigaction(ctx->cfg.signo, &ctx->old_action, 0);
+    atomic_store(&watchdog_dump_signo, 0);
+  }
+  pthread_cond_destroy(&ctx->cond);
+  pthread_mutex_destroy(&ctx->lock);
+  free(ctx->reactors);
+  free(ctx);
+  self->ctx = 0;
+}
+
+static void watchdog_free(watchdog *self)
+{
+  watchdog_terminate(self);
+  free(self);
+}
+
+static int watchdog_watch(watchdog *self, reactor *r)
+{
+  if ( (!self) || (!self->ctx) || (!r) ) {
+    return -1;
+  }
+
+  int res = 0;
+  watchdog_ctx *ctx = self->ctx;
+  pthread_mutex_lock(&ctx->lock);
+  for (size_t i = 0; i < ctx->cnt; ++i) {
+    if (r == ctx->reactors[i].r) {
+      res = -1;
+      break;
+    }
+  }
+  if ( (0 == res) && (ctx->cnt == ctx->cap) ) {
+    const size_t cap = (ctx->cap) ? 2 * ctx->cap : 8;
+    watched *reactors = (watched *) realloc(ctx->reactors, cap * sizeof(watched));
+    if (reactors) {
+      ctx->reactors = reactors;
+      ctx->cap = cap;
+    }
+    else {
+      res = -1;
+    }
+  }
+  if (0 == res) {
+    memset(&ctx->reactors[ctx->cnt], 0, sizeof(watched));
+    ctx->reactors[ctx->cnt++].r = r;
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  return res;
+}
+
+static int watchdog_unwatch(watchdog *self, reactor *r)
+{
+  if ( (!self) || (!self->ctx) || (!r) ) {
+    return -1;
+  }
+
+  int res = -1;
+  watchdog_ctx *ctx = self->ctx;
+  pthread_mutex_lock(&ctx->lock);
+  for (size_t i = 0; i < ctx->cnt; ++i) {
+    if (r == ctx->reactors[i].r) {
+      ctx->reactors[i] = ctx->reactors[--ctx->cnt];
+      res = 0;
+      break;
+    }
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  return res;
+}
+
+static void * watchdog_run(void *arg)
+{
+  watchdog *self = (watchdog *) arg;
+  watchdog_ctx *ctx = self->ctx;
+  struct timespec deadline;
+
+  pthread_mutex_lock(&ctx->lock);
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  while (ctx->run) {
+    deadline.tv_nsec += (long) ctx->cfg.period_ms * 1000000L;
+    deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+    deadline.tv_nsec %= 1000000000L;
+    while ( (ctx->run) && (0 == pthread_cond_timedwait(&ctx->cond, &ctx->lock, &deadline)) )
+      ;
+    if (ctx->run)
+      watchdog_check(self);
+  }
+  pthread_mutex_unlock(&ctx->lock);
+
+  return 0;
+}
+
+static void watchdog_check(watchdog *self)
+{
+  watchdog_ctx *ctx = self->ctx;
+  const uint64_t budget_ns = (uint64_t) ctx->cfg.budget_ms * 1000000ULL;
+
+  for (size_t i = 0; i < ctx->cnt; ++i) {
+    watched *w = &ctx->reactors[i];
+    reactor_activity activity;
+    if (0 != w->r->get_activity(w->r, &activity)) {
+      continue;
+    }
+
+    /* busy time went down, so event_loop has started another batch */
+    if (activity.busy_ns < w->last_busy_ns)
+      w->reported = 0;
+    w->last_busy_ns = activity.busy_ns;
+
+    if ( (w->reported) || (activity.busy_ns <= budget_ns) ) {
+      continue;
+    }
+    w->reported = 1;
+
+    watchdog_report report;
+    report.r = w->r;
+    report.eh = activity.eh;
+    report.fd = activity.fd;
+    report.stalled_ns = activity.busy_ns;
+    watchdog_report_stall(self, &report);
+
+    if ( (0 < ctx->cfg.signo) && (activity.running) )
+      pthread_kill(activity.thread, ctx->cfg.signo);
+  }
+}
+
+static void watchdog_report_stall(watchdog *self, const watchdog_report *report)
+{
+  watchdog_ctx *ctx = self->ctx;
+
+  if (ctx->h) {
+    ctx->h(self, report, ctx->arg);
+    return;
+  }
+
+  dprintf(ctx->cfg.dump_fd, "watchdog: reactor %p stalled for %llu ms in event_handler %p (fd %d)\n",
+          (void *) report->r, (unsigned long long) (report->stalled_ns / 1000000ULL),
+          (const void *) report->eh, report->fd);
+}
+
+static void watchdog_dump_backtrace(int sig)
+{
+  void *frames[64];
+  const int cnt = backtrace(frames, sizeof(frames) / sizeof(frames[0]));
+
+  backtrace_symbols_fd(frames, cnt, atomic_load(&watchdog_dump_fd));
+}
@@ -1,7 +1,7 @@
 /**
  * @file main.c
  * @brief This is very basic telnet echo server, which demonstrates
- * how to use reactor library.
+ * how to use reactor library. It echoes received text line by line.
  * To build this project just run make command in one up folder.
  * To run this project just run run.sh script in one up folder.
  * @author Roman Ulan
@@ -10,6 +10,7 @@
  */
 
 #include "reactor/reactor.h"
+#include "reactor/framer.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,22 +18,25 @@
 #include <signal.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <arpa/inet.h>
 
 static void sig_handler(int sig);
 static event_handler * init_srv_eh(int port);
-static event_handler * init_cli_eh(int cli_fd);
+static framer * init_cli(int cli_fd);
 static void destroy_eh(event_handler *eh);
 
 static void accept_client(event_handler *self, uint32_t events);
-static void echo_reply(event_handler *self, uint32_t events);
+static void echo_lines(framer *f, const frame *frames, size_t cnt, void *arg);
+static void client_lost(framer *f, int err, void *arg);
 
+os OS;
 reactor REACTOR;
+buf_pool POOL;
 
 int main(int argc, char **argv)
 {
-  os o;
   const int port = 5555;
   event_handler *srv_eh = init_srv_eh(port);
 
@@ -43,8 +47,9 @@ int main(int argc, char **argv)
 
   signal(SIGINT, sig_handler);
 
-  os_linux_init(&o);
-  reactor_init(&REACTOR, &o);
+  os_linux_init(&OS);
+  reactor_init(&REACTOR, &OS);
+  buf_pool_init(&POOL, &OS, 0);
 
   REACTOR.register_eh(&REACTOR, srv_eh);
 
@@ -54,6 +59,7 @@ int main(int argc, char **argv)
   printf("\nServer interrupted, bye...\n");
 
   REACTOR.destroy(&REACTOR);
+  POOL.destroy(&POOL);
   srv_eh->destroy(srv_eh);
 
   return 0;
@@ -96,15 +102,13 @@ static event_handler * init_srv_eh(int port)
   return srv_eh;
 }
 
-static event_handler * init_cli_eh(int cli_fd)
+static framer * init_cli(int cli_fd)
 {
-  event_handler *cli_eh = malloc(sizeof(event_handler));
-  memset(cli_eh, 0, sizeof(event_handler));
-  cli_eh->fd = cli_fd;
-  cli_eh->handle_event = echo_reply;
-  cli_eh->destroy = destroy_eh;
+  const size_t frame_size = 1024;
+  decoder d;
+  decoder_line_init(&d, '\n', frame_size - 1);
 
-  return cli_eh;
+  return framer_alloc(&OS, &POOL, frame_size, cli_fd, &d, echo_lines, client_lost, 0);
 }
 
 static void destroy_eh(event_handler *eh)
@@ -118,29 +122,39 @@ static void accept_client(event_handler *self, uint32_t events)
 {
   const int cli_fd = accept(self->fd, 0, 0);
   if (0 < cli_fd) {
-    event_handler *cli_eh = init_cli_eh(cli_fd);
-    REACTOR.register_eh(&REACTOR, cli_eh);
+    framer *cli = init_cli(cli_fd);
+    if (!cli) {
+      close(cli_fd);
+      return;
+    }
+    REACTOR.register_eh(&REACTOR, &cli->eh);
     printf("New connection to client %d...\n", cli_fd);
   }
 }
 
-static void echo_reply(event_handler *self, uint32_t events)
+static void echo_lines(framer *f, const frame *frames, size_t cnt, void *arg)
 {
-  const size_t frame_size = 1024;
-  char buff[frame_size];
-  memset(buff, 0, sizeof(buff));
-  const ssize_t cnt = read(self->fd, buff, frame_size);
-  if (1 > cnt) {
-    printf("Connection lost to client %d...\n", self->fd);
-    REACTOR.unregister_eh(&REACTOR, self);
-    free(self);
+  static char new_line[] = "\n";
+  struct iovec iov[2 * FRAMER_MAX_BATCH];
+  ssize_t total = 0;
+
+  for (size_t i = 0; i < cnt; ++i) {
+    iov[2 * i].iov_base = (void *) frames[i].data;
+    iov[2 * i].iov_len = frames[i].len;
+    iov[2 * i + 1].iov_base = new_line;
+    iov[2 * i + 1].iov_len = 1;
+    total += frames[i].len + 1;
   }
-  else {
-    if (cnt != write(self->fd, buff, cnt)) {
-      printf("Connection lost to client %d...\n", self->fd);
-      REACTOR.unregister_eh(&REACTOR, self);
-      free(self);
-    }
+
+  if (total != writev(f->eh.fd, iov, 2 * cnt)) {
+    printf("Cannot reply to client %d...\n", f->eh.fd);
   }
 }
 
+static void client_lost(framer *f, int err, void *arg)
+{
+  printf("Connection lost to client %d...\n", f->eh.fd);
+  REACTOR.unregister_eh(&REACTOR, &f->eh);
+  close(f->eh.fd);
+  f->destroy(f);
+}
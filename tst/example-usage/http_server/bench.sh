@@ -0,0 +1,43 @@
+#!/bin/bash
+
+# Usage: ./bench.sh [plaintext|json] [connections] [duration] [pipeline depth]
+# It requires wrk (https://github.com/wg/wrk) to be available in PATH.
+
+RESOURCE=${1:-plaintext}
+CONNECTIONS=${2:-256}
+DURATION=${3:-15s}
+PIPELINE=${4:-16}
+PORT=8080
+THREADS=$(nproc)
+
+if ! command -v wrk > /dev/null; then
+  echo "wrk is required to run the benchmark."
+  exit 1
+fi
+
+export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:../../../
+
+SCRIPT=$(mktemp --suffix=.lua)
+cat > $SCRIPT <<LUA
+init = function(args)
+  local r = {}
+  for i = 1, $PIPELINE do
+    r[i] = wrk.format(nil, "/$RESOURCE")
+  end
+  req = table.concat(r)
+end
+
+request = function()
+  return req
+end
+LUA
+
+./http_srv $PORT > /dev/null &
+SRV_PID=$!
+sleep 1
+
+wrk -t $THREADS -c $CONNECTIONS -d $DURATION --latency -s $SCRIPT http://127.0.0.1:$PORT/$RESOURCE
+
+kill -INT $SRV_PID
+wait $SRV_PID
+rm -f $SCRIPT
@@ -0,0 +1,433 @@
+/**
+ * @file main.c
+ * @brief This is minimal HTTP/1.1 keep-alive server with request pipelining,
+ * which is used as realistic throughput and latency yardstick of reactor
+ * library. Requests are split by framer and parsed without copying, all
+ * responses queued during one loop iteration are sent with one writev
+ * from deferred flush, while socket is corked.
+ * Served resources are /plaintext and /json, everything else is 404.
+ * While reactor is overloaded, listener is paused by admission control.
+ * If path of Unix socket is given as second argument, listener is taken
+ * over from running instance (hot restart) and is handed over to the next
+ * one, then this instance drains its connections and exits.
+ * To build this project just run make command in one up folder.
+ * To run this project just run run.sh script in one up folder.
+ * To benchmark it just run bench.sh script in one up folder.
+ * @author Roman Ulan
+ * @version 1.0
+ * @date 2026-10-19
+ */
+
+#define _GNU_SOURCE
+
+#include "reactor/reactor.h"
+#include "reactor/framer.h"
+#include "reactor/buffer.h"
+#include "reactor/hot_restart.h"
+#include "reactor/admission.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <arpa/inet.h>
+
+typedef struct http_conn_s {
+  event_handler eh;
+  framer fr;
+  out_queue out;
+  uint32_t events;
+  int closing;
+  int lost;
+} http_conn;
+
+static void sig_handler(int sig);
+static int listen_on(int port);
+static event_handler * init_srv_eh(int port, int srv_fd);
+static http_conn * init_conn(int cli_fd);
+static void destroy_conn(http_conn *c);
+static void destroy_eh(event_handler *eh);
+static void drain(hot_restart *hr, void *arg);
+static shared_buf * init_response(const char *status, const char *content_type, const char *body);
+
+static void accept_client(event_handler *self, uint32_t events);
+static void handle_conn(event_handler *self, uint32_t events);
+static void flush_conn(event_handler *self);
+static void handle_requests(framer *f, const frame *frames, size_t cnt, void *arg);
+static void client_lost(framer *f, int err, void *arg);
+static ssize_t decode_request(const decoder *self, const char *data, size_t len, frame *f);
+static const char * find_header(const char *headers, size_t len, const char *name, size_t *value_len);
+
+os OS;
+reactor REACTOR;
+buf_pool POOL;
+decoder REQUEST_DECODER;
+shared_buf *PLAINTEXT;
+shared_buf *JSON;
+shared_buf *NOT_FOUND;
+hot_restart HOT_RESTART;
+admission ADMISSION;
+event_handler *SRV_EH;
+size_t CONNS;
+int DRAINING;
+
+int main(int argc, char **argv)
+{
+  const int port = (argc > 1) ? atoi(argv[1]) : 8080;
+  const char *hot_restart_path = (argc > 2) ? argv[2] : 0;
+
+  os_linux_init(&OS);
+  int srv_fd = -1;
+  if ( (hot_restart_path) && (0 == hot_restart_init(&HOT_RESTART, &OS, hot_restart_path)) &&
+       (0 < HOT_RESTART.take(&HOT_RESTART, 1000)) ) {
+    srv_fd = HOT_RESTART.get_fd(&HOT_RESTART, "http");
+  }
+
+  SRV_EH = init_srv_eh(port, srv_fd);
+  if (!SRV_EH) {
+    perror("Cannot setup server.");
+    return 1;
+  }
+
+  signal(SIGINT, sig_handler);
+  signal(SIGALRM, sig_handler);
+  signal(SIGPIPE, SIG_IGN);
+
+  memset(&REQUEST_DECODER, 0, sizeof(REQUEST_DECODER));
+  REQUEST_DECODER.decode = decode_request;
+  REQUEST_DECODER.size = 8192;
+  PLAINTEXT = init_response("200 OK", "text/plain", "Hello, World!");
+  JSON = init_response("200 OK", "application/json", "{\"message\":\"Hello, World!\"}");
+  NOT_FOUND = init_response("404 Not Found", "text/plain", "Not Found");
+
+  reactor_init(&REACTOR, &OS);
+  buf_pool_init(&POOL, &OS, 0);
+
+  REACTOR.register_eh(&REACTOR, SRV_EH);
+  admission_init(&ADMISSION, &REACTOR, &OS, 0, 0, 0);
+  ADMISSION.add_listener(&ADMISSION, SRV_EH);
+  if ( (HOT_RESTART.ctx) && ( (0 != HOT_RESTART.add_fd(&HOT_RESTART, "http", SRV_EH->fd)) ||
+                              (0 != HOT_RESTART.serve(&HOT_RESTART, &REACTOR, drain, 0)) ) ) {
+    perror("Cannot serve hot restart.");
+  }
+  if (0 <= srv_fd) {
+    /* predecessor drains once listener is registered here */
+    HOT_RESTART.ready(&HOT_RESTART);
+  }
+
+  printf("HTTP server setup using port %d.\n", port);
+  printf("Press <ctrl>+<c> to stop it.\n");
+  REACTOR.event_loop(&REACTOR);
+  printf("\nServer interrupted, bye...\n");
+
+  ADMISSION.destroy(&ADMISSION);
+  REACTOR.destroy(&REACTOR);
+  POOL.destroy(&POOL);
+  if (HOT_RESTART.ctx)
+    HOT_RESTART.destroy(&HOT_RESTART);
+  if (SRV_EH)
+    SRV_EH->destroy(SRV_EH);
+  shared_buf_unref(PLAINTEXT);
+  shared_buf_unref(JSON);
+  shared_buf_unref(NOT_FOUND);
+
+  return 0;
+}
+
+static void sig_handler(int sig)
+{
+  REACTOR.stop(&REACTOR);
+}
+
+static int listen_on(int port)
+{
+  struct sockaddr_in addr;
+  const int one = 1;
+  const int srv_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+  if (0 > srv_fd) {
+    return -1;
+  }
+
+  setsockopt(srv_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = INADDR_ANY;
+
+  if ( (0 != bind(srv_fd, (struct sockaddr*) &addr, sizeof(addr))) || (listen(srv_fd, 4096) < 0) ) {
+    close(srv_fd);
+    return -1;
+  }
+
+  return srv_fd;
+}
+
+static event_handler * init_srv_eh(int port, int srv_fd)
+{
+  event_handler *srv_eh = 0;
+
+  if (0 > srv_fd)
+    srv_fd = listen_on(port);
+  if (0 > srv_fd) {
+    return srv_eh;
+  }
+
+  srv_eh = malloc(sizeof(event_handler));
+  memset(srv_eh, 0, sizeof(event_handler));
+  srv_eh->fd = srv_fd;
+  srv_eh->handle_event = accept_client;
+  srv_eh->destroy = destroy_eh;
+
+  return srv_eh;
+}
+
+static http_conn * init_conn(int cli_fd)
+{
+  http_conn *c = malloc(sizeof(http_conn));
+  memset(c, 0, sizeof(http_conn));
+
+  if (0 != framer_init(&c->fr, &OS, &POOL, REQUEST_DECODER.size, cli_fd, &REQUEST_DECODER,
+                       handle_requests, client_lost, c)) {
+    free(c);
+    return 0;
+  }
+
+  if (0 != out_queue_init(&c->out, &OS)) {
+    c->fr.destroy(&c->fr);
+    free(c);
+    return 0;
+  }
+
+  c->eh.fd = cli_fd;
+  c->eh.ctx = c;
+  c->eh.handle_event = handle_conn;
+  c->events = EPOLLIN;
+
+  return c;
+}
+
+static void destroy_conn(http_conn *c)
+{
+  REACTOR.unregister_eh(&REACTOR, &c->eh);
+  close(c->eh.fd);
+  c->fr.destroy(&c->fr);
+  c->out.destroy(&c->out);
+  free(c);
+
+  if ( (0 == --CONNS) && (DRAINING) )
+    REACTOR.stop(&REACTOR);
+}
+
+static void destroy_eh(event_handler *eh)
+{
+  close(eh->fd);
+  memset(eh, 0, sizeof(event_handler));
+  free(eh);
+}
+
+static void drain(hot_restart *hr, void *arg)
+{
+  const unsigned int drain_timeout_s = 30;
+
+  printf("Listener handed over, draining %zu connections...\n", CONNS);
+  DRAINING = 1;
+  ADMISSION.remove_listener(&ADMISSION, SRV_EH);
+  REACTOR.unregister_eh(&REACTOR, SRV_EH);
+  SRV_EH->destroy(SRV_EH);
+  SRV_EH = 0;
+  if (0 == CONNS)
+    REACTOR.stop(&REACTOR);
+  else
+    alarm(drain_timeout_s);
+}
+
+static shared_buf * init_response(const char *status, const char *content_type, const char *body)
+{
+  char response[512];
+  const int len = snprintf(response, sizeof(response),
+                           "HTTP/1.1 %s\r\n"
+                           "Server: libreactor-c\r\n"
+                           "Content-Type: %s\r\n"
+                           "Content-Length: %zu\r\n"
+                           "\r\n"
+                           "%s", status, content_type, strlen(body), body);
+
+  return shared_buf_alloc(response, len);
+}
+
+static void accept_client(event_handler *self, uint32_t events)
+{
+  for (;;) {
+    const int cli_fd = accept4(self->fd, 0, 0, SOCK_NONBLOCK);
+    if (0 > cli_fd) {
+      return;
+    }
+    if (!ADMISSION.admit(&ADMISSION)) {
+      close(cli_fd);
+      continue;
+    }
+
+    http_conn *c = init_conn(cli_fd);
+    if (c)
+      ++CONNS;
+    if ( (!c) || (0 != REACTOR.register_eh(&REACTOR, &c->eh)) ) {
+      if (c)
+        destroy_conn(c);
+      else
+        close(cli_fd);
+    }
+  }
+}
+
+static void handle_conn(event_handler *self, uint32_t events)
+{
+  http_conn *c = (http_conn *) self->ctx;
+
+  if ( (events & EPOLLIN) && (!c->closing) ) {
+    c->fr.eh.handle_event(&c->fr.eh, events);
+    if (c->lost) {
+      destroy_conn(c);
+      return;
+    }
+  }
+
+  if (0 != REACTOR.defer_flush(&REACTOR, self, flush_conn)) {
+    flush_conn(self);
+  }
+}
+
+static void flush_conn(event_handler *self)
+{
+  const size_t max_pending = 256 * 1024;
+  http_conn *c = (http_conn *) self->ctx;
+
+  if ( (c->out.pending(&c->out)) && (0 > c->out.flush(&c->out, self->fd)) ) {
+    destroy_conn(c);
+    return;
+  }
+
+  const size_t pending = c->out.pending(&c->out);
+  if ( (c->closing) && (0 == pending) ) {
+    destroy_conn(c);
+    return;
+  }
+
+  const uint32_t wanted = (pending) ? ( (pending < max_pending) && (!c->closing) ? EPOLLIN | EPOLLOUT : EPOLLOUT )
+                                    : EPOLLIN;
+  if (wanted != c->events) {
+    REACTOR.modify_eh(&REACTOR, self, wanted);
+    c->events = wanted;
+  }
+}
+
+static void handle_requests(framer *f, const frame *frames, size_t cnt, void *arg)
+{
+  http_conn *c = (http_conn *) arg;
+
+  for (size_t i = 0; (i < cnt) && (!c->closing); ++i) {
+    const char *req = frames[i].data;
+    const size_t len = frames[i].len;
+    const char *path = memchr(req, ' ', len);
+    const char *line_end = framer_find_byte(req, len, '\r');
+    if ( (!path) || (!line_end) || (path > line_end) ) {
+      c->closing = 1;
+      break;
+    }
+    ++path;
+    const char *path_end = memchr(path, ' ', line_end - path);
+    if (!path_end) {
+      c->closing = 1;
+      break;
+    }
+
+    const size_t path_len = path_end - path;
+    shared_buf *response = NOT_FOUND;
+    if ( (10 == path_len) && (0 == memcmp(path, "/plaintext", path_len)) )
+      response = PLAINTEXT;
+    else if ( (5 == path_len) && (0 == memcmp(path, "/json", path_len)) )
+      response = JSON;
+    c->out.push(&c->out, response, 0, shared_buf_size(response));
+
+    size_t value_len = 0;
+    const char *connection = find_header(line_end, len - (line_end - req), "connection", &value_len);
+    const int http10 = (line_end - path_end >= 9) && (0 == memcmp(line_end - 3, "1.0", 3));
+    if (connection)
+      c->closing = (5 == value_len) && (0 == strncasecmp(connection, "close", 5));
+    else
+      c->closing = http10;
+    c->closing |= DRAINING;
+  }
+}
+
+static void client_lost(framer *f, int err, void *arg)
+{
+  ((http_conn *) arg)->lost = 1;
+}
+
+static ssize_t decode_request(const decoder *self, const char *data, size_t len, frame *f)
+{
+  const size_t scan_len = (len > self->size) ? self->size : len;
+  size_t pos = 0;
+
+  for (;;) {
+    const char *lf = framer_find_byte(data + pos, scan_len - pos, '\n');
+    if (!lf) {
+      return (len >= self->size) ? -1 : 0;
+    }
+    pos = lf - data + 1;
+    if ( (pos >= 4) && (0 == memcmp(lf - 3, "\r\n\r\n", 4)) )
+      break;
+  }
+
+  size_t body_len = 0;
+  size_t value_len = 0;
+  const char *content_length = find_header(data, pos, "content-length", &value_len);
+  if (content_length) {
+    body_len = strtoul(content_length, 0, 10);
+    if (body_len > self->size - pos) {
+      return -1;
+    }
+  }
+  if (len < pos + body_len) {
+    return 0;
+  }
+
+  f->data = data;
+  f->len = pos + body_len;
+
+  return f->len;
+}
+
+static const char * find_header(const char *headers, size_t len, const char *name, size_t *value_len)
+{
+  const size_t name_len = strlen(name);
+  const char *end = headers + len;
+  const char *line = headers;
+
+  while (line < end) {
+    const char *lf = framer_find_byte(line, end - line, '\n');
+    if (!lf) {
+      break;
+    }
+    line = lf + 1;
+    if ( (end - line > (ssize_t) name_len) && (':' == line[name_len]) &&
+         (0 == strncasecmp(line, name, name_len)) ) {
+      const char *value = line + name_len + 1;
+      while ( (value < end) && (' ' == *value) )
+        ++value;
+      const char *value_end = value;
+      while ( (value_end < end) && ('\r' != *value_end) && ('\n' != *value_end) )
+        ++value_end;
+      *value_len = value_end - value;
+      return value;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,314 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/admission.h"
+    #include "reactor/os_sim.h"
+  }
+#endif
+
+#include <string.h>
+#include <map>
+#include <vector>
+#include <utility>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct watched_reactor {
+  reactor r;
+  uint64_t busy_ns;
+  unsigned long full_batches;
+  reactor_hook hook;
+  void *hook_arg;
+  vector<pair<const event_handler *, uint32_t> > modified;
+  map<const event_handler *, uint32_t> interest;
+};
+
+/* listeners are registered as edge triggered, which pausing must preserve */
+static const uint32_t registered = EPOLLIN | EPOLLET;
+static const uint32_t paused = EPOLLET;
+
+static uint64_t fake_now_ns = 0;
+
+static watched_reactor * as_watched(reactor *r)
+{
+  return reinterpret_cast<watched_reactor *>(r);
+}
+
+static int fake_get_activity(reactor *self, reactor_activity *activity)
+{
+  memset(activity, 0, sizeof(reactor_activity));
+  activity->busy_ns = as_watched(self)->busy_ns;
+  return 0;
+}
+
+static int fake_get_load(reactor *self, reactor_load *load)
+{
+  memset(load, 0, sizeof(reactor_load));
+  load->full_batches = as_watched(self)->full_batches;
+  return 0;
+}
+
+static int fake_add_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg)
+{
+  if (REACTOR_PHASE_CHECK != phase)
+    return -1;
+  as_watched(self)->hook = hook;
+  as_watched(self)->hook_arg = arg;
+  return 0;
+}
+
+static int fake_remove_hook(reactor *self, reactor_phase phase, reactor_hook hook, void *arg)
+{
+  as_watched(self)->hook = 0;
+  return 0;
+}
+
+static int fake_modify_eh(reactor *self, const event_handler *eh, uint32_t events)
+{
+  as_watched(self)->modified.push_back(make_pair(eh, events));
+  as_watched(self)->interest[eh] = events;
+  return 0;
+}
+
+static int fake_get_interest(reactor *self, const event_handler *eh, uint32_t *events)
+{
+  map<const event_handler *, uint32_t>::const_iterator it = as_watched(self)->interest.find(eh);
+  *events = (as_watched(self)->interest.end() != it) ? it->second : registered;
+  return 0;
+}
+
+static int fake_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  ts->tv_sec = fake_now_ns / 1000000000ULL;
+  ts->tv_nsec = fake_now_ns % 1000000000ULL;
+  return 0;
+}
+
+static void init_fake(watched_reactor &f, os &o)
+{
+  memset(&f.r, 0, sizeof(f.r));
+  f.busy_ns = 0;
+  f.full_batches = 0;
+  f.hook = 0;
+  f.hook_arg = 0;
+  f.r.get_activity = fake_get_activity;
+  f.r.get_load = fake_get_load;
+  f.r.add_hook = fake_add_hook;
+  f.r.remove_hook = fake_remove_hook;
+  f.r.modify_eh = fake_modify_eh;
+  f.r.get_interest = fake_get_interest;
+  memset(&o, 0, sizeof(o));
+  o.clock_gettime = fake_clock_gettime;
+  fake_now_ns = 1000000000ULL;
+}
+
+static void check(watched_reactor &f, int cnt)
+{
+  for (int i = 0; i < cnt; ++i)
+    f.hook(&f.r, f.hook_arg);
+}
+
+static void log_state(admission *a, int overloaded, void *arg)
+{
+  ((vector<int> *) arg)->push_back(overloaded);
+}
+
+TEST(tests_admission, init_with_nulls_and_defaults)
+{
+  watched_reactor f;
+  os o;
+  init_fake(f, o);
+  admission a;
+  ASSERT_NE(admission_init(0, &f.r, &o, 0, 0, 0), 0);
+  ASSERT_NE(admission_init(&a, 0, &o, 0, 0, 0), 0);
+  ASSERT_NE(admission_init(&a, &f.r, 0, 0, 0, 0), 0);
+  o.clock_gettime = 0;
+  ASSERT_EQ(admission_alloc(&f.r, &o, 0, 0, 0), nullptr);
+  o.clock_gettime = fake_clock_gettime;
+
+  admission *dyn = admission_alloc(&f.r, &o, 0, 0, 0);
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_NE(f.hook, nullptr);
+  event_handler eh;
+  ASSERT_EQ(dyn->add_listener(dyn, &eh), 0);
+  ASSERT_NE(dyn->add_listener(dyn, &eh), 0);
+  ASSERT_EQ(dyn->remove_listener(dyn, &eh), 0);
+  ASSERT_NE(dyn->remove_listener(dyn, &eh), 0);
+  ASSERT_EQ(dyn->admit(dyn), 1);
+  ASSERT_EQ(dyn->read_budget(dyn, 4096), 4096u);
+  admission_stats stats;
+  ASSERT_EQ(dyn->get_stats(dyn, &stats), 0);
+  ASSERT_EQ(stats.overloaded, 0);
+  dyn->destroy(dyn);
+  ASSERT_EQ(f.hook, nullptr);
+  ASSERT_TRUE(f.modified.empty());
+}
+
+TEST(tests_admission, loop_lag_starts_overload_which_ends_with_hysteresis)
+{
+  watched_reactor f;
+  os o;
+  init_fake(f, o);
+  admission_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.policy = ADMISSION_PAUSE_LISTENERS | ADMISSION_REJECT | ADMISSION_LIMIT_READS;
+  cfg.high_lag_us = 1000;
+  cfg.low_lag_us = 500;
+  cfg.hold_ms = 10;
+  vector<int> states;
+  admission a;
+  ASSERT_EQ(admission_init(&a, &f.r, &o, &cfg, log_state, &states), 0);
+  event_handler listener;
+  ASSERT_EQ(a.add_listener(&a, &listener), 0);
+
+  f.busy_ns = 4000000;
+  check(f, 2);
+  ASSERT_TRUE(states.empty());
+  check(f, 1);
+  ASSERT_EQ(states, vector<int>({ 1 }));
+  ASSERT_EQ(f.modified.size(), 1u);
+  ASSERT_EQ(f.modified[0].first, &listener);
+  ASSERT_EQ(f.modified[0].second, paused);
+  ASSERT_EQ(a.admit(&a), 0);
+  ASSERT_EQ(a.read_budget(&a, 4096), 1024u);
+  ASSERT_EQ(a.read_budget(&a, 2), 1u);
+
+  f.busy_ns = 0;
+  check(f, 20);
+  ASSERT_EQ(states, vector<int>({ 1 }));
+  /* spike after calm checks restarts hold time */
+  fake_now_ns += 5000000;
+  f.busy_ns = 4000000;
+  check(f, 1);
+  f.busy_ns = 0;
+  check(f, 5);
+  fake_now_ns += 5000000;
+  check(f, 1);
+  ASSERT_EQ(states, vector<int>({ 1 }));
+  fake_now_ns += 5000000;
+  check(f, 1);
+  ASSERT_EQ(states, vector<int>({ 1, 0 }));
+  ASSERT_EQ(f.modified.size(), 2u);
+  ASSERT_EQ(f.modified[1].second, registered);
+  ASSERT_EQ(a.admit(&a), 1);
+  ASSERT_EQ(a.read_budget(&a, 4096), 4096u);
+
+  admission_stats stats;
+  ASSERT_EQ(a.get_stats(&a, &stats), 0);
+  ASSERT_EQ(stats.overloaded, 0);
+  ASSERT_EQ(stats.overloads, 1u);
+  ASSERT_EQ(stats.rejected, 1u);
+  a.destroy(&a);
+  ASSERT_EQ(a.ctx, nullptr);
+}
+
+TEST(tests_admission, full_batches_start_overload_and_listeners_follow_state)
+{
+  watched_reactor f;
+  os o;
+  init_fake(f, o);
+  admission_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.full_batches = 3;
+  admission a;
+  ASSERT_EQ(admission_init(&a, &f.r, &o, &cfg, 0, 0), 0);
+  event_handler first, second;
+  ASSERT_EQ(a.add_listener(&a, &first), 0);
+
+  for (int i = 0; i < 3; ++i) {
+    ++f.full_batches;
+    check(f, 1);
+  }
+  ASSERT_EQ(a.admit(&a), 1);
+  ASSERT_EQ(a.read_budget(&a, 4096), 1024u);
+  ASSERT_EQ(f.modified.size(), 1u);
+  ASSERT_EQ(a.add_listener(&a, &second), 0);
+  ASSERT_EQ(f.modified.size(), 2u);
+  ASSERT_EQ(f.modified[1].first, &second);
+  ASSERT_EQ(f.modified[1].second, paused);
+
+  fake_now_ns += 1000000000ULL;
+  ++f.full_batches;
+  check(f, 1);
+  admission_stats stats;
+  ASSERT_EQ(a.get_stats(&a, &stats), 0);
+  ASSERT_EQ(stats.overloaded, 1);
+  ASSERT_EQ(stats.full_batches, 4u);
+
+  ASSERT_EQ(a.remove_listener(&a, &second), 0);
+  ASSERT_EQ(f.modified.back().second, registered);
+  a.destroy(&a);
+  ASSERT_EQ(f.modified.back().first, &first);
+  ASSERT_EQ(f.modified.back().second, registered);
+}
+
+struct flood {
+  reactor r;
+  const os *o;
+  admission a;
+  event_handler listener;
+  vector<event_handler> conns;
+};
+
+static void flood_read(event_handler *self, uint32_t events)
+{
+  flood *fl = (flood *) self->ctx;
+  char buf[64];
+  fl->o->read(self->fd, buf, fl->a.read_budget(&fl->a, sizeof(buf)));
+}
+
+static void flood_accept(event_handler *self, uint32_t events)
+{
+  flood *fl = (flood *) self->ctx;
+  int fd = -1;
+  while ( (fl->conns.size() < fl->conns.capacity()) && (0 <= (fd = fl->o->accept(self->fd, 0, 0))) ) {
+    fl->conns.emplace_back();
+    event_handler *eh = &fl->conns.back();
+    memset(eh, 0, sizeof(event_handler));
+    eh->fd = fd;
+    eh->ctx = fl;
+    eh->handle_event = flood_read;
+    fl->r.register_eh(&fl->r, eh);
+  }
+}
+
+TEST(tests_admission, simulated_flood_is_detected_from_full_batches)
+{
+  os o;
+  os_sim_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.duration_ns = 100000000ULL;
+  cfg.arrival_rate = 1000000;
+  ASSERT_EQ(os_sim_init(&o, &cfg), 0);
+
+  flood fl;
+  fl.o = &o;
+  fl.conns.reserve(1000);
+  ASSERT_EQ(reactor_init(&fl.r, &o), 0);
+  admission_config acfg;
+  memset(&acfg, 0, sizeof(acfg));
+  acfg.full_batches = 4;
+  ASSERT_EQ(admission_init(&fl.a, &fl.r, &o, &acfg, 0, 0), 0);
+  memset(&fl.listener, 0, sizeof(fl.listener));
+  fl.listener.fd = o.socket(AF_INET, SOCK_STREAM, 0);
+  fl.listener.ctx = &fl;
+  fl.listener.handle_event = flood_accept;
+  ASSERT_EQ(o.listen(fl.listener.fd, 128), 0);
+  ASSERT_EQ(fl.r.register_eh(&fl.r, &fl.listener), 0);
+  ASSERT_EQ(fl.a.add_listener(&fl.a, &fl.listener), 0);
+  ASSERT_EQ(os_sim_connect(fl.listener.fd, 100), 0);
+
+  fl.r.event_loop(&fl.r);
+  admission_stats stats;
+  ASSERT_EQ(fl.a.get_stats(&fl.a, &stats), 0);
+  ASSERT_GE(stats.overloads, 1u);
+  reactor_load load;
+  ASSERT_EQ(fl.r.get_load(&fl.r, &load), 0);
+  ASSERT_GT(load.full_batches, 0u);
+  ASSERT_EQ(fl.conns.size(), 100u);
+
+  fl.a.destroy(&fl.a);
+  fl.r.destroy(&fl.r);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
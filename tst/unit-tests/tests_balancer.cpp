@@ -0,0 +1,157 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/balancer.h"
+  }
+#endif
+
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct fake_reactor {
+  reactor r;
+  reactor_load load;
+  vector<pair<reactor_task, void *>> tasks;
+  vector<reactor_task> cleanups;
+  reactor *shed_target;
+  double shed_share;
+};
+
+static fake_reactor * as_fake(reactor *r)
+{
+  return reinterpret_cast<fake_reactor *>(r);
+}
+
+static int fake_get_load(reactor *self, reactor_load *load)
+{
+  *load = as_fake(self)->load;
+  return 0;
+}
+
+static int fake_post_with_cleanup(reactor *self, reactor_task task, reactor_task cleanup, void *arg)
+{
+  as_fake(self)->tasks.push_back(make_pair(task, arg));
+  as_fake(self)->cleanups.push_back(cleanup);
+  return 0;
+}
+
+static int fake_shed_load(reactor *self, reactor *target, double share, unsigned int max_cnt,
+                          int (*can_migrate)(const event_handler *e))
+{
+  as_fake(self)->shed_target = target;
+  as_fake(self)->shed_share = share;
+  return 0;
+}
+
+static void fake_init(fake_reactor &f)
+{
+  memset(&f.r, 0, sizeof(f.r));
+  memset(&f.load, 0, sizeof(f.load));
+  f.r.get_load = fake_get_load;
+  f.r.post_with_cleanup = fake_post_with_cleanup;
+  f.r.shed_load = fake_shed_load;
+  f.shed_target = 0;
+  f.shed_share = 0;
+}
+
+static void run_tasks(fake_reactor &f)
+{
+  for (auto &t: f.tasks)
+    t.first(&f.r, t.second);
+  f.tasks.clear();
+  f.cleanups.clear();
+}
+
+static void drop_tasks(fake_reactor &f)
+{
+  for (size_t i = 0; i < f.tasks.size(); ++i)
+    f.cleanups[i](&f.r, f.tasks[i].second);
+  f.tasks.clear();
+  f.cleanups.clear();
+}
+
+TEST(tests_balancer, init_with_invalid_arguments)
+{
+  fake_reactor f1, f2;
+  fake_init(f1);
+  fake_init(f2);
+  reactor *rs[] = { &f1.r, &f2.r };
+  balancer_policy p;
+  memset(&p, 0, sizeof(p));
+
+  balancer b;
+  ASSERT_NE(balancer_init(0, rs, 2, &p), 0);
+  ASSERT_NE(balancer_init(&b, 0, 2, &p), 0);
+  ASSERT_NE(balancer_init(&b, rs, 1, &p), 0);
+  ASSERT_NE(balancer_init(&b, rs, 2, 0), 0);
+  ASSERT_EQ(balancer_alloc(rs, 1, &p), nullptr);
+}
+
+TEST(tests_balancer, balanced_reactors_are_left_untouched)
+{
+  fake_reactor f1, f2;
+  fake_init(f1);
+  fake_init(f2);
+  reactor *rs[] = { &f1.r, &f2.r };
+  balancer_policy p;
+  memset(&p, 0, sizeof(p));
+  p.imbalance_ratio = 2.0;
+  p.min_events = 10;
+  p.max_migrations = 4;
+
+  balancer *b = balancer_alloc(rs, 2, &p);
+  ASSERT_NE(b, nullptr);
+
+  f1.load.events = 100;
+  f2.load.events = 80;
+  ASSERT_EQ(b->rebalance(b), 0);
+
+  f1.load.events += 5;
+  ASSERT_EQ(b->rebalance(b), 0);
+  ASSERT_TRUE(f1.tasks.empty());
+  ASSERT_TRUE(f2.tasks.empty());
+
+  b->destroy(b);
+}
+
+TEST(tests_balancer, busiest_reactor_sheds_to_the_least_busy_one)
+{
+  fake_reactor f1, f2, f3;
+  fake_init(f1);
+  fake_init(f2);
+  fake_init(f3);
+  reactor *rs[] = { &f1.r, &f2.r, &f3.r };
+  balancer_policy p;
+  memset(&p, 0, sizeof(p));
+  p.imbalance_ratio = 2.0;
+  p.min_events = 10;
+  p.max_migrations = 4;
+
+  balancer b;
+  ASSERT_EQ(balancer_init(&b, rs, 3, &p), 0);
+
+  f1.load.events = 50;
+  f2.load.events = 1000;
+  f3.load.events = 200;
+  ASSERT_EQ(b.rebalance(&b), 1);
+  ASSERT_TRUE(f1.tasks.empty());
+  ASSERT_EQ(f2.tasks.size(), 1u);
+  ASSERT_TRUE(f3.tasks.empty());
+
+  run_tasks(f2);
+  ASSERT_EQ(f2.shed_target, &f1.r);
+  ASSERT_DOUBLE_EQ(f2.shed_share, 0.475);
+
+  /* request dropped by destroyed reactor is released by cleanup */
+  f2.load.events += 1000;
+  ASSERT_EQ(b.rebalance(&b), 1);
+  ASSERT_EQ(f2.cleanups.size(), 1u);
+  ASSERT_NE(f2.cleanups[0], nullptr);
+  drop_tasks(f2);
+
+  b.destroy(&b);
+  ASSERT_EQ(b.ctx, nullptr);
+}
@@ -0,0 +1,163 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/buf_pool.h"
+  }
+#endif
+
+#include <string.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+TEST(tests_buf_pool, init_with_invalid_arguments)
+{
+  os o;
+  memset(&o, 0, sizeof(os));
+  buf_pool p;
+  ASSERT_NE(buf_pool_init(&p, &o, 0), 0);
+
+  os_linux_init(&o);
+  ASSERT_NE(buf_pool_init(0, &o, 0), 0);
+
+  buf_pool_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.classes[0] = 4096;
+  cfg.classes[1] = 1024;
+  ASSERT_NE(buf_pool_init(&p, &o, &cfg), 0);
+
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.bind_numa_node = 1;
+  cfg.numa_node = -1;
+  ASSERT_NE(buf_pool_init(&p, &o, &cfg), 0);
+  cfg.numa_node = 0;
+  o.mbind = 0;
+  ASSERT_EQ(buf_pool_alloc(&o, &cfg), nullptr);
+}
+
+static unsigned long bound_mask;
+static int bound_mode;
+static long bind_res;
+
+static int local_node_getcpu(unsigned int *cpu, unsigned int *node)
+{
+  *cpu = 5;
+  *node = 2;
+  return 0;
+}
+
+static long recording_mbind(void *addr, unsigned long len, int mode, const unsigned long *nodemask,
+                            unsigned long maxnode, unsigned int flags)
+{
+  bound_mask = nodemask[0];
+  bound_mode = mode;
+  return bind_res;
+}
+
+TEST(tests_buf_pool, memory_is_reserved_lazily_and_recycled)
+{
+  os o;
+  os_linux_init(&o);
+  buf_pool p;
+  ASSERT_EQ(buf_pool_init(&p, &o, 0), 0);
+
+  buf_pool_stats stats;
+  ASSERT_EQ(p.get_stats(&p, &stats), 0);
+  ASSERT_EQ(stats.reserved_bytes, 0u);
+
+  io_buf *b = p.acquire(&p, 1000);
+  ASSERT_NE(b, nullptr);
+  ASSERT_EQ(b->size, 2048u);
+  ASSERT_EQ(b->begin, 0u);
+  ASSERT_EQ(b->end, 0u);
+  memset(b->data, 'x', b->size);
+  b->end = b->size;
+
+  ASSERT_EQ(p.get_stats(&p, &stats), 0);
+  ASSERT_GT(stats.reserved_bytes, 0u);
+  ASSERT_EQ(stats.used_bytes, 2048u);
+
+  p.release(&p, b);
+  ASSERT_EQ(p.get_stats(&p, &stats), 0);
+  ASSERT_EQ(stats.used_bytes, 0u);
+
+  io_buf *again = p.acquire(&p, 2048);
+  ASSERT_EQ(again, b);
+  ASSERT_EQ(again->end, 0u);
+  p.release(&p, again);
+
+  ASSERT_EQ(p.acquire(&p, 1024 * 1024), nullptr);
+
+  p.destroy(&p);
+  ASSERT_EQ(p.ctx, nullptr);
+}
+
+TEST(tests_buf_pool, custom_classes_and_chunks)
+{
+  os o;
+  os_linux_init(&o);
+  buf_pool_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.classes[0] = 512;
+  cfg.classes[1] = 4096;
+  cfg.chunk_size = 4096;
+
+  buf_pool *p = buf_pool_alloc(&o, &cfg);
+  ASSERT_NE(p, nullptr);
+
+  vector<io_buf *> bufs;
+  for (int i = 0; i < 9; ++i) {
+    bufs.push_back(p->acquire(p, 100));
+    ASSERT_NE(bufs.back(), nullptr);
+    ASSERT_EQ(bufs.back()->size, 512u);
+  }
+
+  buf_pool_stats stats;
+  ASSERT_EQ(p->get_stats(p, &stats), 0);
+  ASSERT_EQ(stats.reserved_bytes, 2u * 4096u);
+  ASSERT_EQ(stats.used_bytes, 9u * 512u);
+
+  for (auto b: bufs)
+    p->release(p, b);
+  p->destroy(p);
+}
+
+TEST(tests_buf_pool, chunks_are_placed_through_os_proxy)
+{
+  os o;
+  os_linux_init(&o);
+  o.getcpu = local_node_getcpu;
+  o.mbind = recording_mbind;
+  buf_pool_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.chunk_size = 4096;
+
+  /* zeroed config prefers the local node and tolerates failed placement */
+  bound_mask = 0;
+  bind_res = -1;
+  buf_pool p;
+  ASSERT_EQ(buf_pool_init(&p, &o, &cfg), 0);
+  io_buf *b = p.acquire(&p, 100);
+  ASSERT_NE(b, nullptr);
+  ASSERT_EQ(bound_mask, 1UL << 2);
+  ASSERT_EQ(bound_mode, 1); /* MPOL_PREFERRED */
+  p.release(&p, b);
+  p.destroy(&p);
+
+  cfg.bind_numa_node = 1;
+  cfg.numa_node = 1;
+  ASSERT_EQ(buf_pool_init(&p, &o, &cfg), 0);
+  ASSERT_EQ(p.acquire(&p, 100), nullptr);
+  ASSERT_EQ(bound_mask, 1UL << 1);
+  ASSERT_EQ(bound_mode, 2); /* MPOL_BIND */
+  buf_pool_stats stats;
+  ASSERT_EQ(p.get_stats(&p, &stats), 0);
+  ASSERT_EQ(stats.reserved_bytes, 0u);
+
+  bind_res = 0;
+  b = p.acquire(&p, 100);
+  ASSERT_NE(b, nullptr);
+  p.release(&p, b);
+  p.destroy(&p);
+}
@@ -0,0 +1,129 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/buffer.h"
+  }
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+static void count_release(const void *data, void *arg)
+{
+  ++*static_cast<int *>(arg);
+}
+
+static string read_all(int fd)
+{
+  char buff[4096];
+  const ssize_t cnt = read(fd, buff, sizeof(buff));
+  return (cnt > 0) ? string(buff, cnt) : string();
+}
+
+TEST(tests_buffer, shared_buf_is_released_with_last_reference)
+{
+  static const char payload[] = "payload";
+  int released = 0;
+  shared_buf *b = shared_buf_wrap(payload, sizeof(payload) - 1, count_release, &released);
+  ASSERT_NE(b, nullptr);
+  ASSERT_EQ(shared_buf_data(b), payload);
+  ASSERT_EQ(shared_buf_size(b), sizeof(payload) - 1);
+
+  ASSERT_EQ(shared_buf_ref(b), b);
+  shared_buf_unref(b);
+  ASSERT_EQ(released, 0);
+  shared_buf_unref(b);
+  ASSERT_EQ(released, 1);
+
+  ASSERT_EQ(shared_buf_alloc(0, 1), nullptr);
+}
+
+TEST(tests_buffer, push_validates_slices)
+{
+  os o;
+  os_linux_init(&o);
+  out_queue q;
+  ASSERT_EQ(out_queue_init(&q, &o), 0);
+
+  shared_buf *b = shared_buf_alloc("abc", 3);
+  ASSERT_NE(q.push(&q, 0, 0, 0), 0);
+  ASSERT_NE(q.push(&q, b, 4, 0), 0);
+  ASSERT_NE(q.push(&q, b, 1, 3), 0);
+  ASSERT_EQ(q.push(&q, b, 1, 2), 0);
+  ASSERT_EQ(q.pending(&q), 2u);
+
+  shared_buf_unref(b);
+  q.destroy(&q);
+  ASSERT_EQ(q.ctx, nullptr);
+}
+
+TEST(tests_buffer, broadcast_shares_one_buffer_between_queues)
+{
+  os o;
+  os_linux_init(&o);
+  const size_t subscribers = 3;
+  int fds[subscribers][2];
+  vector<out_queue *> qs;
+  for (size_t i = 0; i < subscribers; ++i) {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]), 0);
+    qs.push_back(out_queue_alloc(&o));
+    ASSERT_NE(qs.back(), nullptr);
+  }
+
+  static const char header[] = "hdr:";
+  static const char payload[] = "broadcast";
+  int released = 0;
+  shared_buf *h = shared_buf_alloc(header, sizeof(header) - 1);
+  shared_buf *b = shared_buf_wrap(payload, sizeof(payload) - 1, count_release, &released);
+  ASSERT_EQ(out_queue_broadcast(qs.data(), qs.size(), h), subscribers);
+  ASSERT_EQ(out_queue_broadcast(qs.data(), qs.size(), b), subscribers);
+  shared_buf_unref(h);
+  shared_buf_unref(b);
+
+  for (size_t i = 0; i < subscribers; ++i) {
+    ASSERT_EQ(qs[i]->flush(qs[i], fds[i][0]), (ssize_t) (sizeof(header) + sizeof(payload) - 2));
+    ASSERT_EQ(qs[i]->pending(qs[i]), 0u);
+    ASSERT_EQ(read_all(fds[i][1]), string("hdr:broadcast"));
+    ASSERT_EQ(released, (i + 1 == subscribers) ? 1 : 0);
+  }
+
+  for (size_t i = 0; i < subscribers; ++i) {
+    qs[i]->destroy(qs[i]);
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+}
+
+TEST(tests_buffer, partial_flush_keeps_remaining_bytes)
+{
+  os o;
+  os_linux_init(&o);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  ASSERT_EQ(fcntl(fds[0], F_SETFL, O_NONBLOCK), 0);
+
+  out_queue q;
+  ASSERT_EQ(out_queue_init(&q, &o), 0);
+  const size_t chunk = 64 * 1024;
+  vector<char> data(chunk, 'x');
+  shared_buf *b = shared_buf_alloc(data.data(), data.size());
+  for (int i = 0; i < 64; ++i)
+    ASSERT_EQ(q.push(&q, b, 0, chunk), 0);
+  shared_buf_unref(b);
+
+  const size_t total = 64 * chunk;
+  const ssize_t written = q.flush(&q, fds[0]);
+  ASSERT_GT(written, 0);
+  ASSERT_LT((size_t) written, total);
+  ASSERT_EQ(q.pending(&q), total - written);
+
+  q.destroy(&q);
+  close(fds[0]);
+  close(fds[1]);
+}
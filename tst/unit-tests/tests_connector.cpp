@@ -0,0 +1,239 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/conn_pool.h"
+  }
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+static int listen_on_loopback(struct sockaddr_in *addr)
+{
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(addr, 0, sizeof(*addr));
+  addr->sin_family = AF_INET;
+  addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t len = sizeof(*addr);
+  if ( (0 != bind(fd, (struct sockaddr *) addr, len)) || (0 != listen(fd, 16)) ||
+       (0 != getsockname(fd, (struct sockaddr *) addr, &len)) ) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+struct outcome {
+  reactor *r;
+  int fd = -2;
+  int err = -1;
+  int calls = 0;
+};
+
+static void on_connected(connector *c, int fd, int err, void *arg)
+{
+  outcome *res = static_cast<outcome *>(arg);
+  res->fd = fd;
+  res->err = err;
+  ++res->calls;
+  res->r->stop(res->r);
+}
+
+static void on_acquired(conn_pool *p, int fd, int err, void *arg)
+{
+  outcome *res = static_cast<outcome *>(arg);
+  res->fd = fd;
+  res->err = err;
+  ++res->calls;
+  res->r->stop(res->r);
+}
+
+TEST(tests_connector, init_with_invalid_arguments)
+{
+  os o;
+  memset(&o, 0, sizeof(os));
+  reactor r;
+  connector c;
+  ASSERT_NE(connector_init(&c, &r, &o), 0);
+  os_linux_init(&o);
+  ASSERT_NE(connector_init(&c, 0, &o), 0);
+  ASSERT_NE(connector_init(0, &r, &o), 0);
+}
+
+TEST(tests_connector, connect_succeeds_and_fails)
+{
+  os o;
+  os_linux_init(&o);
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  connector *c = connector_alloc(&r, &o);
+  ASSERT_NE(c, nullptr);
+
+  struct sockaddr_in addr;
+  const int srv_fd = listen_on_loopback(&addr);
+  ASSERT_LE(0, srv_fd);
+
+  outcome ok;
+  ok.r = &r;
+  ASSERT_EQ(c->connect(c, (struct sockaddr *) &addr, sizeof(addr), 1000, on_connected, &ok), 0);
+  ASSERT_EQ(ok.calls, 0);
+  r.event_loop(&r);
+  ASSERT_EQ(ok.calls, 1);
+  ASSERT_EQ(ok.err, 0);
+  ASSERT_LE(0, ok.fd);
+  close(ok.fd);
+
+  close(srv_fd);
+  outcome refused;
+  refused.r = &r;
+  ASSERT_EQ(c->connect(c, (struct sockaddr *) &addr, sizeof(addr), 1000, on_connected, &refused), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(refused.calls, 1);
+  ASSERT_EQ(refused.err, ECONNREFUSED);
+  ASSERT_EQ(refused.fd, -1);
+
+  c->destroy(c);
+  r.destroy(&r);
+}
+
+TEST(tests_connector, pool_reuses_healthy_idle_connections)
+{
+  os o;
+  os_linux_init(&o);
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  conn_pool_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.max_idle = 1;
+  cfg.connect_timeout_ms = 1000;
+  conn_pool p;
+  ASSERT_EQ(conn_pool_init(&p, &r, &o, &cfg), 0);
+
+  struct sockaddr_in addr;
+  const int srv_fd = listen_on_loopback(&addr);
+  ASSERT_LE(0, srv_fd);
+  const char *key = "upstream";
+
+  outcome first;
+  first.r = &r;
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), on_acquired, &first), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(first.err, 0);
+  ASSERT_LE(0, first.fd);
+  const int peer_fd = accept(srv_fd, 0, 0);
+  ASSERT_LE(0, peer_fd);
+
+  p.release(&p, key, first.fd, 1);
+  ASSERT_EQ(p.idle(&p, key), 1u);
+
+  outcome reused;
+  reused.r = &r;
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), on_acquired, &reused), 0);
+  ASSERT_EQ(reused.calls, 0);
+  r.event_loop(&r);
+  ASSERT_EQ(reused.err, 0);
+  ASSERT_EQ(reused.fd, first.fd);
+  ASSERT_EQ(p.idle(&p, key), 0u);
+
+  p.release(&p, key, reused.fd, 1);
+  close(peer_fd);
+  outcome fresh;
+  fresh.r = &r;
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), on_acquired, &fresh), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(fresh.err, 0);
+  ASSERT_LE(0, fresh.fd);
+  ASSERT_EQ(p.idle(&p, key), 0u);
+
+  p.release(&p, key, fresh.fd, 0);
+  ASSERT_EQ(p.idle(&p, key), 0u);
+
+  close(srv_fd);
+  p.destroy(&p);
+  ASSERT_EQ(p.ctx, nullptr);
+  r.destroy(&r);
+}
+
+struct acquire_log {
+  vector<pair<int, int>> *calls;
+  int tag;
+};
+
+static void log_acquired(conn_pool *p, int fd, int err, void *arg)
+{
+  acquire_log *log = static_cast<acquire_log *>(arg);
+  log->calls->push_back(make_pair(log->tag, err));
+  if (0 <= fd)
+    p->release(p, "upstream", fd, 1);
+}
+
+TEST(tests_connector, pool_serves_in_acquire_order_and_cancels_pending_on_destroy)
+{
+  os o;
+  os_linux_init(&o);
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  conn_pool_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.max_idle = 2;
+  cfg.connect_timeout_ms = 1000;
+  conn_pool p;
+  ASSERT_EQ(conn_pool_init(&p, &r, &o, &cfg), 0);
+
+  struct sockaddr_in addr;
+  const int srv_fd = listen_on_loopback(&addr);
+  ASSERT_LE(0, srv_fd);
+  const char *key = "upstream";
+
+  outcome first, second;
+  first.r = &r;
+  second.r = &r;
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), on_acquired, &first), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), on_acquired, &second), 0);
+  r.event_loop(&r);
+  ASSERT_LE(0, first.fd);
+  ASSERT_LE(0, second.fd);
+  const int peer1 = accept(srv_fd, 0, 0);
+  const int peer2 = accept(srv_fd, 0, 0);
+  p.release(&p, key, first.fd, 1);
+  p.release(&p, key, second.fd, 1);
+  ASSERT_EQ(p.idle(&p, key), 2u);
+
+  vector<pair<int, int>> calls;
+  acquire_log log[3];
+  for (int i = 0; i < 3; ++i) {
+    log[i].calls = &calls;
+    log[i].tag = i;
+  }
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), log_acquired, &log[0]), 0);
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), log_acquired, &log[1]), 0);
+  ASSERT_EQ(r.post(&r, [](reactor *r, void *arg) { r->stop(r); }, 0), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(calls, (vector<pair<int, int>>{ { 0, 0 }, { 1, 0 } }));
+  ASSERT_EQ(p.idle(&p, key), 2u);
+
+  /* two acquires are served from idle but not delivered yet, the third one connects */
+  calls.clear();
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), log_acquired, &log[0]), 0);
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), log_acquired, &log[1]), 0);
+  ASSERT_EQ(p.acquire(&p, key, (struct sockaddr *) &addr, sizeof(addr), log_acquired, &log[2]), 0);
+  ASSERT_EQ(p.idle(&p, key), 0u);
+  p.destroy(&p);
+  ASSERT_EQ(calls, (vector<pair<int, int>>{ { 0, ECANCELED }, { 1, ECANCELED }, { 2, ECANCELED } }));
+
+  close(peer1);
+  close(peer2);
+  close(srv_fd);
+  r.destroy(&r);
+}
@@ -0,0 +1,192 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/coro.h"
+  }
+#endif
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct echo_frame {
+  reactor *r;
+  char buf[64];
+  size_t len;
+  int reads;
+  int sleeps;
+  ssize_t last_res;
+};
+
+static int echo_body(coro *co)
+{
+  echo_frame *f = (echo_frame *) co->frame;
+  CORO_BEGIN(co);
+  for (;;) {
+    CORO_READ(co, f->buf, sizeof(f->buf));
+    ++f->reads;
+    if (co->res <= 0)
+      break;
+    f->len = co->res;
+    CORO_SLEEP(co, 5);
+    ++f->sleeps;
+    CORO_WRITE(co, "echo:", 5);
+    CORO_WRITE(co, f->buf, f->len);
+  }
+  f->last_res = co->res;
+  CORO_END(co);
+}
+
+static void stop_on_done(coro *co, void *arg)
+{
+  reactor *r = (reactor *) arg;
+  r->stop(r);
+}
+
+static int non_blocking_pair(int sv[2])
+{
+  if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
+    return -1;
+  return fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+}
+
+static uint64_t now_ms()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL;
+}
+
+TEST(tests_coro, init_with_wrong_args)
+{
+  os o;
+  memset(&o, 0, sizeof(o));
+  reactor r;
+  coro co;
+  ASSERT_NE(coro_init(&co, 0, &o, 3, echo_body, 0, 0, 0), 0);
+
+  os_linux_init(&o);
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(coro_init(0, &r, &o, 3, echo_body, 0, 0, 0), 0);
+  ASSERT_NE(coro_init(&co, &r, 0, 3, echo_body, 0, 0, 0), 0);
+  ASSERT_NE(coro_init(&co, &r, &o, -1, echo_body, 0, 0, 0), 0);
+  ASSERT_NE(coro_init(&co, &r, &o, 3, 0, 0, 0, 0), 0);
+  o.timerfd_create = 0;
+  ASSERT_EQ(coro_alloc(&r, &o, 3, echo_body, 0, 0, 0), nullptr);
+  os_linux_init(&o);
+
+  coro *dyn = coro_alloc(&r, &o, 12345, echo_body, 0, 0, 0);
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_NE(dyn->start(dyn), 0);
+  dyn->destroy(dyn);
+  r.destroy(&r);
+}
+
+TEST(tests_coro, sequential_echo_reads_sleeps_and_writes)
+{
+  os o;
+  os_linux_init(&o);
+  int sv[2];
+  ASSERT_EQ(non_blocking_pair(sv), 0);
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  echo_frame f;
+  memset(&f, 0, sizeof(f));
+  coro co;
+  ASSERT_EQ(coro_init(&co, &r, &o, sv[0], echo_body, &f, stop_on_done, &r), 0);
+
+  ASSERT_EQ(write(sv[1], "ping", 4), 4);
+  ASSERT_EQ(co.start(&co), 0);
+  ASSERT_NE(co.start(&co), 0);
+  ASSERT_EQ(f.reads, 1);
+  ASSERT_EQ(f.sleeps, 0);
+  shutdown(sv[1], SHUT_WR);
+
+  const uint64_t started_ms = now_ms();
+  r.event_loop(&r);
+  ASSERT_GE(now_ms() - started_ms, 5u);
+  ASSERT_EQ(f.reads, 2);
+  ASSERT_EQ(f.sleeps, 1);
+  ASSERT_EQ(f.last_res, 0);
+  ASSERT_EQ(co.line, -1);
+  char buf[16];
+  ASSERT_EQ(read(sv[1], buf, sizeof(buf)), 9);
+  ASSERT_EQ(string(buf, 9), "echo:ping");
+  ASSERT_NE(co.start(&co), 0);
+
+  co.destroy(&co);
+  ASSERT_EQ(co.ctx, nullptr);
+  r.destroy(&r);
+  close(sv[0]);
+  close(sv[1]);
+}
+
+struct bulk_frame {
+  string out;
+  size_t chunks;
+  int err;
+};
+
+static int bulk_body(coro *co)
+{
+  bulk_frame *f = (bulk_frame *) co->frame;
+  CORO_BEGIN(co);
+  while (f->chunks) {
+    CORO_WRITE(co, f->out.data(), f->out.size());
+    if (co->res < 0) {
+      f->err = co->err;
+      break;
+    }
+    --f->chunks;
+  }
+  CORO_END(co);
+}
+
+static void destroy_on_done(coro *co, void *arg)
+{
+  reactor *r = (reactor *) arg;
+  co->destroy(co);
+  r->stop(r);
+}
+
+TEST(tests_coro, write_waits_for_writable_socket_and_callback_may_destroy)
+{
+  os o;
+  os_linux_init(&o);
+  int sv[2];
+  ASSERT_EQ(non_blocking_pair(sv), 0);
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  bulk_frame f;
+  f.out = string(256 * 1024, 'x');
+  f.chunks = 8;
+  f.err = 0;
+  coro *co = coro_alloc(&r, &o, sv[0], bulk_body, &f, destroy_on_done, &r);
+  ASSERT_NE(co, nullptr);
+
+  size_t received = 0;
+  thread reader([&sv, &received]() {
+    char buf[65536];
+    ssize_t n;
+    while (0 < (n = read(sv[1], buf, sizeof(buf))))
+      received += n;
+  });
+  ASSERT_EQ(co->start(co), 0);
+  ASSERT_GT(f.chunks, 0u);
+  r.event_loop(&r);
+  ASSERT_EQ(f.chunks, 0u);
+  ASSERT_EQ(f.err, 0);
+  close(sv[0]);
+  reader.join();
+  ASSERT_EQ(received, 8 * f.out.size());
+
+  r.destroy(&r);
+  close(sv[1]);
+}
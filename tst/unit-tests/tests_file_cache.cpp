@@ -0,0 +1,267 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/file_cache.h"
+  }
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct file_cache_run {
+  reactor r;
+  file_cache c;
+  size_t expected;
+  vector<const file_entry *> entries;
+  vector<int> errs;
+};
+
+static string cached_file(const string &name, const string &content)
+{
+  const string path = "/tmp/tests_file_cache." + to_string(getpid()) + "." + name;
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  write(fd, content.data(), content.size());
+  close(fd);
+  return path;
+}
+
+static void loaded(file_cache *c, const file_entry *e, int err, void *arg)
+{
+  file_cache_run *run = (file_cache_run *) arg;
+  run->entries.push_back(e);
+  run->errs.push_back(err);
+  if (run->entries.size() == run->expected)
+    run->r.stop(&run->r);
+}
+
+static void load_all(file_cache_run &run, const vector<string> &paths)
+{
+  run.expected = run.entries.size() + paths.size();
+  for (const string &path : paths)
+    ASSERT_EQ(run.c.load(&run.c, path.c_str(), loaded, &run), 0);
+  run.r.event_loop(&run.r);
+  ASSERT_EQ(run.entries.size(), run.expected);
+}
+
+static string receive(int fd, size_t len)
+{
+  string res(len, '\0');
+  size_t got = 0;
+  while (got < len) {
+    const ssize_t n = read(fd, &res[got], len - got);
+    if (n <= 0)
+      break;
+    got += n;
+  }
+  res.resize(got);
+  return res;
+}
+
+TEST(tests_file_cache, init_with_wrong_args)
+{
+  os o;
+  memset(&o, 0, sizeof(o));
+  reactor r;
+  file_cache c;
+  ASSERT_NE(file_cache_init(&c, 0, &o, 0), 0);
+
+  os_linux_init(&o);
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(file_cache_init(0, &r, &o, 0), 0);
+  ASSERT_NE(file_cache_init(&c, &r, 0, 0), 0);
+  o.sendfile = 0;
+  ASSERT_EQ(file_cache_alloc(&r, &o, 0), nullptr);
+  os_linux_init(&o);
+
+  file_cache *dyn = file_cache_alloc(&r, &o, 0);
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_EQ(dyn->acquire(dyn, "/nonexistent"), nullptr);
+  ASSERT_NE(dyn->load(dyn, "/nonexistent", 0, 0), 0);
+  ASSERT_NE(dyn->invalidate(dyn, "/nonexistent"), 0);
+  file_cache_stats stats;
+  ASSERT_EQ(dyn->get_stats(dyn, &stats), 0);
+  ASSERT_EQ(stats.entries, 0u);
+  dyn->destroy(dyn);
+  r.destroy(&r);
+}
+
+TEST(tests_file_cache, concurrent_loads_are_merged_and_hits_do_not_block)
+{
+  os o;
+  os_linux_init(&o);
+  const string path = cached_file("index", "<html></html>");
+  file_cache_run run;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  ASSERT_EQ(file_cache_init(&run.c, &run.r, &o, 0), 0);
+
+  load_all(run, { path, path });
+  ASSERT_EQ(run.entries[0], run.entries[1]);
+  ASSERT_EQ(run.errs[0], 0);
+  load_all(run, { "/nonexistent/file" });
+  ASSERT_EQ(run.entries[2], nullptr);
+  ASSERT_EQ(run.errs[2], ENOENT);
+  const file_entry *e = run.entries[0];
+  ASSERT_STREQ(e->path, path.c_str());
+  ASSERT_EQ(e->size, 13u);
+  ASSERT_NE(e->data, nullptr);
+  ASSERT_EQ(memcmp(e->data, "<html></html>", 13), 0);
+  ASSERT_NE(run.c.load(&run.c, path.c_str(), loaded, &run), 0);
+
+  run.c.release(&run.c, e);
+  run.c.release(&run.c, e);
+  ASSERT_EQ(run.c.acquire(&run.c, path.c_str()), e);
+  run.c.release(&run.c, e);
+
+  file_cache_stats stats;
+  ASSERT_EQ(run.c.get_stats(&run.c, &stats), 0);
+  ASSERT_EQ(stats.entries, 1u);
+  ASSERT_EQ(stats.bytes, 13u);
+  ASSERT_EQ(stats.hits, 1u);
+  ASSERT_EQ(stats.misses, 2u);
+  run.c.destroy(&run.c);
+  ASSERT_EQ(run.c.ctx, nullptr);
+  run.r.destroy(&run.r);
+  unlink(path.c_str());
+}
+
+TEST(tests_file_cache, headers_and_content_are_sent_by_writev_or_sendfile)
+{
+  os o;
+  os_linux_init(&o);
+  const string small_content = "small body";
+  const string big_content(100000, 'b');
+  const string small = cached_file("small", small_content);
+  const string big = cached_file("big", big_content);
+  file_cache_run run;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  file_cache_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.map_max = 4096;
+  ASSERT_EQ(file_cache_init(&run.c, &run.r, &o, &cfg), 0);
+  /* files are loaded one by one, since their callbacks may come in any order */
+  load_all(run, { small });
+  load_all(run, { big });
+  ASSERT_NE(run.entries[0]->data, nullptr);
+  ASSERT_EQ(run.entries[1]->data, nullptr);
+
+  int sv[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+  struct iovec hdr[2];
+  hdr[0].iov_base = (void *) "HTTP/1.1 200 OK\r\n";
+  hdr[0].iov_len = 17;
+  hdr[1].iov_base = (void *) "\r\n";
+  hdr[1].iov_len = 2;
+  ASSERT_EQ(run.c.send(&run.c, sv[0], hdr, 2, run.entries[0], 0), 29);
+  ASSERT_EQ(run.c.send(&run.c, sv[0], hdr, 2, run.entries[0], 29), 0);
+  ASSERT_EQ(receive(sv[1], 29), "HTTP/1.1 200 OK\r\n\r\n" + small_content);
+  ASSERT_EQ(run.c.send(&run.c, sv[0], hdr, 2, run.entries[0], 12), 17);
+  ASSERT_EQ(receive(sv[1], 17), " OK\r\n\r\n" + small_content);
+  ASSERT_EQ(run.c.send(&run.c, sv[0], hdr, FILE_CACHE_MAX_HEADERS + 1, run.entries[0], 0), -1);
+
+  thread reader([&sv, &big_content]() { ASSERT_EQ(receive(sv[1], 19 + big_content.size()).substr(19), big_content); });
+  size_t off = 0;
+  while (off < 19 + big_content.size()) {
+    const ssize_t n = run.c.send(&run.c, sv[0], hdr, 2, run.entries[1], off);
+    ASSERT_GT(n, 0);
+    if (off < 19) {
+      ASSERT_EQ(off + n, 19u);
+    }
+    off += n;
+  }
+  reader.join();
+
+  close(sv[0]);
+  close(sv[1]);
+  run.c.release(&run.c, run.entries[0]);
+  run.c.release(&run.c, run.entries[1]);
+  run.c.destroy(&run.c);
+  run.r.destroy(&run.r);
+  unlink(small.c_str());
+  unlink(big.c_str());
+}
+
+TEST(tests_file_cache, least_recently_used_idle_entries_are_evicted_over_budget)
+{
+  os o;
+  os_linux_init(&o);
+  const string a = cached_file("a", string(4096, 'a'));
+  const string b = cached_file("b", string(4096, 'b'));
+  const string c = cached_file("c", string(4096, 'c'));
+  file_cache_run run;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  file_cache_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.budget_bytes = 8192;
+  cfg.map_max = 4096;
+  cfg.max_entries = 8;
+  ASSERT_EQ(file_cache_init(&run.c, &run.r, &o, &cfg), 0);
+
+  load_all(run, { a, b });
+  run.c.release(&run.c, run.entries[0]);
+  run.c.release(&run.c, run.entries[1]);
+  const file_entry *hot = run.c.acquire(&run.c, a.c_str());
+  ASSERT_NE(hot, nullptr);
+  run.c.release(&run.c, hot);
+
+  load_all(run, { c });
+  file_cache_stats stats;
+  ASSERT_EQ(run.c.get_stats(&run.c, &stats), 0);
+  ASSERT_EQ(stats.entries, 2u);
+  ASSERT_EQ(stats.bytes, 8192u);
+  ASSERT_EQ(stats.evictions, 1u);
+  ASSERT_EQ(run.c.acquire(&run.c, b.c_str()), nullptr);
+  run.c.release(&run.c, run.entries[2]);
+  ASSERT_EQ(run.c.get_stats(&run.c, &stats), 0);
+  ASSERT_EQ(stats.entries, 2u);
+  ASSERT_EQ(stats.evictions, 1u);
+  hot = run.c.acquire(&run.c, a.c_str());
+  ASSERT_NE(hot, nullptr);
+  run.c.release(&run.c, hot);
+
+  run.c.destroy(&run.c);
+  run.r.destroy(&run.r);
+  unlink(a.c_str());
+  unlink(b.c_str());
+  unlink(c.c_str());
+}
+
+TEST(tests_file_cache, invalidated_entry_stays_valid_till_release)
+{
+  os o;
+  os_linux_init(&o);
+  const string path = cached_file("page", "old");
+  file_cache_run run;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  ASSERT_EQ(file_cache_init(&run.c, &run.r, &o, 0), 0);
+
+  load_all(run, { path });
+  const file_entry *old_e = run.entries[0];
+  cached_file("page", "brand new");
+  ASSERT_EQ(run.c.invalidate(&run.c, path.c_str()), 0);
+  ASSERT_NE(run.c.invalidate(&run.c, path.c_str()), 0);
+  ASSERT_EQ(run.c.acquire(&run.c, path.c_str()), nullptr);
+  ASSERT_EQ(old_e->size, 3u);
+
+  load_all(run, { path });
+  ASSERT_EQ(run.entries[1]->size, 9u);
+  ASSERT_EQ(memcmp(run.entries[1]->data, "brand new", 9), 0);
+  run.c.release(&run.c, old_e);
+  run.c.release(&run.c, run.entries[1]);
+
+  file_cache_stats stats;
+  ASSERT_EQ(run.c.get_stats(&run.c, &stats), 0);
+  ASSERT_EQ(stats.entries, 1u);
+  ASSERT_EQ(stats.bytes, 9u);
+  run.c.destroy(&run.c);
+  run.r.destroy(&run.r);
+  unlink(path.c_str());
+}
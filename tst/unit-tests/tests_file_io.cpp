@@ -0,0 +1,227 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/file_io.h"
+  }
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct file_io_run {
+  reactor r;
+  int expected;
+  vector<file_io_result> results;
+  vector<long> ids;
+};
+
+struct file_io_tag {
+  file_io_run *run;
+  long id;
+};
+
+static string write_temp_file(const string &name, const string &content)
+{
+  const string path = "/tmp/tests_file_io." + to_string(getpid()) + "." + name;
+  const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  write(fd, content.data(), content.size());
+  close(fd);
+  return path;
+}
+
+static void collect(file_io *fio, const file_io_result *res, void *arg)
+{
+  file_io_tag *tag = (file_io_tag *) arg;
+  file_io_run *run = tag->run;
+  run->results.push_back(*res);
+  run->ids.push_back(tag->id);
+  if ((int) run->results.size() == run->expected)
+    run->r.stop(&run->r);
+}
+
+TEST(tests_file_io, init_with_wrong_args)
+{
+  os o;
+  memset(&o, 0, sizeof(o));
+  reactor r;
+  file_io fio;
+  ASSERT_NE(file_io_init(&fio, 0, &o, 0, 0), 0);
+
+  os_linux_init(&o);
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(file_io_init(0, &r, &o, 0, 0), 0);
+  ASSERT_NE(file_io_init(&fio, &r, 0, 0, 0), 0);
+  o.pread = 0;
+  ASSERT_EQ(file_io_alloc(&r, &o, 0, 0), nullptr);
+  os_linux_init(&o);
+
+  file_io *dyn = file_io_alloc(&r, &o, 2, 4);
+  ASSERT_NE(dyn, nullptr);
+  char buf[4];
+  ASSERT_NE(dyn->open(dyn, 0, 0, collect, 0), 0);
+  ASSERT_NE(dyn->open(dyn, "/tmp", 0, 0, 0), 0);
+  ASSERT_NE(dyn->read(dyn, -1, buf, sizeof(buf), 0, collect, 0), 0);
+  ASSERT_NE(dyn->read(dyn, 0, 0, sizeof(buf), 0, collect, 0), 0);
+  dyn->destroy(dyn);
+  r.destroy(&r);
+}
+
+TEST(tests_file_io, open_maps_small_files_and_reports_errors)
+{
+  os o;
+  os_linux_init(&o);
+  const string small = write_temp_file("small", "hello, world");
+  const string big = write_temp_file("big", string(8192, 'x'));
+
+  file_io_run run;
+  run.expected = 4;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  file_io fio;
+  ASSERT_EQ(file_io_init(&fio, &run.r, &o, 2, 8), 0);
+  file_io_tag args[4] = { { &run, 0 }, { &run, 1 }, { &run, 2 }, { &run, 3 } };
+  ASSERT_EQ(fio.open(&fio, small.c_str(), 4096, collect, &args[0]), 0);
+  ASSERT_EQ(fio.open(&fio, big.c_str(), 4096, collect, &args[1]), 0);
+  ASSERT_EQ(fio.open(&fio, "/nonexistent/file", 4096, collect, &args[2]), 0);
+  ASSERT_EQ(fio.open(&fio, "/tmp", 4096, collect, &args[3]), 0);
+  run.r.event_loop(&run.r);
+  ASSERT_EQ(run.results.size(), 4u);
+
+  for (size_t i = 0; i < run.results.size(); ++i) {
+    const file_io_result &res = run.results[i];
+    switch (run.ids[i]) {
+    case 0:
+      ASSERT_EQ(res.res, 0);
+      ASSERT_GE(res.fd, 0);
+      ASSERT_EQ(res.size, 12u);
+      ASSERT_NE(res.data, nullptr);
+      ASSERT_EQ(memcmp(res.data, "hello, world", 12), 0);
+      munmap(res.data, res.size);
+      close(res.fd);
+      break;
+    case 1:
+      ASSERT_EQ(res.res, 0);
+      ASSERT_EQ(res.size, 8192u);
+      ASSERT_EQ(res.data, nullptr);
+      close(res.fd);
+      break;
+    case 2:
+      ASSERT_EQ(res.res, -1);
+      ASSERT_EQ(res.fd, -1);
+      ASSERT_EQ(res.err, ENOENT);
+      break;
+    default:
+      ASSERT_EQ(res.res, -1);
+      ASSERT_EQ(res.err, EISDIR);
+    }
+  }
+
+  fio.destroy(&fio);
+  ASSERT_EQ(fio.ctx, nullptr);
+  run.r.destroy(&run.r);
+  unlink(small.c_str());
+  unlink(big.c_str());
+}
+
+TEST(tests_file_io, reads_are_completed_and_capacity_is_bounded)
+{
+  os o;
+  os_linux_init(&o);
+  string content;
+  for (int i = 0; i < 64; ++i)
+    content += string(1, 'a' + i % 26);
+  const string path = write_temp_file("read", content);
+  const int fd = open(path.c_str(), O_RDONLY);
+
+  file_io_run run;
+  run.expected = 4;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  file_io fio;
+  ASSERT_EQ(file_io_init(&fio, &run.r, &o, 3, 4), 0);
+  char bufs[4][16];
+  file_io_tag args[4];
+  for (long i = 0; i < 4; ++i) {
+    args[i].run = &run;
+    args[i].id = i;
+    ASSERT_EQ(fio.read(&fio, fd, bufs[i], sizeof(bufs[i]), i * 16, collect, &args[i]), 0);
+  }
+  ASSERT_NE(fio.read(&fio, fd, bufs[0], sizeof(bufs[0]), 0, collect, &args[0]), 0);
+  run.r.event_loop(&run.r);
+
+  ASSERT_EQ(run.results.size(), 4u);
+  for (size_t i = 0; i < run.results.size(); ++i) {
+    ASSERT_EQ(run.results[i].res, 16);
+    ASSERT_EQ(run.results[i].fd, fd);
+    ASSERT_EQ(string(bufs[run.ids[i]], 16), content.substr(run.ids[i] * 16, 16));
+  }
+
+  run.expected = 5;
+  ASSERT_EQ(fio.read(&fio, fd, bufs[0], sizeof(bufs[0]), 60, collect, &args[0]), 0);
+  run.r.event_loop(&run.r);
+  ASSERT_EQ(run.results.back().res, 4);
+
+  ASSERT_EQ(fio.open(&fio, path.c_str(), 4096, collect, &args[1]), 0);
+  fio.destroy(&fio);
+  ASSERT_EQ(run.results.size(), 6u);
+  ASSERT_EQ(run.results.back().res, -1);
+  ASSERT_EQ(run.results.back().fd, -1);
+  ASSERT_EQ(run.results.back().err, ECANCELED);
+  close(fd);
+  run.r.destroy(&run.r);
+  unlink(path.c_str());
+}
+
+static void resubmit_and_collect(file_io *fio, const file_io_result *res, void *arg)
+{
+  static char buf[8];
+  collect(fio, res, arg);
+  file_io_tag *tag = (file_io_tag *) arg;
+  if (0 == fio->read(fio, 0, buf, sizeof(buf), 0, collect, arg))
+    tag->id = -1;
+}
+
+TEST(tests_file_io, destroy_cancels_undelivered_requests_with_callbacks)
+{
+  os o;
+  os_linux_init(&o);
+  const string path = write_temp_file("cancel", string(64, 'c'));
+  const int fd = open(path.c_str(), O_RDONLY);
+
+  file_io_run run;
+  run.expected = 0;
+  ASSERT_EQ(reactor_init(&run.r, &o), 0);
+  file_io fio;
+  ASSERT_EQ(file_io_init(&fio, &run.r, &o, 1, 16), 0);
+  char bufs[8][8];
+  file_io_tag args[9];
+  for (long i = 0; i < 8; ++i) {
+    args[i].run = &run;
+    args[i].id = i;
+    ASSERT_EQ(fio.read(&fio, fd, bufs[i], sizeof(bufs[i]), i * 8, collect, &args[i]), 0);
+  }
+  args[8].run = &run;
+  args[8].id = 8;
+  ASSERT_EQ(fio.open(&fio, path.c_str(), 4096, resubmit_and_collect, &args[8]), 0);
+  /* nothing is delivered before destroy, whether the requests were executed or not */
+  fio.destroy(&fio);
+
+  ASSERT_EQ(run.results.size(), 9u);
+  for (size_t i = 0; i < run.results.size(); ++i) {
+    ASSERT_EQ(run.ids[i], (long) i);
+    ASSERT_EQ(run.results[i].res, -1);
+    ASSERT_EQ(run.results[i].err, ECANCELED);
+    ASSERT_EQ(run.results[i].fd, (i < 8) ? fd : -1);
+  }
+  /* no request is accepted from cancelled callbacks */
+  ASSERT_EQ(args[8].id, 8);
+  close(fd);
+  run.r.destroy(&run.r);
+  unlink(path.c_str());
+}
@@ -0,0 +1,193 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/framer.h"
+  }
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct framed {
+  vector<string> msgs;
+  size_t batches = 0;
+  int closed = 0;
+  int err = -1;
+};
+
+static void collect(framer *f, const frame *frames, size_t cnt, void *arg)
+{
+  framed *res = static_cast<framed *>(arg);
+  for (size_t i = 0; i < cnt; ++i)
+    res->msgs.push_back(string(frames[i].data, frames[i].len));
+  ++res->batches;
+}
+
+static void closed(framer *f, int err, void *arg)
+{
+  framed *res = static_cast<framed *>(arg);
+  ++res->closed;
+  res->err = err;
+}
+
+TEST(tests_framer, find_byte_matches_memchr)
+{
+  vector<char> data(300, 'a');
+  for (size_t len = 0; len < data.size(); len += 7) {
+    for (size_t pos = 0; pos < data.size(); pos += 13) {
+      data[pos] = '\n';
+      const char *expected = (const char *) memchr(data.data(), '\n', len);
+      ASSERT_EQ(framer_find_byte(data.data(), len, '\n'), expected);
+      data[pos] = 'a';
+    }
+  }
+}
+
+TEST(tests_framer, built_in_decoders)
+{
+  frame f;
+  decoder d;
+
+  ASSERT_NE(decoder_line_init(&d, '\n', 0), 0);
+  ASSERT_EQ(decoder_line_init(&d, '\n', 4), 0);
+  ASSERT_EQ(d.decode(&d, "ab\ncd", 5, &f), 3);
+  ASSERT_EQ(string(f.data, f.len), "ab");
+  ASSERT_EQ(d.decode(&d, "abcd", 4, &f), 0);
+  ASSERT_EQ(d.decode(&d, "abcde", 5, &f), -1);
+
+  ASSERT_NE(decoder_length_prefixed_init(&d, 3, 10), 0);
+  ASSERT_EQ(decoder_length_prefixed_init(&d, 2, 10), 0);
+  ASSERT_EQ(d.decode(&d, "\x00\x03" "abcd", 6, &f), 5);
+  ASSERT_EQ(string(f.data, f.len), "abc");
+  ASSERT_EQ(d.decode(&d, "\x00\x03" "ab", 4, &f), 0);
+  ASSERT_EQ(d.decode(&d, "\x01\x00", 2, &f), -1);
+
+  ASSERT_NE(decoder_fixed_init(&d, 0), 0);
+  ASSERT_EQ(decoder_fixed_init(&d, 3), 0);
+  ASSERT_EQ(d.decode(&d, "abcd", 4, &f), 3);
+  ASSERT_EQ(string(f.data, f.len), "abc");
+  ASSERT_EQ(d.decode(&d, "ab", 2, &f), 0);
+}
+
+TEST(tests_framer, lines_are_delivered_in_batches_and_buffer_is_released)
+{
+  os o;
+  os_linux_init(&o);
+  buf_pool pool;
+  ASSERT_EQ(buf_pool_init(&pool, &o, 0), 0);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  decoder d;
+  ASSERT_EQ(decoder_line_init(&d, '\n', 100), 0);
+  framed res;
+  framer f;
+  ASSERT_EQ(framer_init(&f, &o, &pool, 1024, fds[0], &d, collect, closed, &res), 0);
+
+  const string first = "one\ntwo\nthr";
+  ASSERT_EQ(write(fds[1], first.data(), first.size()), (ssize_t) first.size());
+  f.eh.handle_event(&f.eh, EPOLLIN);
+  ASSERT_EQ(res.msgs, vector<string>({ "one", "two" }));
+  ASSERT_EQ(res.batches, 1u);
+  ASSERT_EQ(f.pending(&f), 3u);
+
+  const string second = "ee\n";
+  ASSERT_EQ(write(fds[1], second.data(), second.size()), (ssize_t) second.size());
+  f.eh.handle_event(&f.eh, EPOLLIN);
+  ASSERT_EQ(res.msgs, vector<string>({ "one", "two", "three" }));
+  ASSERT_EQ(f.pending(&f), 0u);
+
+  buf_pool_stats stats;
+  ASSERT_EQ(pool.get_stats(&pool, &stats), 0);
+  ASSERT_EQ(stats.used_bytes, 0u);
+
+  close(fds[1]);
+  f.eh.handle_event(&f.eh, EPOLLIN);
+  ASSERT_EQ(res.closed, 1);
+  ASSERT_EQ(res.err, 0);
+
+  f.destroy(&f);
+  close(fds[0]);
+  pool.destroy(&pool);
+}
+
+static decoder line_decoder;
+static vector<size_t> scanned_offsets;
+
+static ssize_t recording_decode(const decoder *self, const char *data, size_t len, frame *f)
+{
+  scanned_offsets.push_back(self->scanned);
+  line_decoder.scanned = self->scanned;
+  return line_decoder.decode(&line_decoder, data, len, f);
+}
+
+TEST(tests_framer, line_search_resumes_where_previous_read_stopped)
+{
+  os o;
+  os_linux_init(&o);
+  buf_pool pool;
+  ASSERT_EQ(buf_pool_init(&pool, &o, 0), 0);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  frame fr;
+  decoder d;
+  ASSERT_EQ(decoder_line_init(&d, '\n', 100), 0);
+  d.scanned = 2;
+  ASSERT_EQ(d.decode(&d, "a\nb\n", 4, &fr), 4);
+  ASSERT_EQ(string(fr.data, fr.len), "a\nb");
+
+  ASSERT_EQ(decoder_line_init(&line_decoder, '\n', 100), 0);
+  ASSERT_EQ(decoder_line_init(&d, '\n', 100), 0);
+  d.decode = recording_decode;
+  scanned_offsets.clear();
+  framed res;
+  framer f;
+  ASSERT_EQ(framer_init(&f, &o, &pool, 1024, fds[0], &d, collect, closed, &res), 0);
+
+  for (const string part: { "abc", "de", "\nxy" }) {
+    ASSERT_EQ(write(fds[1], part.data(), part.size()), (ssize_t) part.size());
+    f.eh.handle_event(&f.eh, EPOLLIN);
+  }
+  ASSERT_EQ(res.msgs, vector<string>({ "abcde" }));
+  ASSERT_EQ(scanned_offsets, vector<size_t>({ 0, 3, 5, 0 }));
+
+  f.destroy(&f);
+  close(fds[0]);
+  close(fds[1]);
+  pool.destroy(&pool);
+}
+
+TEST(tests_framer, too_long_message_is_protocol_error)
+{
+  os o;
+  os_linux_init(&o);
+  buf_pool pool;
+  ASSERT_EQ(buf_pool_init(&pool, &o, 0), 0);
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+  decoder d;
+  ASSERT_EQ(decoder_fixed_init(&d, 4096), 0);
+  framed res;
+  framer *f = framer_alloc(&o, &pool, 1024, fds[0], &d, collect, closed, &res);
+  ASSERT_NE(f, nullptr);
+
+  const string data(2048, 'x');
+  ASSERT_EQ(write(fds[1], data.data(), data.size()), (ssize_t) data.size());
+  f->eh.handle_event(&f->eh, EPOLLIN);
+  ASSERT_EQ(res.closed, 1);
+  ASSERT_EQ(res.err, EPROTO);
+  ASSERT_TRUE(res.msgs.empty());
+
+  f->destroy(f);
+  close(fds[0]);
+  close(fds[1]);
+  pool.destroy(&pool);
+}
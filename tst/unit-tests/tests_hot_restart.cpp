@@ -0,0 +1,180 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/hot_restart.h"
+  }
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+static string temp_path()
+{
+  return "/tmp/tests_hot_restart." + to_string(getpid());
+}
+
+static int tcp_listener(struct sockaddr_in &addr)
+{
+  socklen_t addr_len = sizeof(addr);
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+  listen(fd, 16);
+  getsockname(fd, (struct sockaddr *) &addr, &addr_len);
+  return fd;
+}
+
+static void stop_reactor(hot_restart *hr, void *arg)
+{
+  reactor *r = (reactor *) arg;
+  r->stop(r);
+}
+
+TEST(tests_hot_restart, init_and_add_fd_with_wrong_args)
+{
+  os o;
+  memset(&o, 0, sizeof(o));
+  hot_restart hr;
+  ASSERT_NE(hot_restart_init(&hr, &o, "/tmp/x"), 0);
+  ASSERT_EQ(hot_restart_alloc(&o, "/tmp/x"), nullptr);
+
+  os_linux_init(&o);
+  ASSERT_NE(hot_restart_init(0, &o, "/tmp/x"), 0);
+  ASSERT_NE(hot_restart_init(&hr, 0, "/tmp/x"), 0);
+  ASSERT_NE(hot_restart_init(&hr, &o, 0), 0);
+  ASSERT_NE(hot_restart_init(&hr, &o, string(200, 'x').c_str()), 0);
+  o.unlink = 0;
+  ASSERT_NE(hot_restart_init(&hr, &o, "/tmp/x"), 0);
+  os_linux_init(&o);
+
+  hot_restart *dyn = hot_restart_alloc(&o, temp_path().c_str());
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_NE(dyn->add_fd(dyn, "", 1), 0);
+  ASSERT_NE(dyn->add_fd(dyn, "x", -1), 0);
+  ASSERT_NE(dyn->add_fd(dyn, string(HOT_RESTART_NAME_SIZE, 'x').c_str(), 1), 0);
+  ASSERT_EQ(dyn->add_fd(dyn, "x", 1), 0);
+  ASSERT_NE(dyn->add_fd(dyn, "x", 2), 0);
+  ASSERT_NE(dyn->ready(dyn), 0);
+  ASSERT_EQ(dyn->get_fd(dyn, "x"), -1);
+  ASSERT_EQ(dyn->take(dyn, 100), -1);
+  dyn->destroy(dyn);
+}
+
+TEST(tests_hot_restart, listener_is_handed_over_to_successor)
+{
+  os o;
+  os_linux_init(&o);
+  const string path = temp_path();
+  struct sockaddr_in addr;
+  const int lfd = tcp_listener(addr);
+  ASSERT_GE(lfd, 0);
+
+  reactor old_r;
+  ASSERT_EQ(reactor_init(&old_r, &o), 0);
+  hot_restart old_hr;
+  ASSERT_EQ(hot_restart_init(&old_hr, &o, path.c_str()), 0);
+  ASSERT_EQ(old_hr.add_fd(&old_hr, "http", lfd), 0);
+  ASSERT_EQ(old_hr.serve(&old_hr, &old_r, stop_reactor, &old_r), 0);
+  ASSERT_NE(old_hr.serve(&old_hr, &old_r, stop_reactor, &old_r), 0);
+  thread old_loop([&old_r]() { old_r.event_loop(&old_r); });
+
+  reactor new_r;
+  ASSERT_EQ(reactor_init(&new_r, &o), 0);
+  hot_restart new_hr;
+  ASSERT_EQ(hot_restart_init(&new_hr, &o, path.c_str()), 0);
+  ASSERT_EQ(new_hr.take(&new_hr, 1000), 1);
+  ASSERT_EQ(new_hr.get_fd(&new_hr, "nope"), -1);
+  const int new_lfd = new_hr.get_fd(&new_hr, "http");
+  ASSERT_GE(new_lfd, 0);
+  ASSERT_NE(new_lfd, lfd);
+  ASSERT_EQ(new_hr.get_fd(&new_hr, "http"), -1);
+  ASSERT_EQ(new_hr.add_fd(&new_hr, "http", new_lfd), 0);
+  ASSERT_EQ(new_hr.serve(&new_hr, &new_r, stop_reactor, &new_r), 0);
+  ASSERT_EQ(new_hr.ready(&new_hr), 0);
+  old_loop.join();
+
+  struct sockaddr_in new_addr;
+  socklen_t addr_len = sizeof(new_addr);
+  ASSERT_EQ(getsockname(new_lfd, (struct sockaddr *) &new_addr, &addr_len), 0);
+  ASSERT_EQ(new_addr.sin_port, addr.sin_port);
+  old_hr.destroy(&old_hr);
+  ASSERT_EQ(old_hr.ctx, nullptr);
+  close(lfd);
+  ASSERT_EQ(access(path.c_str(), F_OK), 0);
+
+  const int cli = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(connect(cli, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  const int srv = accept(new_lfd, 0, 0);
+  ASSERT_GE(srv, 0);
+  close(srv);
+  close(cli);
+
+  new_hr.destroy(&new_hr);
+  ASSERT_NE(access(path.c_str(), F_OK), 0);
+  close(new_lfd);
+  new_r.destroy(&new_r);
+  old_r.destroy(&old_r);
+}
+
+TEST(tests_hot_restart, successor_which_is_not_ready_leaves_sockets_to_predecessor)
+{
+  os o;
+  os_linux_init(&o);
+  const string path = temp_path();
+  const int cnt = 100;
+  int pipes[cnt][2];
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  hot_restart old_hr;
+  ASSERT_EQ(hot_restart_init(&old_hr, &o, path.c_str()), 0);
+  for (int i = 0; i < cnt; ++i) {
+    ASSERT_EQ(pipe(pipes[i]), 0);
+    ASSERT_EQ(old_hr.add_fd(&old_hr, ("pipe" + to_string(i)).c_str(), pipes[i][1]), 0);
+  }
+  ASSERT_EQ(old_hr.serve(&old_hr, &r, stop_reactor, &r), 0);
+  thread loop([&r]() { r.event_loop(&r); });
+
+  hot_restart crashed;
+  ASSERT_EQ(hot_restart_init(&crashed, &o, path.c_str()), 0);
+  ASSERT_EQ(crashed.take(&crashed, 1000), cnt);
+  crashed.destroy(&crashed);
+
+  hot_restart next;
+  ASSERT_EQ(hot_restart_init(&next, &o, path.c_str()), 0);
+  int taken = -1;
+  for (int attempt = 0; (attempt < 100) && (cnt != taken); ++attempt) {
+    /* predecessor serves one successor at a time, so hang up has to be noticed first */
+    taken = next.take(&next, 1000);
+    if (cnt != taken)
+      usleep(1000);
+  }
+  ASSERT_EQ(taken, cnt);
+  const int fd = next.get_fd(&next, "pipe42");
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, "x", 1), 1);
+  char byte = 0;
+  ASSERT_EQ(read(pipes[42][0], &byte, 1), 1);
+  ASSERT_EQ(byte, 'x');
+  ASSERT_EQ(next.ready(&next), 0);
+  loop.join();
+
+  close(fd);
+  next.destroy(&next);
+  old_hr.destroy(&old_hr);
+  for (int i = 0; i < cnt; ++i) {
+    close(pipes[i][0]);
+    close(pipes[i][1]);
+  }
+  unlink(path.c_str());
+  r.destroy(&r);
+}
@@ -0,0 +1,285 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/reactor.h"
+    #include "reactor/os_sim.h"
+  }
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <sys/timerfd.h>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+TEST(tests_os_sim, init_and_finish_with_nulls)
+{
+  os o;
+  os_sim_stats stats;
+  ASSERT_NE(os_sim_init(0, 0), 0);
+  ASSERT_NE(os_sim_finish(), 0);
+  ASSERT_NE(os_sim_get_stats(&stats), 0);
+
+  ASSERT_EQ(os_sim_init(&o, 0), 0);
+  ASSERT_NE(os_sim_init(&o, 0), 0);
+  ASSERT_NE(os_sim_get_stats(0), 0);
+  ASSERT_NE(os_sim_connect(3, 1), 0);
+  ASSERT_NE(os_sim_deliver(3, "x", 1), 0);
+  ASSERT_NE(os_sim_hangup(3), 0);
+  ASSERT_EQ(o.close(3), -1);
+  ASSERT_EQ(errno, EBADF);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
+
+TEST(tests_os_sim, sockets_are_level_and_edge_triggered)
+{
+  os o;
+  os_sim_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.max_fds = 7;
+  ASSERT_EQ(os_sim_init(&o, &cfg), 0);
+
+  const int epfd = o.epoll_create1(0);
+  const int lfd = o.socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(o.bind(lfd, 0, 0), 0);
+  ASSERT_EQ(o.listen(lfd, 128), 0);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = lfd;
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev), 0);
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev), -1);
+  ASSERT_EQ(errno, EEXIST);
+
+  struct epoll_event evs[4];
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 10), 0);
+  os_sim_stats stats;
+  ASSERT_EQ(os_sim_get_stats(&stats), 0);
+  ASSERT_EQ(stats.now_ns, 10000000u);
+
+  ASSERT_EQ(os_sim_connect(lfd, 3), 0);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 1);
+  ASSERT_EQ(evs[0].data.fd, lfd);
+  const int c1 = o.accept(lfd, 0, 0);
+  const int c2 = o.accept(lfd, 0, 0);
+  ASSERT_GE(c1, 0);
+  ASSERT_GE(c2, 0);
+  ASSERT_EQ(o.accept(lfd, 0, 0), -1);
+  ASSERT_EQ(errno, EMFILE);
+
+  ev.events = EPOLLIN;
+  ev.data.fd = c1;
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, c1, &ev), 0);
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.fd = c2;
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, c2, &ev), 0);
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_DEL, lfd, 0), 0);
+
+  char buf[8];
+  ASSERT_EQ(o.read(c1, buf, sizeof(buf)), -1);
+  ASSERT_EQ(errno, EAGAIN);
+  ASSERT_EQ(os_sim_deliver(c1, "ping", 4), 0);
+  ASSERT_EQ(os_sim_deliver(c2, "pong", 4), 0);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 2);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 1);
+  ASSERT_EQ(evs[0].data.fd, c1);
+  ASSERT_EQ(evs[0].events, (uint32_t) EPOLLIN);
+  ASSERT_EQ(o.recv(c1, buf, 2, MSG_PEEK), 2);
+  ASSERT_EQ(o.read(c1, buf, sizeof(buf)), 4);
+  ASSERT_EQ(string(buf, 4), "ping");
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 0);
+
+  ASSERT_EQ(os_sim_hangup(c2), 0);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 1);
+  ASSERT_EQ(evs[0].events, (uint32_t) EPOLLIN);
+  ASSERT_EQ(o.read(c2, buf, sizeof(buf)), 4);
+  ASSERT_EQ(o.read(c2, buf, sizeof(buf)), 0);
+  ASSERT_EQ(o.write(c2, "x", 1), -1);
+  ASSERT_EQ(errno, EPIPE);
+  ASSERT_EQ(o.write(c1, "abc", 3), 3);
+
+  ASSERT_EQ(os_sim_deliver(c1, "x", 1), 0);
+  ASSERT_EQ(o.close(c1), 0);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 0), 0);
+
+  ASSERT_EQ(os_sim_get_stats(&stats), 0);
+  ASSERT_EQ(stats.accepted, 2u);
+  ASSERT_EQ(stats.rx_bytes, 8u);
+  ASSERT_EQ(stats.tx_bytes, 3u);
+  ASSERT_EQ(stats.open_fds, 3u);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
+
+static void ignore_event(event_handler *self, uint32_t events)
+{
+}
+
+TEST(tests_os_sim, socket_queued_in_closed_epoll_is_closed)
+{
+  os o;
+  ASSERT_EQ(os_sim_init(&o, 0), 0);
+  const int lfd = o.socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_EQ(o.listen(lfd, 128), 0);
+  ASSERT_EQ(os_sim_connect(lfd, 1), 0);
+  const int c = o.accept(lfd, 0, 0);
+  ASSERT_GE(c, 0);
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = c;
+  eh.handle_event = ignore_event;
+  ASSERT_EQ(r.register_eh(&r, &eh), 0);
+  ASSERT_EQ(os_sim_deliver(c, "ping", 4), 0);
+  /* epoll is closed first, while the socket is still queued in its ready ring */
+  r.destroy(&r);
+  ASSERT_EQ(o.close(c), 0);
+
+  /* reused descriptors are not confused with the stale queue */
+  const int epfd = o.epoll_create1(0);
+  const int c2 = o.socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(epfd, 0);
+  ASSERT_GE(c2, 0);
+  ASSERT_EQ(o.close(c2), 0);
+  ASSERT_EQ(o.close(epfd), 0);
+  ASSERT_EQ(o.close(lfd), 0);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
+
+TEST(tests_os_sim, timers_and_eventfd_follow_virtual_clock)
+{
+  os o;
+  ASSERT_EQ(os_sim_init(&o, 0), 0);
+
+  const int epfd = o.epoll_create1(0);
+  const int tfd = o.timerfd_create(CLOCK_MONOTONIC, 0);
+  const int efd = o.eventfd(0, 0);
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = tfd;
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev), 0);
+  ev.data.fd = efd;
+  ASSERT_EQ(o.epoll_ctl(epfd, EPOLL_CTL_ADD, efd, &ev), 0);
+
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = 5;
+  its.it_interval.tv_sec = 1;
+  ASSERT_EQ(o.timerfd_settime(tfd, 0, &its, 0), 0);
+
+  struct epoll_event evs[4];
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, -1), 1);
+  ASSERT_EQ(evs[0].data.fd, tfd);
+  struct timespec ts;
+  ASSERT_EQ(o.clock_gettime(CLOCK_MONOTONIC, &ts), 0);
+  ASSERT_EQ(ts.tv_sec, 5);
+  uint64_t cnt = 0;
+  ASSERT_EQ(o.read(tfd, &cnt, sizeof(cnt)), (ssize_t) sizeof(cnt));
+  ASSERT_EQ(cnt, 1u);
+
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 3500), 1);
+  ASSERT_EQ(o.read(tfd, &cnt, sizeof(cnt)), (ssize_t) sizeof(cnt));
+  ASSERT_EQ(cnt, 1u);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 3500), 1);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 3500), 1);
+  ASSERT_EQ(o.read(tfd, &cnt, sizeof(cnt)), (ssize_t) sizeof(cnt));
+  ASSERT_EQ(cnt, 1u);
+  ASSERT_EQ(o.close(tfd), 0);
+
+  cnt = 2;
+  ASSERT_EQ(o.write(efd, &cnt, sizeof(cnt)), (ssize_t) sizeof(cnt));
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, 3500), 1);
+  ASSERT_EQ(evs[0].data.fd, efd);
+  ASSERT_EQ(o.read(efd, &cnt, sizeof(cnt)), (ssize_t) sizeof(cnt));
+  ASSERT_EQ(cnt, 2u);
+  ASSERT_EQ(o.epoll_wait(epfd, evs, 4, -1), 0);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
+
+struct sim_server {
+  reactor r;
+  const os *o;
+  event_handler listener;
+  vector<event_handler> conns;
+  size_t max_conns;
+};
+
+static void sim_echo(event_handler *self, uint32_t events)
+{
+  sim_server *s = (sim_server *) self->ctx;
+  char buf[256];
+  ssize_t len = 0;
+  while (0 < (len = s->o->read(self->fd, buf, sizeof(buf))))
+    s->o->write(self->fd, buf, len);
+}
+
+static void sim_accept(event_handler *self, uint32_t events)
+{
+  sim_server *s = (sim_server *) self->ctx;
+  int fd = -1;
+  while ( (s->conns.size() < s->max_conns) && (0 <= (fd = s->o->accept(self->fd, 0, 0))) ) {
+    s->conns.emplace_back();
+    event_handler *eh = &s->conns.back();
+    memset(eh, 0, sizeof(event_handler));
+    eh->fd = fd;
+    eh->ctx = s;
+    eh->handle_event = sim_echo;
+    s->r.register_eh(&s->r, eh);
+  }
+}
+
+static void run_sim_server(const os_sim_config &cfg, size_t conns_cnt, os_sim_stats &stats)
+{
+  os o;
+  ASSERT_EQ(os_sim_init(&o, &cfg), 0);
+
+  sim_server s;
+  s.o = &o;
+  s.max_conns = conns_cnt;
+  /* handlers must not move once registered */
+  s.conns.reserve(conns_cnt);
+  ASSERT_EQ(reactor_init(&s.r, &o), 0);
+  memset(&s.listener, 0, sizeof(s.listener));
+  s.listener.fd = o.socket(AF_INET, SOCK_STREAM, 0);
+  s.listener.ctx = &s;
+  s.listener.handle_event = sim_accept;
+  ASSERT_EQ(o.listen(s.listener.fd, 128), 0);
+  ASSERT_EQ(s.r.register_eh(&s.r, &s.listener), 0);
+  ASSERT_EQ(os_sim_connect(s.listener.fd, conns_cnt), 0);
+
+  s.r.event_loop(&s.r);
+  ASSERT_EQ(s.conns.size(), conns_cnt);
+
+  ASSERT_EQ(os_sim_get_stats(&stats), 0);
+  s.r.destroy(&s.r);
+  ASSERT_EQ(os_sim_finish(), 0);
+}
+
+TEST(tests_os_sim, reactor_serves_hundred_thousand_connections_deterministically)
+{
+  os_sim_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.duration_ns = 2000000000ULL;
+  cfg.arrival_rate = 100000;
+  cfg.poisson = 1;
+  cfg.target = OS_SIM_SKEWED;
+  cfg.skew = 3;
+  cfg.msg_size = 32;
+  cfg.seed = 42;
+
+  const size_t conns_cnt = 100000;
+  os_sim_stats first;
+  run_sim_server(cfg, conns_cnt, first);
+  ASSERT_EQ(first.accepted, conns_cnt);
+  ASSERT_EQ(first.now_ns, cfg.duration_ns);
+  ASSERT_GT(first.arrivals, 150000u);
+  ASSERT_LT(first.arrivals, 250000u);
+  ASSERT_EQ(first.rx_bytes, first.arrivals * cfg.msg_size);
+  ASSERT_EQ(first.tx_bytes, first.rx_bytes);
+
+  os_sim_stats second;
+  run_sim_server(cfg, conns_cnt, second);
+  ASSERT_EQ(memcmp(&first, &second, sizeof(first)), 0);
+}
@@ -0,0 +1,244 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/reactor.h"
+    #include "reactor/os_trace.h"
+  }
+#endif
+
+#include <string.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+static int fake_waits = 0;
+static uint64_t fake_now_ns = 0;
+static int fake_next_fd = 0;
+
+static int fake_epoll_wait(int epfd, struct epoll_event *evs, int max_evs, int timeout)
+{
+  if (2 <= fake_waits++) {
+    errno = EINTR;
+    return -1;
+  }
+  evs[0].events = EPOLLIN;
+  evs[0].data.fd = 7;
+  return 1;
+}
+
+static ssize_t fake_read(int fd, void *buf, size_t len)
+{
+  if (2 < fake_waits) {
+    errno = EAGAIN;
+    return -1;
+  }
+  memcpy(buf, "ping", 4);
+  return 4;
+}
+
+static ssize_t fake_writev(int fd, const struct iovec *iov, int iov_cnt)
+{
+  return iov[0].iov_len;
+}
+
+static int fake_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  fake_now_ns += 1500;
+  ts->tv_sec = fake_now_ns / 1000000000ULL;
+  ts->tv_nsec = fake_now_ns % 1000000000ULL;
+  return 0;
+}
+
+static int temp_trace()
+{
+  char name[] = "/tmp/tests_os_traceXXXXXX";
+  const int fd = mkstemp(name);
+  unlink(name);
+  return fd;
+}
+
+struct pong_handler {
+  event_handler eh;
+  const os *o;
+  vector<string> received;
+  vector<uint64_t> times;
+};
+
+static void pong(event_handler *self, uint32_t events)
+{
+  pong_handler *h = (pong_handler *) self->ctx;
+  char buf[16];
+  const ssize_t len = h->o->read(self->fd, buf, sizeof(buf));
+  if (0 < len) {
+    struct timespec ts;
+    h->o->clock_gettime(CLOCK_MONOTONIC, &ts);
+    h->received.push_back(string(buf, len));
+    h->times.push_back(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+    struct iovec iov = { (void *) "pong", 4 };
+    h->o->writev(self->fd, &iov, 1);
+  }
+}
+
+static void run_pong(const os *o, pong_handler &h, int fd)
+{
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, o), 0);
+  memset(&h.eh, 0, sizeof(h.eh));
+  h.eh.fd = fd;
+  h.eh.ctx = &h;
+  h.eh.handle_event = pong;
+  h.o = o;
+  ASSERT_EQ(r.register_eh(&r, &h.eh), 0);
+  r.event_loop(&r);
+  r.destroy(&r);
+}
+
+static int fake_epoll_create1(int)
+{
+  return 100;
+}
+
+static int fake_epoll_ctl(int, int, int, struct epoll_event *)
+{
+  return 0;
+}
+
+static int fake_close(int)
+{
+  return 0;
+}
+
+static int fake_eventfd(unsigned int, int)
+{
+  return fake_next_fd++;
+}
+
+static ssize_t real_write(int fd, const void *buf, size_t len)
+{
+  return write(fd, buf, len);
+}
+
+TEST(tests_os_trace, init_with_nulls_and_corrupted_trace)
+{
+  os o, real;
+  memset(&real, 0, sizeof(real));
+  ASSERT_NE(os_record_init(0, &real, 1, 0), 0);
+  ASSERT_NE(os_record_init(&o, 0, 1, 0), 0);
+  ASSERT_NE(os_record_init(&o, &real, 1, 0), 0);
+  ASSERT_NE(os_record_finish(), 0);
+  ASSERT_NE(os_replay_finish(), 0);
+
+  const int fd = temp_trace();
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(write(fd, "garbage!garbage!", 16), 16);
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  ASSERT_NE(os_replay_init(&o, fd), 0);
+  close(fd);
+}
+
+TEST(tests_os_trace, recorded_event_loop_is_replayed_without_kernel)
+{
+  os real;
+  memset(&real, 0, sizeof(real));
+  real.epoll_create1 = fake_epoll_create1;
+  real.epoll_ctl = fake_epoll_ctl;
+  real.epoll_wait = fake_epoll_wait;
+  real.close = fake_close;
+  real.read = fake_read;
+  real.write = real_write;
+  real.writev = fake_writev;
+  real.eventfd = fake_eventfd;
+  real.clock_gettime = fake_clock_gettime;
+
+  const int fd = temp_trace();
+  ASSERT_GE(fd, 0);
+
+  os rec;
+  fake_waits = 0;
+  fake_now_ns = 0;
+  /* 8 is reactor's wake up descriptor */
+  fake_next_fd = 8;
+  ASSERT_EQ(os_record_init(&rec, &real, fd, 1), 0);
+  ASSERT_NE(os_record_init(&rec, &real, fd, 1), 0);
+  pong_handler recorded;
+  run_pong(&rec, recorded, 7);
+  ASSERT_EQ(os_record_finish(), 0);
+  ASSERT_EQ(recorded.received, vector<string>({ "ping", "ping" }));
+
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  os rep;
+  ASSERT_EQ(os_replay_init(&rep, fd), 0);
+  pong_handler replayed;
+  run_pong(&rep, replayed, 7);
+  ASSERT_EQ(os_replay_finish(), 0);
+  ASSERT_EQ(replayed.received, recorded.received);
+  ASSERT_EQ(replayed.times.size(), 2u);
+  ASSERT_LT(replayed.times[0], replayed.times[1]);
+
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(os_replay_init(&rep, fd), 0);
+  ASSERT_EQ(rep.epoll_create1(0), 100);
+  ASSERT_EQ(rep.eventfd(0, 0), 8);
+  char buf[4];
+  ASSERT_EQ(rep.read(8, buf, sizeof(buf)), -1);
+  ASSERT_EQ(errno, EAGAIN);
+  struct epoll_event evs[4];
+  ASSERT_EQ(rep.epoll_wait(0, evs, 4, -1), 1);
+  ASSERT_EQ(evs[0].data.fd, 7);
+  ASSERT_EQ(rep.epoll_wait(0, evs, 4, -1), 1);
+  ASSERT_EQ(rep.epoll_wait(0, evs, 4, -1), -1);
+  ASSERT_EQ(os_replay_finish(), 5);
+
+  close(fd);
+}
+
+TEST(tests_os_trace, replayed_descriptors_match_recorded_events)
+{
+  os real;
+  memset(&real, 0, sizeof(real));
+  real.epoll_create1 = fake_epoll_create1;
+  real.epoll_ctl = fake_epoll_ctl;
+  real.epoll_wait = fake_epoll_wait;
+  real.close = fake_close;
+  real.read = fake_read;
+  real.write = real_write;
+  real.writev = fake_writev;
+  real.eventfd = fake_eventfd;
+  real.clock_gettime = fake_clock_gettime;
+
+  const int fd = temp_trace();
+  ASSERT_GE(fd, 0);
+
+  os rec;
+  fake_waits = 0;
+  fake_now_ns = 0;
+  fake_next_fd = 7;
+  ASSERT_EQ(os_record_init(&rec, &real, fd, 1), 0);
+  pong_handler recorded;
+  run_pong(&rec, recorded, rec.eventfd(0, 0));
+  ASSERT_EQ(os_record_finish(), 0);
+  ASSERT_EQ(recorded.received, vector<string>({ "ping", "ping" }));
+
+  /* handler is registered on the descriptor replayed by the proxy, not on a literal */
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  os rep;
+  ASSERT_EQ(os_replay_init(&rep, fd), 0);
+  pong_handler replayed;
+  run_pong(&rep, replayed, rep.eventfd(0, 0));
+  ASSERT_EQ(os_replay_finish(), 0);
+  ASSERT_EQ(replayed.eh.fd, 7);
+  ASSERT_EQ(replayed.received, recorded.received);
+
+  /* diverged descriptor creation still returns usable descriptor */
+  ASSERT_EQ(lseek(fd, 0, SEEK_SET), 0);
+  ASSERT_EQ(os_replay_init(&rep, fd), 0);
+  ASSERT_GE(rep.socket(AF_INET, SOCK_STREAM, 0), 0);
+  ASSERT_EQ(os_replay_finish(), 1);
+
+  close(fd);
+}
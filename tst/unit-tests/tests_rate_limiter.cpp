@@ -0,0 +1,310 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/rate_limiter.h"
+  }
+#endif
+
+#include <string.h>
+#include <sys/timerfd.h>
+#include <map>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+#define MS 1000000ULL
+
+struct limited_reactor {
+  reactor r;
+  uint64_t now;
+  map<const event_handler *, uint32_t> interest;
+  event_handler *timer;
+};
+
+/* handlers are registered with write interest too, which throttling must keep */
+static const uint32_t registered = EPOLLIN | EPOLLOUT;
+static const uint32_t throttled = EPOLLOUT;
+
+static limited_reactor * as_limited(reactor *r)
+{
+  return reinterpret_cast<limited_reactor *>(r);
+}
+
+static int limited_register_eh(reactor *self, event_handler *e)
+{
+  as_limited(self)->timer = e;
+  return 0;
+}
+
+static int limited_unregister_eh(reactor *self, const event_handler *e)
+{
+  if (as_limited(self)->timer == e)
+    as_limited(self)->timer = 0;
+  return 0;
+}
+
+static int limited_modify_eh(reactor *self, const event_handler *e, uint32_t events)
+{
+  as_limited(self)->interest[e] = events;
+  return 0;
+}
+
+static int limited_get_interest(reactor *self, const event_handler *e, uint32_t *events)
+{
+  map<const event_handler *, uint32_t>::const_iterator it = as_limited(self)->interest.find(e);
+  *events = (as_limited(self)->interest.end() != it) ? it->second : registered;
+  return 0;
+}
+
+static uint64_t limited_now_ns(reactor *self)
+{
+  return as_limited(self)->now;
+}
+
+static void limited_init(limited_reactor &l)
+{
+  memset(&l.r, 0, sizeof(l.r));
+  l.r.register_eh = limited_register_eh;
+  l.r.unregister_eh = limited_unregister_eh;
+  l.r.modify_eh = limited_modify_eh;
+  l.r.get_interest = limited_get_interest;
+  l.r.now_ns = limited_now_ns;
+  l.now = 1000 * MS;
+  l.timer = 0;
+}
+
+static const int timer_fd = 77;
+static uint64_t armed_ns;
+static int armed_flags;
+static int closed_fd;
+
+static int fake_timerfd_create(int clockid, int flags)
+{
+  return timer_fd;
+}
+
+static int fake_timerfd_settime(int fd, int flags, const struct itimerspec *its, struct itimerspec *old)
+{
+  armed_flags = flags;
+  armed_ns = its->it_value.tv_sec * 1000000000ULL + its->it_value.tv_nsec;
+  return 0;
+}
+
+static ssize_t fake_read(int fd, void *buf, size_t len)
+{
+  uint64_t expirations = 1;
+  memcpy(buf, &expirations, sizeof(expirations));
+  return sizeof(expirations);
+}
+
+static int fake_close(int fd)
+{
+  closed_fd = fd;
+  return 0;
+}
+
+static void fake_os_init(os &o)
+{
+  memset(&o, 0, sizeof(o));
+  o.timerfd_create = fake_timerfd_create;
+  o.timerfd_settime = fake_timerfd_settime;
+  o.read = fake_read;
+  o.close = fake_close;
+  armed_ns = 0;
+  armed_flags = 0;
+  closed_fd = -1;
+}
+
+static void fire_timer(limited_reactor &l)
+{
+  l.now = armed_ns;
+  armed_ns = 0;
+  l.timer->handle_event(l.timer, EPOLLIN);
+}
+
+TEST(tests_rate_limiter, init_with_wrong_args)
+{
+  limited_reactor l;
+  limited_init(l);
+  os o;
+  fake_os_init(o);
+  rate_limiter rl;
+  ASSERT_NE(rate_limiter_init(0, &l.r, &o), 0);
+  ASSERT_NE(rate_limiter_init(&rl, 0, &o), 0);
+  ASSERT_NE(rate_limiter_init(&rl, &l.r, 0), 0);
+  o.timerfd_settime = 0;
+  ASSERT_EQ(rate_limiter_alloc(&l.r, &o), nullptr);
+  fake_os_init(o);
+
+  rate_limiter *dyn = rate_limiter_alloc(&l.r, &o);
+  ASSERT_NE(dyn, nullptr);
+  ASSERT_EQ(l.timer->fd, timer_fd);
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  rate_bucket b;
+  rate_limit_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  ASSERT_NE(dyn->attach(dyn, &b, &eh, &cfg), 0);
+  ASSERT_NE(dyn->attach(dyn, &b, 0, &cfg), 0);
+  dyn->destroy(dyn);
+  ASSERT_EQ(l.timer, nullptr);
+  ASSERT_EQ(closed_fd, timer_fd);
+}
+
+TEST(tests_rate_limiter, exhausted_bytes_drop_read_interest_till_refill)
+{
+  limited_reactor l;
+  limited_init(l);
+  os o;
+  fake_os_init(o);
+  rate_limiter rl;
+  ASSERT_EQ(rate_limiter_init(&rl, &l.r, &o), 0);
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  rate_bucket b;
+  rate_limit_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.bytes_per_sec = 100000;
+  cfg.bytes_burst = 4000;
+  ASSERT_EQ(rl.attach(&rl, &b, &eh, &cfg), 0);
+
+  ASSERT_EQ(rl.budget(&rl, &b, 1000), 1000u);
+  ASSERT_EQ(rl.charge(&rl, &b, 1000, 1), 1);
+  ASSERT_EQ(rl.budget(&rl, &b, 8192), 3000u);
+  ASSERT_EQ(l.interest.count(&eh), 0u);
+  ASSERT_EQ(rl.charge(&rl, &b, 3000, 1), 0);
+  ASSERT_EQ(l.interest[&eh], throttled);
+  ASSERT_EQ(rl.budget(&rl, &b, 8192), 0u);
+
+  /* 10 ms worth of tokens, i.e. 1000 bytes are awaited */
+  ASSERT_EQ(armed_flags, TFD_TIMER_ABSTIME);
+  ASSERT_EQ(armed_ns, l.now + 10 * MS);
+  rate_limiter_stats stats;
+  ASSERT_EQ(rl.get_stats(&rl, &stats), 0);
+  ASSERT_EQ(stats.throttled, 1u);
+  ASSERT_EQ(stats.throttles, 1ul);
+
+  fire_timer(l);
+  ASSERT_EQ(l.interest[&eh], registered);
+  ASSERT_EQ(armed_ns, 0u);
+  ASSERT_EQ(rl.budget(&rl, &b, 8192), 1000u);
+  ASSERT_EQ(rl.get_stats(&rl, &stats), 0);
+  ASSERT_EQ(stats.throttled, 0u);
+
+  /* refill is capped by the burst */
+  l.now += 1000 * MS;
+  ASSERT_EQ(rl.budget(&rl, &b, 8192), 4000u);
+
+  rl.destroy(&rl);
+  ASSERT_EQ(rl.ctx, nullptr);
+}
+
+TEST(tests_rate_limiter, messages_limit_and_shared_timer_resumes_earliest_first)
+{
+  limited_reactor l;
+  limited_init(l);
+  os o;
+  fake_os_init(o);
+  rate_limiter rl;
+  ASSERT_EQ(rate_limiter_init(&rl, &l.r, &o), 0);
+  event_handler slow, fast;
+  memset(&slow, 0, sizeof(slow));
+  memset(&fast, 0, sizeof(fast));
+  rate_bucket sb, fb;
+  rate_limit_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.msgs_per_sec = 10;
+  ASSERT_EQ(rl.attach(&rl, &sb, &slow, &cfg), 0);
+  cfg.msgs_per_sec = 1000;
+  cfg.msgs_burst = 2;
+  ASSERT_EQ(rl.attach(&rl, &fb, &fast, &cfg), 0);
+
+  /* messages only limit does not restrict bytes */
+  ASSERT_EQ(rl.budget(&rl, &sb, 1 << 20), (size_t) (1 << 20));
+  ASSERT_EQ(rl.charge(&rl, &sb, 1 << 20, 10), 0);
+  const uint64_t slow_resume_ns = armed_ns;
+  ASSERT_EQ(slow_resume_ns, l.now + 100 * MS);
+  ASSERT_EQ(rl.charge(&rl, &fb, 10, 1), 1);
+  ASSERT_EQ(rl.charge(&rl, &fb, 10, 1), 0);
+  /* whole burst is awaited, since it is smaller than 10 ms worth of tokens */
+  ASSERT_EQ(armed_ns, l.now + 2 * MS);
+
+  fire_timer(l);
+  ASSERT_EQ(l.interest[&fast], registered);
+  ASSERT_EQ(l.interest[&slow], throttled);
+  ASSERT_EQ(armed_ns, slow_resume_ns);
+  fire_timer(l);
+  ASSERT_EQ(l.interest[&slow], registered);
+
+  rate_limiter_stats stats;
+  ASSERT_EQ(rl.get_stats(&rl, &stats), 0);
+  ASSERT_EQ(stats.throttled, 0u);
+  ASSERT_EQ(stats.throttles, 2ul);
+  rl.destroy(&rl);
+}
+
+TEST(tests_rate_limiter, detach_and_destroy_resume_throttled_handlers)
+{
+  limited_reactor l;
+  limited_init(l);
+  os o;
+  fake_os_init(o);
+  rate_limiter rl;
+  ASSERT_EQ(rate_limiter_init(&rl, &l.r, &o), 0);
+  event_handler e1, e2;
+  memset(&e1, 0, sizeof(e1));
+  memset(&e2, 0, sizeof(e2));
+  rate_bucket b1, b2;
+  rate_limit_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.bytes_per_sec = 100;
+  ASSERT_EQ(rl.attach(&rl, &b1, &e1, &cfg), 0);
+  ASSERT_EQ(rl.attach(&rl, &b2, &e2, &cfg), 0);
+  ASSERT_EQ(rl.charge(&rl, &b1, 500, 1), 0);
+  ASSERT_EQ(rl.charge(&rl, &b2, 500, 1), 0);
+  ASSERT_EQ(l.interest[&e1], throttled);
+  ASSERT_EQ(l.interest[&e2], throttled);
+
+  rl.detach(&rl, &b1);
+  ASSERT_EQ(l.interest[&e1], registered);
+  ASSERT_EQ(rl.budget(&rl, &b1, 100), 100u);
+  ASSERT_EQ(rl.charge(&rl, &b1, 100, 1), 1);
+
+  rl.destroy(&rl);
+  ASSERT_EQ(l.interest[&e2], registered);
+}
+
+TEST(tests_rate_limiter, rates_which_overflow_tokens_are_rejected)
+{
+  limited_reactor l;
+  limited_init(l);
+  os o;
+  fake_os_init(o);
+  rate_limiter rl;
+  ASSERT_EQ(rate_limiter_init(&rl, &l.r, &o), 0);
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  rate_bucket b;
+  rate_limit_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.bytes_per_sec = 10000000000ULL;
+  ASSERT_NE(rl.attach(&rl, &b, &eh, &cfg), 0);
+  cfg.bytes_per_sec = 1000;
+  cfg.msgs_burst = 10000000000ULL;
+  ASSERT_NE(rl.attach(&rl, &b, &eh, &cfg), 0);
+
+  /* 9 GB/s is still fine and huge charge only takes the whole burst plus capped debt */
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.bytes_per_sec = 9000000000ULL;
+  ASSERT_EQ(rl.attach(&rl, &b, &eh, &cfg), 0);
+  ASSERT_EQ(rl.budget(&rl, &b, (size_t) 8000000000ULL), (size_t) 8000000000ULL);
+  ASSERT_EQ(rl.charge(&rl, &b, SIZE_MAX, 1), 0);
+  ASSERT_GT(armed_ns, l.now);
+  ASSERT_LE(armed_ns, l.now + 2000 * MS);
+  fire_timer(l);
+  ASSERT_EQ(l.interest[&eh], registered);
+  l.now += 10000 * MS;
+  ASSERT_EQ(rl.budget(&rl, &b, (size_t) 9000000000ULL), (size_t) 9000000000ULL);
+
+  rl.destroy(&rl);
+}
@@ -1,10 +1,13 @@
 #ifdef __cplusplus
   extern "C" {
     #include "reactor/reactor.h"
+    #include "reactor/tracer.h"
   }
 #endif
 
 #include <string.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <vector>
 #include <map>
 #include <thread>
@@ -26,12 +29,14 @@ class mock_os: public CMockMocker<mock_os>
     CMOCK_MOCK_METHOD(int, mock_epoll_ctl, (int, int, int, struct epoll_event *));
     CMOCK_MOCK_METHOD(int, mock_epoll_wait, (int, struct epoll_event *, int, int));
     CMOCK_MOCK_METHOD(int, mock_close, (int));
+    CMOCK_MOCK_METHOD(int, mock_setsockopt, (int, int, int, const void *, socklen_t));
 };
 
 CMOCK_MOCK_FUNCTION(mock_os, int, mock_epoll_create1, (int));
 CMOCK_MOCK_FUNCTION(mock_os, int, mock_epoll_ctl, (int, int, int, struct epoll_event *));
 CMOCK_MOCK_FUNCTION(mock_os, int, mock_epoll_wait, (int, struct epoll_event *, int, int));
 CMOCK_MOCK_FUNCTION(mock_os, int, mock_close, (int fd));
+CMOCK_MOCK_FUNCTION(mock_os, int, mock_setsockopt, (int, int, int, const void *, socklen_t));
 
 class mock_eh: public CMockMocker<mock_eh>
 {
@@ -394,7 +399,7 @@ TEST(tests_reactor, destructor_after_x_eh_registration)
   for (int i = 0; i < ehs_cnt; ++i) {
     ehs[i].fd = registered_fd_starting * (i+1);
     EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, ehs[i].fd, Ne(nullptr))).WillOnce(Return(0)).RetiresOnSaturation();
-    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, ehs[i].fd, Eq(nullptr))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ehs[i].fd, _)).Times(0);
   }
 
   reactor r;
@@ -410,6 +415,64 @@ TEST(tests_reactor, destructor_after_x_eh_registration)
   ASSERT_EQ(r.ctx, nullptr);
 }
 
+TEST(tests_reactor, register_many_is_all_or_nothing_and_unregister_many_skips_unknown)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.close = mock_close;
+
+  const int epoll_fd = 5;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+
+  const int ehs_cnt = 1000;
+  vector<event_handler> ehs(ehs_cnt);
+  vector<event_handler *> batch;
+  for (int i = 0; i < ehs_cnt; ++i) {
+    ehs[i].fd = 10 + i;
+    batch.push_back(&ehs[i]);
+  }
+  event_handler dup;
+  dup.fd = ehs[0].fd;
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(r.register_many(0, batch.data(), batch.size()), 0);
+  ASSERT_NE(r.register_many(&r, 0, batch.size()), 0);
+  ASSERT_EQ(r.register_many(&r, batch.data(), 0), 0);
+
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ehs[0].fd, Ne(nullptr))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ehs[1].fd, Ne(nullptr))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ehs[1].fd, _)).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ehs[0].fd, _)).WillOnce(Return(0));
+  }
+  vector<event_handler *> with_dup = { &ehs[0], &ehs[1], &dup };
+  ASSERT_NE(r.register_many(&r, with_dup.data(), with_dup.size()), 0);
+  ASSERT_NE(r.unregister_eh(&r, &ehs[0]), 0);
+  Mock::VerifyAndClearExpectations(&mos);
+
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_ADD, _, Ne(nullptr))).Times(ehs_cnt).WillRepeatedly(Return(0));
+  ASSERT_EQ(r.register_many(&r, batch.data(), batch.size()), 0);
+  ASSERT_NE(r.register_many(&r, batch.data() + 1, 1), 0);
+  Mock::VerifyAndClearExpectations(&mos);
+
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_DEL, _, _)).Times(ehs_cnt / 2).WillRepeatedly(Return(0));
+  vector<const event_handler *> half(batch.begin(), batch.begin() + ehs_cnt / 2);
+  ASSERT_EQ(r.unregister_many(&r, half.data(), half.size()), 0);
+  half[0] = &dup;
+  ASSERT_NE(r.unregister_many(&r, half.data(), 1), 0);
+  Mock::VerifyAndClearExpectations(&mos);
+
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(_, _, _, _)).Times(0);
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
 ACTION_P(set_events, events)
 {
   ASSERT_LE(events.size(), (size_t) arg2);
@@ -436,7 +499,6 @@ TEST(tests_reactor, handle_X_events_for_one_eh)
   EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
   EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
   EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, registered_fd, Ne(nullptr))).WillOnce(Return(0));
-  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, registered_fd, Eq(nullptr))).WillOnce(Return(0));
 
   const int events_cnt = 100;
   map<int, uint32_t> events = {
@@ -519,3 +581,767 @@ TEST(tests_reactor, check_null_validation_in_public_methods)
   r->destroy(r); //just to avoid memory leak
 }
 
+
+static void stop_task(reactor *r, void *arg)
+{
+  ++*(int *) arg;
+  r->stop(r);
+}
+
+TEST(tests_reactor, posted_task_is_executed_by_event_loop)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd = 10;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _)).WillOnce(Return(0));
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(r.post(&r, 0, 0), 0);
+
+  int executed = 0;
+  ASSERT_EQ(r.post(&r, stop_task, &executed), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(executed, 1);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+TEST(tests_reactor, migrate_eh_to_another_reactor)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd1 = 10;
+  const int epoll_fd2 = 11;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd1)).WillOnce(Return(epoll_fd2));
+  EXPECT_CALL(mos, mock_close(epoll_fd1)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_close(epoll_fd2)).WillOnce(Return(0));
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_ADD, registered_fd, Ne(nullptr))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_DEL, registered_fd, Eq(nullptr))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd2, EPOLL_CTL_ADD, registered_fd, Ne(nullptr))).WillOnce(Return(0));
+  }
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd2, _, _, _)).WillOnce(Return(0));
+
+  reactor r1, r2;
+  ASSERT_EQ(reactor_init(&r1, &o), 0);
+  ASSERT_EQ(reactor_init(&r2, &o), 0);
+
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = registered_fd;
+  ASSERT_EQ(r1.register_eh(&r1, &eh), 0);
+  ASSERT_NE(r1.migrate_eh(&r1, &eh, &r1), 0);
+  ASSERT_EQ(r1.migrate_eh(&r1, &eh, &r2), 0);
+
+  int executed = 0;
+  ASSERT_EQ(r2.post(&r2, stop_task, &executed), 0);
+  r2.event_loop(&r2);
+  ASSERT_EQ(executed, 1);
+
+  reactor_load load1, load2;
+  ASSERT_EQ(r1.get_load(&r1, &load1), 0);
+  ASSERT_EQ(r2.get_load(&r2, &load2), 0);
+  ASSERT_EQ(load1.handlers, 0u);
+  ASSERT_EQ(load2.handlers, 1u);
+
+  r1.destroy(&r1);
+  r2.destroy(&r2);
+}
+
+TEST(tests_reactor, migrated_eh_returns_to_origin_if_target_is_destroyed)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd1 = 10;
+  const int epoll_fd2 = 11;
+  const int epoll_fd3 = 12;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_))
+    .WillOnce(Return(epoll_fd1)).WillOnce(Return(epoll_fd2)).WillOnce(Return(epoll_fd3));
+  EXPECT_CALL(mos, mock_close(_)).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_ADD, registered_fd, Ne(nullptr))).Times(2).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_DEL, registered_fd, Eq(nullptr))).Times(2).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _)).WillOnce(Return(0));
+
+  reactor r1, r2, r3;
+  ASSERT_EQ(reactor_init(&r1, &o), 0);
+  ASSERT_EQ(reactor_init(&r2, &o), 0);
+  ASSERT_EQ(reactor_init(&r3, &o), 0);
+
+  mock_eh meh;
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = registered_fd;
+  eh.handle_event = mock_handle_event;
+  ASSERT_EQ(r1.register_eh(&r1, &eh), 0);
+  ASSERT_EQ(r1.migrate_eh(&r1, &eh, &r2), 0);
+  r2.destroy(&r2);
+
+  int executed = 0;
+  ASSERT_EQ(r1.post(&r1, stop_task, &executed), 0);
+  r1.event_loop(&r1);
+  ASSERT_EQ(executed, 1);
+  reactor_load load;
+  ASSERT_EQ(r1.get_load(&r1, &load), 0);
+  ASSERT_EQ(load.handlers, 1u);
+
+  /* once both reactors are gone, the handler is told it is not registered anywhere */
+  ASSERT_EQ(r1.migrate_eh(&r1, &eh, &r3), 0);
+  r3.destroy(&r3);
+  EXPECT_CALL(meh, mock_handle_event(&eh, EPOLLHUP | EPOLLERR)).Times(1);
+  r1.destroy(&r1);
+}
+
+TEST(tests_reactor, migrate_eh_keeps_event_mask_and_stats)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd1 = 10;
+  const int epoll_fd2 = 11;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd1)).WillOnce(Return(epoll_fd2));
+  EXPECT_CALL(mos, mock_close(_)).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, _, registered_fd, _)).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd2, EPOLL_CTL_ADD, registered_fd,
+                                  Pointee(Field(&epoll_event::events, EPOLLOUT)))).WillOnce(Return(0));
+
+  map<int, uint32_t> events = { { registered_fd, EPOLLIN } };
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _))
+    .WillOnce(DoAll(set_events(events), Return(events.size())))
+    .WillOnce(Return(-1));
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd2, _, _, _)).WillOnce(Return(0));
+
+  mock_eh meh;
+  EXPECT_CALL(meh, mock_handle_event(_, EPOLLIN)).Times(1);
+
+  reactor r1, r2;
+  ASSERT_EQ(reactor_init(&r1, &o), 0);
+  ASSERT_EQ(reactor_init(&r2, &o), 0);
+
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = registered_fd;
+  eh.handle_event = mock_handle_event;
+  ASSERT_EQ(r1.register_eh(&r1, &eh), 0);
+  r1.event_loop(&r1);
+  ASSERT_EQ(r1.modify_eh(&r1, &eh, EPOLLOUT), 0);
+  ASSERT_EQ(r1.migrate_eh(&r1, &eh, &r2), 0);
+
+  int executed = 0;
+  ASSERT_EQ(r2.post(&r2, stop_task, &executed), 0);
+  r2.event_loop(&r2);
+  ASSERT_EQ(executed, 1);
+
+  uint32_t interest = 0;
+  ASSERT_EQ(r2.get_interest(&r2, &eh, &interest), 0);
+  ASSERT_EQ(interest, (uint32_t) EPOLLOUT);
+  reactor_eh_stats stats;
+  ASSERT_EQ(r2.get_eh_stats(&r2, &eh, &stats), 0);
+  ASSERT_EQ(stats.calls, 1u);
+
+  r1.destroy(&r1);
+  r2.destroy(&r2);
+}
+
+TEST(tests_reactor, shed_load_migrates_the_busiest_ehs_within_budget)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd1 = 10;
+  const int epoll_fd2 = 11;
+  const int busy_fd = 20;
+  const int calm_fd = 30;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd1)).WillOnce(Return(epoll_fd2));
+  EXPECT_CALL(mos, mock_close(_)).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_ADD, _, Ne(nullptr))).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_DEL, busy_fd, Eq(nullptr))).WillOnce(Return(0));
+
+  map<int, uint32_t> both = { { busy_fd, EPOLLIN }, { calm_fd, EPOLLIN } };
+  map<int, uint32_t> busy = { { busy_fd, EPOLLIN } };
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _))
+    .WillOnce(DoAll(set_events(both), Return(both.size())))
+    .WillOnce(DoAll(set_events(busy), Return(busy.size())))
+    .WillOnce(Return(-1));
+
+  mock_eh meh;
+  EXPECT_CALL(meh, mock_handle_event(_, EPOLLIN)).Times(3);
+  /* r2 is destroyed after r1, so the migrated handler can not be returned */
+  EXPECT_CALL(meh, mock_handle_event(_, EPOLLHUP | EPOLLERR)).Times(1);
+
+  reactor r1, r2;
+  ASSERT_EQ(reactor_init(&r1, &o), 0);
+  ASSERT_EQ(reactor_init(&r2, &o), 0);
+
+  event_handler busy_eh, calm_eh;
+  memset(&busy_eh, 0, sizeof(busy_eh));
+  memset(&calm_eh, 0, sizeof(calm_eh));
+  busy_eh.fd = busy_fd;
+  busy_eh.handle_event = mock_handle_event;
+  calm_eh.fd = calm_fd;
+  calm_eh.handle_event = mock_handle_event;
+  ASSERT_EQ(r1.register_eh(&r1, &busy_eh), 0);
+  ASSERT_EQ(r1.register_eh(&r1, &calm_eh), 0);
+  r1.event_loop(&r1);
+
+  reactor_load load;
+  ASSERT_EQ(r1.get_load(&r1, &load), 0);
+  ASSERT_EQ(load.events, 3u);
+
+  ASSERT_EQ(r1.shed_load(&r1, &r2, 1.5, 10, 0), -1);
+  ASSERT_EQ(r1.shed_load(&r1, &r2, 0.7, 10, 0), 1);
+  ASSERT_EQ(r1.shed_load(&r1, &r2, 0.7, 10, 0), 0);
+
+  r1.destroy(&r1);
+  r2.destroy(&r2);
+}
+
+TEST(tests_reactor, shed_load_moves_hot_ehs_after_calm_intervals)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd1 = 10;
+  const int epoll_fd2 = 11;
+  const int hot_fd = 20;
+  const int warm_fd = 30;
+  const int calm_fd = 40;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd1)).WillOnce(Return(epoll_fd2));
+  EXPECT_CALL(mos, mock_close(_)).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_ADD, _, Ne(nullptr))).WillRepeatedly(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd1, EPOLL_CTL_DEL, hot_fd, Eq(nullptr))).WillOnce(Return(0));
+
+  /* five calm intervals, which do not trigger shedding, are followed by the spike */
+  map<int, uint32_t> calm = { { hot_fd, EPOLLIN }, { warm_fd, EPOLLIN }, { calm_fd, EPOLLIN } };
+  map<int, uint32_t> spike = { { hot_fd, EPOLLIN }, { warm_fd, EPOLLIN } };
+  map<int, uint32_t> hot = { { hot_fd, EPOLLIN } };
+  {
+    InSequence s;
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _))
+        .WillOnce(DoAll(set_events(calm), Return(calm.size())))
+        .RetiresOnSaturation();
+    }
+    for (int i = 0; i < 4; ++i) {
+      EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _))
+        .WillOnce(DoAll(set_events(spike), Return(spike.size())))
+        .RetiresOnSaturation();
+    }
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _))
+      .WillOnce(DoAll(set_events(hot), Return(hot.size())))
+      .RetiresOnSaturation();
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd1, _, _, _)).WillOnce(Return(-1)).RetiresOnSaturation();
+  }
+
+  mock_eh meh;
+  EXPECT_CALL(meh, mock_handle_event(_, EPOLLIN)).Times(24);
+
+  reactor r1, r2;
+  ASSERT_EQ(reactor_init(&r1, &o), 0);
+  ASSERT_EQ(reactor_init(&r2, &o), 0);
+
+  event_handler ehs[3];
+  memset(ehs, 0, sizeof(ehs));
+  ehs[0].fd = hot_fd;
+  ehs[1].fd = warm_fd;
+  ehs[2].fd = calm_fd;
+  for (event_handler &eh: ehs) {
+    eh.handle_event = mock_handle_event;
+    ASSERT_EQ(r1.register_eh(&r1, &eh), 0);
+  }
+  r1.event_loop(&r1);
+
+  /* spike has 9 events, its half would fit neither of windows of 10, 9 and 5 events */
+  ASSERT_EQ(r1.shed_load(&r1, &r2, 0.5, 10, 0), 1);
+  uint32_t interest = 0;
+  ASSERT_NE(r1.get_interest(&r1, &ehs[0], &interest), 0);
+  ASSERT_EQ(r1.get_interest(&r1, &ehs[1], &interest), 0);
+
+  EXPECT_CALL(meh, mock_handle_event(&ehs[0], EPOLLHUP | EPOLLERR)).Times(1);
+  r1.destroy(&r1);
+  r2.destroy(&r2);
+}
+
+TEST(tests_reactor, modify_eh_changes_events_of_registered_eh_only)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+
+  const int epoll_fd = 10;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_ADD, registered_fd, Ne(nullptr))).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, EPOLL_CTL_MOD, registered_fd,
+                                  Pointee(Field(&epoll_event::events, EPOLLOUT)))).WillOnce(Return(0));
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  event_handler eh, other;
+  memset(&eh, 0, sizeof(eh));
+  memset(&other, 0, sizeof(other));
+  eh.fd = registered_fd;
+  other.fd = registered_fd;
+  ASSERT_NE(r.modify_eh(&r, &eh, EPOLLOUT), 0);
+  ASSERT_EQ(r.register_eh(&r, &eh), 0);
+  uint32_t events = 0;
+  ASSERT_EQ(r.get_interest(&r, &eh, &events), 0);
+  ASSERT_EQ(events, (uint32_t) EPOLLIN);
+  ASSERT_NE(r.modify_eh(&r, &other, EPOLLOUT), 0);
+  ASSERT_NE(r.get_interest(&r, &other, &events), 0);
+  ASSERT_EQ(r.modify_eh(&r, &eh, EPOLLOUT), 0);
+  ASSERT_EQ(r.get_interest(&r, &eh, &events), 0);
+  ASSERT_EQ(events, (uint32_t) EPOLLOUT);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+static void record_phase_hook(reactor *r, void *arg)
+{
+  vector<int> *calls = (vector<int> *) arg;
+  calls->push_back(calls->size());
+  if (4 <= calls->size())
+    r->stop(r);
+}
+
+static void remove_itself_hook(reactor *r, void *arg)
+{
+  ++*(int *) arg;
+  r->remove_hook(r, REACTOR_PHASE_CHECK, remove_itself_hook, arg);
+}
+
+TEST(tests_reactor, hooks_are_called_in_phase_order_and_can_remove_themselves)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd = 10;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _)).Times(2).WillRepeatedly(Return(0));
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  vector<int> prepare_calls, check_calls;
+  int removed_calls = 0;
+  ASSERT_NE(r.add_hook(&r, REACTOR_PHASE_CHECK, 0, 0), 0);
+  ASSERT_NE(r.remove_hook(&r, REACTOR_PHASE_CHECK, remove_itself_hook, 0), 0);
+  ASSERT_EQ(r.add_hook(&r, REACTOR_PHASE_CHECK, remove_itself_hook, &removed_calls), 0);
+  ASSERT_EQ(r.add_hook(&r, REACTOR_PHASE_PREPARE, record_phase_hook, &prepare_calls), 0);
+  ASSERT_EQ(r.add_hook(&r, REACTOR_PHASE_CHECK, record_phase_hook, &prepare_calls), 0);
+  ASSERT_EQ(r.add_hook(&r, REACTOR_PHASE_CHECK, record_phase_hook, &check_calls), 0);
+  ASSERT_EQ(r.remove_hook(&r, REACTOR_PHASE_CHECK, record_phase_hook, &check_calls), 0);
+  r.event_loop(&r);
+
+  ASSERT_EQ(prepare_calls, vector<int>({ 0, 1, 2, 3 }));
+  ASSERT_TRUE(check_calls.empty());
+  ASSERT_EQ(removed_calls, 1);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+static int flush_cnt = 0;
+
+MATCHER_P(points_to_int, value, "")
+{
+  return value == *(const int *) arg;
+}
+
+static void count_flush(event_handler *e)
+{
+  ++flush_cnt;
+}
+
+TEST(tests_reactor, defer_flush_corks_socket_and_flushes_once_per_batch)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+  o.setsockopt = mock_setsockopt;
+
+  const int epoll_fd = 10;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, registered_fd, Ne(nullptr))).WillOnce(Return(0));
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_setsockopt(registered_fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(1), sizeof(int))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_setsockopt(registered_fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(0), sizeof(int))).WillOnce(Return(0));
+  }
+
+  map<int, uint32_t> events = { { registered_fd, EPOLLIN } };
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _))
+      .WillOnce(DoAll(set_events(events), Return(events.size())))
+      .RetiresOnSaturation();
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _)).WillOnce(Return(-1)).RetiresOnSaturation();
+  }
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  mock_eh meh;
+  event_handler eh, other;
+  memset(&eh, 0, sizeof(eh));
+  memset(&other, 0, sizeof(other));
+  eh.fd = registered_fd;
+  eh.handle_event = mock_handle_event;
+  other.fd = registered_fd;
+  EXPECT_CALL(meh, mock_handle_event(&eh, EPOLLIN)).WillOnce(Invoke([&r, &other] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+    ASSERT_NE(r.defer_flush(&r, &other, count_flush), 0);
+    ASSERT_EQ(flush_cnt, 0);
+  }));
+
+  flush_cnt = 0;
+  ASSERT_NE(r.defer_flush(&r, &eh, count_flush), 0);
+  ASSERT_EQ(r.register_eh(&r, &eh), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(flush_cnt, 1);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+static void unregister_and_free_flush(event_handler *e)
+{
+  reactor *r = (reactor *) e->ctx;
+  ++flush_cnt;
+  r->unregister_eh(r, e);
+  delete e;
+}
+
+TEST(tests_reactor, defer_flush_survives_handlers_unregistered_and_freed)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+  o.setsockopt = mock_setsockopt;
+
+  const int epoll_fd = 10;
+  const int early_fd = 20;
+  const int late_fd = 30;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, _, _)).WillRepeatedly(Return(0));
+  for (int fd: { early_fd, late_fd }) {
+    InSequence s;
+    EXPECT_CALL(mos, mock_setsockopt(fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(1), sizeof(int))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_setsockopt(fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(0), sizeof(int))).WillOnce(Return(0));
+  }
+
+  map<int, uint32_t> events = { { early_fd, EPOLLIN }, { late_fd, EPOLLIN } };
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _))
+    .WillOnce(DoAll(set_events(events), Return(events.size())))
+    .WillOnce(Return(-1));
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  /* early one is freed by late one before flushes, late one frees itself in its flush */
+  mock_eh meh;
+  event_handler *early = new event_handler();
+  event_handler *late = new event_handler();
+  early->fd = early_fd;
+  early->ctx = &r;
+  early->handle_event = mock_handle_event;
+  late->fd = late_fd;
+  late->ctx = &r;
+  late->handle_event = mock_handle_event;
+  EXPECT_CALL(meh, mock_handle_event(early, EPOLLIN)).WillOnce(Invoke([&r] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+  }));
+  EXPECT_CALL(meh, mock_handle_event(late, EPOLLIN)).WillOnce(Invoke([&r, early] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, unregister_and_free_flush), 0);
+    ASSERT_EQ(r.unregister_eh(&r, early), 0);
+    delete early;
+  }));
+
+  flush_cnt = 0;
+  ASSERT_EQ(r.register_eh(&r, early), 0);
+  ASSERT_EQ(r.register_eh(&r, late), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(flush_cnt, 1);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+TEST(tests_reactor, unregister_many_cancels_flushes_of_whole_batch)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+  o.setsockopt = mock_setsockopt;
+
+  const int epoll_fd = 10;
+  const vector<int> fds = { 20, 30, 40 };
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, _, _)).WillRepeatedly(Return(0));
+  for (int fd: fds) {
+    InSequence s;
+    EXPECT_CALL(mos, mock_setsockopt(fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(1), sizeof(int))).WillOnce(Return(0));
+    EXPECT_CALL(mos, mock_setsockopt(fd, IPPROTO_TCP, TCP_CORK,
+                                     points_to_int(0), sizeof(int))).WillOnce(Return(0));
+  }
+
+  map<int, uint32_t> events = { { fds[0], EPOLLIN }, { fds[1], EPOLLIN }, { fds[2], EPOLLIN } };
+  EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _))
+    .WillOnce(DoAll(set_events(events), Return(events.size())))
+    .WillOnce(Return(-1));
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  /* the last handler unregisters the first two ones after all of them deferred flushes */
+  mock_eh meh;
+  event_handler ehs[3];
+  memset(ehs, 0, sizeof(ehs));
+  for (size_t i = 0; i < 3; ++i) {
+    ehs[i].fd = fds[i];
+    ehs[i].handle_event = mock_handle_event;
+    ASSERT_EQ(r.register_eh(&r, &ehs[i]), 0);
+  }
+  EXPECT_CALL(meh, mock_handle_event(&ehs[0], EPOLLIN)).WillOnce(Invoke([&r] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+  }));
+  EXPECT_CALL(meh, mock_handle_event(&ehs[1], EPOLLIN)).WillOnce(Invoke([&r] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+  }));
+  EXPECT_CALL(meh, mock_handle_event(&ehs[2], EPOLLIN)).WillOnce(Invoke([&r, &ehs] (event_handler *e, uint32_t) {
+    ASSERT_EQ(r.defer_flush(&r, e, count_flush), 0);
+    const event_handler *batch[2] = { &ehs[0], &ehs[1] };
+    ASSERT_EQ(r.unregister_many(&r, batch, 2), 0);
+  }));
+
+  flush_cnt = 0;
+  r.event_loop(&r);
+  ASSERT_EQ(flush_cnt, 1);
+  reactor_load load;
+  ASSERT_EQ(r.get_load(&r, &load), 0);
+  ASSERT_EQ(load.handlers, 1u);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+static uint64_t fake_clock_ns = 0;
+
+static int fake_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  fake_clock_ns += 1000;
+  ts->tv_sec = fake_clock_ns / 1000000000ULL;
+  ts->tv_nsec = fake_clock_ns % 1000000000ULL;
+  return 0;
+}
+
+TEST(tests_reactor, accounting_measures_handler_wall_time_and_calls)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd = 10;
+  const int registered_fd = 20;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, registered_fd, Ne(nullptr))).WillOnce(Return(0));
+
+  map<int, uint32_t> events = { { registered_fd, EPOLLIN } };
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _))
+      .Times(3)
+      .WillRepeatedly(DoAll(set_events(events), Return(events.size())))
+      .RetiresOnSaturation();
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _)).WillOnce(Return(-1)).RetiresOnSaturation();
+  }
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+  ASSERT_NE(r.set_accounting(&r, REACTOR_ACCOUNT_WALL), 0);
+  o.clock_gettime = fake_clock_gettime;
+  ASSERT_NE(r.set_accounting(&r, 0x80), 0);
+  ASSERT_EQ(r.set_accounting(&r, REACTOR_ACCOUNT_WALL), 0);
+
+  mock_eh meh;
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = registered_fd;
+  eh.handle_event = mock_handle_event;
+  EXPECT_CALL(meh, mock_handle_event(&eh, EPOLLIN)).Times(3).WillRepeatedly(Invoke([&r] (event_handler *e, uint32_t) {
+    reactor_activity activity;
+    ASSERT_EQ(r.get_activity(&r, &activity), 0);
+    ASSERT_EQ(activity.running, 1);
+    ASSERT_EQ(activity.eh, e);
+    ASSERT_EQ(activity.fd, e->fd);
+    ASSERT_GT(activity.busy_ns, 0u);
+  }));
+
+  reactor_eh_stats stats;
+  ASSERT_NE(r.get_eh_stats(&r, &eh, &stats), 0);
+  ASSERT_EQ(r.register_eh(&r, &eh), 0);
+  r.event_loop(&r);
+
+  ASSERT_EQ(r.get_eh_stats(&r, &eh, &stats), 0);
+  ASSERT_EQ(stats.calls, 3u);
+  ASSERT_GT(stats.wall_ns, 0u);
+  ASSERT_GE(stats.wall_ns, stats.max_wall_ns);
+  ASSERT_EQ(stats.cpu_ns, 0u);
+
+  reactor_activity activity;
+  ASSERT_EQ(r.get_activity(&r, &activity), 0);
+  ASSERT_EQ(activity.running, 0);
+  ASSERT_EQ(activity.eh, nullptr);
+  ASSERT_EQ(activity.fd, -1);
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
+
+static vector<int> traced_enabled;
+static vector<int> traced_sampled;
+
+static int fake_tracer_enable(tracer *self, int fd)
+{
+  traced_enabled.push_back(fd);
+  return 0;
+}
+
+static int fake_tracer_sample(tracer *self, int fd)
+{
+  traced_sampled.push_back(fd);
+  return 0;
+}
+
+TEST(tests_reactor, tracer_is_enabled_on_sockets_and_samples_readable_ones)
+{
+  mock_os mos;
+  os o;
+  memset(&o, 0 ,sizeof(os));
+  o.epoll_create1 = mock_epoll_create1;
+  o.close = mock_close;
+  o.epoll_ctl = mock_epoll_ctl;
+  o.epoll_wait = mock_epoll_wait;
+
+  const int epoll_fd = 10;
+  EXPECT_CALL(mos, mock_epoll_create1(_)).WillOnce(Return(epoll_fd));
+  EXPECT_CALL(mos, mock_close(epoll_fd)).WillOnce(Return(0));
+  EXPECT_CALL(mos, mock_epoll_ctl(epoll_fd, _, _, _)).WillRepeatedly(Return(0));
+
+  map<int, uint32_t> events = { { 20, EPOLLIN }, { 21, EPOLLOUT } };
+  {
+    InSequence s;
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _))
+      .WillOnce(DoAll(set_events(events), Return(events.size())))
+      .RetiresOnSaturation();
+    EXPECT_CALL(mos, mock_epoll_wait(epoll_fd, _, _, _)).WillOnce(Return(-1)).RetiresOnSaturation();
+  }
+
+  reactor r;
+  ASSERT_EQ(reactor_init(&r, &o), 0);
+
+  mock_eh meh;
+  event_handler ehs[2];
+  memset(ehs, 0, sizeof(ehs));
+  for (int i = 0; i < 2; ++i) {
+    ehs[i].fd = 20 + i;
+    ehs[i].handle_event = mock_handle_event;
+  }
+  EXPECT_CALL(meh, mock_handle_event(_, _)).Times(2);
+
+  tracer t;
+  memset(&t, 0, sizeof(t));
+  t.enable = fake_tracer_enable;
+  t.sample = fake_tracer_sample;
+  traced_enabled.clear();
+  traced_sampled.clear();
+
+  ASSERT_EQ(r.register_eh(&r, &ehs[0]), 0);
+  ASSERT_EQ(r.set_tracer(&r, &t), 0);
+  ASSERT_EQ(r.register_eh(&r, &ehs[1]), 0);
+  r.event_loop(&r);
+  ASSERT_EQ(r.set_tracer(&r, 0), 0);
+
+  ASSERT_EQ(traced_enabled, vector<int>({ 20, 21 }));
+  ASSERT_EQ(traced_sampled, vector<int>({ 20 }));
+
+  r.destroy(&r);
+  ASSERT_EQ(r.ctx, nullptr);
+}
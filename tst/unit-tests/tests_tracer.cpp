@@ -0,0 +1,151 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/tracer.h"
+  }
+#endif
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+static uint64_t fake_kernel_ns = 0;
+static uint64_t fake_now_ns = 0;
+
+static ssize_t fake_recvmsg(int fd, struct msghdr *msg, int flags)
+{
+  if (!(flags & MSG_PEEK))
+    return -1;
+
+  struct timespec ts;
+  ts.tv_sec = fake_kernel_ns / 1000000000ULL;
+  ts.tv_nsec = fake_kernel_ns % 1000000000ULL;
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_TIMESTAMPNS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(ts));
+  memcpy(CMSG_DATA(cmsg), &ts, sizeof(ts));
+  msg->msg_controllen = CMSG_SPACE(sizeof(ts));
+
+  return 1;
+}
+
+static int fake_clock_gettime(clockid_t clock, struct timespec *ts)
+{
+  ts->tv_sec = fake_now_ns / 1000000000ULL;
+  ts->tv_nsec = fake_now_ns % 1000000000ULL;
+  return 0;
+}
+
+static int fake_setsockopt(int, int, int, const void *, socklen_t)
+{
+  return 0;
+}
+
+static string read_all(int fd)
+{
+  string res;
+  char buf[256];
+  ssize_t len = 0;
+  while (0 < (len = read(fd, buf, sizeof(buf))))
+    res.append(buf, len);
+  return res;
+}
+
+TEST(tests_tracer, init_requires_os_calls)
+{
+  os o;
+  memset(&o, 0, sizeof(o));
+  tracer t;
+  ASSERT_NE(tracer_init(0, &o, 0), 0);
+  ASSERT_NE(tracer_init(&t, 0, 0), 0);
+  ASSERT_NE(tracer_init(&t, &o, 0), 0);
+  ASSERT_EQ(tracer_alloc(&o, 0), nullptr);
+}
+
+TEST(tests_tracer, samples_go_to_histogram_and_ring_keeps_the_latest)
+{
+  os o;
+  os_linux_init(&o);
+  o.setsockopt = fake_setsockopt;
+  o.recvmsg = fake_recvmsg;
+  o.clock_gettime = fake_clock_gettime;
+
+  tracer *t = tracer_alloc(&o, 3);
+  ASSERT_NE(t, nullptr);
+  ASSERT_EQ(t->enable(t, 5), 0);
+
+  const uint64_t delays[] = { 0, 1, 1000, 1500, 5000000 };
+  for (uint64_t delay: delays) {
+    fake_kernel_ns = 1000000000ULL;
+    fake_now_ns = fake_kernel_ns + delay;
+    ASSERT_EQ(t->sample(t, 5), 0);
+  }
+
+  tracer_histogram h;
+  ASSERT_EQ(t->get_histogram(t, &h), 0);
+  ASSERT_EQ(h.samples, 5u);
+  ASSERT_EQ(h.sum_ns, 5002501u);
+  ASSERT_EQ(h.max_ns, 5000000u);
+  ASSERT_EQ(h.buckets[0], 2u);
+  ASSERT_EQ(h.buckets[9], 1u);
+  ASSERT_EQ(h.buckets[10], 1u);
+  ASSERT_EQ(h.buckets[22], 1u);
+
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(t->dump(t, fds[1]), 4);
+  close(fds[1]);
+  ASSERT_EQ(read_all(fds[0]), "5 1000000000 1000000001 1\n"
+                              "5 1000000000 1000001000 1000\n"
+                              "5 1000000000 1000001500 1500\n"
+                              "5 1000000000 1005000000 5000000\n");
+  close(fds[0]);
+
+  t->destroy(t);
+}
+
+TEST(tests_tracer, kernel_timestamp_of_udp_datagram_is_sampled)
+{
+  os o;
+  os_linux_init(&o);
+  tracer t;
+  ASSERT_EQ(tracer_init(&t, &o, 16), 0);
+
+  const int rx = socket(AF_INET, SOCK_DGRAM, 0);
+  const int tx = socket(AF_INET, SOCK_DGRAM, 0);
+  ASSERT_GE(rx, 0);
+  ASSERT_GE(tx, 0);
+  struct sockaddr_in addr;
+  socklen_t addr_len = sizeof(addr);
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(bind(rx, (struct sockaddr *) &addr, sizeof(addr)), 0);
+  ASSERT_EQ(getsockname(rx, (struct sockaddr *) &addr, &addr_len), 0);
+  ASSERT_EQ(t.enable(&t, rx), 0);
+
+  ASSERT_NE(t.sample(&t, rx), 0);
+  ASSERT_EQ(sendto(tx, "x", 1, 0, (struct sockaddr *) &addr, addr_len), 1);
+  usleep(1000);
+  ASSERT_EQ(t.sample(&t, rx), 0);
+
+  char byte = 0;
+  ASSERT_EQ(recv(rx, &byte, 1, MSG_DONTWAIT), 1);
+  ASSERT_EQ(byte, 'x');
+
+  tracer_histogram h;
+  ASSERT_EQ(t.get_histogram(&t, &h), 0);
+  ASSERT_EQ(h.samples, 1u);
+  ASSERT_LT(h.max_ns, 10000000000u);
+
+  close(rx);
+  close(tx);
+  t.destroy(&t);
+  ASSERT_EQ(t.ctx, nullptr);
+}
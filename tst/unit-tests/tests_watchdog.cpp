@@ -0,0 +1,163 @@
+#ifdef __cplusplus
+  extern "C" {
+    #include "reactor/watchdog.h"
+  }
+#endif
+
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace std;
+using namespace testing;
+
+struct fake_reactor {
+  reactor r;
+  atomic<uint64_t> busy_ns;
+  const event_handler *eh;
+};
+
+static fake_reactor * as_fake(reactor *r)
+{
+  return reinterpret_cast<fake_reactor *>(r);
+}
+
+static int fake_get_activity(reactor *self, reactor_activity *activity)
+{
+  memset(activity, 0, sizeof(reactor_activity));
+  activity->busy_ns = as_fake(self)->busy_ns.load();
+  activity->eh = as_fake(self)->eh;
+  activity->fd = (activity->eh) ? activity->eh->fd : -1;
+  return 0;
+}
+
+struct stall_log {
+  mutex lock;
+  vector<watchdog_report> reports;
+};
+
+static void log_stall(watchdog *w, const watchdog_report *report, void *arg)
+{
+  stall_log *log = (stall_log *) arg;
+  lock_guard<mutex> guard(log->lock);
+  log->reports.push_back(*report);
+}
+
+static size_t wait_for_reports(stall_log &log, size_t cnt)
+{
+  for (int i = 0; i < 200; ++i) {
+    {
+      lock_guard<mutex> guard(log.lock);
+      if (log.reports.size() >= cnt)
+        return log.reports.size();
+    }
+    this_thread::sleep_for(chrono::milliseconds(5));
+  }
+
+  lock_guard<mutex> guard(log.lock);
+  return log.reports.size();
+}
+
+TEST(tests_watchdog, init_and_destroy_with_nulls)
+{
+  ASSERT_NE(watchdog_init(0, 0, 0, 0), 0);
+
+  watchdog_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  watchdog *w = watchdog_alloc(&cfg, 0, 0);
+  ASSERT_NE(w, nullptr);
+  ASSERT_NE(w->watch(w, 0), 0);
+  ASSERT_NE(w->unwatch(w, 0), 0);
+  w->destroy(w);
+}
+
+TEST(tests_watchdog, only_one_watchdog_dumps_backtraces)
+{
+  watchdog_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.signo = SIGRTMIN;
+
+  watchdog first, second;
+  ASSERT_EQ(watchdog_init(&first, &cfg, 0, 0), 0);
+  ASSERT_NE(watchdog_init(&second, &cfg, 0, 0), 0);
+  cfg.signo = SIGRTMIN + 1;
+  ASSERT_NE(watchdog_init(&second, &cfg, 0, 0), 0);
+
+  /* watchdog without dumping does not touch the handler */
+  cfg.signo = 0;
+  ASSERT_EQ(watchdog_init(&second, &cfg, 0, 0), 0);
+  second.destroy(&second);
+
+  first.destroy(&first);
+  cfg.signo = SIGRTMIN;
+  ASSERT_EQ(watchdog_init(&second, &cfg, 0, 0), 0);
+  second.destroy(&second);
+}
+
+TEST(tests_watchdog, watch_rejects_duplicates_and_unwatch_unknown)
+{
+  watchdog_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  fake_reactor fr;
+  memset(&fr.r, 0, sizeof(fr.r));
+  fr.r.get_activity = fake_get_activity;
+  fr.busy_ns = 0;
+  fr.eh = 0;
+
+  watchdog w;
+  ASSERT_EQ(watchdog_init(&w, &cfg, 0, 0), 0);
+  ASSERT_EQ(w.watch(&w, &fr.r), 0);
+  ASSERT_NE(w.watch(&w, &fr.r), 0);
+  ASSERT_EQ(w.unwatch(&w, &fr.r), 0);
+  ASSERT_NE(w.unwatch(&w, &fr.r), 0);
+  w.destroy(&w);
+  ASSERT_EQ(w.ctx, nullptr);
+}
+
+TEST(tests_watchdog, stall_over_budget_is_reported_once_per_batch)
+{
+  watchdog_config cfg;
+  memset(&cfg, 0, sizeof(cfg));
+  cfg.budget_ms = 20;
+  cfg.period_ms = 1;
+
+  event_handler eh;
+  memset(&eh, 0, sizeof(eh));
+  eh.fd = 7;
+
+  fake_reactor fr;
+  memset(&fr.r, 0, sizeof(fr.r));
+  fr.r.get_activity = fake_get_activity;
+  fr.busy_ns = 5000000;
+  fr.eh = &eh;
+
+  stall_log log;
+  watchdog w;
+  ASSERT_EQ(watchdog_init(&w, &cfg, log_stall, &log), 0);
+  ASSERT_EQ(w.watch(&w, &fr.r), 0);
+
+  this_thread::sleep_for(chrono::milliseconds(20));
+  ASSERT_EQ(wait_for_reports(log, 0), 0u);
+
+  fr.busy_ns = 30000000;
+  ASSERT_EQ(wait_for_reports(log, 1), 1u);
+  fr.busy_ns = 40000000;
+  this_thread::sleep_for(chrono::milliseconds(20));
+  ASSERT_EQ(wait_for_reports(log, 1), 1u);
+
+  fr.busy_ns = 0;
+  this_thread::sleep_for(chrono::milliseconds(20));
+  fr.busy_ns = 25000000;
+  ASSERT_EQ(wait_for_reports(log, 2), 2u);
+
+  ASSERT_EQ(w.unwatch(&w, &fr.r), 0);
+  w.destroy(&w);
+
+  ASSERT_EQ(log.reports[0].r, &fr.r);
+  ASSERT_EQ(log.reports[0].eh, &eh);
+  ASSERT_EQ(log.reports[0].fd, 7);
+  ASSERT_EQ(log.reports[0].stalled_ns, 30000000u);
+}